@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <lsl_cpp.h>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/* Sweep a matrix of stream configurations over loopback and report throughput, CPU usage and
+ * end-to-end latency percentiles of each as JSON, e.g.:
+ *   BenchmarkMatrix --formats float32,int16 --channels 1,64 --rates 1000,0 --chunks 1,32
+ *                   --inlets 1,4 --outlets 1,2 --duration 5 --output results.json
+ * A rate of 0 pushes as fast as possible. Every sample is stamped with the time at which it was
+ * pushed, so the latency is measured from the push call until the sample was pulled. */
+
+// one point of the benchmark matrix
+struct config {
+	std::string format;
+	int channels, chunk, inlets, outlets;
+	double rate, duration;
+};
+
+// the measurements for one point of the matrix
+struct result {
+	double pushed = 0, received = 0, push_time = 0, wall_time = 0, cpu_time = 0;
+	std::vector<double> latencies;
+};
+
+const std::map<std::string, lsl::channel_format_t> formats{{"int8", lsl::cf_int8},
+    {"int16", lsl::cf_int16}, {"int32", lsl::cf_int32}, {"int64", lsl::cf_int64},
+    {"float32", lsl::cf_float32}, {"double64", lsl::cf_double64}, {"string", lsl::cf_string}};
+
+// get the CPU time (user+system) consumed by the process so far, in seconds
+double process_cpu_time() {
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+	auto seconds = [](const FILETIME& t) {
+		return (((unsigned long long)t.dwHighDateTime << 32) | t.dwLowDateTime) * 1e-7;
+	};
+	return seconds(kernel) + seconds(user);
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec +
+	       usage.ru_stime.tv_usec * 1e-6;
+#endif
+}
+
+template <class T> void fill(std::vector<T>& buffer) {
+	for (std::size_t k = 0; k < buffer.size(); k++) buffer[k] = static_cast<T>(k % 100);
+}
+void fill(std::vector<std::string>& buffer) {
+	for (std::size_t k = 0; k < buffer.size(); k++) buffer[k] = std::to_string(k % 100000);
+}
+
+// push chunks at the configured rate until told to stop; returns the number of samples pushed
+template <class T>
+double run_outlet(lsl::stream_outlet& outlet, const config& cfg, const std::atomic<bool>& stop) {
+	std::vector<T> chunk(cfg.chunk * cfg.channels);
+	std::vector<double> stamps(cfg.chunk);
+	fill(chunk);
+	double start = lsl::local_clock(), pushed = 0;
+	while (!stop) {
+		if (cfg.rate > 0 && pushed + cfg.chunk > (lsl::local_clock() - start) * cfg.rate) {
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			continue;
+		}
+		std::fill(stamps.begin(), stamps.end(), lsl::local_clock());
+		outlet.push_chunk_multiplexed(&chunk[0], &stamps[0], chunk.size());
+		pushed += cfg.chunk;
+	}
+	return pushed;
+}
+
+// pull samples until told to stop and the inlet has run dry; records the latency of each sample
+template <class T>
+void run_inlet(lsl::stream_inlet& inlet, const config& cfg, const std::atomic<bool>& stop,
+    double& received, std::vector<double>& latencies) {
+	const int max_chunk = std::max(cfg.chunk, 1024);
+	std::vector<T> buffer(max_chunk * cfg.channels);
+	std::vector<double> stamps(max_chunk);
+	while (true) {
+		// block for the first sample, then pick up whatever else has arrived
+		double ts = inlet.pull_sample(&buffer[0], cfg.channels, 0.2);
+		if (!ts) {
+			if (stop) break;
+			continue;
+		}
+		double now = lsl::local_clock();
+		latencies.push_back(now - ts);
+		std::size_t n = inlet.pull_chunk_multiplexed(
+		                    &buffer[0], &stamps[0], buffer.size(), stamps.size(), 0.0) /
+		                cfg.channels;
+		if (n) now = lsl::local_clock();
+		for (std::size_t k = 0; k < n; k++) latencies.push_back(now - stamps[k]);
+		received += 1 + n;
+	}
+}
+
+// run one point of the benchmark matrix
+template <class T> result run_config(const config& cfg, int index) {
+	static const std::string session = std::to_string(lsl::local_clock());
+	result res;
+	// create the outlets and connect the inlets to them
+	std::vector<std::unique_ptr<lsl::stream_outlet>> outlets;
+	std::vector<std::unique_ptr<lsl::stream_inlet>> inlets;
+	for (int o = 0; o < cfg.outlets; o++) {
+		std::string id = "BenchmarkMatrix_" + session + "_" + std::to_string(index) + "_" +
+		                 std::to_string(o);
+		lsl::stream_info info("BenchmarkMatrix" + std::to_string(o), "Benchmark", cfg.channels,
+		    cfg.rate > 0 ? cfg.rate : lsl::IRREGULAR_RATE, formats.at(cfg.format), id);
+		outlets.emplace_back(new lsl::stream_outlet(info, cfg.chunk));
+		auto found = lsl::resolve_stream("source_id", id, 1, 10.0);
+		if (found.empty()) throw std::runtime_error("Could not resolve the outlet " + id);
+		for (int i = 0; i < cfg.inlets; i++) {
+			inlets.emplace_back(new lsl::stream_inlet(found[0], 360, 0, false));
+			inlets.back()->open_stream(10.0);
+		}
+	}
+	// let everything settle before taking the measurements
+	std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+	std::atomic<bool> stop_outlets(false), stop_inlets(false);
+	std::vector<double> pushed(outlets.size()), received(inlets.size());
+	std::vector<std::vector<double>> latencies(inlets.size());
+	std::vector<std::thread> threads;
+	double cpu_start = process_cpu_time(), wall_start = lsl::local_clock();
+	for (std::size_t i = 0; i < inlets.size(); i++)
+		threads.emplace_back([&, i]() {
+			run_inlet<T>(*inlets[i], cfg, stop_inlets, received[i], latencies[i]);
+		});
+	for (std::size_t o = 0; o < outlets.size(); o++)
+		threads.emplace_back([&, o]() { pushed[o] = run_outlet<T>(*outlets[o], cfg, stop_outlets); });
+	std::this_thread::sleep_for(std::chrono::duration<double>(cfg.duration));
+	stop_outlets = true;
+	stop_inlets = true;
+	res.push_time = lsl::local_clock() - wall_start;
+	for (auto& t : threads) t.join();
+	res.wall_time = lsl::local_clock() - wall_start;
+	res.cpu_time = process_cpu_time() - cpu_start;
+
+	for (double p : pushed) res.pushed += p;
+	for (double r : received) res.received += r;
+	for (auto& l : latencies) res.latencies.insert(res.latencies.end(), l.begin(), l.end());
+	std::sort(res.latencies.begin(), res.latencies.end());
+	return res;
+}
+
+result run_config(const config& cfg, int index) {
+	switch (formats.at(cfg.format)) {
+	case lsl::cf_int8: return run_config<char>(cfg, index);
+	case lsl::cf_int16: return run_config<short>(cfg, index);
+	case lsl::cf_int32: return run_config<int>(cfg, index);
+	case lsl::cf_float32: return run_config<float>(cfg, index);
+	case lsl::cf_string: return run_config<std::string>(cfg, index);
+	default: return run_config<double>(cfg, index);
+	}
+}
+
+// get the given percentile (0-100) of a sorted list of values
+double percentile(const std::vector<double>& sorted, double p) {
+	if (sorted.empty()) return 0;
+	return sorted[std::min(sorted.size() - 1, (std::size_t)(p / 100.0 * sorted.size()))];
+}
+
+// write the result of one point of the matrix as a JSON object
+void write_json(std::ostream& os, const config& cfg, const result& res) {
+	double delivered = res.pushed * cfg.inlets;
+	os << "    {\"format\": \"" << cfg.format << "\", \"channels\": " << cfg.channels
+	   << ", \"rate\": " << cfg.rate << ", \"chunk\": " << cfg.chunk
+	   << ", \"inlets\": " << cfg.inlets << ", \"outlets\": " << cfg.outlets
+	   << ", \"duration\": " << res.push_time << ",\n     \"samples_pushed\": " << res.pushed
+	   << ", \"samples_received\": " << res.received
+	   << ", \"samples_lost\": " << std::max(0.0, delivered - res.received)
+	   << ", \"throughput\": " << res.received / res.push_time
+	   << ", \"cpu_utilization\": " << res.cpu_time / res.wall_time
+	   << ", \"cpu_ns_per_sample\": " << (res.received ? res.cpu_time * 1e9 / res.received : 0)
+	   << ",\n     \"latency_ms\": {\"p50\": " << percentile(res.latencies, 50) * 1000
+	   << ", \"p99\": " << percentile(res.latencies, 99) * 1000
+	   << ", \"p99.9\": " << percentile(res.latencies, 99.9) * 1000
+	   << ", \"max\": " << percentile(res.latencies, 100) * 1000 << "}}";
+}
+
+// parse a comma-separated list of values
+template <class T> std::vector<T> parse_list(const std::string& arg) {
+	std::vector<T> values;
+	std::istringstream is(arg);
+	for (std::string item; std::getline(is, item, ',');) {
+		std::istringstream conv(item);
+		T value;
+		if (!(conv >> value)) throw std::invalid_argument("Invalid list item: " + item);
+		values.push_back(value);
+	}
+	return values;
+}
+
+int main(int argc, char** argv) {
+	std::vector<std::string> fmts{"float32", "int16", "double64", "string"};
+	std::vector<int> channels{1, 32}, chunks{1, 32}, inlets{1}, outlets{1};
+	std::vector<double> rates{1000, 10000};
+	double duration = 3;
+	int repeat = 1;
+	std::string output;
+	try {
+		for (int k = 1; k + 1 < argc; k += 2) {
+			std::string opt(argv[k]), val(argv[k + 1]);
+			if (opt == "--formats") fmts = parse_list<std::string>(val);
+			else if (opt == "--channels") channels = parse_list<int>(val);
+			else if (opt == "--rates") rates = parse_list<double>(val);
+			else if (opt == "--chunks") chunks = parse_list<int>(val);
+			else if (opt == "--inlets") inlets = parse_list<int>(val);
+			else if (opt == "--outlets") outlets = parse_list<int>(val);
+			else if (opt == "--duration") duration = std::stod(val);
+			else if (opt == "--repeat") repeat = std::stoi(val);
+			else if (opt == "--output") output = val;
+			else throw std::invalid_argument("Unknown option " + opt);
+		}
+		if (argc % 2 == 0) throw std::invalid_argument("Missing value for " + std::string(argv[argc - 1]));
+		for (const auto& f : fmts)
+			if (!formats.count(f)) throw std::invalid_argument("Unknown channel format " + f);
+	} catch (std::exception& e) {
+		std::cerr << e.what() << "\nUsage: " << argv[0]
+		          << " [--formats float32,int16,...] [--channels 1,32] [--rates 1000,0] [--chunks 1,32]"
+		             " [--inlets 1,4] [--outlets 1,2] [--duration secs] [--repeat n] [--output file.json]"
+		          << std::endl;
+		return 1;
+	}
+
+	// enumerate the matrix in a fixed order so that runs can be compared
+	std::vector<config> matrix;
+	for (const auto& f : fmts)
+		for (int c : channels)
+			for (double r : rates)
+				for (int ch : chunks)
+					for (int i : inlets)
+						for (int o : outlets)
+							for (int rep = 0; rep < repeat; rep++)
+								matrix.push_back(config{f, c, ch, i, o, r, duration});
+
+	std::ostringstream json;
+	json.precision(10);
+	json << "{\n  \"benchmark\": \"BenchmarkMatrix\",\n  \"library_version\": "
+	     << lsl::library_version() << ",\n  \"protocol_version\": " << lsl::protocol_version()
+	     << ",\n  \"results\": [\n";
+	for (std::size_t k = 0; k < matrix.size(); k++) {
+		const config& cfg = matrix[k];
+		std::cerr << "[" << k + 1 << "/" << matrix.size() << "] " << cfg.format << " x"
+		          << cfg.channels << " @" << cfg.rate << "Hz, chunk " << cfg.chunk << ", "
+		          << cfg.outlets << " outlet(s) with " << cfg.inlets << " inlet(s) each" << std::endl;
+		try {
+			result res = run_config(cfg, (int)k);
+			write_json(json, cfg, res);
+		} catch (std::exception& e) {
+			std::cerr << "  failed: " << e.what() << std::endl;
+			json << "    {\"format\": \"" << cfg.format << "\", \"channels\": " << cfg.channels
+			     << ", \"rate\": " << cfg.rate << ", \"chunk\": " << cfg.chunk
+			     << ", \"inlets\": " << cfg.inlets << ", \"outlets\": " << cfg.outlets
+			     << ", \"error\": true}";
+		}
+		json << (k + 1 < matrix.size() ? ",\n" : "\n");
+	}
+	json << "  ]\n}\n";
+
+	if (output.empty())
+		std::cout << json.str();
+	else
+		std::ofstream(output) << json.str();
+	return 0;
+}
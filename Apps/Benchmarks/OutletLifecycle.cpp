@@ -0,0 +1,44 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <lsl_cpp.h>
+#include <string>
+#include <vector>
+
+/* Measure how long it takes to create and destroy an outlet (e.g., for per-block outlets) */
+
+double percentile(std::vector<double> values, double p) {
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, (std::size_t)(p / 100.0 * values.size()))];
+}
+
+void report(const char* what, const std::vector<double>& values) {
+	std::cout << what << ": p50=" << percentile(values, 50) * 1000
+	          << "ms, p90=" << percentile(values, 90) * 1000
+	          << "ms, p99=" << percentile(values, 99) * 1000
+	          << "ms, max=" << percentile(values, 100) * 1000 << "ms" << std::endl;
+}
+
+int main(int argc, char** argv) {
+	const int numOutlets = argc > 1 ? std::atoi(argv[1]) : 500;
+	// keep one outlet alive throughout so that shared resources stay warm (as in a typical experiment)
+	lsl::stream_outlet persistent(lsl::stream_info("Persistent", "Lifecycle", 1, lsl::IRREGULAR_RATE, lsl::cf_int32));
+
+	std::vector<double> create, destroy;
+	for (int k = 0; k < numOutlets; k++) {
+		lsl::stream_info info("Block" + std::to_string(k), "Lifecycle", 8, 500, lsl::cf_float32,
+		                      "lifecycle" + std::to_string(k));
+		double t0 = lsl::local_clock();
+		auto* outlet = new lsl::stream_outlet(info);
+		double t1 = lsl::local_clock();
+		delete outlet;
+		double t2 = lsl::local_clock();
+		create.push_back(t1 - t0);
+		destroy.push_back(t2 - t1);
+	}
+
+	std::cout << "Created and destroyed " << numOutlets << " outlets" << std::endl;
+	report("create ", create);
+	report("destroy", destroy);
+	return 0;
+}
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <lsl_cpp.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Stream raw video frames (one cf_int8 sample per frame) through an outlet and an inlet on the same machine and
+ * measure the delivered frame rate and the latency of each frame.
+ * Usage: VideoFrames [width] [height] [fps] [seconds] [latest]
+ * The defaults are 1920 1080 60 10 (RGB frames, i.e., ca. 6MB per sample); if "latest" is given, the inlet only
+ * keeps the most recent frame (see stream_inlet::set_latest_only()), as a viewer would. */
+
+double percentile(std::vector<double> values, double p) {
+	if (values.empty()) return 0;
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, (std::size_t)(p / 100.0 * values.size()))];
+}
+
+int main(int argc, char** argv) {
+	const int width = argc > 1 ? std::atoi(argv[1]) : 1920;
+	const int height = argc > 2 ? std::atoi(argv[2]) : 1080;
+	const double fps = argc > 3 ? std::atof(argv[3]) : 60;
+	const double seconds = argc > 4 ? std::atof(argv[4]) : 10;
+	const bool latest = argc > 5 && std::string(argv[5]) == "latest";
+	const int channels = width * height * 3;
+
+	lsl::stream_info info("VideoFrames", "VideoRaw", channels, fps, lsl::cf_int8, "videoframes-bench");
+	lsl::stream_outlet outlet(info);
+	lsl::stream_inlet inlet(lsl::resolve_stream("source_id", "videoframes-bench")[0], 1);
+	if (latest) inlet.set_latest_only();
+	inlet.open_stream(5);
+
+	const int num_frames = (int)(fps * seconds);
+	std::atomic<bool> done(false);
+	std::thread producer([&]() {
+		std::vector<char> frame(channels);
+		double start = lsl::local_clock();
+		for (int k = 0; k < num_frames; k++) {
+			// wait for the frame's due time, then fill it in and push it
+			double due = start + k / fps;
+			while (lsl::local_clock() < due)
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			std::memset(&frame[0], k & 0xff, std::min<std::size_t>(frame.size(), 4096));
+			outlet.push_sample(frame, lsl::local_clock());
+		}
+		done = true;
+	});
+
+	std::vector<char> frame(channels);
+	std::vector<double> latencies;
+	int received = 0, out_of_order = 0, last_id = -1;
+	double first = 0, last = 0;
+	while (true) {
+		double ts = inlet.pull_sample(frame, 0.5);
+		if (!ts) {
+			if (done) break;
+			continue;
+		}
+		last = lsl::local_clock();
+		if (!received) first = last;
+		latencies.push_back(last - ts);
+		int id = (unsigned char)frame[0];
+		if (last_id >= 0 && id == last_id) out_of_order++;
+		last_id = id;
+		received++;
+	}
+	producer.join();
+
+	lsl::inlet_stats stats = inlet.stats();
+	std::cout << width << "x" << height << " RGB frames (" << channels / 1e6 << "MB) at " << fps << " fps"
+	          << (latest ? ", latest frame only" : "") << std::endl;
+	std::cout << "frames pushed: " << num_frames << ", received: " << received
+	          << ", dropped: " << stats.samples_dropped << ", repeated: " << out_of_order << std::endl;
+	std::cout << "delivered rate: " << (received > 1 ? (received - 1) / (last - first) : 0) << " fps, "
+	          << stats.bytes_received / 1e6 / seconds << " MB/s" << std::endl;
+	std::cout << "latency: p50=" << percentile(latencies, 50) * 1000 << "ms, p90=" << percentile(latencies, 90) * 1000
+	          << "ms, p99=" << percentile(latencies, 99) * 1000 << "ms, max=" << percentile(latencies, 100) * 1000
+	          << "ms" << std::endl;
+	return 0;
+}
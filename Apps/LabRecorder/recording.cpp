@@ -122,6 +122,9 @@ void recording::record_from_streaminfo(const lsl::stream_info& src, bool phase_l
 			// retrieve the stream header & get its XML version
 			info = in->info();
 			std::string as_xml = info.as_xml();
+			// the packed formats are not part of the XDF specification, so their values are recorded in the next wider format
+			boost::algorithm::replace_first(as_xml,"<channel_format>float16</channel_format>","<channel_format>float32</channel_format>");
+			boost::algorithm::replace_first(as_xml,"<channel_format>int24</channel_format>","<channel_format>int32</channel_format>");
 			// generate the [StreamHeader] chunk contents...
 			std::ostringstream hdr_content;
 			// [StreamId]
@@ -166,6 +169,12 @@ void recording::record_from_streaminfo(const lsl::stream_info& src, bool phase_l
 			case lsl::cf_string:
 				typed_transfer_loop<std::string>(streamid,info.nominal_srate(),in,first_timestamp,last_timestamp,sample_count);
 				break;
+			case lsl::cf_float16:
+				typed_transfer_loop<float>(streamid,info.nominal_srate(),in,first_timestamp,last_timestamp,sample_count);
+				break;
+			case lsl::cf_int24:
+				typed_transfer_loop<boost::int32_t>(streamid,info.nominal_srate(),in,first_timestamp,last_timestamp,sample_count);
+				break;
 			default:
 				// unsupported channel format
 				throw std::runtime_error(std::string("Unsupported channel format in stream ") += src.name());
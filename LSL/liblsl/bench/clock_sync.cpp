@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include "../include/lsl_c.h"
+#include "../src/api_config.h"
+#include "../src/sim_clock.h"
+#include "../src/stream_inlet_impl.h"
+#include "../src/stream_outlet_impl.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define putenv _putenv
+#endif
+
+
+// === clock synchronization accuracy benchmark ===
+// Simulates an outlet and an inlet on two "hosts" with different clocks (see sim_clock) within one process,
+// and measures how well the inlet's time correction and timestamp post-processing track the true clock relationship:
+//  * offset error: the difference between time_correction() and the true clock offset, polled every 20ms,
+//  * convergence time: the time until the offset error first falls below a threshold after the start and after
+//    the outlet's clock jumps by a given step,
+//  * dejitter residuals: the difference between the post-processed time stamps and the true (jitter-free)
+//    capture times of the samples on the inlet's clock.
+//
+// Usage: lsl_bench_clock_sync [--option value ...] with the options
+//   --offset s       offset of the inlet's clock relative to the outlet's (default 1000)
+//   --drift ppm      drift of the inlet's clock relative to the outlet's (default 20)
+//   --jitter s       standard deviation of the jitter of both clocks (default 0.0002)
+//   --rate Hz        sampling rate of the stream (default 100)
+//   --duration s     duration of the run (default 20)
+//   --step s         the outlet's clock jumps by this amount half-way through the run (default 0.5; 0 to disable)
+//   --threshold s    the offset error below which the estimate counts as converged (default 0.001)
+//   --update-intervals a,b,...  sweep the TimeUpdateInterval setting (one process per setting)
+//   --probe-counts a,b,...      sweep the TimeProbeCount setting (one process per setting)
+// The results are written to stdout as JSON.
+
+using namespace lsl;
+
+namespace {
+
+	typedef std::map<std::string,std::string> options_t;
+
+	double get(const options_t &opts, const std::string &name, double deflt) {
+		options_t::const_iterator i = opts.find(name);
+		return i == opts.end() ? deflt : lslboost::lexical_cast<double>(i->second);
+	}
+
+	/// Summary statistics of a list of values.
+	struct stats {
+		stats(std::vector<double> values) {
+			mean = rms = p50 = p99 = max = 0;
+			for (std::size_t k=0;k<values.size();k++) {
+				mean += values[k] / values.size();
+				rms += values[k]*values[k] / values.size();
+				values[k] = fabs(values[k]);
+			}
+			rms = sqrt(rms);
+			std::sort(values.begin(),values.end());
+			if (!values.empty()) {
+				p50 = values[values.size()/2];
+				p99 = values[std::min(values.size()-1,(std::size_t)(values.size()*0.99))];
+				max = values.back();
+			}
+		}
+		std::string json() const {
+			std::ostringstream os; os.precision(6);
+			os << "{\"mean\": " << mean*1e3 << ", \"rms\": " << rms*1e3 << ", \"abs_p50\": " << p50*1e3 << ", \"abs_p99\": " << p99*1e3 << ", \"abs_max\": " << max*1e3 << "}";
+			return os.str();
+		}
+		double mean, rms, p50, p99, max;
+	};
+
+	/// Push samples holding their true (lsl_clock) capture time, stamped with the outlet's clock.
+	void push_samples(stream_outlet_impl *outlet, sim_clock *clock, double rate, double end_time) {
+		for (double next=lsl_clock(); next < end_time; next += 1.0/rate) {
+			double wait = next - lsl_clock();
+			if (wait > 0)
+				lslboost::this_thread::sleep_for(lslboost::chrono::duration<double>(wait));
+			double now = lsl_clock();
+			outlet->push_sample(&now,clock->now());
+		}
+	}
+
+	/// Pull samples and record the deviation of their post-processed time stamps from the true capture times.
+	void pull_samples(stream_inlet_impl *inlet, sim_clock *clock, double end_time, std::vector<std::pair<double,double> > *residuals) {
+		double captured;
+		while (lsl_clock() < end_time + 1.0) {
+			try {
+				if (double ts = inlet->pull_sample(&captured,1,0.2))
+					residuals->push_back(std::make_pair(captured,ts - clock->ideal(captured)));
+			} catch(timeout_error &) {
+				// the post-processing could not obtain a time correction in time
+			}
+		}
+	}
+
+	/// Run a single simulation with the current configuration and write the results as a JSON object.
+	void run_single(const options_t &opts) {
+		double offset = get(opts,"offset",1000), drift = get(opts,"drift",20), jitter = get(opts,"jitter",0.0002);
+		double rate = get(opts,"rate",100), duration = get(opts,"duration",20), step = get(opts,"step",0.5), threshold = get(opts,"threshold",0.001);
+		const api_config *cfg = api_config::get_instance();
+
+		// set up the two hosts
+		sim_clock outlet_clock(0,0,jitter,1), inlet_clock(offset,drift,jitter,2);
+		std::string source_id = "clock_sync_" + lslboost::lexical_cast<std::string>(lsl_clock());
+		stream_outlet_impl outlet(stream_info_impl("ClockSync","Benchmark",1,rate,cf_double64,source_id),0,512000,outlet_clock.reader());
+		lsl_streaminfo found;
+		if (!lsl_resolve_byprop(&found,1,const_cast<char*>("source_id"),const_cast<char*>(source_id.c_str()),1,5.0))
+			throw std::runtime_error("Could not resolve the benchmark stream.");
+		double start_time = lsl_clock(), step_time = start_time + duration/2, end_time = start_time + duration;
+		stream_inlet_impl inlet(*(stream_info_impl*)found,360,0,false,inlet_clock.reader());
+		lsl_destroy_streaminfo(found);
+		inlet.set_postprocessing(post_ALL);
+		inlet.open_stream(5.0);
+
+		std::vector<std::pair<double,double> > residuals;
+		lslboost::thread pusher(lslboost::bind(&push_samples,&outlet,&outlet_clock,rate,end_time));
+		lslboost::thread puller(lslboost::bind(&pull_samples,&inlet,&inlet_clock,end_time,&residuals));
+
+		// poll the time correction and compare it with the true offset between the clocks
+		std::vector<std::pair<double,double> > errors;
+		bool stepped = (step == 0);
+		double converged_at = -1, reconverged_at = -1;
+		while (lsl_clock() < end_time) {
+			if (!stepped && lsl_clock() >= step_time) {
+				outlet_clock.step(step);
+				step_time = lsl_clock();
+				stepped = true;
+			}
+			try {
+				double estimate = inlet.time_correction(0.02), now = lsl_clock();
+				double error = estimate - (inlet_clock.ideal(now) - outlet_clock.ideal(now));
+				errors.push_back(std::make_pair(now,error));
+				if (fabs(error) < threshold) {
+					if (converged_at < 0)
+						converged_at = now;
+					if (step && stepped && reconverged_at < 0)
+						reconverged_at = now;
+				}
+			} catch(std::exception &) {
+				// no estimate yet
+			}
+			lslboost::this_thread::sleep_for(lslboost::chrono::milliseconds(20));
+		}
+		pusher.join();
+		puller.join();
+
+		// evaluate the steady-state phases (after the initial convergence, and after the re-convergence following the step)
+		std::vector<double> steady_errors, steady_residuals;
+		for (std::size_t k=0;k<errors.size();k++) {
+			double t = errors[k].first;
+			if (converged_at >= 0 && t >= converged_at && (!step || t < step_time || (reconverged_at >= 0 && t >= reconverged_at)))
+				steady_errors.push_back(errors[k].second);
+		}
+		for (std::size_t k=0;k<residuals.size();k++) {
+			double t = residuals[k].first;
+			// the dejitter regression takes a long time to recover from a clock step, so only the phase before it is used
+			if (converged_at >= 0 && t >= converged_at + 1.0 && (!step || t < step_time))
+				steady_residuals.push_back(residuals[k].second);
+		}
+		lsl_inlet_stats st;
+		inlet.get_stats(st);
+
+		std::ostringstream os; os.precision(8);
+		os << "{\"offset\": " << offset << ", \"drift_ppm\": " << drift << ", \"jitter\": " << jitter << ", \"rate\": " << rate << ", \"duration\": " << duration << ", \"step\": " << step
+		   << ", \"time_update_interval\": " << cfg->time_update_interval() << ", \"time_probe_count\": " << cfg->time_probe_count() << ", \"time_probe_interval\": " << cfg->time_probe_interval()
+		   << ", \"time_probes_sent\": " << st.time_probes_sent << ", \"time_probe_rtt_mean_ms\": " << st.time_probe_rtt_mean*1e3
+		   << ", \"convergence_after_start\": " << (converged_at >= 0 ? converged_at - start_time : -1)
+		   << ", \"convergence_after_step\": " << (reconverged_at >= 0 ? reconverged_at - step_time : -1)
+		   << ", \"offset_error_ms\": " << stats(steady_errors).json() << ", \"dejitter_residual_ms\": " << stats(steady_residuals).json() << "}";
+		std::cout << os.str() << std::endl;
+	}
+
+	std::vector<std::string> split(const std::string &list) {
+		std::vector<std::string> result;
+		std::istringstream is(list);
+		for (std::string item; std::getline(is,item,',');)
+			result.push_back(item);
+		return result;
+	}
+
+}
+
+int main(int argc, char *argv[]) {
+	options_t opts;
+	for (int k=1;k+1<argc;k+=2)
+		opts[std::string(argv[k]).substr(2)] = argv[k+1];
+	try {
+		if (!opts.count("update-intervals") && !opts.count("probe-counts")) {
+			// a single run with the current configuration
+			run_single(opts);
+			return 0;
+		}
+		// sweep the time synchronization settings: each combination is run in a child process
+		// since the configuration is read once per process (here from the file named in LSLAPICFG)
+		std::vector<std::string> intervals = split(opts.count("update-intervals") ? opts["update-intervals"] : "2.0");
+		std::vector<std::string> counts = split(opts.count("probe-counts") ? opts["probe-counts"] : "8");
+		opts.erase("update-intervals");
+		opts.erase("probe-counts");
+		std::string args;
+		for (options_t::iterator i=opts.begin();i!=opts.end();i++)
+			args += " --" + i->first + " " + i->second;
+		const std::string cfgfile = "lsl_bench_clock_sync.cfg";
+		static std::string env = "LSLAPICFG=" + cfgfile;
+		putenv(const_cast<char*>(env.c_str()));
+		std::cout << "[" << std::endl;
+		for (std::size_t i=0;i<intervals.size();i++) {
+			for (std::size_t c=0;c<counts.size();c++) {
+				{
+					std::ofstream f(cfgfile.c_str());
+					// an estimate requires TimeUpdateMinProbes replies, so this must not exceed the probe count
+					int min_probes = std::min(6,lslboost::lexical_cast<int>(counts[c]));
+					f << "[tuning]\nTimeUpdateInterval = " << intervals[i] << "\nTimeProbeCount = " << counts[c] << "\nTimeUpdateMinProbes = " << min_probes << "\n";
+				}
+				FILE *child = popen(("\"" + std::string(argv[0]) + "\"" + args).c_str(),"r");
+				if (!child)
+					throw std::runtime_error("Could not start a benchmark process.");
+				std::string output;
+				char buf[4096];
+				while (std::size_t n = fread(buf,1,sizeof(buf),child))
+					output.append(buf,n);
+				pclose(child);
+				while (!output.empty() && (output[output.size()-1] == '\n' || output[output.size()-1] == '\r'))
+					output.erase(output.size()-1);
+				std::cout << "  " << output << ((i+1 < intervals.size() || c+1 < counts.size()) ? "," : "") << std::endl;
+			}
+		}
+		std::cout << "]" << std::endl;
+		remove(cfgfile.c_str());
+	} catch(std::exception &e) {
+		std::cerr << "Benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
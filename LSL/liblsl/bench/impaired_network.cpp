@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include "../include/lsl_c.h"
+#include "../src/impaired_network.h"
+
+
+// === impaired network benchmark ===
+// Runs an outlet and an inlet within one process while the connection between them passes through
+// the in-process impaired network (see impaired_network), for a set of network profiles, and measures
+//  * the end-to-end latency of the samples (push to pull),
+//  * the throughput and the number of lost samples,
+//  * the error of the time correction (both ends share the same clock, so the true offset is 0),
+//  * the time until samples arrive again after all connections were dropped (if --outage is given).
+//
+// Usage: lsl_bench_impaired_network [--option value ...] with the options
+//   --profiles a,b,...  the network profiles (default ideal,lan,wifi,congested_wifi)
+//   --rate Hz           sampling rate of the stream (default 500)
+//   --channels n        number of double channels (default 8)
+//   --duration s        duration of each run (default 10)
+//   --outage s          drop all connections half-way through each run and refuse new ones for this long (default 1; 0 to disable;
+//                       this has no effect on the ideal profile since its connections are not relayed)
+// The results are written to stdout as JSON.
+
+using namespace lsl;
+
+namespace {
+
+	typedef std::map<std::string,std::string> options_t;
+
+	double get(const options_t &opts, const std::string &name, double deflt) {
+		options_t::const_iterator i = opts.find(name);
+		return i == opts.end() ? deflt : lslboost::lexical_cast<double>(i->second);
+	}
+
+	/// Get the parameters of a named network profile.
+	impaired_network::params profile(const std::string &name) {
+		impaired_network::params p;
+		// lost segments are mostly recovered by fast retransmits (after about one round trip) rather than by the retransmission timeout
+		if (name == "lan") {
+			p.delay = 0.0002; p.jitter = 0.0001; p.distribution = "normal";
+		} else if (name == "wifi") {
+			p.delay = 0.002; p.jitter = 0.003; p.loss = 0.01; p.retransmission_timeout = 0.015;
+		} else if (name == "congested_wifi") {
+			p.delay = 0.01; p.jitter = 0.02; p.loss = 0.05; p.retransmission_timeout = 0.06; p.bandwidth = 250000;
+		} else if (name != "ideal")
+			throw std::invalid_argument("Unknown network profile: " + name);
+		return p;
+	}
+
+	/// Percentile of a sorted list of values.
+	double percentile(const std::vector<double> &sorted, double p) {
+		return sorted.empty() ? 0 : sorted[std::min(sorted.size()-1,(std::size_t)(sorted.size()*p))];
+	}
+
+	/// Push samples holding their push time; drop all connections half-way through if requested.
+	void push_samples(lsl_outlet outlet, int channels, double rate, double start_time, double duration, double outage, unsigned long long *pushed) {
+		std::vector<double> sample(channels);
+		bool disconnected = (outage == 0);
+		for (double next=start_time; next < start_time + duration; next += 1.0/rate) {
+			double wait = next - lsl_local_clock();
+			if (wait > 0)
+				lslboost::this_thread::sleep_for(lslboost::chrono::duration<double>(wait));
+			if (!disconnected && next >= start_time + duration/2) {
+				impaired_network::get_instance().disconnect(outage);
+				disconnected = true;
+			}
+			sample[0] = lsl_local_clock();
+			lsl_push_sample_d(outlet,&sample[0]);
+			(*pushed)++;
+		}
+	}
+
+	/// Run the benchmark with one network profile and write the results as a JSON object.
+	std::string run_profile(const std::string &name, int channels, double rate, double duration, double outage) {
+		impaired_network &net = impaired_network::get_instance();
+		impaired_network::params p = profile(name);
+		net.configure(p);
+
+		std::string source_id = "impaired_network_" + name + "_" + lslboost::lexical_cast<std::string>(lsl_local_clock());
+		lsl_streaminfo info = lsl_create_streaminfo(const_cast<char*>("ImpairedNetwork"),const_cast<char*>("Benchmark"),channels,rate,cft_double64,const_cast<char*>(source_id.c_str()));
+		lsl_outlet outlet = lsl_create_outlet(info,0,360);
+		lsl_destroy_streaminfo(info);
+		lsl_streaminfo found;
+		if (!lsl_resolve_byprop(&found,1,const_cast<char*>("source_id"),const_cast<char*>(source_id.c_str()),1,5.0))
+			throw std::runtime_error("Could not resolve the benchmark stream.");
+		lsl_inlet inlet = lsl_create_inlet(found,360,0,1);
+		lsl_destroy_streaminfo(found);
+		int ec;
+		lsl_open_stream(inlet,10.0,&ec);
+		if (ec)
+			throw std::runtime_error("Could not open the benchmark stream.");
+
+		double start_time = lsl_local_clock(), end_time = start_time + duration;
+		unsigned long long pushed = 0, received = 0;
+		lslboost::thread pusher(lslboost::bind(&push_samples,outlet,channels,rate,start_time,duration,outage,&pushed));
+
+		// pull until the stream has been quiet for a while after the end of the run
+		std::vector<double> sample(channels), latencies;
+		double last_arrival = start_time, max_gap = 0;
+		while (true) {
+			double ts = lsl_pull_sample_d(inlet,&sample[0],channels,0.5,&ec);
+			double now = lsl_local_clock();
+			if (ts) {
+				received++;
+				latencies.push_back(now - sample[0]);
+				max_gap = std::max(max_gap,now - last_arrival);
+				last_arrival = now;
+			} else if (now > end_time + 1.0 && now > last_arrival + 2.0)
+				break;
+		}
+		pusher.join();
+
+		// the clocks of both ends are the same, so the time correction should be 0
+		std::vector<double> tc_errors;
+		for (int k=0;k<20;k++) {
+			double tc = lsl_time_correction(inlet,2.0,&ec);
+			if (!ec)
+				tc_errors.push_back(fabs(tc));
+			lslboost::this_thread::sleep_for(lslboost::chrono::milliseconds(50));
+		}
+		std::sort(tc_errors.begin(),tc_errors.end());
+		std::sort(latencies.begin(),latencies.end());
+		lsl_inlet_stats st;
+		lsl_get_inlet_stats(inlet,&st);
+		lsl_destroy_inlet(inlet);
+		lsl_destroy_outlet(outlet);
+
+		std::ostringstream os; os.precision(6);
+		os << "{\"profile\": \"" << name << "\", \"delay\": " << p.delay << ", \"jitter\": " << p.jitter << ", \"distribution\": \"" << p.distribution << "\""
+		   << ", \"loss\": " << p.loss << ", \"retransmission_timeout\": " << p.retransmission_timeout << ", \"bandwidth\": " << p.bandwidth << ", \"rate\": " << rate << ", \"channels\": " << channels << ", \"duration\": " << duration << ", \"outage\": " << outage
+		   << ", \"samples_pushed\": " << pushed << ", \"samples_received\": " << received << ", \"samples_lost\": " << (pushed > received ? pushed - received : 0)
+		   << ", \"throughput_bytes_per_s\": " << st.bytes_received / duration << ", \"reconnects\": " << st.reconnects
+		   << ", \"latency_ms\": {\"p50\": " << percentile(latencies,0.5)*1e3 << ", \"p99\": " << percentile(latencies,0.99)*1e3 << ", \"max\": " << percentile(latencies,1.0)*1e3 << "}"
+		   << ", \"max_gap_s\": " << max_gap
+		   << ", \"time_correction_error_ms\": {\"p50\": " << percentile(tc_errors,0.5)*1e3 << ", \"max\": " << percentile(tc_errors,1.0)*1e3 << "}"
+		   << ", \"time_probe_rtt_mean_ms\": " << st.time_probe_rtt_mean*1e3 << "}";
+		return os.str();
+	}
+
+	std::vector<std::string> split(const std::string &list) {
+		std::vector<std::string> result;
+		std::istringstream is(list);
+		for (std::string item; std::getline(is,item,',');)
+			result.push_back(item);
+		return result;
+	}
+
+}
+
+int main(int argc, char *argv[]) {
+	options_t opts;
+	for (int k=1;k+1<argc;k+=2)
+		opts[std::string(argv[k]).substr(2)] = argv[k+1];
+	try {
+		std::vector<std::string> profiles = split(opts.count("profiles") ? opts["profiles"] : "ideal,lan,wifi,congested_wifi");
+		int channels = (int)get(opts,"channels",8);
+		double rate = get(opts,"rate",500), duration = get(opts,"duration",10), outage = get(opts,"outage",1);
+		std::cout << "[" << std::endl;
+		for (std::size_t k=0;k<profiles.size();k++)
+			std::cout << "  " << run_profile(profiles[k],channels,rate,duration,outage) << (k+1 < profiles.size() ? "," : "") << std::endl;
+		std::cout << "]" << std::endl;
+	} catch(std::exception &e) {
+		std::cerr << "Benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,450 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include "../src/clock_sources.h"
+#include "../src/common.h"
+#include "../src/consumer_queue.h"
+#include "../src/sample.h"
+#include "../src/send_buffer.h"
+#include "../src/stream_info_impl.h"
+#include "../src/time_postprocessor.h"
+#include "../src/portable_archive/portable_iarchive.hpp"
+#include "../src/portable_archive/portable_oarchive.hpp"
+
+
+// === microbenchmarks of the liblsl internals ===
+// Usage: lsl_bench_internals [name filter] [scale]
+// Runs every benchmark whose name contains the filter and prints the time per operation;
+// the scale multiplies the number of iterations (use <1 for quick runs, >1 for more stable numbers).
+
+using namespace lsl;
+
+namespace {
+
+	std::string filter;		// only run benchmarks whose name contains this string
+	double scale = 1.0;		// multiplier for the number of iterations
+
+	/// Measures the time per operation of a benchmark and prints it when it goes out of scope.
+	class bench_timer {
+	public:
+		bench_timer(const std::string &name, double ops): name_(name), ops_(ops), start_(lsl_clock()) {}
+		~bench_timer() {
+			double elapsed = lsl_clock() - start_;
+			printf("%-52s %12.1f ns/op %14.0f ops\n",name_.c_str(),elapsed*1e9/ops_,ops_);
+			fflush(stdout);
+		}
+	private:
+		std::string name_;
+		double ops_;
+		double start_;
+	};
+
+	/// Whether a benchmark shall run.
+	bool enabled(const std::string &name) { return name.find(filter) != std::string::npos; }
+
+	/// Get the scaled iteration count.
+	int iterations(int n) { return std::max(1,(int)(n*scale)); }
+
+	/// A stream buffer over a fixed memory area that can be rewound for reuse.
+	class memory_streambuf: public std::streambuf {
+	public:
+		explicit memory_streambuf(std::size_t size): buffer_(size) { rewind(); }
+		void rewind() {
+			setp(&buffer_[0],&buffer_[0]+buffer_.size());
+			setg(&buffer_[0],&buffer_[0],&buffer_[0]+buffer_.size());
+		}
+	private:
+		std::vector<char> buffer_;
+	};
+
+	const char *format_names[] = {"undefined","float32","double64","string","int32","int16","int8","int64","float16","int24"};
+
+	/// Create a sample of the given format with some data in it.
+	sample_p make_sample(sample::factory &fac, channel_format_t fmt, int num_chans) {
+		sample_p s(fac.new_sample(lsl_clock(),false));
+		if (fmt == cf_string) {
+			const std::vector<std::string> data(num_chans,"123.456");
+			s->assign_typed(&data[0]);
+		} else {
+			std::vector<double> data(num_chans,17.3);
+			s->assign_typed(&data[0]);
+		}
+		return s;
+	}
+
+
+	// === clock backends ===
+
+	/// Time the readings of a clock.
+	template<class Clock> void bench_clock_reading(const std::string &name, Clock clock) {
+		if (!enabled(name))
+			return;
+		int n = iterations(5000000);
+		double sum = 0;
+		{
+			bench_timer t(name,n);
+			for (int k=0;k<n;k++)
+				sum += clock();
+		}
+		if (sum == 0)
+			printf("(unexpected result)\n");
+	}
+
+	/// Read a tsc_clock (for bench_clock_reading).
+	struct tsc_reader {
+		explicit tsc_reader(tsc_clock &clock): clock_(clock) {}
+		double operator()() { return clock_.now(); }
+		tsc_clock &clock_;
+	};
+
+	void bench_clocks() {
+		bench_clock_reading("clock/lsl_clock",&lsl_clock);
+		bench_clock_reading("clock/chrono",&chrono_clock);
+		bench_clock_reading("clock/monotonic",&monotonic_clock);
+		if (tsc_clock::supported() && enabled("clock/tsc")) {
+			tsc_clock clock(1.0);
+			bench_clock_reading("clock/tsc",tsc_reader(clock));
+		}
+	}
+
+
+	// === sample::factory ===
+
+	void bench_factory() {
+		const int chans[] = {1,32,256};
+		for (int c=0;c<3;c++) {
+			// with a freelist that is large enough
+			std::string name = "factory/new+reclaim/float32x" + lslboost::lexical_cast<std::string>(chans[c]);
+			if (enabled(name)) {
+				sample::factory fac(cf_float32,chans[c],1000);
+				int n = iterations(2000000);
+				bench_timer t(name,n);
+				for (int k=0;k<n;k++)
+					sample_p s(fac.new_sample(0.0,false));
+			}
+			// holding on to a batch of samples at a time (as when a queue fills up)
+			name = "factory/new+reclaim-batch1000/float32x" + lslboost::lexical_cast<std::string>(chans[c]);
+			if (enabled(name)) {
+				sample::factory fac(cf_float32,chans[c],100);
+				std::vector<sample_p> batch(1000);
+				int n = iterations(1000);
+				bench_timer t(name,n*1000.0);
+				for (int k=0;k<n;k++) {
+					for (int i=0;i<1000;i++)
+						batch[i] = fac.new_sample(0.0,false);
+					for (int i=0;i<1000;i++)
+						batch[i].reset();
+				}
+			}
+		}
+	}
+
+
+	// === consumer_queue ===
+
+	void producer(consumer_queue *q, sample::factory *fac, int n) {
+		for (int k=0;k<n;k++)
+			q->push_sample(fac->new_sample(0.0,false));
+	}
+
+	void bench_consumer_queue() {
+		std::string name = "consumer_queue/push+pop/same-thread";
+		if (enabled(name)) {
+			sample::factory fac(cf_float32,8,100);
+			consumer_queue q(1000);
+			sample_p s(fac.new_sample(0.0,false));
+			int n = iterations(2000000);
+			bench_timer t(name,n);
+			for (int k=0;k<n;k++) {
+				q.push_sample(s);
+				q.pop_sample(0.0);
+			}
+		}
+		name = "consumer_queue/push+pop/two-threads";
+		if (enabled(name)) {
+			sample::factory fac(cf_float32,8,100);
+			consumer_queue q(1<<20);
+			int n = iterations(1000000);
+			bench_timer t(name,n);
+			lslboost::thread prod(lslboost::bind(&producer,&q,&fac,n));
+			for (int k=0;k<n;k++)
+				q.pop_sample();
+			prod.join();
+		}
+		name = "consumer_queue/push-overflow";
+		if (enabled(name)) {
+			sample::factory fac(cf_float32,8,100);
+			consumer_queue q(64);
+			sample_p s(fac.new_sample(0.0,false));
+			int n = iterations(2000000);
+			bench_timer t(name,n);
+			for (int k=0;k<n;k++)
+				q.push_sample(s);
+		}
+	}
+
+
+	// === send_buffer fan-out ===
+
+	void bench_send_buffer() {
+		const int consumers[] = {1,4,16};
+		for (int c=0;c<3;c++) {
+			std::string name = "send_buffer/push/consumers=" + lslboost::lexical_cast<std::string>(consumers[c]);
+			if (!enabled(name))
+				continue;
+			sample::factory fac(cf_float32,8,1000);
+			send_buffer_p buf(new send_buffer(100000));
+			std::vector<consumer_queue_p> queues;
+			for (int i=0;i<consumers[c];i++)
+				queues.push_back(buf->new_consumer());
+			// push in batches and drain the queues in between (the draining is not timed)
+			int batches = iterations(1000);
+			double elapsed = 0;
+			for (int b=0;b<batches;b++) {
+				double start = lsl_clock();
+				for (int k=0;k<1000;k++)
+					buf->push_sample(fac.new_sample(0.0,false));
+				elapsed += lsl_clock() - start;
+				for (int i=0;i<consumers[c];i++)
+					while (queues[i]->pop_sample(0.0)) {}
+			}
+			printf("%-52s %12.1f ns/op %14.0f ops\n",name.c_str(),elapsed*1e9/(batches*1000.0),batches*1000.0);
+		}
+	}
+
+
+	// === sample serialization ===
+
+	void bench_serialization() {
+		const channel_format_t fmts[] = {cf_float32,cf_double64,cf_int16,cf_int32,cf_int8,cf_int64,cf_string,cf_float16,cf_int24};
+		const int byte_orders[] = {BOOST_BYTE_ORDER,BOOST_BYTE_ORDER==1234?4321:1234};
+		const int num_chans = 32;
+		for (int f=0;f<9;f++) {
+			for (int b=0;b<2;b++) {
+				std::string suffix = std::string(format_names[fmts[f]]) + "x" + lslboost::lexical_cast<std::string>(num_chans) + (b ? "/swapped" : "/native");
+				sample::factory fac(fmts[f],num_chans,10);
+				sample_p s(make_sample(fac,fmts[f],num_chans));
+				memory_streambuf sb(1<<20);
+				std::vector<char> scratch(num_chans*8);
+				int n = iterations(200000);
+				// keep the stream position within the buffer
+				int per_rewind = (1<<20) / (num_chans*16+16);
+				std::string name = "save_streambuf/" + suffix;
+				if (enabled(name)) {
+					bench_timer t(name,n);
+					for (int k=0;k<n;k++) {
+						if (k % per_rewind == 0)
+							sb.rewind();
+						s->save_streambuf(sb,110,byte_orders[b],&scratch[0]);
+					}
+				}
+				name = "load_streambuf/" + suffix;
+				if (enabled(name)) {
+					// fill the buffer with serialized samples, then read them back repeatedly
+					sb.rewind();
+					for (int k=0;k<per_rewind;k++)
+						s->save_streambuf(sb,110,byte_orders[b],&scratch[0]);
+					sample_p d(fac.new_sample(0.0,false));
+					sb.rewind();
+					bench_timer t(name,n);
+					for (int k=0;k<n;k++) {
+						if (k % per_rewind == 0)
+							sb.rewind();
+						d->load_streambuf(sb,110,byte_orders[b],false);
+					}
+				}
+				if (b)
+					continue;
+				// protocol 1.00 (portable archive, always little endian), starting a new archive at each rewind
+				suffix = std::string(format_names[fmts[f]]) + "x" + lslboost::lexical_cast<std::string>(num_chans);
+				name = "save_archive/" + suffix;
+				if (enabled(name)) {
+					bench_timer t(name,n);
+					for (int k=0;k<n;) {
+						sb.rewind();
+						eos::portable_oarchive ar(sb);
+						for (int e=std::min(n,k+per_rewind);k<e;k++)
+							ar << *s;
+					}
+				}
+				name = "load_archive/" + suffix;
+				if (enabled(name)) {
+					sb.rewind();
+					{
+						eos::portable_oarchive ar(sb);
+						for (int k=0;k<per_rewind;k++)
+							ar << *s;
+					}
+					sample_p d(fac.new_sample(0.0,false));
+					bench_timer t(name,n);
+					for (int k=0;k<n;) {
+						sb.rewind();
+						eos::portable_iarchive ar(sb);
+						for (int e=std::min(n,k+per_rewind);k<e;k++)
+							ar >> *d;
+					}
+				}
+			}
+		}
+	}
+
+
+	// === value conversion (assign_typed/retrieve_typed) ===
+
+	template<class T> void bench_conversion(channel_format_t fmt, const char *type_name) {
+		const int num_chans = 64;
+		sample::factory fac(fmt,num_chans,10);
+		sample_p s(fac.new_sample(0.0,false));
+		std::vector<T> values(num_chans);
+		for (int k=0;k<num_chans;k++)
+			values[k] = (T)(k*37 - 1000);
+		int n = iterations(1000000);
+		std::string suffix = std::string(type_name) + "->" + format_names[fmt] + "x" + lslboost::lexical_cast<std::string>(num_chans);
+		std::string name = "assign_typed/" + suffix;
+		if (enabled(name)) {
+			bench_timer t(name,n);
+			for (int k=0;k<n;k++)
+				s->assign_typed(&values[0]);
+		}
+		name = "retrieve_typed/" + suffix;
+		if (enabled(name)) {
+			bench_timer t(name,n);
+			for (int k=0;k<n;k++)
+				s->retrieve_typed(&values[0]);
+		}
+	}
+
+	void bench_conversions() {
+		bench_conversion<float>(cf_float32,"float");
+		bench_conversion<float>(cf_float16,"float");
+		bench_conversion<lslboost::int32_t>(cf_int32,"int32");
+		bench_conversion<lslboost::int32_t>(cf_int24,"int32");
+	}
+
+
+	// === time_postprocessor ===
+
+	double query_correction() { return 0.001; }
+	double query_srate() { return 1000.0; }
+	bool query_reset() { return false; }
+
+	void bench_time_postprocessor() {
+		const unsigned options[] = {post_none,post_clocksync,post_dejitter,post_ALL};
+		const char *names[] = {"none","clocksync","dejitter","all"};
+		for (int o=0;o<4;o++) {
+			std::string name = std::string("time_postprocessor/process_timestamp/") + names[o];
+			if (!enabled(name))
+				continue;
+			time_postprocessor pp(&query_correction,&query_srate,&query_reset);
+			pp.set_options(options[o]);
+			int n = iterations(2000000);
+			double ts = 1000.0, sum = 0;
+			{
+				bench_timer t(name,n);
+				for (int k=0;k<n;k++)
+					sum += pp.process_timestamp(ts += 0.001 + (k%7)*1e-6);
+			}
+			if (sum == 0)
+				printf("(unexpected result)\n");
+		}
+	}
+
+
+	// === stream_info_impl ===
+
+	/// Create a stream info with a realistic description (channel labels, units, etc.)
+	void fill_desc(stream_info_impl &info, int num_chans) {
+		pugi::xml_node chns = info.desc().append_child("channels");
+		for (int k=0;k<num_chans;k++) {
+			pugi::xml_node ch = chns.append_child("channel");
+			ch.append_child("label").append_child(pugi::node_pcdata).set_value(("C" + lslboost::lexical_cast<std::string>(k)).c_str());
+			ch.append_child("unit").append_child(pugi::node_pcdata).set_value("microvolts");
+			ch.append_child("type").append_child(pugi::node_pcdata).set_value("EEG");
+		}
+		pugi::xml_node acq = info.desc().append_child("acquisition");
+		acq.append_child("manufacturer").append_child(pugi::node_pcdata).set_value("LSL");
+		acq.append_child("model").append_child(pugi::node_pcdata).set_value("Benchmark");
+	}
+
+	void bench_stream_info() {
+		stream_info_impl info("BioSemi","EEG",64,2048,cf_float32,"bench1234");
+		fill_desc(info,64);
+		std::string name = "matches_query/cached";
+		if (enabled(name)) {
+			int n = iterations(500000);
+			bench_timer t(name,n);
+			for (int k=0;k<n;k++)
+				info.matches_query("name='BioSemi' and type='EEG'");
+		}
+		name = "matches_query/uncached";
+		if (enabled(name)) {
+			int n = iterations(50000);
+			std::vector<std::string> queries(n);
+			for (int k=0;k<n;k++)
+				queries[k] = "type='EEG' and channel_count>" + lslboost::lexical_cast<std::string>(k%1000) + " and starts-with(name,'Bio" + lslboost::lexical_cast<std::string>(k) + "')";
+			bench_timer t(name,n);
+			for (int k=0;k<n;k++)
+				info.matches_query(queries[k]);
+		}
+		std::string shortinfo = info.to_shortinfo_message(), fullinfo = info.to_fullinfo_message();
+		name = "shortinfo/serialize";
+		if (enabled(name)) {
+			int n = iterations(100000);
+			bench_timer t(name,n);
+			for (int k=0;k<n;k++)
+				info.to_shortinfo_message();
+		}
+		name = "shortinfo/parse";
+		if (enabled(name)) {
+			int n = iterations(100000);
+			stream_info_impl parsed;
+			bench_timer t(name,n);
+			for (int k=0;k<n;k++)
+				parsed.from_shortinfo_message(shortinfo);
+		}
+		name = "fullinfo/serialize/64ch";
+		if (enabled(name)) {
+			int n = iterations(20000);
+			bench_timer t(name,n);
+			for (int k=0;k<n;k++)
+				info.to_fullinfo_message();
+		}
+		name = "fullinfo/parse/64ch";
+		if (enabled(name)) {
+			int n = iterations(20000);
+			stream_info_impl parsed;
+			bench_timer t(name,n);
+			for (int k=0;k<n;k++)
+				parsed.from_fullinfo_message(fullinfo);
+		}
+	}
+
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 1)
+		filter = argv[1];
+	if (argc > 2)
+		scale = atof(argv[2]);
+	try {
+		bench_clocks();
+		bench_factory();
+		bench_consumer_queue();
+		bench_send_buffer();
+		bench_serialization();
+		bench_conversions();
+		bench_time_postprocessor();
+		bench_stream_info();
+	} catch(std::exception &e) {
+		std::cerr << "Benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
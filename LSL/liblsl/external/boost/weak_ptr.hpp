@@ -0,0 +1,6 @@
+#include <lslboost/weak_ptr.hpp>
+
+#ifndef LSLBOOST_NAMESPACE_DECLARED
+#define LSLBOOST_NAMESPACE_DECLARED
+namespace lslboost { }; namespace boost = lslboost;
+#endif
@@ -96,6 +96,10 @@ typedef enum {
                         /* Not recommended for encoding string data. */
     cft_int64 = 7,      /* For now only for future compatibility. Support for this type is not yet exposed in all languages. */
                         /* Also, some builds of liblsl will not be able to send or receive data of this type. */
+    cft_float16 = 8,    /* For signals whose resolution fits into 11 significant bits, at half the bandwidth of cft_float32. */
+                        /* Pushed and pulled as float (or any other numeric type); not understood by older liblsl versions. */
+    cft_int24 = 9,      /* For 24-bit digitized signals (e.g., EEG amplifiers), at three quarters of the bandwidth of cft_int32. */
+                        /* Pushed and pulled as int32 (or any other numeric type); not understood by older liblsl versions. */
     cft_undefined = 0   /* Can not be transmitted. */
 } lsl_channel_format_t;
 
@@ -115,6 +119,26 @@ typedef enum {
 	proc_ALL = 1|2|4|8		/* The combination of all possible post-processing options. */
 } lsl_processing_options_t;
 
+/**
+* What an outlet does when a lossless inlet (see lsl_set_lossless) falls so far behind that its queue is full.
+*/
+typedef enum {
+	lsl_overflow_drop = 0,	/* Drop the oldest samples, like for regular inlets. */
+	lsl_overflow_block = 1,	/* Block the push functions until the inlet has caught up (this also delays the other inlets). */
+	lsl_overflow_spill = 2	/* Spill the samples to a temporary file and send them once the inlet has caught up (the default). */
+} lsl_overflow_policy_t;
+
+/**
+* Transport options for stream outlets (see lsl_create_outlet_ex).
+*/
+typedef enum {
+	transp_default = 0,		/* Send every inlet its own copy of the data over TCP (the default). */
+	transp_multicast = 1,	/* Additionally publish the data once to a multicast group, which inlets join instead (IPv4 only; */
+							/* lossless inlets keep receiving over TCP). For streams with many inlets on the local network. */
+	transp_multi_producer = 2	/* Allow several threads to push into the outlet at the same time (e.g., markers from */
+								/* different parts of an application) without locking it; can be combined with the above. */
+} lsl_transport_options_t;
+
 /**
 * Possible error codes.
 */
@@ -159,6 +183,18 @@ typedef struct lsl_outlet_struct_* lsl_outlet;
 */
 typedef struct lsl_inlet_struct_* lsl_inlet;
 
+/**
+* A function that receives chunks of samples from an inlet (see lsl_set_chunk_callback).
+* @param in The inlet that has received the samples.
+* @param data The sample values, multiplexed (num_samples times the channel count), in the format that was requested
+*             when the callback was set (for string streams, an array of pointers to null-terminated strings).
+*             The values are only valid during the call.
+* @param timestamps The (post-processed) time stamps of the samples.
+* @param num_samples The number of samples in the chunk.
+* @param user_data The user data that was given when the callback was set.
+*/
+typedef void (*lsl_chunk_callback)(lsl_inlet in, const void *data, const double *timestamps, unsigned long num_samples, void *user_data);
+
 /**
 * A lightweight XML element tree handle; models the description of a streaminfo object.
 * XML elements behave like advanced pointers into memory that is owned by some respective streaminfo.
@@ -177,6 +213,43 @@ typedef struct lsl_xml_ptr_struct_* lsl_xml_ptr;
 */
 typedef struct lsl_continuous_resolver_* lsl_continuous_resolver;
 
+/**
+* Runtime transport statistics of an outlet (see lsl_get_outlet_stats).
+* All counters are cumulative over the lifetime of the outlet.
+*/
+typedef struct {
+	unsigned long long samples_pushed;		/* number of samples pushed into the outlet */
+	unsigned long long bytes_pushed;		/* payload bytes pushed into the outlet (0 for string-formatted streams) */
+	unsigned long long samples_sent;		/* number of samples sent over the network (summed over all consumers) */
+	unsigned long long bytes_sent;			/* number of bytes of sample data sent over the network (summed over all consumers) */
+	unsigned long long samples_dropped;		/* number of samples dropped because a consumer's queue overran (summed over all consumers) */
+	unsigned consumers;						/* number of currently connected consumers */
+	unsigned queue_depth;					/* number of samples in the fullest consumer queue */
+	unsigned queue_high_water;				/* the highest number of samples that any consumer queue has held */
+	unsigned long long samples_spilled;		/* number of samples spilled to disk because a lossless consumer's queue was full (summed over all consumers) */
+} lsl_outlet_stats;
+
+/**
+* Runtime transport statistics of an inlet (see lsl_get_inlet_stats).
+* All counters are cumulative over the lifetime of the inlet; times are in seconds.
+*/
+typedef struct {
+	unsigned long long samples_received;	/* number of samples received from the network */
+	unsigned long long bytes_received;		/* number of bytes received on the data connection (including protocol overhead) */
+	unsigned long long samples_dropped;		/* number of samples dropped because the inlet's buffer overran (not those superseded in latest-only mode) */
+	unsigned long long time_probes_sent;	/* number of time-synchronization probes sent */
+	unsigned long long time_probes_received;/* number of time-synchronization probes answered */
+	unsigned queue_depth;					/* number of samples currently buffered in the inlet */
+	unsigned queue_high_water;				/* the highest number of samples that have been buffered in the inlet */
+	unsigned reconnects;					/* number of times the data connection was re-established */
+	double handshake_time;					/* duration of the most recent connection setup and protocol negotiation (0 if not yet connected) */
+	double time_probe_rtt_min;				/* smallest round-trip time of a time probe (0 if none received) */
+	double time_probe_rtt_mean;				/* mean round-trip time of the time probes (0 if none received) */
+	double time_probe_rtt_max;				/* largest round-trip time of a time probe (0 if none received) */
+	unsigned long long samples_lost;		/* number of samples of a multicast stream or datagram feed that were lost in transmission (and not repaired) */
+	unsigned long long samples_repaired;	/* number of samples of a multicast stream that were re-sent by the outlet after having been lost */
+} lsl_inlet_stats;
+
 
 
 
@@ -282,6 +355,21 @@ extern LIBLSL_C_API int lsl_resolve_bypred(lsl_streaminfo *buffer, unsigned buff
 */
 extern LIBLSL_C_API void lsl_destroy_string(char *s);
 
+/**
+* Write the events recorded by the sample-path tracing into a file in the Chrome trace (JSON) format.
+* The library records timing events at the stages of the sample path (push, dispatch, serialize, write, 
+* receive, parse, enqueue, pull) into per-thread ring buffers if it was built with the LSL_TRACING option; 
+* the resulting file can be inspected with chrome://tracing or https://ui.perfetto.dev.
+* To keep the cost of the tracing low, the push and dispatch events are recorded for every 64th push of each thread 
+* only (set the environment variable LSL_TRACE_INTERVAL to change this; 1 traces every push).
+* The recorded events are retained, so this can be called repeatedly. Alternatively, the trace is written 
+* to the file named by the environment variable LSL_TRACE_FILE when the process exits.
+* @param filename The name of the file to write.
+* @return The error code: if nonzero, can be lsl_argument_error if no filename was given or lsl_internal_error 
+*         if the file could not be written or the library was built without tracing support.
+*/
+extern LIBLSL_C_API int lsl_write_trace(const char *filename);
+
 
 
 /* =============================== */
@@ -458,6 +546,26 @@ extern LIBLSL_C_API lsl_streaminfo lsl_streaminfo_from_xml(char *xml);
 */
 extern LIBLSL_C_API lsl_outlet lsl_create_outlet(lsl_streaminfo info, int chunk_size, int max_buffered);
 
+/**
+* Establish a new stream outlet with transport options.
+* In multicast mode (transp_multicast) the outlet sends its data once to a multicast group (configured in the
+* [multicast] section of the config file) instead of once per inlet, so its load does not grow with the number of inlets.
+* Inlets detect lost datagrams and can have them re-sent (see lsl_set_multicast_repair); they fall back to TCP if the
+* group is not reachable. Note that in this mode the outlet always has a consumer (see lsl_have_consumers).
+* In multi-producer mode (transp_multi_producer) the push functions may be called by several threads at the same time.
+* Each pushing thread keeps a small cache of samples, and the pushes are published in a single order that all inlets
+* see; the samples of one push (e.g., a chunk) stay together, and the samples of each thread keep their order.
+* Deduced time stamps (LSL_DEDUCED_TIMESTAMP) refer to the previous sample of the stream, which may come from another
+* thread, so each thread should give its samples explicit time stamps (or 0.0 for the current time) except within a chunk.
+* Reservations (lsl_outlet_reserve) must still be made and committed by one thread at a time.
+* @param info The stream information to use for creating this stream (see lsl_create_outlet).
+* @param chunk_size Optionally the desired chunk granularity (in samples) for transmission (see lsl_create_outlet).
+* @param max_buffered Optionally the maximum amount of data to buffer (see lsl_create_outlet).
+* @param flags The transport options (a combination of the lsl_transport_options_t values).
+* @return A newly created lsl_outlet handle or NULL in the event that an error occurred.
+*/
+extern LIBLSL_C_API lsl_outlet lsl_create_outlet_ex(lsl_streaminfo info, int chunk_size, int max_buffered, lsl_transport_options_t flags);
+
 /**
 * Destroy an outlet.
 * The outlet will no longer be discoverable after destruction and all connected inlets will stop delivering data.
@@ -561,6 +669,37 @@ extern LIBLSL_C_API int lsl_push_chunk_buftn(lsl_outlet out, char **data, unsign
 extern LIBLSL_C_API int lsl_push_chunk_buftnp(lsl_outlet out, char **data, unsigned *lengths, unsigned long data_elements, double *timestamps, int pushthrough);
 
 
+/**
+* Reserve samples in the outlet, so that their values can be written in place instead of being copied in by a push.
+* The values of each reserved sample are written through its own pointer (the samples of an outlet are separate
+* allocations, so a reservation is not one contiguous buffer); each pointer addresses channel_count values of the
+* stream's format. The reservation is pushed by lsl_outlet_commit or lsl_outlet_commit_n; until then the pointers stay
+* valid and the outlet does not accept another reservation. If the outlet was created with transp_multi_producer,
+* each thread has its own pending reservation, which it must commit itself.
+* @param out The lsl_outlet object in which to reserve the samples.
+* @param num_samples The number of samples to reserve.
+* @param format The format in which the values will be written; must be the stream's channel format (and not cft_string).
+* @param buffers An array of num_samples pointers which receives the location of each sample's values.
+* @return Error code of the operation or lsl_no_error if successful (lsl_argument_error if the format does not match or
+*         a reservation is already pending).
+*/
+extern LIBLSL_C_API int lsl_outlet_reserve(lsl_outlet out, unsigned long num_samples, lsl_channel_format_t format, void **buffers);
+
+/**
+* Push the first num_samples samples of the pending reservation into the outlet and release the remaining ones.
+* Committing zero samples cancels the reservation. With transp_multi_producer, this commits the calling thread's reservation.
+* @param out The lsl_outlet object through which to push the data.
+* @param num_samples The number of reserved samples to push.
+* @param timestamp The capture time of the most recent sample, in agreement with local_clock(); if 0.0, the current time is used.
+*                   The time stamps of other samples are automatically derived based on the sampling rate of the stream.
+* @param timestamps For lsl_outlet_commit_n, a buffer holding the time stamp of each sample (0.0 for the current time).
+* @param pushthrough Whether to push the samples through to the receivers instead of buffering them with subsequent samples.
+*                    Note that the chunk_size, if specified at outlet construction, takes precedence over the pushthrough flag.
+* @return Error code of the operation or lsl_no_error if successful (lsl_argument_error if more samples than reserved are committed).
+*/
+extern LIBLSL_C_API int lsl_outlet_commit(lsl_outlet out, unsigned long num_samples, double timestamp, int pushthrough);
+extern LIBLSL_C_API int lsl_outlet_commit_n(lsl_outlet out, unsigned long num_samples, const double *timestamps, int pushthrough);
+
 /**
 * Check whether consumers are currently registered.
 * While it does not hurt, there is technically no reason to push samples if there is no consumer.
@@ -581,6 +720,25 @@ extern LIBLSL_C_API int lsl_wait_for_consumers(lsl_outlet out, double timeout);
 */ 
 extern LIBLSL_C_API lsl_streaminfo lsl_get_info(lsl_outlet out);
 
+/**
+* Retrieve runtime transport statistics of the outlet.
+* This is cheap enough to be called periodically (e.g., for monitoring) while data is being pushed.
+* @param out The lsl_outlet object to act on.
+* @param stats A pointer to a structure that receives the statistics.
+* @return The error code: if nonzero, can be lsl_argument_error if stats is NULL or lsl_internal_error.
+*/
+extern LIBLSL_C_API int lsl_get_outlet_stats(lsl_outlet out, lsl_outlet_stats *stats);
+
+/**
+* Set what happens when the queue of a lossless inlet (see lsl_set_lossless) is full.
+* The default is given by the OverflowPolicy setting in the config file (spill if not set).
+* Regular inlets are not affected; their oldest samples are always dropped.
+* @param out The lsl_outlet object to act on.
+* @param policy The overflow policy (one of the lsl_overflow_policy_t values).
+* @return The error code: if nonzero, can be lsl_argument_error if the policy is unknown.
+*/
+extern LIBLSL_C_API int lsl_set_overflow_policy(lsl_outlet out, lsl_overflow_policy_t policy);
+
 
 
 
@@ -683,6 +841,115 @@ extern LIBLSL_C_API double lsl_time_correction_ex(lsl_inlet in, double *remote_t
 */
 extern LIBLSL_C_API int lsl_set_postprocessing(lsl_inlet in, unsigned flags);
 
+/**
+* Enable or disable lossless transmission (e.g., for recording).
+* By default, an inlet drops its oldest samples when its buffer is full (and so does the outlet when the inlet
+* falls behind). A lossless inlet instead stops reading from the network, so that the outlet buffers the samples
+* and applies its overflow policy once its queue for this inlet is full (see lsl_set_overflow_policy).
+* This takes effect when the inlet (re-)connects to the outlet, so it should be called before the stream is opened.
+* Outlets of older library versions do not support lossless transmission and drop samples regardless.
+* If a process-wide memory budget is set (MemoryBudgetMB in the config file), samples are never evicted from the buffers
+* of lossless inlets (or from the outlet's queues for them) to stay within the budget.
+* @param in The lsl_inlet object to act on.
+* @param lossless Whether transmission shall be lossless (nonzero) or not (zero).
+* @return The error code: if nonzero, can be lsl_internal_error.
+*/
+extern LIBLSL_C_API int lsl_set_lossless(lsl_inlet in, int lossless);
+
+/**
+* Enable or disable the repair of lost datagrams on a multicast stream (see lsl_create_outlet_ex).
+* A regular inlet of a multicast stream receives the data from the multicast group; datagrams that get lost on the way
+* are counted in the samples_lost statistic (see lsl_get_inlet_stats). With repair enabled, the inlet instead asks the
+* outlet to re-send them over TCP (which delays the following samples); samples that are no longer buffered by the outlet
+* (see RepairBufferMB in the config file) are still lost. Lossless inlets always receive the data over TCP.
+* @param in The lsl_inlet object to act on.
+* @param repair Whether lost datagrams shall be repaired (nonzero) or not (zero).
+* @return The error code: if nonzero, can be lsl_internal_error.
+*/
+extern LIBLSL_C_API int lsl_set_multicast_repair(lsl_inlet in, int repair);
+
+/**
+* Enable or disable the datagram transport for the inlet.
+* With the datagram transport, the outlet sends each sample to the inlet as a single UDP datagram as soon as it has
+* been pushed (regardless of the chunk sizes), instead of over the inlet's TCP connection. This shaves off latency for
+* small, irregular samples such as event markers or button presses (e.g., for experiment triggers). Datagrams that get
+* lost on the way are not re-sent but counted in the samples_lost statistic (see lsl_get_inlet_stats); samples that are
+* too large for a datagram (see DatagramSize in the config file) are still sent over TCP, in order with the others.
+* The inlet falls back to TCP if the outlet does not support it (older library versions) or no datagrams arrive (e.g.,
+* due to a firewall). Lossless inlets always receive the data over TCP.
+* This takes effect when the inlet (re-)connects to the outlet, so it should be called before the stream is opened.
+* @param in The lsl_inlet object to act on.
+* @param datagrams Whether the datagram transport shall be used (nonzero) or not (zero).
+* @return The error code: if nonzero, can be lsl_internal_error.
+*/
+extern LIBLSL_C_API int lsl_set_datagram_transport(lsl_inlet in, int datagrams);
+
+/**
+* Keep only the most recent samples in the inlet's buffer ("latest frame" delivery).
+* Whenever a new sample arrives, the inlet drops the buffered samples that exceed the given number, so that a consumer
+* that cannot keep up (e.g., a viewer that renders the frames of a video stream) always gets the latest data instead of
+* falling behind. These samples are not counted as overruns in the samples_dropped statistic (see lsl_get_inlet_stats).
+* The inlet also asks the outlet to buffer no more than this number of samples for it, so that superseded samples are
+* dropped before they are sent (saving the bandwidth and the time to receive them); the outlet of an older library version
+* sends all samples instead. This part takes effect when the inlet (re-)connects to the outlet, so this function
+* should be called before the stream is opened. Samples that the outlet drops are not counted in the inlet's statistics.
+* This has no effect on lossless inlets (see lsl_set_lossless) or while a chunk callback is set (see lsl_set_chunk_callback).
+* @param in The lsl_inlet object to act on.
+* @param num_samples The number of samples to keep (e.g., 1 for the latest frame only), or 0 to buffer up to max_buflen again.
+* @return The error code: if nonzero, can be lsl_internal_error.
+*/
+extern LIBLSL_C_API int lsl_set_latest_only(lsl_inlet in, unsigned num_samples);
+
+/**
+* Set a callback that receives the samples of the inlet as soon as they have arrived.
+* The callback is invoked from the inlet's data thread with each chunk of samples that have arrived together, already
+* converted to the requested format and with post-processed time stamps (see lsl_set_postprocessing; the clock
+* synchronization uses the most recent clock offset, or none until the first estimate is in). The samples are no
+* longer buffered for the pull functions while a callback is set; this saves a queue hop and a thread wakeup, e.g.,
+* for closed-loop applications. The callback should return quickly since no data is read while it runs
+* (in lossless mode, the outlet then buffers the samples). It must not throw exceptions or set the callback itself.
+* Samples are only received after the stream has been opened (see lsl_open_stream).
+* @param in The lsl_inlet object to act on.
+* @param format The format of the values that are passed to the callback (cft_undefined for the stream's own format,
+*               or cft_float32/cft_int32 for cft_float16/cft_int24 streams); string streams can only be delivered as cft_string.
+* @param callback The callback, or NULL to resume buffering the samples for the pull functions.
+* @param user_data An arbitrary pointer that is passed to the callback.
+* @return The error code: if nonzero, can be lsl_argument_error (unsupported format) or lsl_internal_error.
+*         When the function returns, the previous callback (if any) is no longer running.
+*/
+extern LIBLSL_C_API int lsl_set_chunk_callback(lsl_inlet in, lsl_channel_format_t format, lsl_chunk_callback callback, void *user_data);
+
+
+/* === Waiting for samples on many inlets === */
+
+/**
+* Get a file descriptor that becomes readable when samples arrive at the inlet.
+* This allows a single thread to wait on many inlets with epoll/poll/select, or to integrate inlets into existing
+* event loops (Qt, asio, libuv, ...). The descriptor must only be waited on, not read or closed by the application:
+* it stays readable until a pull finds the inlet's buffer empty, so the application should pull all available samples
+* (with a timeout of 0.0) whenever it becomes readable. It also becomes readable if the stream has been lost.
+* The descriptor is owned by the inlet and remains valid until the inlet is destroyed. It is not signalled for samples
+* that are delivered to a callback (see lsl_set_chunk_callback). Serves as an implicit lsl_open_stream.
+* @param in The lsl_inlet object to act on.
+* @param ec Error code: if nonzero, can be lsl_internal_error (e.g., if the platform does not support this; currently
+*           only POSIX platforms do).
+* @return The descriptor, or -1 if there was an error.
+*/
+extern LIBLSL_C_API int lsl_get_inlet_fd(lsl_inlet in, int *ec);
+
+/**
+* Wait until any of the given inlets has samples available for immediate pickup (or has lost its stream).
+* Unlike per-inlet pulls with timeouts, this does not poll and lets a single thread serve many inlets.
+* Serves as an implicit lsl_open_stream for all of the inlets.
+* @param inlets An array of inlets to wait on.
+* @param num_inlets The number of inlets in the array.
+* @param timeout The maximum time to wait, in seconds (LSL_FOREVER to wait indefinitely; 0.0 to only check).
+* @param ec Error code: if nonzero, can be lsl_argument_error or lsl_internal_error.
+* @return The index of the first inlet in the array that has samples available, or -1 if the timeout expired.
+*         To treat all inlets fairly, pull the available samples of all ready inlets before waiting again.
+*/
+extern LIBLSL_C_API int lsl_wait_any(lsl_inlet *inlets, int num_inlets, double timeout, int *ec);
+
 
 /* === Pulling a sample from the inlet === */
 
@@ -794,6 +1061,29 @@ extern LIBLSL_C_API unsigned long lsl_pull_chunk_str(lsl_inlet in, char **data_b
 
 extern LIBLSL_C_API unsigned long lsl_pull_chunk_buf(lsl_inlet in, char **data_buffer, unsigned *lengths_buffer, double *timestamp_buffer, unsigned long data_buffer_elements, unsigned long timestamp_buffer_elements, double timeout, int *ec);
 
+/**
+* Borrow a chunk of samples from the inlet without copying their values.
+* Instead of copying the samples into a user buffer, the inlet holds on to them and returns a read-only view of their
+* values, which is useful for consumers that only forward, checksum or write the data. Since each sample is a separate
+* allocation, the view consists of one pointer per sample, each of which addresses channel_count values of the
+* stream's format. The view stays valid until lsl_release_chunk() or the next lsl_borrow_chunk() call on the inlet.
+* @param in The lsl_inlet object to act on.
+* @param format The format in which the values will be read; must be the stream's channel format (and not cft_string).
+* @param max_samples The maximum number of samples to borrow.
+* @param data Receives a pointer to an array of pointers to the values of each borrowed sample.
+* @param timestamps Receives a pointer to an array of the time stamps of the borrowed samples.
+* @param timeout The timeout of the operation; if passed as 0.0, then only samples available for immediate pickup will be returned.
+* @param ec Error code: can be either no error or lsl_lost_error (if the stream source has been lost), or
+*           lsl_argument_error (if the format does not match).
+* @return The number of samples borrowed.
+*/
+extern LIBLSL_C_API unsigned long lsl_borrow_chunk(lsl_inlet in, lsl_channel_format_t format, unsigned long max_samples, const void * const **data, const double **timestamps, double timeout, int *ec);
+
+/**
+* Release the samples of the chunk that was most recently borrowed from the inlet (see lsl_borrow_chunk()).
+*/
+extern LIBLSL_C_API void lsl_release_chunk(lsl_inlet in);
+
 /**
 * Query whether samples are currently available for immediate pickup.
 * Note that it is not a good idea to use samples_available() to determine whether 
@@ -825,6 +1115,15 @@ extern LIBLSL_C_API unsigned lsl_was_clock_reset(lsl_inlet in);
 */
 extern LIBLSL_C_API int lsl_smoothing_halftime(lsl_inlet in, float value);
 
+/**
+* Retrieve runtime transport statistics of the inlet.
+* This is cheap enough to be called periodically (e.g., for monitoring) while data is being pulled.
+* @param in The lsl_inlet object to act on.
+* @param stats A pointer to a structure that receives the statistics.
+* @return The error code: if nonzero, can be lsl_argument_error if stats is NULL or lsl_internal_error.
+*/
+extern LIBLSL_C_API int lsl_get_inlet_stats(lsl_inlet in, lsl_inlet_stats *stats);
+
 
 
 /* ============================ */
@@ -21,6 +21,10 @@
 #include <string>
 #include <vector>
 #include <stdexcept>
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600)
+    #define LSL_CPP_HAS_STD_FUNCTION
+    #include <functional>
+#endif
 
 namespace lsl {
    #include "lsl_c.h"
@@ -62,6 +66,10 @@ namespace lsl {
                             // Not recommended for encoding string data.
         cf_int64 = 7,       // For now only for future compatibility. Support for this type is not yet exposed in all languages. 
                             // Also, some builds of liblsl will not be able to send or receive data of this type.
+        cf_float16 = 8,     // For signals whose resolution fits into 11 significant bits, at half the bandwidth of cf_float32.
+                            // Pushed and pulled as float (or any other numeric type); not understood by older liblsl versions.
+        cf_int24 = 9,       // For 24-bit digitized signals (e.g., EEG amplifiers), at three quarters of the bandwidth of cf_int32.
+                            // Pushed and pulled as int32 (or any other numeric type); not understood by older liblsl versions.
         cf_undefined = 0    // Can not be transmitted.
     };
 
@@ -80,6 +88,38 @@ namespace lsl {
 		post_threadsafe = 8,    // Post-processing is thread-safe (same inlet can be read from by multiple threads); uses somewhat more CPU.
 		post_ALL = 1|2|4|8		// The combination of all possible post-processing options.
 	};
+
+	/**
+	* What an outlet does when a lossless inlet (see stream_inlet::set_lossless()) falls so far behind that its queue is full.
+	*/
+	enum overflow_policy_t {
+		overflow_drop = 0,		// Drop the oldest samples, like for regular inlets.
+		overflow_block = 1,		// Block the push functions until the inlet has caught up (this also delays the other inlets).
+		overflow_spill = 2		// Spill the samples to a temporary file and send them once the inlet has caught up (the default).
+	};
+
+	/**
+	* Transport options for stream outlets.
+	*/
+	enum transport_options_t {
+		transport_default = 0,		// Send every inlet its own copy of the data over TCP (the default).
+		transport_multicast = 1,	// Additionally publish the data once to a multicast group, which inlets join instead (IPv4 only;
+									// lossless inlets keep receiving over TCP). For streams with many inlets on the local network.
+		transport_multi_producer = 2	// Allow several threads to push into the outlet at the same time (e.g., markers from
+										// different parts of an application) without locking it; can be combined with the above.
+	};
+
+    /**
+    * Runtime transport statistics of an outlet (see stream_outlet::stats()).
+    * All counters are cumulative over the lifetime of the outlet.
+    */
+    typedef lsl_outlet_stats outlet_stats;
+
+    /**
+    * Runtime transport statistics of an inlet (see stream_inlet::stats()).
+    * All counters are cumulative over the lifetime of the inlet; times are in seconds.
+    */
+    typedef lsl_inlet_stats inlet_stats;
 	
     /**
     * Protocol version.
@@ -311,10 +351,19 @@ namespace lsl {
     // ==== Stream Outlet ====
     // =======================
 
+    /// The channel format that corresponds to a C++ value type.
+    inline lsl_channel_format_t value_format(const float *) { return cft_float32; }
+    inline lsl_channel_format_t value_format(const double *) { return cft_double64; }
+    inline lsl_channel_format_t value_format(const std::string *) { return cft_string; }
+    inline lsl_channel_format_t value_format(const int *) { return cft_int32; }
+    inline lsl_channel_format_t value_format(const short *) { return cft_int16; }
+    inline lsl_channel_format_t value_format(const char *) { return cft_int8; }
+
     /**
     * A stream outlet.
     * Outlets are used to make streaming data (and the meta-data) available on the lab network.
     */
+    void check_error(int ec);
     class stream_outlet {
     public:
         /**
@@ -324,8 +373,12 @@ namespace lsl {
         *                   each push operation yields one chunk. Inlets can override this setting.
         * @param max_buffered Optionally the maximum amount of data to buffer (in seconds if there is a nominal 
         *                     sampling rate, otherwise x100 in samples). The default is 6 minutes of data. 
+        * @param transport Optionally the transport options (transport_multicast to send the data once to a multicast group
+        *                  instead of once per inlet, so that the load of the outlet does not grow with the number of inlets;
+        *                  note that such an outlet always has consumers; transport_multi_producer to allow several threads
+        *                  to push at the same time, see lsl_create_outlet_ex() for the details).
         */
-        stream_outlet(const stream_info &info, int chunk_size=0, int max_buffered=360): channel_count(info.channel_count()), obj(lsl_create_outlet(info.handle(),chunk_size,max_buffered)) {}
+        stream_outlet(const stream_info &info, int chunk_size=0, int max_buffered=360, transport_options_t transport=transport_default): channel_count(info.channel_count()), obj(lsl_create_outlet_ex(info.handle(),chunk_size,max_buffered,(lsl_transport_options_t)transport)) {}
 
 
         // ========================================
@@ -602,6 +655,19 @@ namespace lsl {
         */ 
         stream_info info() const { return stream_info(lsl_get_info(obj)); }
 
+        /**
+        * Retrieve runtime transport statistics of the outlet.
+        * This is cheap enough to be called periodically (e.g., for monitoring) while data is being pushed.
+        */
+        outlet_stats stats() const { outlet_stats res; check_error(lsl_get_outlet_stats(obj,&res)); return res; }
+
+        /**
+        * Set what happens when the queue of a lossless inlet (see stream_inlet::set_lossless()) is full.
+        * The default is given by the OverflowPolicy setting in the config file (spill if not set).
+        * Regular inlets are not affected; their oldest samples are always dropped.
+        */
+        void set_overflow_policy(overflow_policy_t policy) { check_error(lsl_set_overflow_policy(obj,(lsl_overflow_policy_t)policy)); }
+
         /**
         * Destructor.
         * The stream will no longer be discoverable after destruction and all paired inlets will stop delivering data.
@@ -619,11 +685,83 @@ namespace lsl {
                 throw std::runtime_error("Provided element count does not match the stream's channel count.");
         }
 
+        template<class T> friend class outlet_reservation;
+
         int channel_count;
         lsl_outlet obj;
     };
 
 
+    /**
+    * A reservation of samples in a stream outlet, whose values are written in place.
+    * The values of each sample are written through operator[] (the samples are separate allocations, so the 
+    * reservation is not one contiguous buffer) and pushed into the outlet by commit(), so that they are written exactly 
+    * once instead of being copied in by a push. T must be the value type of the stream's channel format (and not a 
+    * string). An outlet can have only one pending reservation (one per thread if it was created with 
+    * transport_multi_producer, in which case the reservation must be committed by the thread that made it); a reservation 
+    * that is destroyed without having been committed is cancelled.
+    */
+    template<class T> class outlet_reservation {
+    public:
+        /**
+        * Reserve samples in an outlet.
+        * @param outlet The outlet in which to reserve the samples.
+        * @param num_samples The number of samples to reserve.
+        * @throws std::invalid_argument if T does not match the stream's format or the outlet has a pending reservation.
+        */
+        outlet_reservation(stream_outlet &outlet, std::size_t num_samples): outlet(outlet.obj), buffers(num_samples), committed(false) {
+            check_error(lsl_outlet_reserve(this->outlet,(unsigned long)num_samples,value_format((const T*)NULL),buffers.empty() ? NULL : &buffers[0]));
+        }
+
+        /// Get the values of the k'th reserved sample (channel_count values).
+        T *operator[](std::size_t k) const { return static_cast<T*>(buffers[k]); }
+
+        /// Get the number of reserved samples.
+        std::size_t size() const { return buffers.size(); }
+
+        /**
+        * Push the reserved samples into the outlet.
+        * @param timestamp Optionally the capture time of the most recent sample, in agreement with local_clock(); if omitted, the current time is used.
+        *                  The time stamps of other samples are automatically derived based on the sampling rate of the stream.
+        * @param pushthrough Whether to push the samples through to the receivers instead of buffering them with subsequent samples.
+        */
+        void commit(double timestamp=0.0, bool pushthrough=true) { commit(size(),timestamp,pushthrough); }
+
+        /**
+        * Push the first num_samples reserved samples into the outlet and release the remaining ones.
+        * @param num_samples The number of samples to push (at most size()).
+        * @param timestamp The capture time of the most recent sample, in agreement with local_clock(); if 0.0, the current time is used.
+        * @param pushthrough Whether to push the samples through to the receivers instead of buffering them with subsequent samples.
+        */
+        void commit(std::size_t num_samples, double timestamp, bool pushthrough=true) { check_committable(); check_error(lsl_outlet_commit(outlet,(unsigned long)num_samples,timestamp,pushthrough)); committed = true; }
+
+        /**
+        * Push the reserved samples into the outlet, one time stamp per sample.
+        * @param timestamps A vector of capture times, one per sample to push (at most size()); 0.0 stands for the current time.
+        * @param pushthrough Whether to push the samples through to the receivers instead of buffering them with subsequent samples.
+        */
+        void commit(const std::vector<double> &timestamps, bool pushthrough=true) { check_committable(); check_error(lsl_outlet_commit_n(outlet,(unsigned long)timestamps.size(),timestamps.empty() ? NULL : &timestamps[0],pushthrough)); committed = true; }
+
+        /// Destructor. Cancels the reservation if it has not been committed.
+        ~outlet_reservation() { if (!committed) lsl_outlet_commit(outlet,0,0.0,0); }
+
+    private:
+        // The reservation is a non-copyable object.
+        outlet_reservation(const outlet_reservation &rhs);
+        outlet_reservation &operator=(const outlet_reservation &rhs);
+
+        /// Check that the reservation has not been committed yet; throw if it has.
+        void check_committable() const {
+            if (committed)
+                throw std::logic_error("The reservation has already been committed.");
+        }
+
+        lsl_outlet outlet;
+        std::vector<void*> buffers;
+        bool committed;
+    };
+
+
     // ===========================
     // ==== Resolve Functions ====
     // ===========================
@@ -671,10 +809,57 @@ namespace lsl {
     inline std::vector<stream_info> resolve_stream(const std::string &pred, int minimum=1, double timeout=FOREVER) { lsl_streaminfo buffer[1024]; return std::vector<stream_info>(&buffer[0],&buffer[lsl_resolve_bypred(buffer,sizeof(buffer),const_cast<char*>(pred.c_str()),minimum,timeout)]); }
 
 
+    // =============================
+    // ==== Sample-Path Tracing ====
+    // =============================
+
+    /**
+    * Write the events recorded by the sample-path tracing into a file in the Chrome trace (JSON) format.
+    * The library records timing events at the stages of the sample path (push, dispatch, serialize, write, 
+    * receive, parse, enqueue, pull) into per-thread ring buffers if it was built with the LSL_TRACING option; 
+    * the resulting file can be inspected with chrome://tracing or https://ui.perfetto.dev.
+    * To keep the cost of the tracing low, the push and dispatch events are recorded for every 64th push of each thread 
+    * only (set the environment variable LSL_TRACE_INTERVAL to change this; 1 traces every push).
+    * Alternatively, the trace is written to the file named by the environment variable LSL_TRACE_FILE when the process exits.
+    * @param filename The name of the file to write.
+    * @throws std::runtime_error if the file could not be written or the library was built without tracing support.
+    */
+    inline void write_trace(const std::string &filename) { check_error(lsl_write_trace(filename.c_str())); }
+
+
     // ======================
     // ==== Stream Inlet ====
     // ======================
 
+    /// Base class of the holders of the C++ callbacks of inlets (see stream_inlet::set_callback()).
+    class inlet_callback_base {
+    public:
+        virtual ~inlet_callback_base() {}
+    };
+
+#ifdef LSL_CPP_HAS_STD_FUNCTION
+    /// Holder of a C++ callback of an inlet that is invoked through the C callback interface.
+    template<class T> class inlet_callback: public inlet_callback_base {
+    public:
+        typedef std::function<void(const T *data, const double *timestamps, std::size_t num_samples)> function_type;
+        inlet_callback(const function_type &fn, int channel_count): fn(fn), channel_count(channel_count) {}
+        static void invoke(lsl_inlet, const void *data, const double *timestamps, unsigned long num_samples, void *user_data) { static_cast<inlet_callback*>(user_data)->call((const T*)data,timestamps,num_samples); }
+    private:
+        void call(const T *data, const double *timestamps, std::size_t num_samples) { fn(data,timestamps,num_samples); }
+        function_type fn;
+        int channel_count;
+    };
+
+    /// The string callback converts the C strings into std::strings first.
+    template<> inline void inlet_callback<std::string>::invoke(lsl_inlet, const void *data, const double *timestamps, unsigned long num_samples, void *user_data) {
+        inlet_callback *self = static_cast<inlet_callback*>(user_data);
+        const char * const *strings = (const char * const *)data;
+        std::vector<std::string> values(strings,strings+num_samples*self->channel_count);
+        self->call(values.empty() ? NULL : &values[0],timestamps,num_samples);
+    }
+
+#endif
+
     /**
     * A stream inlet.
     * Inlets are used to receive streaming data (and meta-data) from the lab network.
@@ -702,13 +887,13 @@ namespace lsl {
         *                In all other cases (recover is false or the stream is not recoverable) functions may throw a 
         *                lost_error if the stream's source is lost (e.g., due to an app or computer crash).
         */
-        stream_inlet(const stream_info &info, int max_buflen=360, int max_chunklen=0, bool recover=true): channel_count(info.channel_count()), obj(lsl_create_inlet(info.handle(),max_buflen,max_chunklen,recover)) {}
+        stream_inlet(const stream_info &info, int max_buflen=360, int max_chunklen=0, bool recover=true): channel_count(info.channel_count()), obj(lsl_create_inlet(info.handle(),max_buflen,max_chunklen,recover)), callback(NULL) {}
 
         /** 
         * Destructor.
         * The inlet will automatically disconnect if destroyed.
         */
-        ~stream_inlet() { lsl_destroy_inlet(obj); }
+        ~stream_inlet() { lsl_destroy_inlet(obj); delete callback; }
 
         /**
         * Retrieve the complete information of the given stream, including the extended description.
@@ -768,6 +953,91 @@ namespace lsl {
         */
         void set_postprocessing(unsigned flags=post_ALL) { check_error(lsl_set_postprocessing(obj,flags)); }
 
+        /**
+        * Enable or disable lossless transmission (e.g., for recording).
+        * By default, an inlet drops its oldest samples when its buffer is full (and so does the outlet when the inlet
+        * falls behind). A lossless inlet instead stops reading from the network, so that the outlet buffers the samples
+        * and applies its overflow policy once its queue for this inlet is full (see stream_outlet::set_overflow_policy()).
+        * This takes effect when the inlet (re-)connects to the outlet, so it should be called before the stream is opened.
+        * Outlets of older library versions do not support lossless transmission and drop samples regardless.
+        * If a process-wide memory budget is set (MemoryBudgetMB in the config file), samples are never evicted from the buffers
+        * of lossless inlets (or from the outlet's queues for them) to stay within the budget.
+        */
+        void set_lossless(bool lossless=true) { check_error(lsl_set_lossless(obj,lossless)); }
+
+        /**
+        * Enable or disable the repair of lost datagrams on a multicast stream (see stream_outlet).
+        * A regular inlet of a multicast stream receives the data from the multicast group; datagrams that get lost on the way
+        * are counted in stats().samples_lost. With repair enabled, the inlet instead asks the outlet to re-send them over TCP
+        * (which delays the following samples). Lossless inlets always receive the data over TCP.
+        */
+        void set_multicast_repair(bool repair=true) { check_error(lsl_set_multicast_repair(obj,repair)); }
+
+        /**
+        * Enable or disable the datagram transport for this inlet.
+        * With the datagram transport, the outlet sends each sample to the inlet as a single UDP datagram as soon as it has
+        * been pushed (regardless of the chunk sizes), instead of over the inlet's TCP connection. This shaves off latency
+        * for small, irregular samples such as event markers (e.g., for experiment triggers). Lost datagrams are not re-sent
+        * but counted in stats().samples_lost; samples that are too large for a datagram (see DatagramSize in the config
+        * file) are still sent over TCP. The inlet falls back to TCP if the outlet does not support it or no datagrams arrive.
+        * Lossless inlets always receive the data over TCP.
+        * This takes effect when the inlet (re-)connects to the outlet, so it should be called before the stream is opened.
+        */
+        void set_datagram_transport(bool datagrams=true) { check_error(lsl_set_datagram_transport(obj,datagrams)); }
+
+        /**
+        * Keep only the most recent samples in the inlet's buffer ("latest frame" delivery).
+        * Whenever a new sample arrives, the inlet drops the buffered samples that exceed the given number, so that a consumer
+        * that cannot keep up (e.g., a viewer that renders the frames of a video stream) always gets the latest data instead of
+        * falling behind. These samples are not counted as overruns in stats().samples_dropped.
+        * The inlet also asks the outlet to buffer no more than this number of samples for it, so that superseded samples
+        * are dropped before they are sent (outlets of older library versions send all samples instead). This part takes
+        * effect when the inlet (re-)connects to the outlet, so it should be called before the stream is opened.
+        * This has no effect on lossless inlets or while a chunk callback is set.
+        * @param num_samples The number of samples to keep (e.g., 1 for the latest frame only), or 0 to buffer up to max_buflen again.
+        */
+        void set_latest_only(int num_samples=1) { check_error(lsl_set_latest_only(obj,num_samples)); }
+
+#ifdef LSL_CPP_HAS_STD_FUNCTION
+        /**
+        * Set a function that receives the samples as soon as they have arrived, instead of buffering them for the pull functions.
+        * The function is called from the inlet's data thread with each chunk of samples that have arrived together, converted
+        * to T (float, double, int, short, char or std::string) and with post-processed time stamps (see set_postprocessing();
+        * the clock synchronization uses the most recent clock offset, or none until the first estimate is in).
+        * The values are multiplexed (num_samples times the channel count) and only valid during the call.
+        * The function should return quickly since no data is read while it runs; it must not throw or set the callback itself.
+        * Samples are only received after the stream has been opened (see open_stream()).
+        * Example: inlet.set_callback<float>([](const float *data, const double *timestamps, std::size_t num_samples) { ... });
+        * @throws std::invalid_argument if T is not compatible with the stream's format (strings can only be delivered as strings).
+        */
+        template<class T> void set_callback(const typename inlet_callback<T>::function_type &fn) {
+            inlet_callback<T> *holder = new inlet_callback<T>(fn,channel_count);
+            int ec = lsl_set_chunk_callback(obj,value_format((const T*)NULL),&inlet_callback<T>::invoke,holder);
+            if (ec) {
+                delete holder;
+                check_error(ec);
+            }
+            delete callback;
+            callback = holder;
+        }
+#endif
+
+        /**
+        * Get a file descriptor that becomes readable when samples arrive, so that a single thread can wait on many inlets
+        * with epoll/poll/select or an existing event loop (Qt, asio, libuv, ...). The descriptor is owned by the inlet and
+        * must only be waited on; it stays readable until a pull finds the buffer empty, so pull all available samples
+        * (with a timeout of 0.0) whenever it becomes readable. Serves as an implicit open_stream().
+        * @throws std::runtime_error if the platform does not support it (currently only POSIX platforms do).
+        */
+        int fd() { int ec; int result = lsl_get_inlet_fd(obj,&ec); check_error(ec); return result; }
+
+        /// Remove the callback (if any) and resume buffering the samples for the pull functions.
+        void clear_callback() {
+            check_error(lsl_set_chunk_callback(obj,cft_undefined,NULL,NULL));
+            delete callback;
+            callback = NULL;
+        }
+
         // =======================================
         // === Pulling a sample from the inlet ===
         // =======================================
@@ -1030,6 +1300,15 @@ namespace lsl {
 		* degrees C per minute sufficiently well.
 		*/
 		void smoothing_halftime(float value) { check_error(lsl_smoothing_halftime(obj,value)); }
+
+        /**
+        * Retrieve runtime transport statistics of the inlet.
+        * This is cheap enough to be called periodically (e.g., for monitoring) while data is being pulled.
+        */
+        inlet_stats stats() const { inlet_stats res; check_error(lsl_get_inlet_stats(obj,&res)); return res; }
+
+        /// Get the underlying inlet handle (e.g., for lsl_wait_any()).
+        lsl_inlet handle() const { return obj; }
     private:
         // The inlet is a non-copyable object.
         stream_inlet(const stream_inlet &rhs);
@@ -1037,8 +1316,76 @@ namespace lsl {
 
         int channel_count;
         lsl_inlet obj;
+        inlet_callback_base *callback;  // the C++ callback that has been set with set_callback() (if any)
+    };
+
+    /**
+    * A chunk of samples borrowed from a stream inlet, whose values are read in place.
+    * Instead of copying the samples into user buffers, the inlet holds on to them until the chunk is destroyed, so 
+    * consumers that only forward, checksum or write the data need not copy it. The values of each sample are read 
+    * through operator[] (the samples are separate allocations, so the chunk is not one contiguous buffer). T must be 
+    * the value type of the stream's channel format (and not a string). An inlet can lend only one chunk at a time, 
+    * so a chunk must be destroyed before the next one is borrowed.
+    */
+    template<class T> class borrowed_chunk {
+    public:
+        /**
+        * Borrow a chunk of samples from an inlet.
+        * @param inlet The inlet from which to borrow the samples.
+        * @param max_samples The maximum number of samples to borrow.
+        * @param timeout The timeout of the operation; if passed as 0.0, then only samples available for immediate pickup will be returned.
+        * @throws lost_error (if the stream source has been lost), or std::invalid_argument if T does not match the stream's format.
+        */
+        borrowed_chunk(stream_inlet &inlet, std::size_t max_samples, double timeout=0.0): inlet(inlet.handle()), data(NULL), timestamps(NULL) {
+            int ec = 0;
+            num_samples = lsl_borrow_chunk(this->inlet,value_format((const T*)NULL),(unsigned long)max_samples,&data,&timestamps,timeout,&ec);
+            check_error(ec);
+        }
+
+        /// Get the values of the k'th sample (channel_count values).
+        const T *operator[](std::size_t k) const { return static_cast<const T*>(data[k]); }
+
+        /// Get the time stamp of the k'th sample.
+        double timestamp(std::size_t k) const { return timestamps[k]; }
+
+        /// Get the number of borrowed samples.
+        std::size_t size() const { return num_samples; }
+
+        /// Check whether no samples were borrowed.
+        bool empty() const { return num_samples == 0; }
+
+        /// Destructor. Returns the samples to the inlet.
+        ~borrowed_chunk() { lsl_release_chunk(inlet); }
+
+    private:
+        // The chunk is a non-copyable object.
+        borrowed_chunk(const borrowed_chunk &rhs);
+        borrowed_chunk &operator=(const borrowed_chunk &rhs);
+
+        lsl_inlet inlet;
+        const void * const *data;
+        const double *timestamps;
+        std::size_t num_samples;
     };
 
+    /**
+    * Wait until any of the given inlets has samples available for immediate pickup (or has lost its stream).
+    * Unlike pulls with timeouts on each inlet, this does not poll and lets a single thread serve many inlets.
+    * Serves as an implicit open_stream() for all of the inlets.
+    * @param inlets The inlets to wait on.
+    * @param timeout The maximum time to wait, in seconds (default: no timeout; 0.0 to only check).
+    * @return The index of the first inlet in the vector that has samples available, or -1 if the timeout expired.
+    *         To treat all inlets fairly, pull the available samples of all ready inlets before waiting again.
+    */
+    inline int wait_any(const std::vector<stream_inlet*> &inlets, double timeout=FOREVER) {
+        std::vector<lsl_inlet> handles(inlets.size());
+        for (std::size_t k=0; k<inlets.size(); k++)
+            handles[k] = inlets[k]->handle();
+        int ec, result = lsl_wait_any(handles.empty() ? NULL : &handles[0],(int)handles.size(),timeout,&ec);
+        check_error(ec);
+        return result;
+    }
+
 
     // =====================
     // ==== XML Element ====
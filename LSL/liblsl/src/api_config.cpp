@@ -54,9 +54,14 @@ bool file_is_readable(const std::string& filename) {
 * Applies default settings and overrides them based on a config file (if present).
 */
 api_config::api_config() {
-	// for each config file location under consideration...
-	std::string filenames[] = {"lsl_api.cfg", expand_tilde("~/lsl_api/lsl_api.cfg"), "/etc/lsl_api/lsl_api.cfg"};
-	for (unsigned k=0; k < sizeof(filenames)/sizeof(filenames[0]); k++) {
+	// for each config file location under consideration (a file named in the LSLAPICFG environment variable takes precedence)...
+	std::vector<std::string> filenames;
+	if (getenv("LSLAPICFG"))
+		filenames.push_back(getenv("LSLAPICFG"));
+	filenames.push_back("lsl_api.cfg");
+	filenames.push_back(expand_tilde("~/lsl_api/lsl_api.cfg"));
+	filenames.push_back("/etc/lsl_api/lsl_api.cfg");
+	for (unsigned k=0; k < filenames.size(); k++) {
 		try {
 			if (file_is_readable(filenames[k])) {
 				// try to load it if the file exists
@@ -155,6 +160,12 @@ void api_config::load_from_file(const std::string &filename) {
 		if (!address_override.empty())
 			multicast_addresses_ = address_override;
 
+		// read the multicast data settings
+		multicast_data_address_ = pt.get("multicast.DataAddress","239.255.173.1");
+		multicast_data_port_ = pt.get("multicast.DataPort",16600);
+		multicast_packet_size_ = pt.get("multicast.DataPacketSize",1472);
+		multicast_repair_buffer_mb_ = pt.get("multicast.RepairBufferMB",16.0);
+
 		// read the [lab] settings
 		known_peers_ = parse_set(pt.get("lab.KnownPeers","{}"));
 		session_id_ = pt.get("lab.SessionID","default");
@@ -168,6 +179,11 @@ void api_config::load_from_file(const std::string &filename) {
 		unicast_min_rtt_ = pt.get("tuning.UnicastMinRTT",0.75);
 		unicast_max_rtt_ = pt.get("tuning.UnicastMaxRTT",5.0);
 		continuous_resolve_interval_ = pt.get("tuning.ContinuousResolveInterval",0.5);
+		recovery_probe_timeout_ = pt.get("tuning.RecoveryProbeTimeout",0.5);
+		recovery_probe_interval_ = pt.get("tuning.RecoveryProbeInterval",0.1);
+		recovery_resolve_time_ = pt.get("tuning.RecoveryResolveTime",1.0);
+		recovery_retry_time_ = pt.get("tuning.RecoveryRetryTime",5.0);
+		reconnect_interval_ = pt.get("tuning.ReconnectInterval",0.5);
 		timer_resolution_ = pt.get("tuning.TimerResolution",1);
 		max_cached_queries_ = pt.get("tuning.MaxCachedQueries",100);
 		time_update_interval_ = pt.get("tuning.TimeUpdateInterval",2.0);
@@ -179,8 +195,29 @@ void api_config::load_from_file(const std::string &filename) {
 		outlet_buffer_reserve_samples_ = pt.get("tuning.OutletBufferReserveSamples",128);
 		inlet_buffer_reserve_ms_ = pt.get("tuning.InletBufferReserveMs",5000);
 		inlet_buffer_reserve_samples_ = pt.get("tuning.InletBufferReserveSamples",128);
+		large_sample_bytes_ = pt.get("tuning.LargeSampleBytes",65536);
+		large_sample_reserve_ = pt.get("tuning.LargeSampleReserve",4);
 		smoothing_halftime_ = pt.get("tuning.SmoothingHalftime",90.0f);
+		clock_source_ = pt.get("tuning.ClockSource","default");
+		clock_calibration_interval_ = pt.get("tuning.ClockCalibrationInterval",1.0);
 		force_default_timestamps_ = pt.get("tuning.ForceDefaultTimestamps", false);
+		overflow_policy_ = pt.get("tuning.OverflowPolicy","spill");
+		spill_directory_ = pt.get("tuning.SpillDirectory","");
+		memory_budget_mb_ = pt.get("tuning.MemoryBudgetMB",0.0);
+		eviction_policy_ = pt.get("tuning.EvictionPolicy","oldest");
+		multiplex_sessions_ = pt.get("tuning.MultiplexSessions",false);
+		datagram_size_ = pt.get("tuning.DatagramSize",1472);
+
+		// read the [impairment] settings
+		impairment_delay_ = pt.get("impairment.Delay",0.0);
+		impairment_jitter_ = pt.get("impairment.Jitter",0.0);
+		impairment_distribution_ = pt.get("impairment.JitterDistribution","exponential");
+		impairment_loss_ = pt.get("impairment.Loss",0.0);
+		impairment_retransmission_timeout_ = pt.get("impairment.RetransmissionTimeout",0.2);
+		impairment_bandwidth_ = pt.get("impairment.Bandwidth",0.0);
+		impairment_disconnect_interval_ = pt.get("impairment.DisconnectInterval",0.0);
+		impairment_outage_duration_ = pt.get("impairment.OutageDuration",0.0);
+		impairment_seed_ = pt.get("impairment.Seed",1u);
 
 	} catch(std::exception &e) {
 		std::cerr << "Error parsing config file " << filename << " (" << e.what() << "). Rolling back to defaults." << std::endl;
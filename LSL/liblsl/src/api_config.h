@@ -113,6 +113,19 @@ namespace lsl {
 		*/
 		int multicast_ttl() const { return multicast_ttl_; } 
 
+		/**
+		* The multicast group to which outlets in multicast mode publish their data (see multicast_publisher).
+		* Each stream uses one of 256 ports starting at multicast_data_port() (chosen by a hash of its UID).
+		*/
+		const std::string &multicast_data_address() const { return multicast_data_address_; }
+		int multicast_data_port() const { return multicast_data_port_; }
+
+		/// The maximum size of a multicast data packet, in bytes (larger samples are sent in fragments).
+		int multicast_packet_size() const { return multicast_packet_size_; }
+
+		/// The amount of recently published data that an outlet in multicast mode keeps for repair requests, in MB.
+		double multicast_repair_buffer_mb() const { return multicast_repair_buffer_mb_; }
+
 		/**
 		* The configured session ID. 
 		* Allows to keep recording operations isolated from each other (precluding unwanted interference).
@@ -143,6 +156,16 @@ namespace lsl {
 		double unicast_max_rtt() const { return unicast_max_rtt_; }
 		/// The interval at which resolve queries are emitted for continuous/background resolve activities. This is in addition to the assumed RTT's.
 		double continuous_resolve_interval() const { return continuous_resolve_interval_; }
+		/// Time budget for the first recovery stage, which re-probes the last known host of a lost stream directly (0 disables this stage).
+		double recovery_probe_timeout() const { return recovery_probe_timeout_; }
+		/// Interval at which the direct recovery probe is re-sent to the last known host while waiting for a reply.
+		double recovery_probe_interval() const { return recovery_probe_interval_; }
+		/// Minimum search time of the first network-wide resolve during a recovery (subsequent resolves use recovery_retry_time()).
+		double recovery_resolve_time() const { return recovery_resolve_time_; }
+		/// Minimum search time of repeated network-wide resolves during a recovery (e.g., while multiple candidate streams are present).
+		double recovery_retry_time() const { return recovery_retry_time_; }
+		/// Pause between reconnect attempts of an inlet whose stream was not re-hosted elsewhere, in seconds (re-hosted streams are reconnected immediately).
+		double reconnect_interval() const { return reconnect_interval_; }
 		/// Desired timer resolution in ms (0 means no change). Currently only affects Windows operating systems, where values other than 1 can increase LSL transmission latency.
 		int timer_resolution() const { return timer_resolution_; }
 		/// The maximum number of most-recently-used queries that is cached.
@@ -165,10 +188,51 @@ namespace lsl {
 		int inlet_buffer_reserve_ms() const { return inlet_buffer_reserve_ms_; }
 		/// Default pre-allocated buffer size for the inlet, in samples (irregular streams).
 		int inlet_buffer_reserve_samples() const { return inlet_buffer_reserve_samples_; }
+		/// Size from which a sample counts as large (e.g., a video frame), in bytes; large samples are allocated page-aligned.
+		int large_sample_bytes() const { return large_sample_bytes_; }
+		/// Maximum number of large samples that are pre-allocated per outlet or inlet (more are allocated on demand).
+		int large_sample_reserve() const { return large_sample_reserve_; }
 		/// Default halftime of the time-stamp smoothing window (if enabled), in seconds.
 		float smoothing_halftime() const { return smoothing_halftime_; }
+		/// The backend of the local clock: default (boost::chrono), monotonic (CLOCK_MONOTONIC via the vDSO) or tsc (calibrated time-stamp counter; see clock_sources.h).
+		const std::string &clock_source() const { return clock_source_; }
+		/// The maximum interval between calibrations of the tsc clock backend against the system's monotonic clock, in seconds.
+		double clock_calibration_interval() const { return clock_calibration_interval_; }
 		/// Override timestamps with lsl clock if True
 		bool force_default_timestamps() const { return force_default_timestamps_; }
+		/// What an outlet does when the queue of a lossless inlet is full: block, drop or spill (see lsl_overflow_policy_t).
+		const std::string &overflow_policy() const { return overflow_policy_; }
+		/// The directory in which samples are spilled to disk (empty = the system's temporary directory).
+		const std::string &spill_directory() const { return spill_directory_; }
+		/// Process-wide budget for the memory held in buffered samples, in MB (0 = unlimited; see memory_budget).
+		double memory_budget_mb() const { return memory_budget_mb_; }
+		/// Which samples are evicted when the memory budget is exhausted: oldest, fullest or none (see memory_budget).
+		const std::string &eviction_policy() const { return eviction_policy_; }
+		/// Whether the streams of this process are multiplexed over one TCP connection per remote process (see mux_server and mux_connection).
+		bool multiplex_sessions() const { return multiplex_sessions_; }
+		/// The maximum size of a datagram of a datagram feed, in bytes (larger samples are sent over TCP; see feed_encoder).
+		int datagram_size() const { return datagram_size_; }
+
+		// === impairment parameters (for testing; see impaired_network) ===
+
+		/// Base one-way delay of the emulated network, in seconds (0 = none).
+		double impairment_delay() const { return impairment_delay_; }
+		/// Spread of the random extra delay of the emulated network, in seconds (0 = none).
+		double impairment_jitter() const { return impairment_jitter_; }
+		/// Distribution of the extra delay: exponential, uniform or normal.
+		const std::string &impairment_distribution() const { return impairment_distribution_; }
+		/// Probability that a UDP datagram is lost or that a TCP segment is retransmitted.
+		double impairment_loss() const { return impairment_loss_; }
+		/// Extra delay of a retransmitted TCP segment, in seconds.
+		double impairment_retransmission_timeout() const { return impairment_retransmission_timeout_; }
+		/// Throughput limit per connection and direction, in bytes per second (0 = unlimited).
+		double impairment_bandwidth() const { return impairment_bandwidth_; }
+		/// Mean time between random disconnects, in seconds (0 = never).
+		double impairment_disconnect_interval() const { return impairment_disconnect_interval_; }
+		/// Time during which new connections are refused after a disconnect, in seconds.
+		double impairment_outage_duration() const { return impairment_outage_duration_; }
+		/// Seed of the random number generator of the emulated network.
+		unsigned impairment_seed() const { return impairment_seed_; }
 
 	private:
 		// Thread-safe initialization logic (boilerplate).
@@ -198,6 +262,10 @@ namespace lsl {
 		std::vector<std::string> multicast_addresses_;
 		int multicast_ttl_;
 		std::string listen_address_;
+		std::string multicast_data_address_;
+		int multicast_data_port_;
+		int multicast_packet_size_;
+		double multicast_repair_buffer_mb_;
 		std::vector<std::string> known_peers_;
 		std::string session_id_;
 		// tuning parameters
@@ -209,6 +277,11 @@ namespace lsl {
 		double unicast_min_rtt_;
 		double unicast_max_rtt_;
 		double continuous_resolve_interval_;
+		double recovery_probe_timeout_;
+		double recovery_probe_interval_;
+		double recovery_resolve_time_;
+		double recovery_retry_time_;
+		double reconnect_interval_;
 		int timer_resolution_;
 		int max_cached_queries_;
 		double time_update_interval_;
@@ -220,8 +293,28 @@ namespace lsl {
 		int outlet_buffer_reserve_samples_;
 		int inlet_buffer_reserve_ms_;
 		int inlet_buffer_reserve_samples_;
+		int large_sample_bytes_;
+		int large_sample_reserve_;
 		float smoothing_halftime_;
+		std::string clock_source_;
+		double clock_calibration_interval_;
 		bool force_default_timestamps_;
+		std::string overflow_policy_;
+		std::string spill_directory_;
+		double memory_budget_mb_;
+		std::string eviction_policy_;
+		bool multiplex_sessions_;
+		int datagram_size_;
+		// impairment parameters
+		double impairment_delay_;
+		double impairment_jitter_;
+		std::string impairment_distribution_;
+		double impairment_loss_;
+		double impairment_retransmission_timeout_;
+		double impairment_bandwidth_;
+		double impairment_disconnect_interval_;
+		double impairment_outage_duration_;
+		unsigned impairment_seed_;
 	};
 }
 
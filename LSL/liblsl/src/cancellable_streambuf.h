@@ -20,10 +20,14 @@
 #endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
 
 #include "cancellation.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
 #include <streambuf>
 #include <exception>
 #include <set>
 #include <boost/asio/detail/config.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/utility/base_from_member.hpp>
 #include <boost/asio/basic_socket.hpp>
 #include <boost/asio/detail/array.hpp>
@@ -42,7 +46,7 @@ namespace lslboost {
 			typedef typename Protocol::endpoint endpoint_type;
 
 			/// Construct a cancellable_streambuf without establishing a connection.
-			cancellable_streambuf(): basic_socket<Protocol, StreamSocketService>(lslboost::base_from_member<lslboost::asio::io_service>::member), cancel_issued_(false), cancel_started_(false) {
+			cancellable_streambuf(): basic_socket<Protocol, StreamSocketService>(lslboost::base_from_member<lslboost::asio::io_service>::member), bytes_received_(0), cancel_issued_(false), cancel_started_(false) {
 				init_buffers();
 			}
 
@@ -113,6 +117,9 @@ namespace lslboost {
 			*/
 			const lslboost::system::error_code& puberror() const { return error(); }
 
+			/// Get the total number of bytes that have been received through this stream buffer.
+			lslboost::uint64_t bytes_received() const { return bytes_received_; }
+
 		protected:
 			/// Close the socket if it's open.
 			void close_if_open() {
@@ -134,18 +141,22 @@ namespace lslboost {
 
 			int_type underflow() {
 				if (gptr() == egptr()) {
+					LSL_TRACE_SCOPE("receive");
 					io_handler handler = { this };
 					this->get_service().async_receive(this->get_implementation(),
 						lslboost::asio::buffer(lslboost::asio::buffer(get_buffer_) + putback_max),
 						0, handler);
 
 					ec_ = lslboost::asio::error::would_block;
+					bytes_transferred_ = 0;
 					protected_reset(); // line changed for lsl
 					do this->get_service().get_io_service().run_one();
 					while (ec_ == lslboost::asio::error::would_block);
-					if (ec_)
+					// a cancel() closes the socket without an error code, in which case nothing was received
+					if (ec_ || !bytes_transferred_)
 						return traits_type::eof();
 
+					bytes_received_ += bytes_transferred_;
 					setg(&get_buffer_[0], &get_buffer_[0] + putback_max,
 						&get_buffer_[0] + putback_max + bytes_transferred_);
 					return traits_type::to_int_type(*gptr());
@@ -154,6 +165,34 @@ namespace lslboost {
 					return traits_type::eof();
 			}
 
+			/// Read a block of data; blocks that are larger than the get buffer are received directly into the destination.
+			std::streamsize xsgetn(char_type *s, std::streamsize n) {
+				// take what is already buffered
+				std::streamsize done = std::min<std::streamsize>(n,egptr()-gptr());
+				memcpy(s,gptr(),(std::size_t)done);
+				gbump((int)done);
+				// receive the bulk of a large block (e.g., a video frame) without copying it through the get buffer
+				while (n-done >= (std::streamsize)buffer_size) {
+					LSL_TRACE_SCOPE("receive");
+					io_handler handler = { this };
+					this->get_service().async_receive(this->get_implementation(),
+						lslboost::asio::buffer(s+done,(std::size_t)(n-done)), 0, handler);
+					ec_ = lslboost::asio::error::would_block;
+					bytes_transferred_ = 0;
+					protected_reset();
+					do this->get_service().get_io_service().run_one();
+					while (ec_ == lslboost::asio::error::would_block);
+					if (ec_ || !bytes_transferred_)
+						return done;
+					bytes_received_ += bytes_transferred_;
+					done += bytes_transferred_;
+				}
+				// read the remainder through the get buffer
+				if (done < n)
+					done += std::streambuf::xsgetn(s+done,n-done);
+				return done;
+			}
+
 			int_type overflow(int_type c) {
 				// Send all data in the output buffer.
 				lslboost::asio::const_buffer buffer =
@@ -220,6 +259,7 @@ namespace lslboost {
 			lslboost::asio::detail::array<char, buffer_size> put_buffer_;
 			lslboost::system::error_code ec_;
 			std::size_t bytes_transferred_;
+			lslboost::uint64_t bytes_received_;
 			bool cancel_issued_;
 			bool cancel_started_;
 			lslboost::recursive_mutex cancel_mut_;
@@ -0,0 +1,201 @@
+#include "clock_sources.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <boost/chrono/system_clocks.hpp>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+	#define LSL_HAS_TSC
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#include <cpuid.h>
+	#define LSL_HAS_TSC
+#endif
+#ifdef __linux__
+	#include <time.h>
+#endif
+
+
+// === implementation of the clock backends ===
+
+using namespace lsl;
+
+namespace {
+
+	/// Offsets from the reference clock beyond this (in seconds) are corrected in one step rather than slewed out.
+	const double max_slew_offset = 0.001;
+
+	/// The duration of the initial calibration, in seconds.
+	const double initial_calibration = 0.005;
+
+	/// The first calibration interval, in seconds (the interval then doubles up to the configured maximum).
+	const double first_interval = 0.1;
+
+	/// Read the time-stamp counter.
+	inline lslboost::uint64_t read_tsc() {
+#if defined(_MSC_VER) && defined(LSL_HAS_TSC)
+		return __rdtsc();
+#elif defined(LSL_HAS_TSC)
+		return __builtin_ia32_rdtsc();
+#else
+		return 0;
+#endif
+	}
+
+	/// Store a double in a 64-bit integer (for atomics).
+	inline lslboost::uint64_t to_bits(double value) { lslboost::uint64_t result; memcpy(&result,&value,sizeof(result)); return result; }
+
+	/// Get a double back from its bits.
+	inline double from_bits(lslboost::uint64_t bits) { double result; memcpy(&result,&bits,sizeof(result)); return result; }
+
+	/// The largest reading of a tsc_clock on the calling thread (a compiler-supported thread-local, which is much cheaper than a shared atomic).
+#ifdef _MSC_VER
+	__declspec(thread) double last_tsc_reading = 0.0;
+#else
+	__thread double last_tsc_reading = 0.0;
+#endif
+
+	/// The tsc_clock that backs lsl_clock() (if selected).
+	tsc_clock *shared_tsc_clock = NULL;
+
+	/// Read the shared tsc_clock.
+	double shared_tsc_reading() { return shared_tsc_clock->now(); }
+
+}
+
+/// Read boost::chrono's high_resolution_clock (the default backend).
+double lsl::chrono_clock() {
+	return lslboost::chrono::nanoseconds(lslboost::chrono::high_resolution_clock::now().time_since_epoch()).count()/1000000000.0;
+}
+
+/// Read CLOCK_MONOTONIC directly (which is also the clock behind boost::chrono's high_resolution_clock on Linux).
+double lsl::monotonic_clock() {
+#ifdef __linux__
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec*1e-9;
+#else
+	return chrono_clock();
+#endif
+}
+
+/// Whether the CPU has an invariant time-stamp counter.
+bool tsc_clock::supported() {
+#if defined(_MSC_VER) && defined(LSL_HAS_TSC)
+	int regs[4];
+	__cpuid(regs,0x80000000);
+	if ((unsigned)regs[0] < 0x80000007)
+		return false;
+	__cpuid(regs,0x80000007);
+	return (regs[3] & (1<<8)) != 0;
+#elif defined(LSL_HAS_TSC)
+	unsigned a, b, c, d;
+	if (!__get_cpuid(0x80000007,&a,&b,&c,&d))
+		return false;
+	return (d & (1u<<8)) != 0;
+#else
+	return false;
+#endif
+}
+
+/// Construct and calibrate the clock.
+tsc_clock::tsc_clock(double calibration_interval): sequence_(0), calibrating_(false), interval_(first_interval), max_interval_(std::max(calibration_interval,first_interval)) {
+	// measure the initial rate over a few milliseconds
+	origin_time_ = reference_sample(origin_ticks_);
+	lslboost::uint64_t ticks = 0;
+	double time;
+	do time = reference_sample(ticks);
+	while (time < origin_time_ + initial_calibration || ticks <= origin_ticks_);
+	double seconds_per_tick = (time - origin_time_)/(double)(ticks - origin_ticks_);
+	base_ticks_.store(ticks);
+	base_time_.store(to_bits(time));
+	seconds_per_tick_.store(to_bits(seconds_per_tick));
+	next_calibration_.store(ticks + (lslboost::uint64_t)(interval_/seconds_per_tick));
+}
+
+/// Read the clock, in seconds.
+double tsc_clock::now() {
+	while (true) {
+		unsigned seq = sequence_.load(lslboost::memory_order_acquire);
+		lslboost::uint64_t ticks = read_tsc();
+		lslboost::uint64_t base_ticks = base_ticks_.load(lslboost::memory_order_relaxed);
+		double base_time = from_bits(base_time_.load(lslboost::memory_order_relaxed));
+		double seconds_per_tick = from_bits(seconds_per_tick_.load(lslboost::memory_order_relaxed));
+		lslboost::uint64_t next_calibration = next_calibration_.load(lslboost::memory_order_relaxed);
+		lslboost::atomic_thread_fence(lslboost::memory_order_acquire);
+		if ((seq & 1) || sequence_.load(lslboost::memory_order_relaxed) != seq)
+			continue;
+		if (ticks >= next_calibration && !calibrating_.exchange(true,lslboost::memory_order_acquire)) {
+			calibrate();
+			calibrating_.store(false,lslboost::memory_order_release);
+			continue;
+		}
+		// the TSC of another core may lag slightly behind the base of the conversion
+		double time = base_time + (double)(lslboost::int64_t)(ticks - base_ticks)*seconds_per_tick;
+		if (time < last_tsc_reading)
+			return last_tsc_reading;
+		return last_tsc_reading = time;
+	}
+}
+
+/// Sample the TSC and the reference clock at (nearly) the same time.
+double tsc_clock::reference_sample(lslboost::uint64_t &ticks) {
+	// take the tightest of a few brackets of TSC readings around a reference reading (the reference may be preempted)
+	lslboost::uint64_t best_span = ~(lslboost::uint64_t)0;
+	double result = 0.0;
+	for (int k=0;k<3;k++) {
+		lslboost::uint64_t before = read_tsc();
+		double time = monotonic_clock();
+		lslboost::uint64_t after = read_tsc();
+		if (after - before < best_span) {
+			best_span = after - before;
+			ticks = before + best_span/2;
+			result = time;
+		}
+	}
+	return result;
+}
+
+/// Calibrate the conversion.
+void tsc_clock::calibrate() {
+	lslboost::uint64_t ticks = 0;
+	double time = reference_sample(ticks);
+	lslboost::uint64_t base_ticks = base_ticks_.load(lslboost::memory_order_relaxed);
+	double base_time = from_bits(base_time_.load(lslboost::memory_order_relaxed));
+	double seconds_per_tick = from_bits(seconds_per_tick_.load(lslboost::memory_order_relaxed));
+	// the current conversion at this point and its offset from the reference clock
+	double current = base_time + (double)(lslboost::int64_t)(ticks - base_ticks)*seconds_per_tick;
+	double offset = current - time;
+	if (std::fabs(offset) > max_slew_offset || ticks <= origin_ticks_) {
+		// step to the reference clock and start over with the rate estimate (each thread's readings stay monotonic)
+		current = time;
+		origin_ticks_ = ticks;
+		origin_time_ = time;
+		interval_ = first_interval;
+	} else {
+		// estimate the rate over the whole time since the origin, and slew out the offset over the next interval
+		interval_ = std::min(2*interval_,max_interval_);
+		seconds_per_tick = (time - origin_time_)/(double)(ticks - origin_ticks_) * (1.0 - offset/interval_);
+	}
+	sequence_.fetch_add(1,lslboost::memory_order_relaxed);
+	lslboost::atomic_thread_fence(lslboost::memory_order_release);
+	base_ticks_.store(ticks,lslboost::memory_order_relaxed);
+	base_time_.store(to_bits(current),lslboost::memory_order_relaxed);
+	seconds_per_tick_.store(to_bits(seconds_per_tick),lslboost::memory_order_relaxed);
+	next_calibration_.store(ticks + (lslboost::uint64_t)(interval_/seconds_per_tick),lslboost::memory_order_relaxed);
+	sequence_.fetch_add(1,lslboost::memory_order_release);
+}
+
+/// Get the clock backend of the given name.
+clock_source_fn lsl::select_clock_source(const std::string &name, double calibration_interval) {
+	if (name == "tsc" && tsc_clock::supported()) {
+		// the clock is never deallocated, since it may be read until the very end of the process
+		static tsc_clock *instance = shared_tsc_clock = new tsc_clock(calibration_interval);
+		(void)instance;
+		return &shared_tsc_reading;
+	}
+#ifdef __linux__
+	if (name == "tsc" || name == "monotonic")
+		return &monotonic_clock;
+#endif
+	return &chrono_clock;
+}
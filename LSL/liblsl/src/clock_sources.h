@@ -0,0 +1,86 @@
+#ifndef CLOCK_SOURCES_H
+#define CLOCK_SOURCES_H
+
+#include <string>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+
+namespace lsl {
+
+	/**
+	* The backends of lsl_clock(), which is selected by the ClockSource setting of the api_config.
+	* All backends count the seconds on the same time line (CLOCK_MONOTONIC on Linux), so that processes
+	* with different settings on the same machine still agree on the time; they only differ in the cost per reading.
+	*/
+
+	/// A clock backend; returns the time in seconds.
+	typedef double (*clock_source_fn)();
+
+	/// Read boost::chrono's high_resolution_clock (the default backend).
+	double chrono_clock();
+
+	/// Read CLOCK_MONOTONIC directly, which is served by the vDSO on Linux; elsewhere the same as chrono_clock().
+	double monotonic_clock();
+
+	/**
+	* A clock that reads the CPU's time-stamp counter and converts it into monotonic_clock() time.
+	*
+	* Reading the TSC takes a few nanoseconds and needs no system call. The conversion is calibrated against
+	* monotonic_clock() at the first reading and re-calibrated periodically (by whichever thread reads the clock
+	* when a calibration is due), which slews the conversion such that it meets the reference clock at the next
+	* calibration; the conversion is therefore continuous and deviates from the reference clock by at most the
+	* drift accumulated over one calibration interval. Offsets of more than a millisecond (e.g., after a suspend
+	* of the machine) are corrected in one step. The readings of each thread never decrease (a reading that would
+	* be earlier than the thread's previous one, e.g., after a step back, returns the previous one instead); across threads,
+	* they are as consistent as the TSCs of the CPU cores, which the operating system keeps synchronized.
+	* This requires an invariant TSC, i.e., one that ticks at a constant rate regardless of power states.
+	* Since the monotonicity is tracked per thread, a process should read only one instance (see select_clock_source()).
+	*/
+	class tsc_clock: public lslboost::noncopyable {
+	public:
+		/**
+		* Construct and calibrate the clock (which takes a few milliseconds).
+		* @param calibration_interval The maximum interval between calibrations, in seconds.
+		*/
+		explicit tsc_clock(double calibration_interval);
+
+		/// Whether the CPU has an invariant time-stamp counter.
+		static bool supported();
+
+		/// Read the clock, in seconds.
+		double now();
+
+	private:
+		/// Sample the TSC and the reference clock at (nearly) the same time.
+		double reference_sample(lslboost::uint64_t &ticks);
+
+		/// Calibrate the conversion (only called by one thread at a time).
+		void calibrate();
+
+		// the conversion from ticks to seconds, which readers access under a sequence lock (doubles are stored as bits)
+		lslboost::atomic<unsigned> sequence_;				// odd while a calibration is being written
+		lslboost::atomic<lslboost::uint64_t> base_ticks_;	// the tick count at which the current conversion starts ...
+		lslboost::atomic<lslboost::uint64_t> base_time_;	// ... and the time in seconds that it maps to
+		lslboost::atomic<lslboost::uint64_t> seconds_per_tick_;	// the slope of the conversion
+		lslboost::atomic<lslboost::uint64_t> next_calibration_;	// the tick count at which the next calibration is due
+		lslboost::atomic<bool> calibrating_;				// whether a thread is calibrating the conversion
+		// state of the calibration (only accessed by the calibrating thread)
+		lslboost::uint64_t origin_ticks_;					// the tick count at the first calibration (or the last step) ...
+		double origin_time_;								// ... and the reference time at that point (for the long-term rate)
+		double interval_;									// the current calibration interval (grows up to the maximum)
+		double max_interval_;								// the maximum calibration interval
+	};
+
+	/**
+	* Get the clock backend of the given name (default, monotonic or tsc).
+	* Backends that are not available on this machine fall back to the next simpler one (tsc to monotonic to default).
+	* @param name The name of the backend, as in the ClockSource setting.
+	* @param calibration_interval The maximum calibration interval of the tsc backend, in seconds.
+	*/
+	clock_source_fn select_clock_source(const std::string &name, double calibration_interval);
+
+}
+
+#endif
@@ -1,6 +1,6 @@
 #include "common.h"
 #include "api_config.h"
-#include <boost/chrono/system_clocks.hpp>
+#include "clock_sources.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -9,9 +9,10 @@
 
 // === implementation of misc functions ===
 
-/// Implementation of the clock facility.
+/// Implementation of the clock facility (the backend is selected by the ClockSource setting at the first call).
 double lsl::lsl_clock() { 
-	return lslboost::chrono::nanoseconds(lslboost::chrono::high_resolution_clock::now().time_since_epoch()).count()/1000000000.0; 
+	static const clock_source_fn clock = select_clock_source(api_config::get_instance()->clock_source(),api_config::get_instance()->clock_calibration_interval());
+	return clock();
 }
 
 /// Ensure that LSL is initialized. Performs initialization tasks
@@ -59,6 +59,10 @@ namespace lsl {
 							// Not recommended for encoding string data.
 		cf_int64 = 7,		// For now only for future compatibility. Support for this type is not yet exposed in all languages. 
 							// Also, some builds of liblsl will not be able to send or receive data of this type.
+		cf_float16 = 8,		// For signals whose resolution fits into 11 significant bits, at half the bandwidth of cf_float32.
+							// Pushed and pulled as float (or any other numeric type); not understood by older liblsl versions.
+		cf_int24 = 9,		// For 24-bit digitized signals (e.g., EEG amplifiers), at three quarters of the bandwidth of cf_int32.
+							// Pushed and pulled as int32 (or any other numeric type); not understood by older liblsl versions.
 		cf_undefined = 0	// Can not be transmitted.
 	};
 
@@ -1,7 +1,11 @@
 #include "consumer_queue.h"
+#include "memory_budget.h"
 #include "send_buffer.h"
+#include "spill_file.h"
 #include "../include/lsl_c.h"
+#include <algorithm>
 #include <iostream>
+#include <boost/bind.hpp>
 #include <boost/date_time/time_duration.hpp>
 
 // === implementation of the consumer_queue class ===
@@ -12,8 +16,13 @@ using namespace lsl;
 * Create a new queue with a given capacity.
 * @param max_capacity The maximum number of samples that can be held by the queue. Beyond that, the oldest samples are dropped.
 * @param registry Optionally a pointer to a registration facility, to dispatch samples to all consumers.
+* @param lossless Whether the queue applies the overflow policy of the registry instead of dropping the oldest samples.
+* @param fmt The channel format of the samples (required to spill the samples of a lossless queue).
+* @param num_chans The number of channels of the samples (required to spill the samples of a lossless queue).
 */
-consumer_queue::consumer_queue(std::size_t max_capacity, send_buffer_p registry): registry_(registry), buffer_(max_capacity)  {
+consumer_queue::consumer_queue(std::size_t max_capacity, send_buffer_p registry, bool lossless, channel_format_t fmt, int num_chans): registry_(registry), buffer_(max_capacity,memory_budget::get_instance().enabled()?&lsl_clock:NULL), lossless_(lossless), fmt_(fmt), num_chans_(num_chans), closed_(false), evictable_(!lossless), spilling_(false), spill_writing_(false), room_waiters_(0), pushed_(0), popped_(0), dropped_(0), evicted_(0), high_water_(0), spilled_(0), next_position_(0), skipped_(0), num_events_(0), wakeup_(NULL) {
+	if (memory_budget::get_instance().enabled())
+		memory_budget::get_instance().register_queue(this);
 	if (registry_)
 		registry_->register_consumer(this);
 }
@@ -23,22 +32,48 @@ consumer_queue::consumer_queue(std::size_t max_capacity, send_buffer_p registry)
 * Unregisters from the send buffer, if any.
 */
 consumer_queue::~consumer_queue() {
+	// release a producer that is blocked on this queue (it holds the registry's lock)
+	closed_ = true;
+	notify_room();
+	if (memory_budget::get_instance().enabled())
+		memory_budget::get_instance().unregister_queue(this);
 	try {
 		if (registry_)
 			registry_->unregister_consumer(this);
 	} catch(std::exception &e) {
 		std::cerr << "Unexpected error while trying to unregister a consumer queue from its registry:" << e.what() << std::endl;
 	}
+	// wait for the spill writer to finish (no new one can be started now that the producer is gone)
+	thread_pool::job_p job;
+	{
+		lslboost::lock_guard<lslboost::mutex> lock(pending_mut_);
+		job = spill_job_;
+	}
+	if (job)
+		while (!job->wait_for(lslboost::chrono::milliseconds(1000)));
+	delete wakeup_.load();
 }
 
 /**
 * Push a new sample onto the queue.
 */
 void consumer_queue::push_sample(const sample_p &sample) {
-	while (!buffer_.push(sample)) {
-		sample_p dummy;
-		buffer_.pop(dummy);
+	if (!lossless_ || !push_lossless(sample)) {
+		while (!buffer_.push(sample)) {
+			sample_p dummy;
+			buffer_.pop(dummy);
+			dropped_.store(dropped_.load(lslboost::memory_order_relaxed)+1,lslboost::memory_order_relaxed);
+		}
 	}
+	// update the statistics (we are the only writer, so no read-modify-write is needed)
+	pushed_.store(pushed_.load(lslboost::memory_order_relaxed)+1,lslboost::memory_order_relaxed);
+	std::size_t fill = size();
+	if (fill > high_water_.load(lslboost::memory_order_relaxed))
+		high_water_.store(fill,lslboost::memory_order_relaxed);
+	// wake up whatever waits for samples (the fence pairs with the one in attach()/try_pop(), so that either the waiter sees the sample or we see the waiter)
+	lslboost::atomic_thread_fence(lslboost::memory_order_seq_cst);
+	if (num_events_.load(lslboost::memory_order_relaxed) || wakeup_.load(lslboost::memory_order_relaxed))
+		notify();
 }
 
 /**
@@ -48,22 +83,263 @@ void consumer_queue::push_sample(const sample_p &sample) {
 */
 sample_p consumer_queue::pop_sample(double timeout) {
 	sample_p result;
-	if (timeout <= 0.0) {
-		buffer_.pop(result);
-	} else {
-		if (!buffer_.pop(result)) {
-			// turn timeout into the point in time at which we give up
-			timeout += lsl_local_clock(); 
-			do {
-				if (lsl_local_clock() >= timeout)
-					break;
-				lslboost::this_thread::sleep(lslboost::posix_time::milliseconds(1));
-			} while (!buffer_.pop(result));
+	bool popped = try_pop(result);
+	if (!popped && timeout > 0.0) {
+		// wait for the producer to signal new samples
+		queue_event event;
+		attach(&event);
+		double end_time = timeout < FOREVER ? lsl_clock() + timeout : FOREVER;
+		while (!(popped = try_pop(result))) {
+			double remaining = end_time < FOREVER ? end_time - lsl_clock() : FOREVER;
+			if (remaining <= 0.0)
+				break;
+			event.wait(remaining);
 		}
+		detach(&event);
+	}
+	if (popped) {
+		popped_.fetch_add(1,lslboost::memory_order_relaxed);
+		notify_room();
 	}
 	return result;
 }
 
+/**
+* Push a sample into a lossless queue.
+* If the queue is full, the overflow policy of the registry decides whether the producer waits until there is room,
+* whether the sample is spilled to a file, or whether the queue drops the oldest sample like a regular queue.
+* @return Whether the sample has been stored (false if it shall be handled like in a regular queue).
+*/
+bool consumer_queue::push_lossless(const sample_p &sample) {
+	// once samples have been spilled, the subsequent ones are spilled, too, so that the order is preserved
+	// (the consumer clears the flag under the same lock once it has read back all spilled samples)
+	if (spilling_.load(lslboost::memory_order_acquire)) {
+		lslboost::lock_guard<lslboost::mutex> lock(pending_mut_);
+		if (spilling_) {
+			spill(sample);
+			return true;
+		}
+	}
+	int policy = registry_ ? registry_->overflow_policy() : lsl_overflow_drop;
+	// while the memory budget is exhausted, a queue that may spill does so rather than holding more samples in memory
+	if (!(policy == lsl_overflow_spill && memory_budget::get_instance().exceeded()) && buffer_.push(sample))
+		return true;
+	switch (policy) {
+		case lsl_overflow_block:
+			// wait until the consumer has made room (or has gone away)
+			while (!buffer_.push(sample)) {
+				if (closed_)
+					return false;
+				wait_for_room(0.1);
+			}
+			return true;
+		case lsl_overflow_spill:
+			{
+				// the disk I/O happens on the spill writer, so that the dispatch to the other consumers is not held up
+				lslboost::lock_guard<lslboost::mutex> lock(pending_mut_);
+				spill(sample);
+				spilling_ = true;
+				return true;
+			}
+		default:
+			return false;
+	}
+}
+
+/**
+* Hand a sample over to the spill writer (requires a lock on pending_mut_).
+* Starts a writer on a pooled thread unless one is running already.
+*/
+void consumer_queue::spill(const sample_p &sample) {
+	spill_pending_.push_back(sample);
+	spilled_.store(spilled_.load(lslboost::memory_order_relaxed)+1,lslboost::memory_order_relaxed);
+	if (!spill_writing_) {
+		spill_writing_ = true;
+		spill_job_ = thread_pool::get_instance().submit(lslboost::bind(&consumer_queue::write_spill,this));
+	}
+}
+
+/**
+* Write the samples handed over to the spill writer to the spill file (runs on a pooled thread).
+* Each batch is written while holding the lock on the file, so that the consumer cannot read past it.
+* If the file cannot be written, the spilled samples are discarded (like the samples of a regular queue that is full).
+*/
+void consumer_queue::write_spill() {
+	while (true) {
+		lslboost::lock_guard<lslboost::mutex> lock(spill_mut_);
+		std::deque<sample_p> batch;
+		{
+			lslboost::lock_guard<lslboost::mutex> pending_lock(pending_mut_);
+			if (spill_pending_.empty()) {
+				spill_writing_ = false;
+				return;
+			}
+			batch.swap(spill_pending_);
+		}
+		try {
+			if (!spill_)
+				spill_.reset(new spill_file(fmt_,num_chans_));
+			for (std::size_t k=0; k<batch.size(); k++)
+				spill_->write(batch[k]);
+		} catch(std::exception &e) {
+			std::cerr << "Could not spill samples to disk (" << e.what() << "); dropping samples instead." << std::endl;
+			// the samples that are not in the file are discarded (they are counted like evicted ones, as the producer owns dropped_)
+			lslboost::lock_guard<lslboost::mutex> pending_lock(pending_mut_);
+			std::size_t lost = batch.size() + spill_pending_.size() + (spill_ ? spill_->size() : 0);
+			spill_.reset();
+			spill_pending_.clear();
+			spilling_ = false;
+			spill_writing_ = false;
+			evicted_.fetch_add(lost,lslboost::memory_order_relaxed);
+			notify_room();
+			return;
+		}
+	}
+}
+
+/**
+* Pop a sample without blocking.
+* The spilled samples (if any) are newer than those in the buffer, so they are read once the buffer is empty;
+* those in the spill file are older than those that the spill writer has not written yet.
+*/
+bool consumer_queue::try_pop(sample_p &result) {
+	lslboost::uint64_t position;
+	if (buffer_.pop(result,&position)) {
+		// the positions of the samples that have been dropped from the buffer in the meantime are skipped
+		skipped_.store(position - next_position_.load(lslboost::memory_order_relaxed),lslboost::memory_order_relaxed);
+		next_position_.store(position + 1,lslboost::memory_order_relaxed);
+		return true;
+	}
+	skipped_.store(0,lslboost::memory_order_relaxed);
+	if (spilling_.load(lslboost::memory_order_acquire)) {
+		lslboost::lock_guard<lslboost::mutex> lock(spill_mut_);
+		if (spill_ && spill_->size()) {
+			try {
+				result = spill_->read();
+				return true;
+			} catch(std::exception &e) {
+				std::cerr << "Could not read back the spilled samples (" << e.what() << "); discarding them." << std::endl;
+				evicted_.fetch_add(spill_->size(),lslboost::memory_order_relaxed);
+				spill_.reset();
+			}
+		}
+		// the samples that the spill writer has not got to yet follow those in the file
+		lslboost::lock_guard<lslboost::mutex> pending_lock(pending_mut_);
+		if (!spill_pending_.empty()) {
+			result = spill_pending_.front();
+			spill_pending_.pop_front();
+			return true;
+		}
+		spilling_ = false;
+	}
+	if (wakeup_fd *w = wakeup_.load(lslboost::memory_order_acquire)) {
+		// the queue has been drained: make the descriptor unreadable until the next sample arrives
+		w->reset();
+		lslboost::atomic_thread_fence(lslboost::memory_order_seq_cst);
+		if (!empty())
+			w->signal();
+	}
+	return false;
+}
+
+/// Wake up everything that waits for samples (called by the producer after a push).
+void consumer_queue::notify() {
+	if (wakeup_fd *w = wakeup_.load(lslboost::memory_order_acquire))
+		w->signal();
+	if (num_events_.load(lslboost::memory_order_relaxed)) {
+		lslboost::lock_guard<lslboost::mutex> lock(events_mut_);
+		for (std::size_t k=0; k<events_.size(); k++)
+			events_[k]->signal();
+	}
+}
+
+/**
+* Wait until the queue has room for another sample (without polling; the consumer signals when it has made room).
+* @param timeout The maximum time to wait, in seconds.
+* @return Whether there is room.
+*/
+bool consumer_queue::wait_for_room(double timeout) {
+	// the fence pairs with the one in notify_room(), so that either we see the room or the consumer sees us waiting
+	room_waiters_.fetch_add(1,lslboost::memory_order_relaxed);
+	lslboost::atomic_thread_fence(lslboost::memory_order_seq_cst);
+	{
+		lslboost::unique_lock<lslboost::mutex> lock(room_mut_);
+		if (full() && !closed_)
+			room_cv_.wait_for(lock,lslboost::chrono::duration<double>(timeout));
+	}
+	room_waiters_.fetch_sub(1,lslboost::memory_order_relaxed);
+	return !full();
+}
+
+/// Wake up a producer that waits for room (called by the consumer after samples have been removed).
+void consumer_queue::notify_room() {
+	lslboost::atomic_thread_fence(lslboost::memory_order_seq_cst);
+	if (room_waiters_.load(lslboost::memory_order_relaxed)) {
+		lslboost::lock_guard<lslboost::mutex> lock(room_mut_);
+		room_cv_.notify_all();
+	}
+	if (lossless_ && registry_)
+		registry_->notify_room();
+}
+
+/// Attach an event that is signalled whenever a sample is pushed (the event must be detached before it is destroyed).
+void consumer_queue::attach(queue_event *e) {
+	lslboost::lock_guard<lslboost::mutex> lock(events_mut_);
+	events_.push_back(e);
+	num_events_ = events_.size();
+	lslboost::atomic_thread_fence(lslboost::memory_order_seq_cst);
+}
+
+/// Detach an event.
+void consumer_queue::detach(queue_event *e) {
+	lslboost::lock_guard<lslboost::mutex> lock(events_mut_);
+	events_.erase(std::remove(events_.begin(),events_.end(),e),events_.end());
+	num_events_ = events_.size();
+}
+
+/**
+* Get a file descriptor that is readable while samples may be available (created on first use).
+* It becomes readable when a sample is pushed and unreadable when a pop finds the queue empty.
+* Throws a std::runtime_error if the platform does not support it.
+*/
+int consumer_queue::wakeup_descriptor() {
+	lslboost::lock_guard<lslboost::mutex> lock(events_mut_);
+	if (!wakeup_.load()) {
+		wakeup_fd *w = new wakeup_fd();
+		wakeup_.store(w);
+		lslboost::atomic_thread_fence(lslboost::memory_order_seq_cst);
+		// samples may have arrived before the descriptor existed
+		if (!empty())
+			w->signal();
+	}
+	return wakeup_.load()->fd();
+}
+
+/**
+* Evict the oldest samples from the queue (may be called from any thread).
+* @param max_samples The maximum number of samples to evict.
+* @return The number of samples that have been evicted.
+*/
+std::size_t consumer_queue::evict(std::size_t max_samples) {
+	std::size_t evicted = 0;
+	for (sample_p s; evicted < max_samples && buffer_.pop(s); evicted++);
+	evicted_.fetch_add(evicted,lslboost::memory_order_relaxed);
+	if (evicted)
+		notify_room();
+	return evicted;
+}
+
 bool consumer_queue::empty() {
-	return buffer_.empty();
+	return buffer_.empty() && !spilling_;
+}
+
+/**
+* Get the number of samples currently held by the queue.
+* This value may be slightly outdated if the queue is concurrently modified.
+*/
+std::size_t consumer_queue::size() const {
+	// read the consumer-side counter first so that the difference cannot become negative
+	lslboost::uint64_t popped = popped_.load(lslboost::memory_order_relaxed) + dropped_.load(lslboost::memory_order_relaxed) + evicted_.load(lslboost::memory_order_relaxed);
+	lslboost::uint64_t pushed = pushed_.load(lslboost::memory_order_relaxed);
+	return pushed > popped ? (std::size_t)(pushed - popped) : 0;
 }
@@ -1,8 +1,17 @@
 #ifndef CONSUMER_QUEUE_H
 #define CONSUMER_QUEUE_H
 
-#include <boost/lockfree/spsc_queue.hpp>
+#include <deque>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 #include "sample.h"
+#include "segmented_queue.h"
+#include "thread_pool.h"
+#include "wakeup_fd.h"
 
 namespace lsl {
 	/// shared pointer to a consumer queue
@@ -10,19 +19,65 @@ namespace lsl {
 	/// shared pointer to a send buffer
 	typedef lslboost::shared_ptr<class send_buffer> send_buffer_p;
 
+	class spill_file;
+
+	/**
+	* An event that is signalled when a sample is pushed into any of the consumer queues to which it is attached.
+	* Used to wait for samples without polling, on one queue (see consumer_queue::pop_sample()) or on several at once.
+	*/
+	class queue_event: private lslboost::noncopyable {
+	public:
+		queue_event(): signalled_(false) {}
+
+		/// Signal the event.
+		void signal() {
+			lslboost::lock_guard<lslboost::mutex> lock(mut_);
+			signalled_ = true;
+			cv_.notify_all();
+		}
+
+		/**
+		* Wait until the event is signalled and reset it.
+		* @param timeout The maximum time to wait, in seconds (FOREVER to wait indefinitely).
+		* @return False if the timeout expired.
+		*/
+		bool wait(double timeout) {
+			lslboost::unique_lock<lslboost::mutex> lock(mut_);
+			if (timeout >= FOREVER)
+				while (!signalled_)
+					cv_.wait(lock);
+			else if (!signalled_ && timeout > 0)
+				cv_.wait_for(lock,lslboost::chrono::duration<double>(timeout));
+			bool result = signalled_;
+			signalled_ = false;
+			return result;
+		}
+
+	private:
+		lslboost::mutex mut_;					// protects the signalled flag
+		lslboost::condition_variable cv_;		// notified when the event is signalled
+		bool signalled_;						// whether the event has been signalled since the last wait
+	};
+
 	/**
 	* A thread-safe producer-consumer queue of unread samples.
-	* Erases the oldest samples if max capacity is exceeded. Implemented as a circular buffer.
+	* Erases the oldest samples if max capacity is exceeded. Implemented as a segmented queue whose memory grows
+	* and shrinks with the number of buffered samples (rather than being allocated for the max capacity up front).
+	* A lossless queue instead applies the overflow policy of its send buffer (see send_buffer::set_overflow_policy()).
+	* If a memory budget is set, samples may also be evicted from an evictable queue to stay within the budget (see memory_budget).
 	*/
 	class consumer_queue: private lslboost::noncopyable {
-		typedef lslboost::lockfree::spsc_queue<sample_p> buffer_type;
+		typedef segmented_queue<sample_p> buffer_type;
 	public:
 		/**
 		* Create a new queue with a given capacity.
 		* @param max_capacity The maximum number of samples that can be held by the queue. Beyond that, the oldest samples are dropped.
 		* @param registry Optionally a pointer to a registration facility, for multiple-reader arrangements.
+		* @param lossless Whether the queue applies the overflow policy of the registry instead of dropping the oldest samples.
+		* @param fmt The channel format of the samples (required to spill the samples of a lossless queue).
+		* @param num_chans The number of channels of the samples (required to spill the samples of a lossless queue).
 		*/
-		consumer_queue(std::size_t max_capacity, send_buffer_p registry=send_buffer_p());
+		consumer_queue(std::size_t max_capacity, send_buffer_p registry=send_buffer_p(), bool lossless=false, channel_format_t fmt=cf_undefined, int num_chans=0);
 
 		/**
 		* Destructor.
@@ -37,7 +92,7 @@ namespace lsl {
 
 		/**
 		* Pop a sample from the queue. 
-		* Blocks if empty.
+		* Blocks (without polling) if empty.
 		* @param timeout Timeout for the blocking, in seconds. If expired, an empty sample is returned.
 		*/
 		sample_p pop_sample(double timeout=FOREVER);
@@ -47,9 +102,127 @@ namespace lsl {
 		*/ 
 		bool empty();
 
+		/**
+		* Check whether the buffer is full (i.e., the next push will overrun it).
+		* This value may be slightly outdated if the queue is concurrently modified.
+		*/
+		bool full() const { return size() >= buffer_.capacity(); }
+
+		/**
+		* Wait until the queue has room for another sample (without polling; the consumer signals when it has made room).
+		* @param timeout The maximum time to wait, in seconds.
+		* @return Whether there is room.
+		*/
+		bool wait_for_room(double timeout);
+
+		/// Check whether this is a lossless queue.
+		bool lossless() const { return lossless_; }
+
+		/**
+		* Get the number of samples currently held by the queue.
+		* This value may be slightly outdated if the queue is concurrently modified.
+		*/
+		std::size_t size() const;
+
+		/// Get the largest number of samples that have been held by the queue at any one time.
+		std::size_t high_water_mark() const { return high_water_.load(lslboost::memory_order_relaxed); }
+
+		/// Get the number of samples that have been dropped because the queue was full or to stay within the memory budget.
+		lslboost::uint64_t dropped() const { return dropped_.load(lslboost::memory_order_relaxed) + evicted_.load(lslboost::memory_order_relaxed); }
+
+		/**
+		* Get the number of samples that have been dropped (or evicted) right before the sample that was popped last,
+		* i.e., the gap between it and the previously popped sample (only meaningful if the samples are popped by one thread).
+		*/
+		lslboost::uint64_t skipped() const { return skipped_.load(lslboost::memory_order_relaxed); }
+
+		/// Get the number of samples that have been spilled to a file because the queue was full.
+		lslboost::uint64_t spilled() const { return spilled_.load(lslboost::memory_order_relaxed); }
+
+		// === waiting for samples ===
+
+		/// Attach an event that is signalled whenever a sample is pushed (the event must be detached before it is destroyed).
+		void attach(queue_event *e);
+
+		/// Detach an event.
+		void detach(queue_event *e);
+
+		/**
+		* Get a file descriptor that is readable while samples may be available (created on first use).
+		* It becomes readable when a sample is pushed and unreadable when a pop finds the queue empty.
+		* Throws a std::runtime_error if the platform does not support it.
+		*/
+		int wakeup_descriptor();
+
+		// === memory budget ===
+
+		/// Check whether samples may be evicted from this queue to stay within the memory budget (false for lossless queues).
+		bool evictable() const { return evictable_.load(lslboost::memory_order_relaxed); }
+
+		/// Set whether samples may be evicted from this queue to stay within the memory budget (e.g., false for recording inlets).
+		void set_evictable(bool evictable) { evictable_ = evictable; }
+
+		/**
+		* Evict the oldest samples from the queue (may be called from any thread).
+		* @param max_samples The maximum number of samples to evict.
+		* @return The number of samples that have been evicted.
+		*/
+		std::size_t evict(std::size_t max_samples);
+
+		/**
+		* Get a time no later than the push of the oldest sample in the queue (only available if a memory budget is set).
+		* @return False if the queue is empty.
+		*/
+		bool oldest_stamp(double &stamp) { return buffer_.front_stamp(stamp); }
+
 	private:
+		/// Push a sample into a lossless queue; returns false if the sample shall be handled like in a regular queue.
+		bool push_lossless(const sample_p &sample);
+
+		/// Pop a sample without blocking.
+		bool try_pop(sample_p &result);
+
+		/// Wake up everything that waits for samples (called by the producer after a push).
+		void notify();
+
+		/// Wake up a producer that waits for room (called by the consumer after samples have been removed).
+		void notify_room();
+
+		/// Hand a sample over to the spill writer (requires a lock on pending_mut_).
+		void spill(const sample_p &sample);
+
+		/// Write the samples handed over to the spill writer to the spill file (runs on a pooled thread).
+		void write_spill();
+
 		send_buffer_p registry_;				// optional consumer registry
 		buffer_type buffer_;					// the sample buffer
+		bool lossless_;							// whether the queue applies the overflow policy of the registry
+		channel_format_t fmt_;					// the channel format of the samples (for spilling)
+		int num_chans_;							// the number of channels of the samples (for spilling)
+		lslboost::atomic<bool> closed_;			// set when the queue is destroyed (ends a blocking push)
+		lslboost::atomic<bool> evictable_;		// whether samples may be evicted to stay within the memory budget
+		lslboost::atomic<bool> spilling_;		// whether there are spilled samples (all subsequent samples then get spilled, too)
+		lslboost::mutex spill_mut_;				// protects the spill file (held by the spill writer while it writes a batch)
+		lslboost::scoped_ptr<spill_file> spill_;	// the spill file, created on demand
+		lslboost::mutex pending_mut_;			// protects the samples that have not been written to the spill file yet
+		std::deque<sample_p> spill_pending_;	// spilled samples that are newer than those in the file, not yet written
+		bool spill_writing_;					// whether a spill writer job is running
+		thread_pool::job_p spill_job_;			// the most recent spill writer job
+		lslboost::mutex room_mut_;				// protects the waiting for room
+		lslboost::condition_variable room_cv_;	// notified when the consumer has made room
+		lslboost::atomic<std::size_t> room_waiters_;	// the number of threads waiting for room (checked by the consumer without locking)
+		lslboost::atomic<lslboost::uint64_t> pushed_;	// the number of samples pushed (written only by the producer)
+		lslboost::atomic<lslboost::uint64_t> popped_;	// the number of samples popped by the consumer
+		lslboost::atomic<lslboost::uint64_t> dropped_;	// the number of samples dropped due to overrun (written only by the producer)
+		lslboost::atomic<lslboost::uint64_t> evicted_;	// the number of samples evicted to stay within the memory budget
+		lslboost::atomic<std::size_t> high_water_;	// the largest fill level seen so far (written only by the producer)
+		lslboost::atomic<lslboost::uint64_t> spilled_;	// the number of samples spilled to the file (written only by the producer)
+		lslboost::atomic<lslboost::uint64_t> next_position_;	// the position in the buffer that follows the last popped sample
+		lslboost::atomic<lslboost::uint64_t> skipped_;	// the number of samples skipped before the last popped sample
+		lslboost::mutex events_mut_;				// protects the attached events
+		std::vector<queue_event*> events_;			// the events that are signalled when a sample is pushed
+		lslboost::atomic<std::size_t> num_events_;	// the number of attached events (checked by the producer without locking)
+		lslboost::atomic<wakeup_fd*> wakeup_;		// the descriptor that is readable while samples may be available, if requested
 	};
 
 }
@@ -5,6 +5,9 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/algorithm/string.hpp>
 #include "data_receiver.h"
+#include "datagram_receiver.h"
+#include "multicast_receiver.h"
+#include "mux_connection.h"
 #include "socket_utils.h"
 #include "portable_archive/portable_iarchive.hpp"
 
@@ -22,8 +25,9 @@ using namespace lslboost::algorithm;
 * @param max_chunklen Optionally the maximum size, in samples, at which chunks are transmitted (the default corresponds to the chunk sizes used by the sender).
 *					  Recording applications can use a generous size here (leaving it to the network how to pack things), while real-time applications may want a finer (perhaps 1-sample) granularity.
 */
-data_receiver::data_receiver(inlet_connection &conn, int max_buflen, int max_chunklen): conn_(conn), check_thread_start_(true), closing_stream_(false), connected_(false), sample_queue_(max_buflen), 
-	sample_factory_(new sample::factory(conn.type_info().channel_format(),conn.type_info().channel_count(),conn.type_info().nominal_srate()?conn.type_info().nominal_srate()*api_config::get_instance()->inlet_buffer_reserve_ms()/1000:api_config::get_instance()->inlet_buffer_reserve_samples())), max_buflen_(max_buflen), max_chunklen_(max_chunklen) 
+data_receiver::data_receiver(inlet_connection &conn, int max_buflen, int max_chunklen): conn_(conn), 
+	sample_factory_(new sample::factory(conn.type_info().channel_format(),conn.type_info().channel_count(),conn.type_info().nominal_srate()?conn.type_info().nominal_srate()*api_config::get_instance()->inlet_buffer_reserve_ms()/1000:api_config::get_instance()->inlet_buffer_reserve_samples())), 
+	check_thread_start_(true), closing_stream_(false), connected_(false), sample_queue_(max_buflen), connections_(0), handshake_time_(0.0), samples_received_(0), bytes_received_(0), samples_lost_(0), samples_repaired_(0), samples_superseded_(0), max_buflen_(max_buflen), max_chunklen_(max_chunklen), lossless_(false), multicast_repair_(false), multicast_unavailable_(false), datagram_transport_(false), datagrams_unavailable_(false), latest_only_(0), has_chunk_handler_(false)
 {
 	if (max_buflen < 0)
 		throw std::invalid_argument("The max_buflen argument must not be smaller than 0.");
@@ -104,15 +108,13 @@ double data_receiver::pull_sample_untyped(void *buffer, int buffer_bytes, double
 	if (conn_.lost())
 		throw lost_error("The stream read by this inlet has been lost. To recover, you need to re-resolve the source and re-create the inlet.");
 	// start data thread implicitly if necessary
-	if (check_thread_start_ && !data_thread_.joinable()) {
-		data_thread_ = lslboost::thread(&data_receiver::data_thread,this);
-		check_thread_start_ = false;
-	}
+	start_thread();
 	// get the sample with timeout
 	if (sample_p s = sample_queue_.pop_sample(timeout)) {
 		if (buffer_bytes != conn_.type_info().sample_bytes())
 			throw std::range_error("The size of the provided buffer does not match the number of bytes in the sample.");
 		s->retrieve_untyped(buffer);
+		LSL_TRACE_EVENT("pull");
 		return s->timestamp;
 	} else {
 		if (conn_.lost())
@@ -121,167 +123,539 @@ double data_receiver::pull_sample_untyped(void *buffer, int buffer_bytes, double
 	}
 }
 
+/// Retrieve the next sample itself from the sample queue (without copying its contents); NULL if none arrived within the timeout.
+sample_p data_receiver::pull_sample(double timeout) {
+	if (conn_.lost())
+		throw lost_error("The stream read by this inlet has been lost. To recover, you need to re-resolve the source and re-create the inlet.");
+	// start data thread implicitly if necessary
+	start_thread();
+	// get the sample with timeout
+	sample_p s = sample_queue_.pop_sample(timeout);
+	if (s)
+		LSL_TRACE_EVENT("pull");
+	else if (conn_.lost())
+		throw lost_error("The stream read by this inlet has been lost. To recover, you need to re-resolve the source and re-create the inlet.");
+	return s;
+}
+
+/**
+* Get statistics of the connection setup.
+* @param reconnects Receives the number of times the connection has been re-established.
+* @param handshake_time Receives the duration of the most recent connection setup, in seconds (0 if not yet connected).
+*/
+void data_receiver::connection_stats(unsigned &reconnects, double &handshake_time) {
+	lslboost::lock_guard<lslboost::mutex> lock(connected_mut_);
+	reconnects = connections_ ? connections_-1 : 0;
+	handshake_time = handshake_time_;
+}
+
+
+/**
+* Set a function that receives the samples directly from the data thread, bypassing the sample queue.
+* The samples are delivered in chunks of those that have arrived together (at most max_chunklen, if given).
+* Blocks while the previous handler (if any) is being called; an empty function restores the queueing.
+*/
+void data_receiver::set_chunk_handler(const chunk_handler_t &handler) {
+	lslboost::lock_guard<lslboost::mutex> lock(chunk_handler_mut_);
+	chunk_handler_ = handler;
+	has_chunk_handler_ = !handler.empty();
+}
+
 
 // === internal processing ===
 
+/// The maximum number of samples that are passed to the chunk handler at a time if no max_chunklen was given.
+const std::size_t max_handler_chunk = 1024;
+
+/// Pass a chunk of samples to the chunk handler (or the sample queue if there is none) and clear it.
+void data_receiver::deliver_chunk(std::vector<sample_p> &chunk) {
+	{
+		lslboost::lock_guard<lslboost::mutex> lock(chunk_handler_mut_);
+		if (!chunk_handler_.empty()) {
+			LSL_TRACE_SCOPE("callback");
+			try {
+				chunk_handler_(chunk);
+			} catch(std::exception &e) {
+				std::cerr << "Unexpected error in an inlet callback: " << e.what() << std::endl;
+			}
+			chunk.clear();
+			return;
+		}
+	}
+	// the handler has been removed in the meantime
+	for (std::size_t k=0; k<chunk.size(); k++)
+		sample_queue_.push_sample(chunk[k]);
+	chunk.clear();
+}
+
+/// Pass a received sample on to the chunk handler (collected into chunks until no more data is pending) or the sample queue.
+void data_receiver::deliver_sample(const sample_p &samp, std::vector<sample_p> &chunk, bool more_pending, bool lossless) {
+	if (has_chunk_handler_.load(lslboost::memory_order_relaxed)) {
+		// collect the samples that have arrived together and pass them on once the received data is used up
+		chunk.push_back(samp);
+		if (!more_pending || chunk.size() >= (max_chunklen_ ? (std::size_t)max_chunklen_ : max_handler_chunk))
+			deliver_chunk(chunk);
+	} else {
+		if (!chunk.empty())
+			deliver_chunk(chunk);
+		// in lossless mode, wait until there is room in the sample queue (this stops reading from the network,
+		// so the outlet buffers the samples instead) while keeping the watchdog from reconnecting
+		if (lossless) {
+			while (sample_queue_.full() && !conn_.lost() && !conn_.shutdown() && !closing_stream_) {
+				conn_.update_receive_time(lsl_clock());
+				sample_queue_.wait_for_room(0.1);
+			}
+		} else if (std::size_t keep = latest_only_.load(lslboost::memory_order_relaxed)) {
+			// drop the samples that the new one supersedes (e.g., video frames that have not been displayed yet)
+			std::size_t queued = sample_queue_.size();
+			if (queued >= keep) {
+				std::size_t superseded = sample_queue_.evict(queued-keep+1);
+				// (released after the queue has counted them, so that samples_dropped() never sees more superseded than evicted samples)
+				samples_superseded_.store(samples_superseded_.load(lslboost::memory_order_relaxed)+superseded,lslboost::memory_order_release);
+			}
+		}
+		// push it into the sample queue
+		{
+			LSL_TRACE_SCOPE("enqueue");
+			sample_queue_.push_sample(samp);
+		}
+	}
+}
+
+/// Signal to the accessor functions on other threads that the stream has been connected
+/// (and remains to be even if we later recover silently).
+void data_receiver::mark_connected(double handshake_start) {
+	{
+		lslboost::lock_guard<lslboost::mutex> lock(connected_mut_);
+		connected_ = true;
+		connections_++;
+		handshake_time_ = lsl_clock() - handshake_start;
+	}
+	connected_upd_.notify_all();
+}
+
+/**
+* Connect to the outlet, negotiate the feed and receive samples until the connection breaks off or the stream is closed.
+* @param buffer A stream buffer that can be connected to the endpoint (a cancellable_streambuf or a mux_streambuf).
+* @param endpoint The endpoint of the outlet's data port or of its process' multiplexed sessions.
+* @param factory The sample factory.
+* @param chunk The samples that have arrived together, for the chunk handler.
+* @param datagrams Whether to ask the outlet for a datagram feed (the samples are then received on a UDP socket).
+*/
+template<class StreamBuf> void data_receiver::receive_feed(StreamBuf &buffer, const tcp::endpoint &endpoint, sample::factory_p &factory, std::vector<sample_p> &chunk, bool datagrams) {
+	// make a stream on top of the stream buffer
+	buffer.register_at(&conn_);
+	buffer.register_at(this);
+	std::iostream server_stream(&buffer);
+	lslboost::scoped_ptr<eos::portable_iarchive> inarch;
+	// connect to endpoint
+	double handshake_start = lsl_clock();
+	lslboost::uint64_t bytes_before = bytes_received_.load(lslboost::memory_order_relaxed);
+	buffer.connect(endpoint);
+	if (buffer.puberror())
+		throw buffer.puberror();
+
+	// open the socket for a datagram feed if requested (the outlet sends to the address from which we have connected)
+	lslboost::scoped_ptr<datagram_receiver> receiver;
+	if (datagrams) {
+		try {
+			receiver.reset(new datagram_receiver(endpoint.address().is_v4() ? udp::v4() : udp::v6(),conn_.current_uid()));
+			receiver->register_at(&conn_);
+			receiver->register_at(this);
+		} catch(std::exception &e) {
+			datagrams_unavailable_ = true;
+			std::clog << "Note: could not open a socket for the datagrams of stream " << conn_.type_info().name() << " (" << e.what() << "); receiving it over TCP instead." << std::endl;
+			receiver.reset();
+		}
+	}
+
+	// --- protocol negotiation ---
+
+	bool lossless = lossless_;			// whether this connection shall be lossless
+	// the number of most recent samples that the outlet shall keep for us (a chunk handler takes all samples)
+	unsigned latest_only = (lossless || has_chunk_handler_) ? 0 : latest_only_.load();
+	bool lossless_accepted = false;		// whether the other party has agreed to send losslessly
+	bool datagrams_accepted = false;	// whether the other party has agreed to send a datagram feed
+	int use_byte_order = 0;				// which byte order we shall use (0=portable byte order)
+	int data_protocol_version = 100;	// which protocol version we shall use for data transmission (100=version 1.00)
+	bool suppress_subnormals = false;	// whether we shall suppress subnormal numbers
+
+	// propose to use the highest protocol version supported by both parties
+	int proposed_protocol_version = std::min(api_config::get_instance()->use_protocol_version(),conn_.type_info().version());
+	if (proposed_protocol_version >= 110) {
+		// request line LSL:streamfeed/[ProtocolVersion] [UID]\r\n
+		server_stream << "LSL:streamfeed/" << proposed_protocol_version << " " << conn_.current_uid() << "\r\n";
+		// transmit request parameters
+		server_stream << "Native-Byte-Order: " << BOOST_BYTE_ORDER << "\r\n";
+		server_stream << "Endian-Performance: " << std::floor(measure_endian_performance()) << "\r\n";
+		server_stream << "Has-IEEE754-Floats: " << (format_ieee754[cf_float32] && format_ieee754[cf_double64]) << "\r\n";
+		server_stream << "Supports-Subnormals: " << format_subnormal[conn_.type_info().channel_format()] << "\r\n";
+		server_stream << "Value-Size: " << conn_.type_info().channel_bytes() << "\r\n"; // 0 for strings
+		server_stream << "Data-Protocol-Version: " << proposed_protocol_version << "\r\n";
+		server_stream << "Max-Buffer-Length: " << max_buflen_ << "\r\n";
+		server_stream << "Max-Chunk-Length: " << max_chunklen_ << "\r\n";
+		if (lossless)
+			server_stream << "Lossless: 1\r\n";
+		if (latest_only)
+			server_stream << "Latest-Only: " << latest_only << "\r\n";
+		if (receiver)
+			server_stream << "Datagram-Port: " << receiver->port() << "\r\n";
+		server_stream << "Hostname: " << conn_.type_info().hostname() << "\r\n";
+		server_stream << "Source-Id: " << conn_.type_info().source_id() << "\r\n";
+		server_stream << "Session-Id: " << conn_.type_info().session_id() << "\r\n";
+		server_stream << "\r\n" << std::flush;
+
+		// check server response line (LSL/[Version] [StatusCode] [Message])
+		char buf[16384] = {0};
+		if (!server_stream.getline(buf,sizeof(buf)))
+			throw lost_error("Connection lost.");
+		std::vector<std::string> parts; split(parts,buf,is_any_of(" \t"));
+		if (parts.size() < 3 || !starts_with(parts[0],"LSL/"))
+			throw std::runtime_error("Received a malformed response.");
+		if (lslboost::lexical_cast<int>(parts[0].substr(4))/100 > api_config::get_instance()->use_protocol_version()/100)
+			throw std::runtime_error("The other party's protocol version is too new for this client; please upgrade your LSL library.");
+		int status_code = lslboost::lexical_cast<int>(parts[1]);
+		if (status_code == 404)
+			throw lost_error("The given address does not serve the resolved stream (likely outdated).");
+		if (status_code >= 400)
+			throw std::runtime_error("The other party sent an error: " + std::string(buf));
+		if (status_code >= 300)
+			throw lost_error("The other party requested a redirect.");
+
+		// receive response parameters
+		while (server_stream.getline(buf,sizeof(buf)) && (buf[0] != '\r')) {
+			std::string hdrline(buf);
+			std::size_t colon = hdrline.find_first_of(':');
+			if (colon != std::string::npos) {
+				// extract key & value
+				std::string type = to_lower_copy(trim_copy(hdrline.substr(0,colon))), rest = to_lower_copy(trim_copy(hdrline.substr(colon+1)));
+				// strip off comments
+				std::size_t semicolon = rest.find_first_of(';');
+				if (semicolon != std::string::npos)
+					rest = rest.substr(0,semicolon);
+				// get the header information
+				if (type == "byte-order") {
+					use_byte_order = lslboost::lexical_cast<int>(rest);
+					if (use_byte_order==2134 && BOOST_BYTE_ORDER!=2134 && format_sizes[conn_.type_info().channel_format()]>=8)
+						throw std::runtime_error("The byte order conversion requested by the other party is not supported.");
+				}
+				if (type == "suppress-subnormals") 
+					suppress_subnormals = lslboost::lexical_cast<bool>(rest);
+				if (type == "lossless")
+					lossless_accepted = lslboost::lexical_cast<bool>(rest);
+				if (type == "datagrams")
+					datagrams_accepted = lslboost::lexical_cast<bool>(rest);
+				if (type == "uid" && rest != conn_.current_uid())
+					throw lost_error("The received UID does not match the current connection's UID.");
+				if (type == "data-protocol-version") {
+					data_protocol_version = lslboost::lexical_cast<int>(rest);
+					if (data_protocol_version > api_config::get_instance()->use_protocol_version())
+						throw std::runtime_error("The protocol version requested by the other party is not supported by this client.");
+				}
+			}
+		}
+		if (!server_stream)
+			throw lost_error("Server connection lost.");
+	} else {
+		// version 1.00: send request line and feed parameters
+		server_stream << "LSL:streamfeed\r\n";
+		server_stream << max_buflen_ << " " << max_chunklen_ << "\r\n" << std::flush;
+	}
+
+	if (data_protocol_version == 100) {
+		// portable binary archive (parse archive header)
+		inarch.reset(new eos::portable_iarchive(server_stream));
+		// receive stream_info message from server
+		std::string infomsg; *inarch >> infomsg;
+		stream_info_impl info; info.from_shortinfo_message(infomsg);
+		// confirm that the UID matches, otherwise reconnect
+		if (info.uid() != conn_.current_uid())
+			throw lost_error("The received UID does not match the current connection's UID.");
+	}
+
+	if (lossless && !lossless_accepted)
+		std::cerr << "The outlet does not support lossless transmission (perhaps it uses an older version of liblsl); samples may be dropped if the inlet falls behind." << std::endl;
+
+	// --- format validation ---
+	{
+		// receive and parse two subsequent test-pattern samples and check if they are formatted as expected
+		lslboost::scoped_ptr<sample> temp[4]; 
+		for (int k=0; k<4; temp[k++].reset(sample::factory::new_sample_unmanaged(conn_.type_info().channel_format(),conn_.type_info().channel_count(),0.0,false)));
+		temp[0]->assign_test_pattern(4); if (data_protocol_version >= 110) temp[1]->load_streambuf(buffer,data_protocol_version,use_byte_order,suppress_subnormals); else *inarch >> *temp[1];
+		temp[2]->assign_test_pattern(2); if (data_protocol_version >= 110) temp[3]->load_streambuf(buffer,data_protocol_version,use_byte_order,suppress_subnormals); else *inarch >> *temp[3];
+		if (!(*temp[0].get() == *temp[1].get()) || !(*temp[2].get() == *temp[3].get()))
+			throw std::runtime_error("The received test-pattern samples do not match the specification. The protocol formats are likely incompatible.");
+	}
+
+	// the protocol negotiation has been successful
+	mark_connected(handshake_start);
+
+	if (receiver) {
+		if (datagrams_accepted) {
+			receive_datagrams(buffer,*receiver,factory,chunk,data_protocol_version,suppress_subnormals);
+			return;
+		}
+		datagrams_unavailable_ = true;
+		std::clog << "Note: the outlet of stream " << conn_.type_info().name() << " does not send datagram feeds (perhaps it uses an older version of liblsl); receiving it over TCP instead." << std::endl;
+	}
+
+	// --- transmission loop ---
+
+	double last_timestamp = 0.0;
+	double srate = conn_.current_srate();
+	for (int k=0;!conn_.lost() && !conn_.shutdown() && !closing_stream_;k++) {
+		// allocate and fetch a new sample						
+		sample_p samp(factory->new_sample(0.0,false));
+		{
+			LSL_TRACE_SCOPE("parse");
+			if (data_protocol_version >= 110) samp->load_streambuf(buffer,data_protocol_version,use_byte_order,suppress_subnormals); else *inarch >> *samp;
+		}
+		// deduce timestamp if necessary
+		if (samp->timestamp == DEDUCED_TIMESTAMP) {
+			samp->timestamp = last_timestamp;
+			if (srate != IRREGULAR_RATE)
+				samp->timestamp += 1.0/srate;
+		}
+		last_timestamp = samp->timestamp;
+		deliver_sample(samp,chunk,buffer.in_avail() > 0,lossless);
+		// update the statistics (we are the only writer, so no read-modify-write is needed)
+		samples_received_.store(samples_received_.load(lslboost::memory_order_relaxed)+1,lslboost::memory_order_relaxed);
+		bytes_received_.store(bytes_before + buffer.bytes_received(),lslboost::memory_order_relaxed);
+		// periodically update the last receive time to keep the watchdog happy
+		if (srate<=16 || (k & 0xF) == 0)
+			conn_.update_receive_time(lsl_clock());
+	}
+}
+
+/// Parse the sample in a datagram (or a sample that has been sent over the connection) of a datagram feed.
+/// Returns an empty pointer if the datagram is too short to hold a header.
+static sample_p parse_datagram(const std::string &dgram, sample::factory_p &factory, int data_protocol_version, bool suppress_subnormals) {
+	datagram_header hdr;
+	if (!datagram_read_header(dgram.data(),dgram.size(),hdr))
+		return sample_p();
+	memory_source src(dgram.data()+datagram_header_size,dgram.size()-datagram_header_size);
+	sample_p samp(factory->new_sample(0.0,false));
+	samp->load_streambuf(src,data_protocol_version,hdr.byte_order,suppress_subnormals);
+	return samp;
+}
+
+/// The time to wait for the first datagram of a datagram feed before the data is received over TCP instead, in seconds
+/// (the outlet sends a heartbeat right away, and then at least every half second).
+const double datagram_probe_timeout = 2.0;
+
+/**
+* Receive the samples of a datagram feed until the stream is closed (or the outlet goes away).
+* Each datagram holds one sample; lost datagrams are counted as lost samples. The samples that were too large for a
+* datagram have been sent over the connection, and are read from there when a later datagram shows that they are due.
+* @param buffer The stream buffer of the connection to the outlet (after the feed header).
+* @param receiver The receiver of the datagrams.
+* @param factory The sample factory.
+* @param chunk The samples that have arrived together, for the chunk handler.
+* @param data_protocol_version The negotiated protocol version (1.10 or later).
+* @param suppress_subnormals Whether subnormal numbers shall be suppressed.
+*/
+void data_receiver::receive_datagrams(std::streambuf &buffer, datagram_receiver &receiver, sample::factory_p &factory, std::vector<sample_p> &chunk, int data_protocol_version, bool suppress_subnormals) {
+	std::string dgram;
+	if (!receiver.receive(dgram,datagram_probe_timeout)) {
+		datagrams_unavailable_ = true;
+		std::clog << "Note: no datagrams arrived from the outlet of stream " << conn_.type_info().name() << " (perhaps a firewall blocks them); receiving it over TCP instead." << std::endl;
+		return;
+	}
+	lslboost::uint64_t next_seq = 0;	// the number of the next expected datagram
+	lslboost::uint64_t next_index = 0;	// the number of the next expected sample
+	std::string frame;
+	std::vector<sample_p> samples;
+	while (!conn_.lost() && !conn_.shutdown() && !closing_stream_) {
+		datagram_header hdr;
+		bool valid = datagram_read_header(dgram.data(),dgram.size(),hdr);
+		if (valid && (hdr.flags & datagram_end))
+			throw lost_error("The outlet has been destroyed.");
+		// skip malformed datagrams, duplicates and datagrams that have arrived too late
+		if (valid && hdr.seq >= next_seq && hdr.index >= next_index) {
+			bool heartbeat = (hdr.flags & datagram_heartbeat) != 0;
+			lslboost::uint64_t received_bytes = dgram.size();
+			// each lost datagram held one sample; the other samples before this one have been sent over the connection
+			lslboost::uint64_t lost = hdr.seq - next_seq;
+			lslboost::uint64_t deferred = (hdr.index - next_index > lost) ? hdr.index - next_index - lost : 0;
+			{
+				LSL_TRACE_SCOPE("parse");
+				for (; deferred; deferred--) {
+					char length[4];
+					if (buffer.sgetn(length,4) != 4)
+						throw lost_error("The connection to the outlet has been lost.");
+					frame.resize((std::size_t)datagram_get(length,4));
+					if (frame.size() < datagram_header_size || buffer.sgetn(&frame[0],frame.size()) != (std::streamsize)frame.size())
+						throw lost_error("The connection to the outlet has been lost.");
+					if (sample_p samp = parse_datagram(frame,factory,data_protocol_version,suppress_subnormals))
+						samples.push_back(samp);
+					received_bytes += 4 + frame.size();
+				}
+				sample_p samp;
+				if (!heartbeat && (samp = parse_datagram(dgram,factory,data_protocol_version,suppress_subnormals)))
+					samples.push_back(samp);
+			}
+			next_seq = heartbeat ? hdr.seq : hdr.seq+1;
+			next_index = heartbeat ? hdr.index : hdr.index+1;
+			for (std::size_t k=0; k<samples.size(); k++)
+				deliver_sample(samples[k],chunk,k+1 < samples.size(),false);
+			// update the statistics (we are the only writer, so no read-modify-write is needed)
+			samples_lost_.store(samples_lost_.load(lslboost::memory_order_relaxed)+lost,lslboost::memory_order_relaxed);
+			samples_received_.store(samples_received_.load(lslboost::memory_order_relaxed)+samples.size(),lslboost::memory_order_relaxed);
+			bytes_received_.store(bytes_received_.load(lslboost::memory_order_relaxed)+received_bytes,lslboost::memory_order_relaxed);
+			samples.clear();
+		}
+		// every well-formed datagram (including the heartbeats) keeps the watchdog happy
+		if (valid)
+			conn_.update_receive_time(lsl_clock());
+		while (!receiver.receive(dgram,0.5))
+			if (conn_.lost() || conn_.shutdown() || closing_stream_)
+				return;
+	}
+}
+
+/// The time to wait for the first datagram from a multicast group before the data is received over TCP instead, in seconds
+/// (the outlet sends at least a heartbeat every half second).
+const double multicast_probe_timeout = 2.0;
+
+/**
+* Join the multicast group of the stream and receive samples until the stream is closed (or the outlet goes away).
+* Lost datagrams are fetched from the outlet if repairs are enabled, and counted as lost samples otherwise.
+* @param group The multicast group and port to which the outlet publishes the stream's data.
+* @param factory The sample factory.
+* @param chunk The samples that have arrived together, for the chunk handler.
+* @return False if no data arrived from the group (then the data shall be received over TCP instead).
+*/
+bool data_receiver::receive_multicast(const udp::endpoint &group, sample::factory_p &factory, std::vector<sample_p> &chunk) {
+	double handshake_start = lsl_clock();
+	lslboost::scoped_ptr<multicast_receiver> joined;
+	try {
+		joined.reset(new multicast_receiver(group,conn_.current_uid(),factory,conn_.current_srate()));
+	} catch(std::exception &e) {
+		multicast_unavailable_ = true;
+		std::clog << "Note: could not join the multicast group " << group << " of stream " << conn_.type_info().name() << " (" << e.what() << "); receiving it over TCP instead." << std::endl;
+		return false;
+	}
+	multicast_receiver &receiver = *joined;
+	receiver.register_at(&conn_);
+	receiver.register_at(this);
+	std::string dgram;
+	if (!receiver.receive(dgram,multicast_probe_timeout)) {
+		multicast_unavailable_ = true;
+		std::clog << "Note: no data arrived from the multicast group " << group << " of stream " << conn_.type_info().name() << "; receiving it over TCP instead." << std::endl;
+		return false;
+	}
+	mark_connected(handshake_start);
+	std::vector<sample_p> samples;
+	std::vector<std::string> repaired;
+	while (!conn_.lost() && !conn_.shutdown() && !closing_stream_) {
+		// fill in the datagrams that got lost on the way, if requested (and the outlet still has them)
+		if (lslboost::uint64_t missing = receiver.missing(dgram)) {
+			if (multicast_repair_) {
+				repaired.clear();
+				fetch_repairs(receiver.next_seq(),missing,repaired);
+				for (std::size_t k=0; k<repaired.size(); k++) {
+					std::size_t before = samples.size();
+					samples_lost_.store(samples_lost_.load(lslboost::memory_order_relaxed)+receiver.unpack(repaired[k],samples),lslboost::memory_order_relaxed);
+					samples_repaired_.store(samples_repaired_.load(lslboost::memory_order_relaxed)+(samples.size()-before),lslboost::memory_order_relaxed);
+					bytes_received_.store(bytes_received_.load(lslboost::memory_order_relaxed)+repaired[k].size(),lslboost::memory_order_relaxed);
+				}
+			}
+		}
+		{
+			LSL_TRACE_SCOPE("parse");
+			samples_lost_.store(samples_lost_.load(lslboost::memory_order_relaxed)+receiver.unpack(dgram,samples),lslboost::memory_order_relaxed);
+		}
+		for (std::size_t k=0; k<samples.size(); k++)
+			deliver_sample(samples[k],chunk,k+1 < samples.size(),false);
+		// update the statistics (we are the only writer, so no read-modify-write is needed)
+		samples_received_.store(samples_received_.load(lslboost::memory_order_relaxed)+samples.size(),lslboost::memory_order_relaxed);
+		bytes_received_.store(bytes_received_.load(lslboost::memory_order_relaxed)+dgram.size(),lslboost::memory_order_relaxed);
+		samples.clear();
+		// every datagram (including the heartbeats) keeps the watchdog happy
+		conn_.update_receive_time(lsl_clock());
+		while (!receiver.receive(dgram,0.5))
+			if (conn_.lost() || conn_.shutdown() || closing_stream_)
+				return true;
+	}
+	return true;
+}
+
+/**
+* Fetch lost datagrams of a multicast stream from the outlet's data port (see multicast_publisher::repair()).
+* @param first The number of the first datagram.
+* @param count The number of datagrams.
+* @param dgrams Receives the datagrams that the outlet still has.
+*/
+void data_receiver::fetch_repairs(lslboost::uint64_t first, lslboost::uint64_t count, std::vector<std::string> &dgrams) {
+	lslboost::asio::cancellable_streambuf<tcp> buffer;
+	buffer.register_at(&conn_);
+	buffer.register_at(this);
+	std::iostream server_stream(&buffer);
+	buffer.connect(conn_.get_tcp_endpoint());
+	if (buffer.puberror())
+		return;
+	// request line LSL:repair/[ProtocolVersion] [UID]\r\n, followed by the range
+	server_stream << "LSL:repair/" << api_config::get_instance()->use_protocol_version() << " " << conn_.current_uid() << "\r\n";
+	server_stream << first << " " << count << "\r\n" << std::flush;
+	// check the response line (LSL/[Version] [StatusCode] [Message]) and skip the blank line
+	char buf[16384] = {0};
+	if (!server_stream.getline(buf,sizeof(buf)))
+		return;
+	std::vector<std::string> parts; split(parts,buf,is_any_of(" \t"));
+	if (parts.size() < 3 || !starts_with(parts[0],"LSL/") || parts[1] != "200")
+		return;
+	if (!server_stream.getline(buf,sizeof(buf)))
+		return;
+	// read the datagrams (each preceded by its length) until the outlet closes the connection
+	char length[4];
+	while (server_stream.read(length,4)) {
+		std::string dgram((std::size_t)datagram_get(length,4),'\0');
+		if (dgram.empty() || !server_stream.read(&dgram[0],dgram.size()))
+			break;
+		dgrams.push_back(dgram);
+	}
+}
+
 /// The data reader thread.
 void data_receiver::data_thread() {
 	conn_.acquire_watchdog();
 	// ensure that the sample factory persists for the lifetime of this thread
 	sample::factory_p factory(sample_factory_);
+	std::vector<sample_p> chunk;	// samples that have arrived together, for the chunk handler
+	bool lost = false;				// whether the connection was irrecoverably lost (or the inlet disengaged)
 	try {
 		while (!conn_.lost() && !conn_.shutdown() && !closing_stream_) {
+			bool reconnect_now = false;	// whether the last recovery found the stream available for an immediate reconnect
 			try {
 				// --- connection setup ---
 
-				// make a new stream buffer and a stream on top of it
-				lslboost::asio::cancellable_streambuf<tcp> buffer;
-				buffer.register_at(&conn_);
-				buffer.register_at(this);
-				std::iostream server_stream(&buffer);
-				lslboost::scoped_ptr<eos::portable_iarchive> inarch;
-				// connect to endpoint
-				buffer.connect(conn_.get_tcp_endpoint());
-				if (buffer.puberror())
-					throw buffer.puberror();
-
-				// --- protocol negotiation ---
-
-				int use_byte_order = 0;				// which byte order we shall use (0=portable byte order)
-				int data_protocol_version = 100;	// which protocol version we shall use for data transmission (100=version 1.00)
-				bool suppress_subnormals = false;	// whether we shall suppress subnormal numbers
-
-				// propose to use the highest protocol version supported by both parties
-				int proposed_protocol_version = std::min(api_config::get_instance()->use_protocol_version(),conn_.type_info().version());
-				if (proposed_protocol_version >= 110) {
-					// request line LSL:streamfeed/[ProtocolVersion] [UID]\r\n
-					server_stream << "LSL:streamfeed/" << proposed_protocol_version << " " << conn_.current_uid() << "\r\n";
-					// transmit request parameters
-					server_stream << "Native-Byte-Order: " << BOOST_BYTE_ORDER << "\r\n";
-					server_stream << "Endian-Performance: " << std::floor(measure_endian_performance()) << "\r\n";
-					server_stream << "Has-IEEE754-Floats: " << (format_ieee754[cf_float32] && format_ieee754[cf_double64]) << "\r\n";
-					server_stream << "Supports-Subnormals: " << format_subnormal[conn_.type_info().channel_format()] << "\r\n";
-					server_stream << "Value-Size: " << conn_.type_info().channel_bytes() << "\r\n"; // 0 for strings
-					server_stream << "Data-Protocol-Version: " << proposed_protocol_version << "\r\n";
-					server_stream << "Max-Buffer-Length: " << max_buflen_ << "\r\n";
-					server_stream << "Max-Chunk-Length: " << max_chunklen_ << "\r\n";
-					server_stream << "Hostname: " << conn_.type_info().hostname() << "\r\n";
-					server_stream << "Source-Id: " << conn_.type_info().source_id() << "\r\n";
-					server_stream << "Session-Id: " << conn_.type_info().session_id() << "\r\n";
-					server_stream << "\r\n" << std::flush;
-
-					// check server response line (LSL/[Version] [StatusCode] [Message])
-					char buf[16384] = {0};
-					if (!server_stream.getline(buf,sizeof(buf)))
-						throw lost_error("Connection lost.");
-					std::vector<std::string> parts; split(parts,buf,is_any_of(" \t"));
-					if (parts.size() < 3 || !starts_with(parts[0],"LSL/"))
-						throw std::runtime_error("Received a malformed response.");
-					if (lslboost::lexical_cast<int>(parts[0].substr(4))/100 > api_config::get_instance()->use_protocol_version()/100)
-						throw std::runtime_error("The other party's protocol version is too new for this client; please upgrade your LSL library.");
-					int status_code = lslboost::lexical_cast<int>(parts[1]);
-					if (status_code == 404)
-						throw lost_error("The given address does not serve the resolved stream (likely outdated).");
-					if (status_code >= 400)
-						throw std::runtime_error("The other party sent an error: " + std::string(buf));
-					if (status_code >= 300)
-						throw lost_error("The other party requested a redirect.");
-
-					// receive response parameters
-					while (server_stream.getline(buf,sizeof(buf)) && (buf[0] != '\r')) {
-						std::string hdrline(buf);
-						std::size_t colon = hdrline.find_first_of(':');
-						if (colon != std::string::npos) {
-							// extract key & value
-							std::string type = to_lower_copy(trim_copy(hdrline.substr(0,colon))), rest = to_lower_copy(trim_copy(hdrline.substr(colon+1)));
-							// strip off comments
-							std::size_t semicolon = rest.find_first_of(';');
-							if (semicolon != std::string::npos)
-								rest = rest.substr(0,semicolon);
-							// get the header information
-							if (type == "byte-order") {
-								use_byte_order = lslboost::lexical_cast<int>(rest);
-								if (use_byte_order==2134 && BOOST_BYTE_ORDER!=2134 && format_sizes[conn_.type_info().channel_format()]>=8)
-									throw std::runtime_error("The byte order conversion requested by the other party is not supported.");
-							}
-							if (type == "suppress-subnormals") 
-								suppress_subnormals = lslboost::lexical_cast<bool>(rest);
-							if (type == "uid" && rest != conn_.current_uid())
-								throw lost_error("The received UID does not match the current connection's UID.");
-							if (type == "data-protocol-version") {
-								data_protocol_version = lslboost::lexical_cast<int>(rest);
-								if (data_protocol_version > api_config::get_instance()->use_protocol_version())
-									throw std::runtime_error("The protocol version requested by the other party is not supported by this client.");
-							}
-						}
+				// ask for a datagram feed on a dedicated connection to the outlet's data port if requested (unless the inlet is
+				// lossless, or no datagrams have arrived before); otherwise join the multicast group of the stream if its outlet
+				// publishes the data there (unless the inlet is lossless, or no data has arrived from the group before), or else
+				// receive the feed on a channel of the shared session with the outlet's process if that multiplexes its streams,
+				// or on a dedicated connection to the outlet's data port
+				udp::endpoint group;
+				if (datagram_transport_ && !datagrams_unavailable_ && !lossless_) {
+					lslboost::asio::cancellable_streambuf<tcp> buffer;
+					receive_feed(buffer,conn_.get_tcp_endpoint(),factory,chunk,true);
+				} else if (lossless_ || multicast_unavailable_ || !conn_.get_multicast_endpoint(group) || !receive_multicast(group,factory,chunk)) {
+					tcp::endpoint mux_endpoint;
+					if (conn_.get_mux_endpoint(mux_endpoint)) {
+						mux_streambuf buffer(conn_.current_uid());
+						receive_feed(buffer,mux_endpoint,factory,chunk);
+					} else {
+						lslboost::asio::cancellable_streambuf<tcp> buffer;
+						receive_feed(buffer,conn_.get_tcp_endpoint(),factory,chunk);
 					}
-					if (!server_stream)
-						throw lost_error("Server connection lost.");
-				} else {
-					// version 1.00: send request line and feed parameters
-					server_stream << "LSL:streamfeed\r\n";
-					server_stream << max_buflen_ << " " << max_chunklen_ << "\r\n" << std::flush;
 				}
-
-				if (data_protocol_version == 100) {
-					// portable binary archive (parse archive header)
-					inarch.reset(new eos::portable_iarchive(server_stream));
-					// receive stream_info message from server
-					std::string infomsg; *inarch >> infomsg;
-					stream_info_impl info; info.from_shortinfo_message(infomsg);
-					// confirm that the UID matches, otherwise reconnect
-					if (info.uid() != conn_.current_uid())
-						throw lost_error("The received UID does not match the current connection's UID.");
-				}
-
-				// --- format validation ---
-				{
-					// receive and parse two subsequent test-pattern samples and check if they are formatted as expected
-					lslboost::scoped_ptr<sample> temp[4]; 
-					for (int k=0; k<4; temp[k++].reset(sample::factory::new_sample_unmanaged(conn_.type_info().channel_format(),conn_.type_info().channel_count(),0.0,false)));
-					temp[0]->assign_test_pattern(4); if (data_protocol_version >= 110) temp[1]->load_streambuf(buffer,data_protocol_version,use_byte_order,suppress_subnormals); else *inarch >> *temp[1];
-					temp[2]->assign_test_pattern(2); if (data_protocol_version >= 110) temp[3]->load_streambuf(buffer,data_protocol_version,use_byte_order,suppress_subnormals); else *inarch >> *temp[3];
-					if (!(*temp[0].get() == *temp[1].get()) || !(*temp[2].get() == *temp[3].get()))
-						throw std::runtime_error("The received test-pattern samples do not match the specification. The protocol formats are likely incompatible.");
-				}
-
-                // signal to accessor functions on other threads that the protocol negotiation has been successful,
-                // so we're now connected (and remain to be even if we later recover silently)
-                {
-                    lslboost::lock_guard<lslboost::mutex> lock(connected_mut_);
-                    connected_ = true;
-                }
-                connected_upd_.notify_all();
-
-                // --- transmission loop ---
-
-                double last_timestamp = 0.0;
-                double srate = conn_.current_srate();
-                for (int k=0;!conn_.lost() && !conn_.shutdown() && !closing_stream_;k++) {
-                    // allocate and fetch a new sample						
-                    sample_p samp(factory->new_sample(0.0,false));
-					if (data_protocol_version >= 110) samp->load_streambuf(buffer,data_protocol_version,use_byte_order,suppress_subnormals); else *inarch >> *samp;
-                    // deduce timestamp if necessary
-                    if (samp->timestamp == DEDUCED_TIMESTAMP) {
-                        samp->timestamp = last_timestamp;
-                        if (srate != IRREGULAR_RATE)
-                            samp->timestamp += 1.0/srate;
-                    }
-                    last_timestamp = samp->timestamp;
-                    // push it into the sample queue
-                    sample_queue_.push_sample(samp);
-                    // periodically update the last receive time to keep the watchdog happy
-					if (srate<=16 || (k & 0xF) == 0)
-						conn_.update_receive_time(lsl_clock());
-                }
 			}
 			catch(error_code &) {
 				// connection-level error: closed, reset, refused, etc.
-				conn_.try_recover_from_error();
+				reconnect_now = conn_.try_recover_from_error();
 			}
 			catch(lost_error &) {
 				// another type of connection error
-				conn_.try_recover_from_error();
+				reconnect_now = conn_.try_recover_from_error();
 			}
 			catch(shutdown_error &) {
 				// termination due to connection shutdown
@@ -291,17 +665,26 @@ void data_receiver::data_thread() {
 				// some perhaps more serious transmission or parsing error (could be indicative of a protocol issue)
 				if (!conn_.shutdown())
 					std::cerr << "Stream transmission broke off (" << e.what() << "); re-connecting..." << std::endl;
-				conn_.try_recover_from_error();
+				reconnect_now = conn_.try_recover_from_error();
 			}
+			// pass on the samples that were received before the connection broke off
+			if (!chunk.empty())
+				deliver_chunk(chunk);
             // wait for a few msec so as to not spam the provider with reconnects
-            lslboost::this_thread::sleep(lslboost::posix_time::millisec(500));
+            // (unless the stream has just been found at a new endpoint or still answers at its host, so we can connect right away)
+            if (!reconnect_now)
+                conn_.wait_unless_shutdown(api_config::get_instance()->reconnect_interval());
 		}
 	}
 	catch(lost_error &) {
-		// the connection was irrecoverably lost: since the pull_sample() function may
-		// be waiting for the next sample we need to wake it up by passing a sentinel
-		sample_queue_.push_sample(sample_p());
+		// the connection was irrecoverably lost
+		lost = true;
 	}
+	// since the pull_sample() function (or a wait on the inlet's events or descriptor) may be waiting for the next sample,
+	// we need to wake it up by passing a sentinel; this includes the case where the loss was detected by another
+	// component of the inlet (e.g., a time or info query), which makes the loops above return without an exception
+	if (lost || conn_.lost())
+		sample_queue_.push_sample(sample_p());
 	conn_.release_watchdog();
 }
 
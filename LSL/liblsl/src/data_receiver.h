@@ -1,10 +1,13 @@
 #ifndef DATA_RECEIVER_H
 #define DATA_RECEIVER_H
 
+#include <vector>
+#include <boost/function.hpp>
 #include <boost/thread/thread.hpp>
 #include "consumer_queue.h"
 #include "inlet_connection.h"
 #include "cancellable_streambuf.h"
+#include "trace.h"
 
 
 
@@ -12,6 +15,9 @@ using lslboost::asio::ip::tcp;
 
 namespace lsl {
 
+	/// A function that receives a chunk of samples directly from the data thread.
+	typedef lslboost::function<void(const std::vector<sample_p>&)> chunk_handler_t;
+
 	/// Internal class of an inlet that is responsible for retrieving the data (the samples) of the inlet.
 	/// The actual communication runs in an internal background thread, while the public functions (pull_sample_typed/untyped, open_stream, close_stream) wait for the thread to finish.
 	/// The public functions have an optional timeout after which they give up, while the background thread continues to do its job (so the next public-function call may succeed within the timeout).
@@ -49,20 +55,39 @@ namespace lsl {
 		*/
 		void close_stream();
 
+		/// Enable or disable lossless transmission (takes effect when the data connection is (re-)established).
+		/// The buffer of a lossless inlet is also exempt from evictions under the memory budget.
+		void set_lossless(bool lossless) { lossless_ = lossless; sample_queue_.set_evictable(!lossless); }
+
+		/// Enable or disable the repair of lost datagrams on a multicast stream (takes effect at the next lost datagram).
+		void set_multicast_repair(bool repair) { multicast_repair_ = repair; }
+
+		/// Enable or disable the datagram feed (takes effect when the data connection is (re-)established).
+		void set_datagram_transport(bool datagrams) { datagram_transport_ = datagrams; datagrams_unavailable_ = false; }
+
+		/// Keep only the given number of most recent samples in the sample queue (0 = keep up to max_buflen samples).
+		/// The outlet is asked to do the same for this inlet when the data connection is (re-)established.
+		void set_latest_only(unsigned num_samples) { latest_only_ = num_samples; }
+
+		/**
+		* Set a function that receives the samples directly from the data thread, bypassing the sample queue.
+		* The samples are delivered in chunks of those that have arrived together (at most max_chunklen, if given).
+		* Blocks while the previous handler (if any) is being called; an empty function restores the queueing.
+		*/
+		void set_chunk_handler(const chunk_handler_t &handler);
+
 		/// Retrieve a sample from the sample queue and assign its contents to the given typed buffer.
 		template<class T> double pull_sample_typed(T *buffer, int buffer_elements, double timeout=FOREVER) {
 			if (conn_.lost())
 				throw lost_error("The stream read by this outlet has been lost. To recover, you need to re-resolve the source and re-create the inlet.");
 			// start data thread implicitly if necessary
-			if (check_thread_start_ && !data_thread_.joinable()) {
-				data_thread_ = lslboost::thread(&data_receiver::data_thread,this);
-				check_thread_start_ = false;
-			}
+			start_thread();
 			// get the sample with timeout
 			if (sample_p s = sample_queue_.pop_sample(timeout)) {
 				if (buffer_elements != conn_.type_info().channel_count())
 					throw std::range_error("The number of buffer elements provided does not match the number of channels in the sample.");
 				s->retrieve_typed(buffer);
+				LSL_TRACE_EVENT("pull");
 				return s->timestamp;
 			} else {
 				if (conn_.lost())
@@ -74,13 +99,89 @@ namespace lsl {
 		/// Read sample from the inlet and read it into a pointer to raw data.
 		double pull_sample_untyped(void *buffer, int buffer_bytes, double timeout=FOREVER);
 
+		/// Retrieve the next sample itself from the sample queue (without copying its contents); NULL if none arrived within the timeout.
+		sample_p pull_sample(double timeout=FOREVER);
+
 		/// Check whether the underlying buffer is empty. This value may be inaccurate.
 		bool empty() { return sample_queue_.empty(); };
 
+		/// Check whether a pull would return immediately, i.e., whether samples are available or the stream has been lost.
+		bool ready() { return !sample_queue_.empty() || conn_.lost(); }
+
+		/// Attach an event that is signalled when samples arrive (starts the data thread if necessary).
+		void attach(queue_event *e) { sample_queue_.attach(e); start_thread(); }
+
+		/// Detach an event.
+		void detach(queue_event *e) { sample_queue_.detach(e); }
+
+		/// Get a file descriptor that is readable while samples may be available (starts the data thread if necessary).
+		int wakeup_descriptor() { int fd = sample_queue_.wakeup_descriptor(); start_thread(); return fd; }
+
+		/// Get the number of samples that are currently buffered. This value may be inaccurate.
+		std::size_t queue_depth() const { return sample_queue_.size(); }
+
+		/// Get the highest number of samples that have been buffered at any one time.
+		std::size_t queue_high_water() const { return sample_queue_.high_water_mark(); }
+
+		/// Get the number of samples that were dropped because the buffer overran (or to stay within the memory budget);
+		/// the samples that were superseded in latest-only mode are not counted.
+		lslboost::uint64_t samples_dropped() const {
+			lslboost::uint64_t superseded = samples_superseded_.load(lslboost::memory_order_acquire), dropped = sample_queue_.dropped();
+			return dropped > superseded ? dropped - superseded : 0;
+		}
+
+		/// Get the number of samples received so far.
+		lslboost::uint64_t samples_received() const { return samples_received_.load(lslboost::memory_order_relaxed); }
+
+		/// Get the number of bytes received on the data connection(s) so far.
+		lslboost::uint64_t bytes_received() const { return bytes_received_.load(lslboost::memory_order_relaxed); }
+
+		/// Get the number of samples of a multicast stream or datagram feed that were lost in transmission (and not repaired).
+		lslboost::uint64_t samples_lost() const { return samples_lost_.load(lslboost::memory_order_relaxed); }
+
+		/// Get the number of samples of a multicast stream that were re-sent by the outlet after having been lost.
+		lslboost::uint64_t samples_repaired() const { return samples_repaired_.load(lslboost::memory_order_relaxed); }
+
+		/**
+		* Get statistics of the connection setup.
+		* @param reconnects Receives the number of times the connection has been re-established.
+		* @param handshake_time Receives the duration of the most recent connection setup, in seconds (0 if not yet connected).
+		*/
+		void connection_stats(unsigned &reconnects, double &handshake_time);
+
 	private:
 		/// The data reader thread.
 		void data_thread();
 
+		/// Connect to the outlet, negotiate the feed and receive samples until the connection breaks off or the stream is closed.
+		template<class StreamBuf> void receive_feed(StreamBuf &buffer, const lslboost::asio::ip::tcp::endpoint &endpoint, sample::factory_p &factory, std::vector<sample_p> &chunk, bool datagrams=false);
+
+		/// Receive the samples of a datagram feed (and those that were too large for a datagram from the connection) until the stream is closed.
+		void receive_datagrams(std::streambuf &buffer, class datagram_receiver &receiver, sample::factory_p &factory, std::vector<sample_p> &chunk, int data_protocol_version, bool suppress_subnormals);
+
+		/// Join the multicast group of the stream and receive samples until the stream is closed; returns false if no data arrives from the group.
+		bool receive_multicast(const lslboost::asio::ip::udp::endpoint &group, sample::factory_p &factory, std::vector<sample_p> &chunk);
+
+		/// Fetch lost datagrams of a multicast stream from the outlet (those that it no longer has are left out).
+		void fetch_repairs(lslboost::uint64_t first, lslboost::uint64_t count, std::vector<std::string> &dgrams);
+
+		/// Start the data thread if it is not yet running (pulls and waits serve as an implicit open_stream()).
+		void start_thread() {
+			if (check_thread_start_ && !data_thread_.joinable()) {
+				data_thread_ = lslboost::thread(&data_receiver::data_thread,this);
+				check_thread_start_ = false;
+			}
+		}
+
+		/// Pass a chunk of samples to the chunk handler (or the sample queue if there is none) and clear it.
+		void deliver_chunk(std::vector<sample_p> &chunk);
+
+		/// Pass a received sample on to the chunk handler (collected into chunks until no more data is pending) or the sample queue.
+		void deliver_sample(const sample_p &samp, std::vector<sample_p> &chunk, bool more_pending, bool lossless);
+
+		/// Signal to the accessor functions that the stream has been connected.
+		void mark_connected(double handshake_start);
+
 		/// Function that is polled by the condition variable
 		bool connection_completed() { return connected_ || conn_.lost(); }
 
@@ -96,10 +197,30 @@ namespace lsl {
 		consumer_queue sample_queue_;				// queue of samples ready to be picked up (populated by the data thread)
 		lslboost::mutex connected_mut_;				// mutex to protect the connected state
 		lslboost::condition_variable connected_upd_;	// condition variable to indicate that an update for the connected state is available
+		unsigned connections_;						// the number of connections that have been established so far (protected by connected_mut_)
+		double handshake_time_;						// the duration of the most recent connection setup (protected by connected_mut_)
+
+		// statistics (written only by the data thread)
+		lslboost::atomic<lslboost::uint64_t> samples_received_;	// the number of samples received so far
+		lslboost::atomic<lslboost::uint64_t> bytes_received_;	// the number of bytes received so far
+		lslboost::atomic<lslboost::uint64_t> samples_lost_;		// the number of samples of a multicast stream or datagram feed that were lost
+		lslboost::atomic<lslboost::uint64_t> samples_repaired_;	// the number of samples of a multicast stream that were repaired
+		lslboost::atomic<lslboost::uint64_t> samples_superseded_;	// the number of samples that were evicted from the queue in latest-only mode
 
 		// internal data used by the reader thread
 		int max_buflen_;							// the maximum number of samples to be buffered for this inlet
 		int max_chunklen_;							// the desired maximum chunklen for received samples
+		lslboost::atomic<bool> lossless_;			// whether the inlet stops reading instead of dropping samples when its buffer is full
+		lslboost::atomic<bool> multicast_repair_;	// whether lost datagrams of a multicast stream are fetched from the outlet
+		bool multicast_unavailable_;				// whether no data arrived from the multicast group (so the data is received over TCP)
+		lslboost::atomic<bool> datagram_transport_;	// whether the samples shall be received as datagrams (see feed_encoder)
+		lslboost::atomic<bool> datagrams_unavailable_;	// whether no datagrams arrived from the outlet (so the data is received over TCP)
+		lslboost::atomic<unsigned> latest_only_;	// the number of most recent samples that are kept in the sample queue (0 = no limit)
+
+		// push-style delivery
+		chunk_handler_t chunk_handler_;				// the function that receives the samples instead of the sample queue (if any)
+		lslboost::mutex chunk_handler_mut_;			// protects the chunk handler (held while it is being called)
+		lslboost::atomic<bool> has_chunk_handler_;	// whether a chunk handler is set
 	};
 
 }
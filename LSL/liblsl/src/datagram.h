@@ -0,0 +1,123 @@
+#ifndef DATAGRAM_H
+#define DATAGRAM_H
+
+#include <cstddef>
+#include <streambuf>
+#include <string>
+#include <boost/cstdint.hpp>
+
+
+namespace lsl {
+
+	/**
+	* The datagrams that carry the samples of a stream to a multicast group (see multicast_publisher and multicast_receiver),
+	* or to a single inlet that has asked for a datagram feed (see feed_encoder and data_receiver::receive_datagrams()).
+	*
+	* A datagram consists of a header (in network byte order) and a payload, which holds either one or more whole samples
+	* (in the binary format of protocol 1.10 and the byte order given in the header), or one fragment of a sample that is
+	* too large for a single datagram. The datagrams of a stream are numbered consecutively, so that receivers can detect
+	* gaps and request the missing datagrams from the outlet's data port (see multicast_publisher::repair()); the samples
+	* are numbered as well, so that the time stamps of samples that follow a gap can still be deduced.
+	* A datagram feed carries exactly one sample per datagram (with an explicit time stamp); samples that are too large for
+	* a datagram are sent over the feed's TCP connection instead (each preceded by its length as a 4-byte value in network
+	* byte order, with a header like that of a datagram), so their numbers are skipped by the datagrams.
+	* The header fields are:
+	*  * tag: a hash of the stream's UID (so that receivers can ignore other streams that use the same group and port).
+	*  * seq: the number of the datagram (or, for a heartbeat, the number of the next datagram).
+	*  * index: the number of the first sample in the payload (or of the sample whose fragment it holds).
+	*  * fragment, fragments: the number of the fragment in the payload and the number of fragments of its sample (0 if
+	*	 the payload holds whole samples).
+	*  * byte_order: the byte order of the sample data.
+	*  * flags: datagram_heartbeat (sent when no data has been sent for a while; has no payload) or datagram_end (sent when
+	*	 the outlet is destroyed).
+	*/
+	enum datagram_flags {
+		datagram_heartbeat = 1,		// no payload; announces the number of the next datagram
+		datagram_end = 2			// the outlet has been destroyed
+	};
+
+	/// The header of a datagram.
+	struct datagram_header {
+		lslboost::uint32_t tag;			// a hash of the stream's UID
+		lslboost::uint64_t seq;			// the number of the datagram
+		lslboost::uint64_t index;		// the number of the first sample in the payload
+		lslboost::uint16_t fragment;	// the number of the fragment in the payload
+		lslboost::uint16_t fragments;	// the number of fragments of the sample (0 if the payload holds whole samples)
+		lslboost::uint16_t byte_order;	// the byte order of the sample data
+		lslboost::uint16_t flags;		// datagram_flags
+	};
+
+	/// The size of a datagram header, in bytes.
+	const std::size_t datagram_header_size = 28;
+
+	/// Write a big-endian value of the given number of bytes.
+	inline void datagram_put(char *p, lslboost::uint64_t v, int bytes) {
+		for (int k=bytes-1; k>=0; k--, v>>=8)
+			p[k] = (char)(v & 0xFF);
+	}
+
+	/// Read a big-endian value of the given number of bytes.
+	inline lslboost::uint64_t datagram_get(const char *p, int bytes) {
+		lslboost::uint64_t v = 0;
+		for (int k=0; k<bytes; k++)
+			v = (v<<8) | (unsigned char)p[k];
+		return v;
+	}
+
+	/// Write a datagram header (datagram_header_size bytes).
+	inline void datagram_write_header(char *p, const datagram_header &h) {
+		datagram_put(p,h.tag,4);
+		datagram_put(p+4,h.seq,8);
+		datagram_put(p+12,h.index,8);
+		datagram_put(p+20,h.fragment,2);
+		datagram_put(p+22,h.fragments,2);
+		datagram_put(p+24,h.byte_order,2);
+		datagram_put(p+26,h.flags,2);
+	}
+
+	/// Parse a datagram header; returns false if the datagram is too short.
+	inline bool datagram_read_header(const char *p, std::size_t len, datagram_header &h) {
+		if (len < datagram_header_size)
+			return false;
+		h.tag = (lslboost::uint32_t)datagram_get(p,4);
+		h.seq = datagram_get(p+4,8);
+		h.index = datagram_get(p+12,8);
+		h.fragment = (lslboost::uint16_t)datagram_get(p+20,2);
+		h.fragments = (lslboost::uint16_t)datagram_get(p+22,2);
+		h.byte_order = (lslboost::uint16_t)datagram_get(p+24,2);
+		h.flags = (lslboost::uint16_t)datagram_get(p+26,2);
+		return true;
+	}
+
+	/// A stream buffer that reads from a block of memory (for parsing the samples in a payload).
+	class memory_source: public std::streambuf {
+	public:
+		memory_source(const char *data, std::size_t len) { char *p = const_cast<char*>(data); setg(p,p,p+len); }
+	};
+
+	/// A stream buffer that appends everything that is written to it to a string (for serializing samples into a payload).
+	class string_sink: public std::streambuf {
+	public:
+		string_sink(std::string &target): target_(target) { }
+	protected:
+		std::streamsize xsputn(const char *s, std::streamsize n) { target_.append(s,(std::size_t)n); return n; }
+		int_type overflow(int_type c) {
+			if (!traits_type::eq_int_type(c,traits_type::eof()))
+				target_.push_back(traits_type::to_char_type(c));
+			return traits_type::not_eof(c);
+		}
+	private:
+		std::string &target_;
+	};
+
+	/// Calculate the tag of a stream from its UID (FNV-1a).
+	inline lslboost::uint32_t datagram_tag(const std::string &uid) {
+		lslboost::uint32_t h = 2166136261u;
+		for (std::size_t k=0; k<uid.size(); k++)
+			h = (h ^ (unsigned char)uid[k]) * 16777619u;
+		return h;
+	}
+
+}
+
+#endif
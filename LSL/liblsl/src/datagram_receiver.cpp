@@ -0,0 +1,107 @@
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include "common.h"
+#include "impaired_network.h"
+#include "datagram_receiver.h"
+
+
+// === implementation of the datagram_receiver class ===
+
+using namespace lsl;
+using namespace lslboost::asio;
+using lslboost::asio::ip::udp;
+using lslboost::system::error_code;
+
+namespace {
+	/// Handler that stores the outcome of a receive operation and stops the timer.
+	void handle_receive(bool &received, std::size_t &received_len, deadline_timer &timer, error_code err, std::size_t len) {
+		if (!err) {
+			received = true;
+			received_len = len;
+		}
+		timer.cancel();
+	}
+
+	/// Handler that aborts the receive operation once the timer has expired.
+	void handle_timeout(udp::socket &sock, error_code err) {
+		if (err != error::operation_aborted) {
+			error_code ec;
+			sock.cancel(ec);
+		}
+	}
+}
+
+/**
+* Open a socket on a free port.
+* @param protocol The protocol (IPv4 or IPv6) of the socket.
+* @param uid The UID of the stream (the datagrams of other streams are skipped).
+*/
+datagram_receiver::datagram_receiver(udp protocol, const std::string &uid): sock_(io_), timer_(io_), tag_(datagram_tag(uid)), cancelled_(false), buf_(65536), received_(false), received_len_(0) {
+	sock_.open(protocol);
+	sock_.bind(udp::endpoint(protocol,0));
+}
+
+/// Create a receiver whose socket is opened by the derived class.
+datagram_receiver::datagram_receiver(const std::string &uid): sock_(io_), timer_(io_), tag_(datagram_tag(uid)), cancelled_(false), buf_(65536), received_(false), received_len_(0) { }
+
+/// Destructor. Closes the socket.
+datagram_receiver::~datagram_receiver() {
+	// no cancel() can fire after this call
+	unregister_from_all();
+}
+
+/**
+* Receive the next datagram of the stream.
+* @param dgram Receives the datagram.
+* @param timeout The maximum time to wait, in seconds.
+* @return False if no datagram arrived within the timeout.
+* @throws lost_error if the receiver has been cancelled.
+*/
+bool datagram_receiver::receive(std::string &dgram, double timeout) {
+	while (true) {
+		if (cancelled_)
+			throw lost_error("The datagram reception has been cancelled.");
+		// take a datagram that has already arrived without waiting
+		error_code ec;
+		std::size_t len = 0;
+		if (sock_.available(ec)) {
+			len = sock_.receive(buffer(buf_),0,ec);
+			if (ec)
+				continue;
+		} else {
+			// otherwise wait for one (the IO service also runs a pending cancellation)
+			received_ = false;
+			sock_.async_receive(buffer(buf_),lslboost::bind(&handle_receive,lslboost::ref(received_),lslboost::ref(received_len_),lslboost::ref(timer_),placeholders::error,placeholders::bytes_transferred));
+			timer_.expires_from_now(lslboost::posix_time::millisec((long)(timeout*1000)));
+			timer_.async_wait(lslboost::bind(&handle_timeout,lslboost::ref(sock_),placeholders::error));
+			io_.reset();
+			io_.run();
+			if (cancelled_)
+				throw lost_error("The datagram reception has been cancelled.");
+			if (!received_)
+				return false;
+			len = received_len_;
+		}
+		// skip the datagrams of other streams (and those that an emulated impaired network loses)
+		datagram_header hdr;
+		if (!datagram_read_header(&buf_[0],len,hdr) || hdr.tag != tag_)
+			continue;
+		if (impaired_network::get_instance().enabled() && impaired_network::get_instance().packet_lost())
+			continue;
+		dgram.assign(&buf_[0],len);
+		return true;
+	}
+}
+
+/// Cancel the current and all subsequent receive operations.
+void datagram_receiver::cancel() {
+	cancelled_ = true;
+	io_.post(lslboost::bind(&datagram_receiver::close_socket,this));
+}
+
+/// Close the socket (in the context of the receive operations).
+void datagram_receiver::close_socket() {
+	error_code ec;
+	sock_.close(ec);
+	timer_.cancel(ec);
+}
@@ -0,0 +1,73 @@
+#ifndef DATAGRAM_RECEIVER_H
+#define DATAGRAM_RECEIVER_H
+
+#include <string>
+#include <vector>
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/atomic.hpp>
+#include "cancellation.h"
+#include "datagram.h"
+
+
+namespace lsl {
+
+	/**
+	* Receives the datagrams of a stream (see datagram.h) on a UDP socket.
+	* Datagrams of other streams and those that are too short are skipped, and the loss of an emulated impaired network
+	* is applied (see impaired_network). The blocking receive() can be cancelled from another thread like the other
+	* cancellable objects of an inlet. The socket of a datagram feed is bound to a free port, which the inlet tells the
+	* outlet in its feed request; see multicast_receiver for the receiver of a multicast group.
+	*/
+	class datagram_receiver: public cancellable_obj {
+	public:
+		/**
+		* Open a socket on a free port.
+		* @param protocol The protocol (IPv4 or IPv6) of the socket.
+		* @param uid The UID of the stream (the datagrams of other streams are skipped).
+		*/
+		datagram_receiver(lslboost::asio::ip::udp protocol, const std::string &uid);
+
+		/// Destructor. Closes the socket.
+		virtual ~datagram_receiver();
+
+		/// Get the port to which the socket is bound.
+		unsigned short port() const { return sock_.local_endpoint().port(); }
+
+		/**
+		* Receive the next datagram of the stream.
+		* @param dgram Receives the datagram.
+		* @param timeout The maximum time to wait, in seconds.
+		* @return False if no datagram arrived within the timeout.
+		* @throws lost_error if the receiver has been cancelled.
+		*/
+		bool receive(std::string &dgram, double timeout);
+
+		/// Cancel the current and all subsequent receive operations.
+		virtual void cancel();
+
+	protected:
+		/// Create a receiver whose socket is opened by the derived class.
+		explicit datagram_receiver(const std::string &uid);
+
+		lslboost::asio::io_service io_;				// the IO service of the socket
+		lslboost::asio::ip::udp::socket sock_;		// the socket on which the datagrams arrive
+
+	private:
+		/// Close the socket (in the context of the receive operations).
+		void close_socket();
+
+		lslboost::asio::deadline_timer timer_;		// the timer of the receive operations
+		lslboost::uint32_t tag_;					// the tag of the stream (see datagram.h)
+		lslboost::atomic<bool> cancelled_;			// whether the receiver has been cancelled
+		std::vector<char> buf_;						// the buffer for incoming datagrams
+
+		// the outcome of an asynchronous receive operation
+		bool received_;								// whether a datagram has been received
+		std::size_t received_len_;					// the length of the datagram
+	};
+
+}
+
+#endif
@@ -0,0 +1,433 @@
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/weak_ptr.hpp>
+#include "api_config.h"
+#include "common.h"
+#include "impaired_network.h"
+
+
+// === implementation of the impaired_network class and its relays ===
+
+using namespace lsl;
+using namespace lslboost::asio;
+using lslboost::system::error_code;
+
+namespace lsl {
+
+	typedef lslboost::shared_ptr<ip::tcp::socket> tcp_socket_p;
+	typedef lslboost::shared_ptr<ip::udp::socket> udp_socket_p;
+	typedef lslboost::shared_ptr<std::vector<char> > packet_p;
+	typedef lslboost::shared_ptr<deadline_timer> timer_p;
+
+	/// The maximum number of bytes that a pipe holds back before it stops reading (so that a bandwidth cap exerts backpressure).
+	const std::size_t max_pipe_backlog = 1<<22;
+
+	/// Get the loopback address of the given IP version (this is where the relays listen).
+	static ip::address loopback(bool v4) { return v4 ? ip::address(ip::address_v4::loopback()) : ip::address(ip::address_v6::loopback()); }
+
+	/// Wait for the given number of seconds on a timer.
+	static void expire_in(deadline_timer &timer, double seconds) { timer.expires_from_now(lslboost::posix_time::microseconds((long)(std::max(0.0,seconds)*1e6))); }
+
+	/// One direction of a relayed TCP connection: reads from one socket and writes the data into the other after a delay.
+	class impaired_pipe: public lslboost::enable_shared_from_this<impaired_pipe> {
+	public:
+		impaired_pipe(impaired_network &net, tcp_socket_p from, tcp_socket_p to): net_(net), from_(from), to_(to), timer_(from->get_io_service()),
+			backlog_(0), reading_(false), writing_(false), eof_(false), closed_(false), last_sent_(0), last_delivery_(0) {}
+
+		/// Start relaying.
+		void start() { read_next(); }
+
+		/// Close both sockets (the opposite pipe will then fail, too).
+		void close() {
+			error_code ec;
+			closed_ = true;
+			from_->close(ec);
+			to_->close(ec);
+			timer_.cancel(ec);
+		}
+
+	private:
+		void read_next() {
+			packet_p buf(new std::vector<char>(65536));
+			reading_ = true;
+			from_->async_read_some(buffer(*buf),lslboost::bind(&impaired_pipe::handle_read,shared_from_this(),buf,placeholders::error,placeholders::bytes_transferred));
+		}
+
+		void handle_read(packet_p buf, error_code err, std::size_t len) {
+			reading_ = false;
+			if (closed_)
+				return;
+			if (err) {
+				// deliver what is still in flight before passing on the end of the stream
+				eof_ = true;
+				if (!writing_)
+					close();
+				return;
+			}
+			buf->resize(len);
+			double now = lsl_clock();
+			// the segment leaves once the link is free, and arrives after the (random) delay
+			double bw = net_.bandwidth();
+			last_sent_ = bw > 0 ? std::max(now,last_sent_) + len/bw : now;
+			// TCP delivers in order, so a delayed segment holds up the ones behind it
+			last_delivery_ = std::max(last_delivery_,last_sent_ + net_.packet_delay(true));
+			queue_.push_back(std::make_pair(last_delivery_,buf));
+			backlog_ += len;
+			if (!writing_)
+				schedule_write();
+			if (backlog_ < max_pipe_backlog)
+				read_next();
+		}
+
+		void schedule_write() {
+			writing_ = true;
+			expire_in(timer_,queue_.front().first - lsl_clock());
+			timer_.async_wait(lslboost::bind(&impaired_pipe::handle_timer,shared_from_this(),placeholders::error));
+		}
+
+		void handle_timer(error_code err) {
+			if (err || closed_) {
+				writing_ = false;
+				return;
+			}
+			async_write(*to_,buffer(*queue_.front().second),lslboost::bind(&impaired_pipe::handle_write,shared_from_this(),placeholders::error));
+		}
+
+		void handle_write(error_code err) {
+			if (err || closed_) {
+				writing_ = false;
+				close();
+				return;
+			}
+			backlog_ -= queue_.front().second->size();
+			queue_.pop_front();
+			if (!queue_.empty())
+				schedule_write();
+			else {
+				writing_ = false;
+				if (eof_) {
+					close();
+					return;
+				}
+			}
+			if (!reading_ && !eof_ && backlog_ < max_pipe_backlog)
+				read_next();
+		}
+
+		impaired_network &net_;					// the network that determines the impairment
+		tcp_socket_p from_, to_;				// the sockets between which the data is relayed
+		deadline_timer timer_;					// schedules the delivery of the next segment
+		std::deque<std::pair<double,packet_p> > queue_;	// the segments in flight and their delivery times
+		std::size_t backlog_;					// the number of bytes in flight
+		bool reading_, writing_;				// whether a read or a (scheduled) write is pending
+		bool eof_;								// whether the source has closed the connection
+		bool closed_;							// whether the pipe has been closed
+		double last_sent_;						// the time at which the last segment has left (under the bandwidth cap)
+		double last_delivery_;					// the delivery time of the last segment
+	};
+
+	/// A local TCP relay to a given destination; each accepted connection is relayed through a pair of impaired pipes.
+	class impaired_tcp_relay: public lslboost::enable_shared_from_this<impaired_tcp_relay> {
+	public:
+		impaired_tcp_relay(impaired_network &net, io_service &io, const ip::tcp::endpoint &destination): net_(net), io_(io), destination_(destination),
+			acceptor_(io,ip::tcp::endpoint(loopback(destination.address().is_v4()),0)) {}
+
+		/// The endpoint at which the relay listens.
+		ip::tcp::endpoint local_endpoint() const { return acceptor_.local_endpoint(); }
+
+		/// Start accepting connections.
+		void start() { accept_next(); }
+
+		/// Drop all relayed connections.
+		void disconnect() {
+			for (std::size_t k=0;k<pipes_.size();k++)
+				if (lslboost::shared_ptr<impaired_pipe> p = pipes_[k].lock())
+					p->close();
+			pipes_.clear();
+		}
+
+	private:
+		void accept_next() {
+			tcp_socket_p client(new ip::tcp::socket(io_));
+			acceptor_.async_accept(*client,lslboost::bind(&impaired_tcp_relay::handle_accept,shared_from_this(),client,placeholders::error));
+		}
+
+		void handle_accept(tcp_socket_p client, error_code err) {
+			if (err == error::operation_aborted)
+				return;
+			if (!err) {
+				if (net_.in_outage()) {
+					error_code ec;
+					client->close(ec);
+				} else {
+					tcp_socket_p upstream(new ip::tcp::socket(io_));
+					upstream->async_connect(destination_,lslboost::bind(&impaired_tcp_relay::handle_connect,shared_from_this(),client,upstream,placeholders::error));
+				}
+			}
+			accept_next();
+		}
+
+		void handle_connect(tcp_socket_p client, tcp_socket_p upstream, error_code err) {
+			error_code ec;
+			if (err) {
+				client->close(ec);
+				return;
+			}
+			// the relay shall not add any latency of its own
+			client->set_option(ip::tcp::no_delay(true),ec);
+			upstream->set_option(ip::tcp::no_delay(true),ec);
+			lslboost::shared_ptr<impaired_pipe> out(new impaired_pipe(net_,client,upstream)), in(new impaired_pipe(net_,upstream,client));
+			// forget about connections that have ended
+			std::vector<lslboost::weak_ptr<impaired_pipe> > alive;
+			for (std::size_t k=0;k<pipes_.size();k++)
+				if (!pipes_[k].expired())
+					alive.push_back(pipes_[k]);
+			alive.push_back(out);
+			alive.push_back(in);
+			pipes_.swap(alive);
+			out->start();
+			in->start();
+		}
+
+		impaired_network &net_;					// the network that determines the impairment
+		io_service &io_;						// the IO service of the relay
+		ip::tcp::endpoint destination_;			// the endpoint to which connections are relayed
+		ip::tcp::acceptor acceptor_;			// accepts the connections to be relayed
+		std::vector<lslboost::weak_ptr<impaired_pipe> > pipes_;	// the pipes of the relayed connections
+	};
+
+	/// A local UDP relay to a given destination; replies are relayed back to the respective sender.
+	class impaired_udp_relay: public lslboost::enable_shared_from_this<impaired_udp_relay> {
+	public:
+		impaired_udp_relay(impaired_network &net, io_service &io, const ip::udp::endpoint &destination): net_(net), io_(io), destination_(destination),
+			socket_(new ip::udp::socket(io,ip::udp::endpoint(loopback(destination.address().is_v4()),0))), last_sent_out_(0), last_sent_in_(0) {}
+
+		/// The endpoint at which the relay listens.
+		ip::udp::endpoint local_endpoint() const { return socket_->local_endpoint(); }
+
+		/// Start relaying.
+		void start() { receive_next(); }
+
+	private:
+		void receive_next() {
+			packet_p buf(new std::vector<char>(65536));
+			socket_->async_receive_from(buffer(*buf),sender_,lslboost::bind(&impaired_udp_relay::handle_receive,shared_from_this(),buf,placeholders::error,placeholders::bytes_transferred));
+		}
+
+		void handle_receive(packet_p buf, error_code err, std::size_t len) {
+			if (err == error::operation_aborted)
+				return;
+			if (!err) {
+				// each sender gets its own upstream socket so that the replies can be routed back
+				udp_socket_p &upstream = upstreams_[sender_];
+				if (!upstream) {
+					upstream.reset(new ip::udp::socket(io_));
+					upstream->open(destination_.protocol());
+					receive_upstream(upstream,sender_);
+				}
+				buf->resize(len);
+				forward(upstream,destination_,buf,last_sent_out_);
+			}
+			receive_next();
+		}
+
+		void receive_upstream(udp_socket_p upstream, ip::udp::endpoint client) {
+			packet_p buf(new std::vector<char>(65536));
+			lslboost::shared_ptr<ip::udp::endpoint> from(new ip::udp::endpoint());
+			upstream->async_receive_from(buffer(*buf),*from,lslboost::bind(&impaired_udp_relay::handle_upstream,shared_from_this(),upstream,client,buf,from,placeholders::error,placeholders::bytes_transferred));
+		}
+
+		void handle_upstream(udp_socket_p upstream, ip::udp::endpoint client, packet_p buf, lslboost::shared_ptr<ip::udp::endpoint>, error_code err, std::size_t len) {
+			if (err == error::operation_aborted)
+				return;
+			if (!err) {
+				buf->resize(len);
+				forward(socket_,client,buf,last_sent_in_);
+			}
+			receive_upstream(upstream,client);
+		}
+
+		/// Send a datagram after a random delay (datagrams may overtake each other), unless it is lost.
+		void forward(udp_socket_p sock, const ip::udp::endpoint &to, packet_p buf, double &last_sent) {
+			if (net_.packet_lost())
+				return;
+			double now = lsl_clock(), bw = net_.bandwidth();
+			last_sent = bw > 0 ? std::max(now,last_sent) + buf->size()/bw : now;
+			timer_p timer(new deadline_timer(io_));
+			expire_in(*timer,last_sent + net_.packet_delay(false) - now);
+			timer->async_wait(lslboost::bind(&impaired_udp_relay::send_delayed,shared_from_this(),sock,to,buf,timer,placeholders::error));
+		}
+
+		void send_delayed(udp_socket_p sock, ip::udp::endpoint to, packet_p buf, timer_p, error_code err) {
+			if (!err)
+				sock->async_send_to(buffer(*buf),to,lslboost::bind(&impaired_udp_relay::handle_sent,shared_from_this(),buf,placeholders::error));
+		}
+
+		void handle_sent(packet_p, error_code) { }
+
+		impaired_network &net_;					// the network that determines the impairment
+		io_service &io_;						// the IO service of the relay
+		ip::udp::endpoint destination_;			// the endpoint to which datagrams are relayed
+		udp_socket_p socket_;					// the socket at which the relay listens
+		ip::udp::endpoint sender_;				// the sender of the last received datagram
+		std::map<ip::udp::endpoint,udp_socket_p> upstreams_;	// the upstream sockets, by sender
+		double last_sent_out_, last_sent_in_;	// the times at which the last datagrams have left in either direction (under the bandwidth cap)
+	};
+
+}
+
+/// Construct parameters that impose no impairment.
+impaired_network::params::params(): delay(0), jitter(0), distribution("exponential"), loss(0), retransmission_timeout(0.2),
+	bandwidth(0), disconnect_interval(0), outage_duration(0), seed(1) { }
+
+/// Get the process-wide instance.
+/// The instance is intentionally never destroyed since the relay thread may still use it during process exit.
+impaired_network &impaired_network::get_instance() {
+	static impaired_network *net = new impaired_network();
+	return *net;
+}
+
+/// Construct the instance from the config file.
+impaired_network::impaired_network(): enabled_(false), outage_until_(0), disconnect_timer_(io_) {
+	const api_config *cfg = api_config::get_instance();
+	params p;
+	p.delay = cfg->impairment_delay();
+	p.jitter = cfg->impairment_jitter();
+	p.distribution = cfg->impairment_distribution();
+	p.loss = cfg->impairment_loss();
+	p.retransmission_timeout = cfg->impairment_retransmission_timeout();
+	p.bandwidth = cfg->impairment_bandwidth();
+	p.disconnect_interval = cfg->impairment_disconnect_interval();
+	p.outage_duration = cfg->impairment_outage_duration();
+	p.seed = cfg->impairment_seed();
+	configure(p);
+}
+
+/// Change the impairment.
+void impaired_network::configure(const params &p) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	params_ = p;
+	rng_.seed(p.seed);
+	enabled_ = p.any();
+	if (thread_.joinable())
+		schedule_disconnect();
+}
+
+/// Get the current impairment parameters.
+impaired_network::params impaired_network::get_params() {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	return params_;
+}
+
+/// Get the endpoint through which a TCP destination shall be reached.
+ip::tcp::endpoint impaired_network::route(const ip::tcp::endpoint &destination) {
+	if (!enabled_)
+		return destination;
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	lslboost::shared_ptr<impaired_tcp_relay> &relay = tcp_relays_[destination];
+	if (!relay) {
+		relay.reset(new impaired_tcp_relay(*this,io_,destination));
+		relay->start();
+		ensure_running();
+	}
+	return relay->local_endpoint();
+}
+
+/// Get the endpoint through which a UDP destination shall be reached.
+ip::udp::endpoint impaired_network::route(const ip::udp::endpoint &destination) {
+	if (!enabled_)
+		return destination;
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	lslboost::shared_ptr<impaired_udp_relay> &relay = udp_relays_[destination];
+	if (!relay) {
+		relay.reset(new impaired_udp_relay(*this,io_,destination));
+		relay->start();
+		ensure_running();
+	}
+	return relay->local_endpoint();
+}
+
+/// Drop all relayed TCP connections.
+void impaired_network::disconnect(double outage) {
+	io_.post(lslboost::bind(&impaired_network::do_disconnect,this,outage));
+}
+
+/// Start the relay thread if it is not yet running.
+void impaired_network::ensure_running() {
+	if (thread_.joinable())
+		return;
+	work_.reset(new io_service::work(io_));
+	thread_ = lslboost::thread(lslboost::bind(&io_service::run,&io_));
+	schedule_disconnect();
+}
+
+/// Schedule the next random disconnect, if any.
+void impaired_network::schedule_disconnect() {
+	error_code ec;
+	disconnect_timer_.cancel(ec);
+	if (params_.disconnect_interval > 0) {
+		lslboost::random::exponential_distribution<> interval(1.0/params_.disconnect_interval);
+		expire_in(disconnect_timer_,interval(rng_));
+		disconnect_timer_.async_wait(lslboost::bind(&impaired_network::handle_disconnect_timer,this,placeholders::error));
+	}
+}
+
+/// Handler of the random disconnect timer.
+void impaired_network::handle_disconnect_timer(error_code err) {
+	if (err)
+		return;
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	double outage = params_.outage_duration;
+	outage_until_ = lsl_clock() + outage;
+	for (std::map<ip::tcp::endpoint,lslboost::shared_ptr<impaired_tcp_relay> >::iterator i=tcp_relays_.begin();i!=tcp_relays_.end();i++)
+		i->second->disconnect();
+	schedule_disconnect();
+}
+
+/// Drop all relayed TCP connections (on the relay thread).
+void impaired_network::do_disconnect(double outage) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	outage_until_ = lsl_clock() + outage;
+	for (std::map<ip::tcp::endpoint,lslboost::shared_ptr<impaired_tcp_relay> >::iterator i=tcp_relays_.begin();i!=tcp_relays_.end();i++)
+		i->second->disconnect();
+}
+
+/// Draw the one-way delay of a packet.
+double impaired_network::packet_delay(bool retransmit_if_lost) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	double result = params_.delay;
+	if (params_.jitter > 0) {
+		if (params_.distribution == "normal")
+			result = std::max(0.0,result + lslboost::random::normal_distribution<>(0.0,params_.jitter)(rng_));
+		else if (params_.distribution == "uniform")
+			result += lslboost::random::uniform_real_distribution<>(0.0,2*params_.jitter)(rng_);
+		else
+			result += lslboost::random::exponential_distribution<>(1.0/params_.jitter)(rng_);
+	}
+	if (retransmit_if_lost && params_.loss > 0 && lslboost::random::uniform_real_distribution<>(0.0,1.0)(rng_) < params_.loss)
+		result += params_.retransmission_timeout;
+	return result;
+}
+
+/// Draw whether a packet is lost.
+bool impaired_network::packet_lost() {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	return params_.loss > 0 && lslboost::random::uniform_real_distribution<>(0.0,1.0)(rng_) < params_.loss;
+}
+
+/// Get the bandwidth limit.
+double impaired_network::bandwidth() {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	return params_.bandwidth;
+}
+
+/// Whether new connections are currently refused.
+bool impaired_network::in_outage() {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	return lsl_clock() < outage_until_;
+}
@@ -0,0 +1,129 @@
+#ifndef IMPAIRED_NETWORK_H
+#define IMPAIRED_NETWORK_H
+
+#include <map>
+#include <string>
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/random.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+
+namespace lsl {
+
+	class impaired_tcp_relay;
+	class impaired_udp_relay;
+	class impaired_pipe;
+
+	/**
+	* An in-process emulation of an impaired network, for performance testing without real networks or root access (e.g., for netem).
+	*
+	* When enabled, inlets reach their outlets through local relays that are created on demand for each destination
+	* (see inlet_connection::get_tcp_endpoint() and get_udp_endpoint()). The relays impose a random delay, packet loss,
+	* a bandwidth cap and disconnects on the traffic. This covers the data and info connections (TCP) and the time
+	* probes (UDP), including the reconnects during the recovery of a stream; the datagrams of multicast streams and of
+	* datagram feeds are only subject to the packet loss (see datagram_receiver), and the multicast resolver traffic is
+	* not affected.
+	*
+	* The impairment is configured in the [impairment] section of the config file (so that unmodified applications can
+	* be tested) or programmatically via configure(); it is disabled by default.
+	*/
+	class impaired_network: public lslboost::noncopyable {
+	public:
+		/// The parameters of the impairment.
+		struct params {
+			/// Construct parameters that impose no impairment.
+			params();
+			/// Whether these parameters impose any impairment.
+			bool any() const { return delay > 0 || jitter > 0 || loss > 0 || bandwidth > 0 || disconnect_interval > 0; }
+
+			double delay;					// the base one-way delay, in seconds
+			double jitter;					// the spread of the random extra delay, in seconds (see distribution)
+			std::string distribution;		// the distribution of the extra delay: "exponential" (jitter is the mean), "uniform" (from 0 to 2*jitter) or "normal" (jitter is the standard deviation; the total delay is clamped at 0)
+			double loss;					// the probability that a UDP datagram is lost or that a TCP segment needs to be retransmitted
+			double retransmission_timeout;	// the extra delay of a retransmitted TCP segment, in seconds
+			double bandwidth;				// the throughput limit per connection and direction, in bytes per second (0 = unlimited)
+			double disconnect_interval;		// the mean time between random disconnects of all TCP connections, in seconds (0 = never)
+			double outage_duration;			// the time during which new TCP connections are refused after a disconnect, in seconds
+			unsigned seed;					// the seed of the random number generator
+		};
+
+		/// Get the process-wide instance (initially configured from the config file).
+		static impaired_network &get_instance();
+
+		/// Whether the network is currently impaired.
+		bool enabled() const { return enabled_; }
+
+		/// Change the impairment; this also affects the connections that are already relayed.
+		void configure(const params &p);
+
+		/// Get the current impairment parameters.
+		params get_params();
+
+		/// Get the endpoint through which a TCP destination shall be reached (a relay if the network is impaired).
+		lslboost::asio::ip::tcp::endpoint route(const lslboost::asio::ip::tcp::endpoint &destination);
+
+		/// Get the endpoint through which a UDP destination shall be reached (a relay if the network is impaired).
+		lslboost::asio::ip::udp::endpoint route(const lslboost::asio::ip::udp::endpoint &destination);
+
+		/**
+		* Drop all relayed TCP connections (like a link failure).
+		* @param outage The time during which new connections are refused, in seconds.
+		*/
+		void disconnect(double outage);
+
+	private:
+		friend class impaired_tcp_relay;
+		friend class impaired_udp_relay;
+		friend class impaired_pipe;
+		friend class datagram_receiver;
+
+		/// Construct the instance from the config file.
+		impaired_network();
+
+		/// Start the relay thread if it is not yet running (requires a lock on mut_).
+		void ensure_running();
+
+		/// Schedule the next random disconnect, if any (requires a lock on mut_).
+		void schedule_disconnect();
+
+		/// Handler of the random disconnect timer.
+		void handle_disconnect_timer(lslboost::system::error_code err);
+
+		/// Drop all relayed TCP connections (on the relay thread).
+		void do_disconnect(double outage);
+
+		/// Draw the one-way delay of a packet, including the retransmission timeout if it was lost (TCP only).
+		double packet_delay(bool retransmit_if_lost);
+
+		/// Draw whether a packet is lost.
+		bool packet_lost();
+
+		/// Get the bandwidth limit (0 = unlimited).
+		double bandwidth();
+
+		/// Whether new connections are currently refused.
+		bool in_outage();
+
+		lslboost::mutex mut_;							// protects the parameters, the random number generator and the relays
+		params params_;									// the current parameters
+		lslboost::atomic<bool> enabled_;				// whether any impairment is configured
+		lslboost::random::mt19937 rng_;					// the random number generator
+		double outage_until_;							// the time until which new connections are refused
+		lslboost::asio::io_service io_;					// the IO service of the relays
+		lslboost::scoped_ptr<lslboost::asio::io_service::work> work_;	// keeps the IO service running while there are no relays
+		lslboost::thread thread_;						// the thread that runs the relays
+		lslboost::asio::deadline_timer disconnect_timer_;	// schedules the random disconnects
+		std::map<lslboost::asio::ip::tcp::endpoint,lslboost::shared_ptr<impaired_tcp_relay> > tcp_relays_;	// the TCP relays by destination
+		std::map<lslboost::asio::ip::udp::endpoint,lslboost::shared_ptr<impaired_udp_relay> > udp_relays_;	// the UDP relays by destination
+	};
+
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "info_receiver.h"
 #include "cancellable_streambuf.h"
+#include "mux_connection.h"
 #include <iostream>
 #include <boost/bind.hpp>
 
@@ -8,6 +9,21 @@
 
 using namespace lsl;
 
+namespace {
+	/// Request the full stream_info of the stream through the given (fresh) stream buffer and return the response.
+	template<class StreamBuf> std::string request_fullinfo(StreamBuf &buffer, inlet_connection &conn, const tcp::endpoint &endpoint) {
+		buffer.register_at(&conn);
+		std::iostream server_stream(&buffer);
+		// connect...
+		buffer.connect(endpoint);
+		// send the query
+		server_stream << "LSL:fullinfo\r\n" << std::flush;
+		// receive the response
+		std::ostringstream os; os << server_stream.rdbuf();
+		return os.str();
+	}
+}
+
 /// Construct a new info receiver.
 info_receiver::info_receiver(inlet_connection &conn): conn_(conn) {
 	conn_.register_onlost(this,&fullinfo_upd_);
@@ -53,18 +69,17 @@ void info_receiver::info_thread() {
 	try {
 		while (!conn_.lost() && !conn_.shutdown()) {
 			try {
-				// make a new stream buffer & stream
-				lslboost::asio::cancellable_streambuf<tcp> buffer;
-				buffer.register_at(&conn_);
-				std::iostream server_stream(&buffer);
-				// connect...
-				buffer.connect(conn_.get_tcp_endpoint());
-				// send the query
-				server_stream << "LSL:fullinfo\r\n" << std::flush;
-				// receive and parse the response
-				std::ostringstream os; os << server_stream.rdbuf();
+				// make a new stream buffer (on the multiplexed session if there is one), send the query and receive the response
+				std::string msg;
+				tcp::endpoint mux_endpoint;
+				if (conn_.get_mux_endpoint(mux_endpoint)) {
+					mux_streambuf buffer(conn_.current_uid());
+					msg = request_fullinfo(buffer,conn_,mux_endpoint);
+				} else {
+					lslboost::asio::cancellable_streambuf<tcp> buffer;
+					msg = request_fullinfo(buffer,conn_,conn_.get_tcp_endpoint());
+				}
 				stream_info_impl info;
-				std::string msg = os.str();
 				info.from_fullinfo_message(msg);
 				// if this is not a valid streaminfo we retry
 				if (!info.created_at())
@@ -3,6 +3,7 @@
 #include <boost/lexical_cast.hpp>
 #include "inlet_connection.h"
 #include "api_config.h"
+#include "impaired_network.h"
 
 
 // === implementation of the inlet_connection class ===
@@ -19,7 +20,7 @@ using namespace lslboost::asio;
 * @param recover Try to silently recover lost streams that are recoverable (=those that that have a source_id set).
 *				 In all other cases (recover is false or the stream is not recoverable) a lost_error is thrown where indicated if the stream's source is lost (e.g., due to an app or computer crash).
 */
-inlet_connection::inlet_connection(const stream_info_impl &info, bool recover): type_info_(info), host_info_(info), recovery_enabled_(recover), tcp_protocol_(tcp::v4()), udp_protocol_(udp::v4()), lost_(false), shutdown_(false), last_receive_time_(lsl_clock()), active_transmissions_(0) {
+inlet_connection::inlet_connection(const stream_info_impl &info, bool recover): type_info_(info), host_info_(info), recovery_enabled_(recover), tcp_protocol_(tcp::v4()), udp_protocol_(udp::v4()), lost_(false), watchdog_timer_(0), shutdown_(false), last_receive_time_(lsl_clock()), last_immediate_reconnect_(0.0), active_transmissions_(0) {
 	// if the given stream_info is already fully resolved...
 	if (!host_info_.v4address().empty() || !host_info_.v6address().empty()) {
 
@@ -78,10 +79,10 @@ inlet_connection::inlet_connection(const stream_info_impl &info, bool recover):
 	}	
 }
 
-/// Engage the connection and its recovery watchdog thread.
+/// Engage the connection and its recovery watchdog.
 void inlet_connection::engage() {
 	if (recovery_enabled_)
-		watchdog_thread_ = lslboost::thread(&inlet_connection::watchdog_thread,this);
+		schedule_watchdog();
 }
 
 /// Disengage the connection and all its resolver capabilities (including the watchdog).
@@ -92,32 +93,70 @@ void inlet_connection::disengage() {
 		shutdown_ = true;
 	}
 	shutdown_cond_.notify_all();
+	// stop the watchdog (waits for an ongoing check to finish)
+	timer_wheel::timer_id watchdog_timer;
+	{
+		lslboost::lock_guard<lslboost::mutex> lock(watchdog_mut_);
+		watchdog_timer = watchdog_timer_;
+	}
+	if (watchdog_timer)
+		timer_wheel::get_instance().cancel(watchdog_timer);
 	// cancel all operations (resolver, streams, ...)
 	resolver_.cancel();
 	cancel_and_shutdown();
-	// and wait for the watchdog to finish
-	if (recovery_enabled_)
-		watchdog_thread_.join();
+	// and wait for any speculative recovery to finish
+	lslboost::lock_guard<lslboost::mutex> lock(watchdog_mut_);
+	if (recovery_thread_.joinable())
+		recovery_thread_.join();
 }
 
 
 // === external accessors for connection properties ===
 
 // get the TCP endpoint from the info (according to our configured protocol)
+// (if the network is impaired for testing, this is the endpoint of a local relay to the outlet)
 tcp::endpoint inlet_connection::get_tcp_endpoint() {
 	lslboost::shared_lock<lslboost::shared_mutex> lock(host_info_mut_);
-	
+	return make_tcp_endpoint(host_info_.v4data_port(),host_info_.v6data_port());
+}
+
+// get the TCP endpoint of the multiplexed sessions of the stream's process (according to our configured protocol)
+// returns false if multiplexing is disabled or the outlet's process does not accept multiplexed sessions
+bool inlet_connection::get_mux_endpoint(tcp::endpoint &endpoint) {
+	if (!api_config::get_instance()->multiplex_sessions())
+		return false;
+	lslboost::shared_lock<lslboost::shared_mutex> lock(host_info_mut_);
+	if (!(tcp_protocol_ == tcp::v4() ? host_info_.v4mux_port() : host_info_.v6mux_port()))
+		return false;
+	endpoint = make_tcp_endpoint(host_info_.v4mux_port(),host_info_.v6mux_port());
+	return true;
+}
+
+// get the multicast group and port to which the stream's data is published
+// returns false if the outlet does not publish its data to a multicast group or we do not use IPv4
+bool inlet_connection::get_multicast_endpoint(udp::endpoint &endpoint) {
+	if (tcp_protocol_ != tcp::v4() || api_config::get_instance()->use_protocol_version() < 110)
+		return false;
+	lslboost::shared_lock<lslboost::shared_mutex> lock(host_info_mut_);
+	if (!host_info_.v4multicast_port())
+		return false;
+	endpoint = udp::endpoint(ip::address::from_string(host_info_.v4multicast_address()),(unsigned short)host_info_.v4multicast_port());
+	return true;
+}
+
+// make a TCP endpoint at the host's address and the given port (according to our configured protocol; requires a lock on host_info_mut_)
+tcp::endpoint inlet_connection::make_tcp_endpoint(int v4port, int v6port) {
 	if(tcp_protocol_ == tcp::v4()) {
         std::string address = host_info_.v4address();
-        unsigned short port = host_info_.v4data_port();
-        return tcp::endpoint(ip::address::from_string(address), port);
+        unsigned short port = v4port;
+        return impaired_network::get_instance().route(tcp::endpoint(ip::address::from_string(address), port));
         
     //This more complicated procedure is required when the address is an ipv6 link-local address.
     //Simplified from https://stackoverflow.com/questions/10286042/using-lslboost-to-accept-on-ipv6-link-scope-address
 	//It does not hurt when the address is not link-local.
 	} else {
         std::string address = host_info_.v6address();
-        std::string port = lslboost::lexical_cast<std::string>(host_info_.v6data_port());
+        std::string port = lslboost::lexical_cast<std::string>(v6port);
 
         io_service io; 
         ip::tcp::resolver resolver(io);
@@ -129,25 +168,26 @@ tcp::endpoint inlet_connection::get_tcp_endpoint() {
             throw lost_error("Unable to resolve tcp stream at address: " + address + ", port: " + port);
         }
         //assuming first (typically only) element in list is valid.
-        return *it;
+        return impaired_network::get_instance().route(it->endpoint());
     }
 }
 
 // get the UDP endpoint from the info (according to our configured protocol)
+// (if the network is impaired for testing, this is the endpoint of a local relay to the outlet)
 udp::endpoint inlet_connection::get_udp_endpoint() {
 	lslboost::shared_lock<lslboost::shared_mutex> lock(host_info_mut_);
 	
 	if(udp_protocol_ == udp::v4()) {
         std::string address = host_info_.v4address();
-        unsigned short port = host_info_.v4data_port();
-        return udp::endpoint(ip::address::from_string(address), port);
+        unsigned short port = host_info_.v4service_port();
+        return impaired_network::get_instance().route(udp::endpoint(ip::address::from_string(address), port));
         
     //This more complicated procedure is required when the address is an ipv6 link-local address.
     //Simplified from https://stackoverflow.com/questions/10286042/using-lslboost-to-accept-on-ipv6-link-scope-address
 	//It does not hurt when the address is not link-local.
 	} else {
         std::string address = host_info_.v6address();
-        std::string port = lslboost::lexical_cast<std::string>(host_info_.v6data_port());
+        std::string port = lslboost::lexical_cast<std::string>(host_info_.v6service_port());
 
         io_service io; 
         ip::udp::resolver resolver(io);
@@ -159,7 +199,7 @@ udp::endpoint inlet_connection::get_udp_endpoint() {
              throw lost_error("Unable to resolve udp stream at address: " + address + ", port: " + port);
         }
         //assuming first (typically only) element in list is valid.
-        return *it;
+        return impaired_network::get_instance().route(it->endpoint());
     }
 }
 
@@ -185,16 +225,18 @@ double inlet_connection::current_srate() {
 // === connection recovery logic ===
 
 /// Performs the actual work of attempting a recovery.
-void inlet_connection::try_recover() {
+/// The recovery proceeds in two stages: first the last known host of the stream is re-probed directly
+/// (which finds a restarted source within a few ms), and only if that fails a network-wide resolve is issued.
+bool inlet_connection::try_recover() {
 	if (recovery_enabled_) {
 		try {
 			lslboost::lock_guard<lslboost::mutex> lock(recovery_mut_);
+			const api_config *cfg = api_config::get_instance();
 			// first create the query string based on the known stream information
 			std::ostringstream query; 
 			{
 				lslboost::shared_lock<lslboost::shared_mutex> lock(host_info_mut_);
 				// construct query according to the fields that are present in the stream_info
-				const char *channel_format_strings[] = {"undefined","float32","double64","string","int32","int16","int8","int64"};
 				query << "channel_count='" << lslboost::lexical_cast<std::string>(host_info_.channel_count()) << "'";
 				if (!host_info_.name().empty())
 					query << " and name='" << host_info_.name() << "'";
@@ -206,73 +248,127 @@ void inlet_connection::try_recover() {
 					query << " and source_id='" << host_info_.source_id() << "'";					
 				query << " and channel_format='" << channel_format_strings[host_info_.channel_format()] << "'";
 			}
-			// attempt a recovery
+			// stage 1: re-probe the last known host directly with a tight timeout
+			if (cfg->recovery_probe_timeout() > 0) {
+				switch (apply_recovery_results(resolver_.resolve_direct(query.str(),last_known_endpoints(),1,cfg->recovery_probe_timeout()))) {
+					case recovery_rehosted: return true;
+					case recovery_unchanged: {
+						// the host still serves the stream: reconnect right away, but only once until data flows again,
+						// since a host whose service port answers while its data port fails would otherwise be hammered
+						lslboost::lock_guard<lslboost::mutex> lock(client_status_mut_);
+						if (last_immediate_reconnect_ > last_receive_time_)
+							return false;
+						last_immediate_reconnect_ = lsl_clock();
+						return true;
+					}
+					default: break; // not found or ambiguous: fall back to a network-wide resolve
+				}
+			}
+			// stage 2: attempt a network-wide recovery
 			for (int attempt=0;;attempt++) {
 				// issue the resolve (blocks until it is either cancelled or got at least one matching streaminfo and has waited for a certain timeout)
-				std::vector<stream_info_impl> infos = resolver_.resolve_oneshot(query.str(),1,FOREVER,attempt==0 ? 1.0 : 5.0);
-				if (!infos.empty()) {
-					// got a result
-					lslboost::unique_lock<lslboost::shared_mutex> lock(host_info_mut_);
-					// check if any of the returned streams is the one that we're currently connected to
-					for (unsigned k=0;k<infos.size();k++)
-						if (infos[k].uid() == host_info_.uid())
-							return; // in this case there is no need to recover (we're still fine)
-					// otherwise our stream is gone and we indeed need to recover:
-					// ensure that the query result is unique (since someone might have used a non-unique stream ID)
-					if (infos.size() == 1) {
-						// update the endpoint
-						host_info_ = infos[0];
-						// cancel all cancellable operations registered with this connection
-						cancel_all_registered();
-						// invoke any callbacks associated with a connection recovery
-						lslboost::lock_guard<lslboost::mutex> lock(onrecover_mut_);
-						for(std::map<void*,lslboost::function<void()> >::iterator i=onrecover_.begin(),e=onrecover_.end();i!=e;i++)
-							(i->second)();
-					} else {
-						// there are multiple possible streams to connect to in a recovery attempt: we warn and re-try
-						// this is because we don't want to randomly connect to the wrong source without the user knowing about it;
-						// the correct action (if this stream shall indeed have multiple instances) is to change the user code and 
-						// make its source_id unique, or remove the source_id altogether if that's not possible (therefore disabling the ability to recover)
-						std::clog << "Found multiple streams with name='" << host_info_.name() << "' and source_id='" << host_info_.source_id() << "'. Cannot recover unless all but one are closed." << std::endl;
-						continue;
-					}
-				} else {
-					// cancelled
+				std::vector<stream_info_impl> infos = resolver_.resolve_oneshot(query.str(),1,FOREVER,attempt==0 ? cfg->recovery_resolve_time() : cfg->recovery_retry_time());
+				switch (apply_recovery_results(infos)) {
+					case recovery_rehosted: return true;
+					case recovery_ambiguous: continue;
+					default: return false; // unchanged or cancelled
 				}
-				break;
 			}
 		} catch(std::exception &e) {
 			std::cerr << "A recovery attempt encountered an unexpected error: " << e.what() << std::endl;
 		}
 	}
+	return false;
 }
 
-/// A thread that periodically re-resolves the stream and checks if it has changed its location
-void inlet_connection::watchdog_thread() {
-	while(!lost_ && !shutdown_) {
+/// Apply the results of a recovery resolve.
+int inlet_connection::apply_recovery_results(const std::vector<stream_info_impl> &infos) {
+	if (infos.empty())
+		return recovery_notfound; // cancelled or timed out
+	lslboost::unique_lock<lslboost::shared_mutex> lock(host_info_mut_);
+	// check if any of the returned streams is the one that we're currently connected to
+	for (unsigned k=0;k<infos.size();k++)
+		if (infos[k].uid() == host_info_.uid())
+			return recovery_unchanged; // in this case there is no need to recover (we're still fine)
+	// otherwise our stream is gone and we indeed need to recover:
+	// ensure that the query result is unique (since someone might have used a non-unique stream ID)
+	if (infos.size() == 1) {
+		// update the endpoint
+		host_info_ = infos[0];
+		// cancel all cancellable operations registered with this connection
+		cancel_all_registered();
+		// invoke any callbacks associated with a connection recovery
+		lslboost::lock_guard<lslboost::mutex> lock(onrecover_mut_);
+		for(std::map<void*,lslboost::function<void()> >::iterator i=onrecover_.begin(),e=onrecover_.end();i!=e;i++)
+			(i->second)();
+		return recovery_rehosted;
+	} else {
+		// there are multiple possible streams to connect to in a recovery attempt: we warn and re-try
+		// this is because we don't want to randomly connect to the wrong source without the user knowing about it;
+		// the correct action (if this stream shall indeed have multiple instances) is to change the user code and 
+		// make its source_id unique, or remove the source_id altogether if that's not possible (therefore disabling the ability to recover)
+		std::clog << "Found multiple streams with name='" << host_info_.name() << "' and source_id='" << host_info_.source_id() << "'. Cannot recover unless all but one are closed." << std::endl;
+		return recovery_ambiguous;
+	}
+}
+
+/// Get the UDP service endpoints at which the stream was last seen.
+/// This is the last service port on each known address, followed by the rest of the configured port range
+/// (where a restarted outlet on the same host would most likely bind to).
+std::vector<udp::endpoint> inlet_connection::last_known_endpoints() {
+	const api_config *cfg = api_config::get_instance();
+	std::vector<udp::endpoint> result;
+	lslboost::shared_lock<lslboost::shared_mutex> lock(host_info_mut_);
+	const std::string addrs[2] = {host_info_.v4address(), host_info_.v6address()};
+	const int ports[2] = {host_info_.v4service_port(), host_info_.v6service_port()};
+	for (int k=0;k<2;k++) {
+		if (addrs[k].empty())
+			continue;
 		try {
-			// we only try to recover if a) there are active transmissions and b) we haven't seen new data for some time
-			{
-				lslboost::unique_lock<lslboost::mutex> lock(client_status_mut_);
-				if ((active_transmissions_ > 0) && (lsl_clock() - last_receive_time_ > api_config::get_instance()->watchdog_time_threshold())) {
-					lock.unlock();
-					try_recover();
-				}
-			}
-			// instead of sleeping we're waiting on a condition variable for the sleep duration 
-			// so that the watchdog can be cancelled conveniently
-			{
-				lslboost::unique_lock<lslboost::mutex> lock(shutdown_mut_);
-				shutdown_cond_.wait_for(lock,lslboost::chrono::duration<double>(api_config::get_instance()->watchdog_check_interval()), lslboost::bind(&inlet_connection::shutdown,this));
-			}
-		} catch(std::exception &e) {
-			std::cerr << "Unexpected hiccup in the watchdog thread: " << e.what() << std::endl;
+			ip::address addr = ip::address::from_string(addrs[k]);
+			if (ports[k])
+				result.push_back(udp::endpoint(addr,(unsigned short)ports[k]));
+			for (int p=cfg->base_port(); p<cfg->base_port()+cfg->port_range(); p++)
+				if (p != ports[k])
+					result.push_back(udp::endpoint(addr,(unsigned short)p));
+		} catch(std::exception &) { }
+	}
+	return result;
+}
+
+/// Periodically checks whether the stream needs to be re-resolved because it may have changed its location.
+void inlet_connection::watchdog_check() {
+	try {
+		// we only try to recover if a) there are active transmissions and b) we haven't seen new data for some time
+		bool stalled;
+		{
+			lslboost::lock_guard<lslboost::mutex> lock(client_status_mut_);
+			stalled = (active_transmissions_ > 0) && (lsl_clock() - last_receive_time_ > api_config::get_instance()->watchdog_time_threshold());
+		}
+		lslboost::lock_guard<lslboost::mutex> lock(watchdog_mut_);
+		if (stalled && !shutdown_) {
+			// the resolve blocks for a while, so it is done on a separate thread (unless one is still underway)
+			if (!recovery_thread_.joinable() || recovery_thread_.try_join_for(lslboost::chrono::milliseconds(0)))
+				recovery_thread_ = lslboost::thread(&inlet_connection::try_recover,this);
 		}
+	} catch(std::exception &e) {
+		std::cerr << "Unexpected hiccup in the watchdog: " << e.what() << std::endl;
 	}
+	schedule_watchdog();
+}
+
+/// Schedule the next watchdog check.
+void inlet_connection::schedule_watchdog() {
+	lslboost::lock_guard<lslboost::mutex> lock(watchdog_mut_);
+	if (!lost_ && !shutdown_)
+		watchdog_timer_ = timer_wheel::get_instance().schedule(api_config::get_instance()->watchdog_check_interval(),lslboost::bind(&inlet_connection::watchdog_check,this));
+	else
+		watchdog_timer_ = 0;
 }
 
 /// Issue a recovery attempt if a connection loss was detected.
-void inlet_connection::try_recover_from_error() {
+/// Returns whether the caller may reconnect immediately (the stream was found at a new endpoint or still answers at its last known host).
+bool inlet_connection::try_recover_from_error() {
 	if (!shutdown_) {
 		if (!recovery_enabled_) {
 			// if the stream is irrecoverable it is now lost, 
@@ -287,8 +383,9 @@ void inlet_connection::try_recover_from_error() {
 			}
 			throw lost_error("The stream read by this inlet has been lost. To recover, you need to re-resolve the source and re-create the inlet.");
 		} else
-			try_recover();
+			return try_recover();
 	}
+	return false;
 }
 
 
@@ -312,6 +409,12 @@ void inlet_connection::update_receive_time(double t) {
 	last_receive_time_ = t;
 }
 
+/// Wait for the given number of seconds, unless the connection is shut down in the meantime.
+void inlet_connection::wait_unless_shutdown(double seconds) {
+	lslboost::unique_lock<lslboost::mutex> lock(shutdown_mut_);
+	shutdown_cond_.wait_for(lock,lslboost::chrono::duration<double>(seconds), lslboost::bind(&inlet_connection::shutdown,this));
+}
+
 /// Register a condition variable that should be notified when a connection is lost
 void inlet_connection::register_onlost(void *id, lslboost::condition_variable *cond) {
 	lslboost::lock_guard<lslboost::mutex> lock(client_status_mut_);
@@ -9,6 +9,7 @@
 #include "common.h"
 #include "resolver_impl.h"
 #include "cancellation.h"
+#include "timer_wheel.h"
 
 
 using lslboost::asio::ip::tcp;
@@ -23,7 +24,7 @@ namespace lsl {
 	* When a client of the connection (one of the other inlet components) experiences a connection loss it invokes the 
 	* function try_recover_from_error() which attempts to update the endpoint to a valid state (possible once the stream is back online). 
 	* Since in some cases a client might not be able to detect a connection loss and so would stall forever, the inlet_connection 
-	* maintains a watchdog thread that periodically checks and recovers the connection state. Internally the recovery works by 
+	* maintains a watchdog (driven by the process-wide timer wheel) that periodically checks and recovers the connection state. Internally the recovery works by 
 	* using the resolver to find the desired stream on the network again and updating the endpoint information if it has changed.
 	*/
 	class inlet_connection: public cancellable_registry {
@@ -37,7 +38,7 @@ namespace lsl {
 		*/
 		inlet_connection(const stream_info_impl &info, bool recover=true);
 
-		/// Prepare the connection and its auto-recovery thread.
+		/// Prepare the connection and its auto-recovery watchdog.
 		/// This is called once by the inlet after all other initialization.
 		void engage();
 
@@ -51,6 +52,12 @@ namespace lsl {
 
 		/// Get the current TCP endpoint from the info (according to our configured protocol).
 		tcp::endpoint get_tcp_endpoint();
+		/// Get the current TCP endpoint of the multiplexed sessions of the stream's process (according to our configured protocol).
+		/// Returns false if multiplexing is disabled or the outlet's process does not accept multiplexed sessions.
+		bool get_mux_endpoint(tcp::endpoint &endpoint);
+		/// Get the multicast group and port to which the stream's data is published (see multicast_publisher).
+		/// Returns false if the outlet does not publish its data to a multicast group or we do not use IPv4.
+		bool get_multicast_endpoint(udp::endpoint &endpoint);
 		/// Get the current UDP endpoint from the info (according to our configured protocol).
 		udp::endpoint get_udp_endpoint();
 		/// Get the current hostname from the info.
@@ -77,7 +84,8 @@ namespace lsl {
 		/// This either blocks until it succeeds or declares the connection as lost (if recovery is disabled),
 		/// and throws a lost error. Only call this when the connection is found to have broken down
 		/// (e.g., socket error).
-		void try_recover_from_error();
+		/// @return Whether the caller may reconnect immediately (the stream was found at a new endpoint or still answers at its last known host).
+		bool try_recover_from_error();
 
 
 		// === client status info ===
@@ -95,6 +103,10 @@ namespace lsl {
 		/// try to recover the connection.
 		void update_receive_time(double t);
 
+		/// Wait for the given number of seconds, unless the connection is shut down in the meantime.
+		/// Used to pace reconnect attempts without delaying the shutdown of the inlet.
+		void wait_unless_shutdown(double seconds);
+
 		/// Register a condition variable that should be notified when a connection is lost
 		void register_onlost(void *id, lslboost::condition_variable *cond);
 
@@ -123,11 +135,30 @@ namespace lsl {
 
 
 	private:
-        /// A thread that periodically checks whether the connection should be recovered.
-        void watchdog_thread();
+		/// Make a TCP endpoint at the host's address and the given port (according to our configured protocol; requires a lock on host_info_mut_).
+		tcp::endpoint make_tcp_endpoint(int v4port, int v6port);
+
+		/// A timer handler that periodically checks whether the connection should be recovered.
+		/// This runs on the timer wheel thread and hands any actual recovery work off to a recovery thread.
+		void watchdog_check();
+
+		/// Schedule the next watchdog check (unless we're shutting down).
+		void schedule_watchdog();
+
+		/// A (potentially speculative) resolve-and-recover operation.
+		/// Returns whether the stream can be reconnected to right away (found at a new endpoint, or its last known host still serves it
+		/// and no immediate reconnect to it has been made since data was last received).
+		bool try_recover();
 
-        /// A (potentially speculative) resolve-and-recover operation.
-        void try_recover();
+		/// Apply the results of a recovery resolve (requires a lock on recovery_mut_).
+		/// Returns recovery_rehosted, recovery_unchanged, recovery_ambiguous or recovery_notfound.
+		int apply_recovery_results(const std::vector<stream_info_impl> &infos);
+
+		/// Get the UDP service endpoints at which the stream was last seen (for the direct recovery probe).
+		std::vector<udp::endpoint> last_known_endpoints();
+
+		/// Possible outcomes of apply_recovery_results().
+		enum { recovery_notfound, recovery_unchanged, recovery_rehosted, recovery_ambiguous };
 
 		// core connection properties
 		const stream_info_impl type_info_;			// static/read-only information of the stream (type & format)
@@ -138,8 +169,10 @@ namespace lsl {
 		bool recovery_enabled_;						// whether we would try to recover the stream if it is lost
 		bool lost_;									// whether the stream is irrecoverably lost (set by try_recover_from_error if recovery is disabled)
 
-		// internal watchdog thread (to detect dead connections)
-		lslboost::thread watchdog_thread_;				// re-resolves the current connection speculatively
+		// internal watchdog (to detect dead connections)
+		timer_wheel::timer_id watchdog_timer_;			// the currently scheduled watchdog check, if any
+		lslboost::mutex watchdog_mut_;					// protects the watchdog timer and recovery thread
+		lslboost::thread recovery_thread_;				// re-resolves the current connection speculatively when the watchdog fires
 
 		// things related to the shutdown condition
 		bool shutdown_;								// indicates to threads that we're shutting down
@@ -149,11 +182,12 @@ namespace lsl {
 		// things related to recovery
 		resolver_impl resolver_;					// our resolver, in case we need it
 		lslboost::mutex recovery_mut_;					// we allow only one recovery operation at a time
-        
+
 		// client status info for recovery & notification purposes
 		std::map<void*,lslboost::condition_variable*> onlost_;		// a group of condition variables that should be notified when the connection is lost 
 		std::map<void*,lslboost::function<void()> > onrecover_;	// a group of callback functions that should be invoked once the connection has been recovered
 		double last_receive_time_;					// the last time when we received data from the server
+		double last_immediate_reconnect_;			// the last time when a recovery allowed an immediate reconnect to an unchanged host
 		int active_transmissions_;					// the number of currently active transmissions (data or info)
 		lslboost::mutex client_status_mut_;			// protects the client status info
 		lslboost::mutex onrecover_mut_;				// protects the onrecover callback map
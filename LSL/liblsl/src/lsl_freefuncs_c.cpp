@@ -1,7 +1,7 @@
 #include "../include/lsl_c.h"
 #include "common.h"
 #include "resolver_impl.h"
-#include <boost/chrono/system_clocks.hpp>
+#include "trace.h"
 
 
 // === Implementation of the free-standing functions in lsl_c.h ===
@@ -29,7 +29,7 @@ LIBLSL_C_API int lsl_library_version() { return LSL_LIBRARY_VERSION; }
 * when a sample was actually captured.
 */
 LIBLSL_C_API double lsl_local_clock() { 
-	return lslboost::chrono::nanoseconds(lslboost::chrono::high_resolution_clock::now().time_since_epoch()).count()/1000000000.0; 
+	return lsl_clock(); 
 } 
 
 /**
@@ -146,3 +146,18 @@ LIBLSL_C_API void lsl_destroy_string(char *s) {
 	if (s)
 		free(s);
 }
+
+/**
+* Write the events recorded by the sample-path tracing into a file in the Chrome trace (JSON) format.
+*/
+LIBLSL_C_API int lsl_write_trace(const char *filename) {
+	if (!filename)
+		return lsl_argument_error;
+	try {
+		write_trace(filename);
+		return lsl_no_error;
+	} catch(std::exception &e) {
+		std::cerr << "Error during write_trace: " << e.what() << std::endl;
+		return lsl_internal_error;
+	}
+}
@@ -187,6 +187,113 @@ LIBLSL_C_API int lsl_set_postprocessing(lsl_inlet in, unsigned flags) {
 	}
 }
 
+/**
+* Enable or disable lossless transmission.
+*/
+LIBLSL_C_API int lsl_set_lossless(lsl_inlet in, int lossless) {
+	try {
+		((stream_inlet_impl*)in)->set_lossless(lossless != 0);
+		return lsl_no_error;
+	}
+	catch(std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+/**
+* Enable or disable the repair of lost datagrams on a multicast stream.
+*/
+LIBLSL_C_API int lsl_set_multicast_repair(lsl_inlet in, int repair) {
+	try {
+		((stream_inlet_impl*)in)->set_multicast_repair(repair != 0);
+		return lsl_no_error;
+	}
+	catch(std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+/**
+* Enable or disable the datagram transport for the inlet.
+*/
+LIBLSL_C_API int lsl_set_datagram_transport(lsl_inlet in, int datagrams) {
+	try {
+		((stream_inlet_impl*)in)->set_datagram_transport(datagrams != 0);
+		return lsl_no_error;
+	}
+	catch(std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+/**
+* Keep only the most recent samples in the inlet's buffer.
+*/
+LIBLSL_C_API int lsl_set_latest_only(lsl_inlet in, unsigned num_samples) {
+	try {
+		((stream_inlet_impl*)in)->set_latest_only(num_samples);
+		return lsl_no_error;
+	}
+	catch(std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+/**
+* Set a callback that is invoked with each chunk of samples as it arrives (or clear it).
+*/
+LIBLSL_C_API int lsl_set_chunk_callback(lsl_inlet in, lsl_channel_format_t format, lsl_chunk_callback callback, void *user_data) {
+	try {
+		((stream_inlet_impl*)in)->set_chunk_callback(format,callback,user_data);
+		return lsl_no_error;
+	}
+	catch(std::invalid_argument &) {
+		return lsl_argument_error;
+	}
+	catch(std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+/**
+* Get a file descriptor that becomes readable when samples arrive at the inlet.
+*/
+LIBLSL_C_API int lsl_get_inlet_fd(lsl_inlet in, int *ec) {
+	if (ec)
+		*ec = lsl_no_error;
+	try {
+		return ((stream_inlet_impl*)in)->wakeup_descriptor();
+	}
+	catch(std::exception &e) {
+		std::cerr << "Could not create a descriptor for the inlet: " << e.what() << std::endl;
+		if (ec)
+			*ec = lsl_internal_error;
+		return -1;
+	}
+}
+
+/**
+* Wait until any of the given inlets has samples available (or has lost its stream).
+*/
+LIBLSL_C_API int lsl_wait_any(lsl_inlet *inlets, int num_inlets, double timeout, int *ec) {
+	if (ec)
+		*ec = lsl_no_error;
+	if ((!inlets && num_inlets) || num_inlets < 0) {
+		if (ec)
+			*ec = lsl_argument_error;
+		return -1;
+	}
+	try {
+		return stream_inlet_impl::wait_any((stream_inlet_impl**)inlets,num_inlets,timeout);
+	}
+	catch(std::exception &e) {
+		std::cerr << "Unexpected error while waiting for inlets: " << e.what() << std::endl;
+		if (ec)
+			*ec = lsl_internal_error;
+		return -1;
+	}
+}
+
 
 /* === Pulling a sample from the inlet === */
 
@@ -771,6 +878,42 @@ LIBLSL_C_API unsigned long lsl_pull_chunk_buf(lsl_inlet in, char **data_buffer,
 	return 0;
 }
 
+/**
+* Borrow a chunk of samples from the inlet without copying their values.
+*/
+LIBLSL_C_API unsigned long lsl_borrow_chunk(lsl_inlet in, lsl_channel_format_t format, unsigned long max_samples, const void * const **data, const double **timestamps, double timeout, int *ec) {
+	if (ec)
+		*ec = lsl_no_error;
+	try {
+		return (unsigned long)((stream_inlet_impl*)in)->borrow_chunk((channel_format_t)format,(std::size_t)max_samples,data,timestamps,timeout);
+	}
+	catch(lost_error &) { 
+		if (ec)
+			*ec = lsl_lost_error; 
+	}
+	catch(std::invalid_argument &) { 
+		if (ec)
+			*ec = lsl_argument_error; 
+	}
+	catch(std::exception &) { 
+		if (ec)
+			*ec = lsl_internal_error; 
+	}
+	return 0;
+}
+
+/**
+* Release the samples of the chunk that was most recently borrowed from the inlet.
+*/
+LIBLSL_C_API void lsl_release_chunk(lsl_inlet in) {
+	try {
+		((stream_inlet_impl*)in)->release_chunk();
+	}
+	catch(std::exception &e) {
+		std::cerr << "Unexpected error in lsl_release_chunk: " << e.what() << std::endl;
+	}
+}
+
 /**
 * Query the number of samples that are currently available for immediate pickup.
 */
@@ -810,3 +953,18 @@ LIBLSL_C_API int lsl_smoothing_halftime(lsl_inlet in, float value) {
 		return lsl_internal_error;
 	}
 }
+
+/**
+* Retrieve runtime transport statistics of the inlet.
+*/
+LIBLSL_C_API int lsl_get_inlet_stats(lsl_inlet in, lsl_inlet_stats *stats) {
+	if (!stats)
+		return lsl_argument_error;
+	try {
+		((stream_inlet_impl*)in)->get_stats(*stats);
+		return lsl_no_error;
+	}
+	catch(std::exception &) {
+		return lsl_internal_error;
+	}
+}
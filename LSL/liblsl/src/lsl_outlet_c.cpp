@@ -19,6 +19,17 @@ LIBLSL_C_API lsl_outlet lsl_create_outlet(lsl_streaminfo info, int chunk_size, i
 	}
 }
 
+LIBLSL_C_API lsl_outlet lsl_create_outlet_ex(lsl_streaminfo info, int chunk_size, int max_buffered, lsl_transport_options_t flags) { 
+	try {
+		stream_info_impl *infoimpl = (stream_info_impl*)info;
+		lsl_outlet result = (lsl_outlet)new stream_outlet_impl(*infoimpl, chunk_size, infoimpl->nominal_srate()?(int)(infoimpl->nominal_srate()*max_buffered):max_buffered*100, clock_fn(), flags);
+		return result;
+	} catch(std::exception &e) {
+		std::cerr << "Unexpected error during construction of stream outlet: " << e.what() << std::endl;
+		return NULL;
+	}
+}
+
 LIBLSL_C_API void lsl_destroy_outlet(lsl_outlet out) { 
 	try {
 		delete (stream_outlet_impl*)out; 
@@ -1368,6 +1379,51 @@ LIBLSL_C_API int lsl_push_chunk_buftnp(lsl_outlet out, char **data, unsigned *le
 	}
 }
 
+LIBLSL_C_API int lsl_outlet_reserve(lsl_outlet out, unsigned long num_samples, lsl_channel_format_t format, void **buffers) {
+	try {
+		((stream_outlet_impl*)out)->reserve((std::size_t)num_samples,(channel_format_t)format,buffers);
+		return lsl_no_error;
+	}
+	catch(std::logic_error &e) {
+		std::cerr << "Error during lsl_outlet_reserve: " << e.what() << std::endl;
+		return lsl_argument_error;
+	}
+	catch(std::exception &e) {
+		std::cerr << "Unexpected error during lsl_outlet_reserve: " << e.what() << std::endl;
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int lsl_outlet_commit(lsl_outlet out, unsigned long num_samples, double timestamp, int pushthrough) {
+	try {
+		((stream_outlet_impl*)out)->commit((std::size_t)num_samples,timestamp,pushthrough!=0);
+		return lsl_no_error;
+	}
+	catch(std::logic_error &e) {
+		std::cerr << "Error during lsl_outlet_commit: " << e.what() << std::endl;
+		return lsl_argument_error;
+	}
+	catch(std::exception &e) {
+		std::cerr << "Unexpected error during lsl_outlet_commit: " << e.what() << std::endl;
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int lsl_outlet_commit_n(lsl_outlet out, unsigned long num_samples, const double *timestamps, int pushthrough) {
+	try {
+		((stream_outlet_impl*)out)->commit((std::size_t)num_samples,timestamps,pushthrough!=0);
+		return lsl_no_error;
+	}
+	catch(std::logic_error &e) {
+		std::cerr << "Error during lsl_outlet_commit_n: " << e.what() << std::endl;
+		return lsl_argument_error;
+	}
+	catch(std::exception &e) {
+		std::cerr << "Unexpected error during lsl_outlet_commit_n: " << e.what() << std::endl;
+		return lsl_internal_error;
+	}
+}
+
 LIBLSL_C_API int lsl_have_consumers(lsl_outlet out) { 
 	try {
 		return ((stream_outlet_impl*)out)->have_consumers(); 
@@ -1398,3 +1454,29 @@ LIBLSL_C_API lsl_streaminfo lsl_get_info(lsl_outlet out) {
 	}
 }
 
+LIBLSL_C_API int lsl_get_outlet_stats(lsl_outlet out, lsl_outlet_stats *stats) {
+	if (!stats)
+		return lsl_argument_error;
+	try {
+		((stream_outlet_impl*)out)->get_stats(*stats);
+		return lsl_no_error;
+	}
+	catch(std::exception &e) {
+		std::cerr << "Unexpected error in lsl_get_outlet_stats: " << e.what() << std::endl;
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int lsl_set_overflow_policy(lsl_outlet out, lsl_overflow_policy_t policy) {
+	if (policy != lsl_overflow_drop && policy != lsl_overflow_block && policy != lsl_overflow_spill)
+		return lsl_argument_error;
+	try {
+		((stream_outlet_impl*)out)->set_overflow_policy(policy);
+		return lsl_no_error;
+	}
+	catch(std::exception &e) {
+		std::cerr << "Unexpected error in lsl_set_overflow_policy: " << e.what() << std::endl;
+		return lsl_internal_error;
+	}
+}
+
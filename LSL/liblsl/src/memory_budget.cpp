@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <iostream>
+#include "api_config.h"
+#include "consumer_queue.h"
+#include "memory_budget.h"
+
+
+// === implementation of the memory_budget class ===
+
+using namespace lsl;
+
+/// The number of samples that are evicted from a queue at a time.
+const std::size_t eviction_batch_size = 32;
+
+/// The minimum interval between warnings about the exhausted budget, in seconds.
+const double warning_interval = 10.0;
+
+/// Get the instance (configured from the config file).
+memory_budget &memory_budget::get_instance() {
+	static memory_budget *budget = new memory_budget();
+	return *budget;
+}
+
+/// Construct the instance from the config file.
+memory_budget::memory_budget(): policy_(evict_oldest), allocated_(0), last_warning_(-warning_interval) {
+	const api_config *cfg = api_config::get_instance();
+	limit_ = (std::size_t)(std::max(0.0,cfg->memory_budget_mb())*1024*1024);
+	if (cfg->eviction_policy() == "fullest")
+		policy_ = evict_fullest;
+	else if (cfg->eviction_policy() == "none")
+		policy_ = evict_none;
+	else if (cfg->eviction_policy() != "oldest")
+		std::cerr << "Unsupported eviction policy " << cfg->eviction_policy() << "; evicting the oldest samples instead." << std::endl;
+}
+
+/// Register a consumer queue so that samples can be evicted from it.
+void memory_budget::register_queue(consumer_queue *q) {
+	lslboost::lock_guard<lslboost::mutex> lock(queues_mut_);
+	queues_.push_back(q);
+}
+
+/// Unregister a consumer queue (blocks while samples are being evicted from it).
+void memory_budget::unregister_queue(consumer_queue *q) {
+	lslboost::lock_guard<lslboost::mutex> lock(queues_mut_);
+	queues_.erase(std::remove(queues_.begin(),queues_.end(),q),queues_.end());
+}
+
+/**
+* Evict samples from the evictable queues until the memory held in samples is within the budget again
+* (or there is nothing left to evict). Returns immediately if another thread is already evicting.
+*/
+void memory_budget::enforce() {
+	lslboost::unique_lock<lslboost::mutex> lock(queues_mut_,lslboost::try_to_lock);
+	if (!lock.owns_lock())
+		return;
+	// evict at most as many samples as were queued when we started, in case the producers keep refilling the queues
+	// faster than we evict (or the evicted samples are still held elsewhere, e.g., by a lossless queue of the same outlet)
+	std::size_t queued = 0, evicted = 0;
+	if (policy_ != evict_none)
+		for (std::vector<consumer_queue*>::iterator i=queues_.begin(); i != queues_.end(); i++)
+			if ((*i)->evictable())
+				queued += (*i)->size();
+	while (exceeded() && evicted < queued) {
+		consumer_queue *victim = select_victim();
+		if (!victim)
+			break;
+		std::size_t n = victim->evict(std::min(eviction_batch_size,queued-evicted));
+		if (!n)
+			break;
+		evicted += n;
+	}
+	double now = lsl_clock();
+	if (now - last_warning_ >= warning_interval) {
+		last_warning_ = now;
+		std::cerr << "The memory budget of " << limit_/(1024*1024) << " MB for buffered samples is exhausted (" << allocated()/(1024*1024) << " MB in use); "
+			<< (evicted ? "evicted buffered samples of stalled consumers." : "no samples could be evicted.") << std::endl;
+	}
+}
+
+/// Select the queue from which to evict next (requires a lock on queues_mut_).
+consumer_queue *memory_budget::select_victim() {
+	consumer_queue *victim = NULL;
+	double oldest = 0;
+	std::size_t fullest = 0;
+	for (std::vector<consumer_queue*>::iterator i=queues_.begin(); i != queues_.end(); i++) {
+		if (!(*i)->evictable())
+			continue;
+		if (policy_ == evict_oldest) {
+			double stamp;
+			if ((*i)->oldest_stamp(stamp) && (!victim || stamp < oldest)) {
+				victim = *i;
+				oldest = stamp;
+			}
+		} else {
+			std::size_t size = (*i)->size();
+			if (size > fullest) {
+				victim = *i;
+				fullest = size;
+			}
+		}
+	}
+	return victim;
+}
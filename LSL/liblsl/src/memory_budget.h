@@ -0,0 +1,84 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <cstddef>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+
+namespace lsl {
+
+	class consumer_queue;
+
+	/**
+	* A process-wide budget for the memory that is held in samples.
+	*
+	* The buffers of outlets and inlets are bounded per stream, so a host with many streams can still run out of
+	* memory when many consumers stall at the same time (e.g., during a network outage). The sample factories
+	* therefore account all of their allocations here; while the total exceeds the budget (see api_config::memory_budget_mb()),
+	*  * samples that are allocated beyond a factory's pre-allocated storage are returned to the system when they are released
+	*    (instead of being kept in the factory's freelist),
+	*  * before a factory allocates more memory, samples are evicted from the evictable consumer queues according to the
+	*    eviction policy (see api_config::eviction_policy()),
+	*  * lossless queues whose outlet uses the spill policy spill their samples to disk instead of holding them in memory.
+	* Lossless queues and the queues of lossless inlets (i.e., recorders) are never evicted from.
+	*/
+	class memory_budget: public lslboost::noncopyable {
+	public:
+		/// The eviction policies.
+		enum eviction_policy_t {
+			evict_oldest,	// evict the oldest samples across all evictable queues first
+			evict_fullest,	// evict from the evictable queue with the most samples first
+			evict_none		// do not evict (only trim the freelists and spill)
+		};
+
+		/// Get the instance (configured from the config file).
+		static memory_budget &get_instance();
+
+		/// Check whether a budget has been set.
+		bool enabled() const { return limit_ != 0; }
+
+		/// Check whether the memory held in samples exceeds the budget.
+		bool exceeded() const { return limit_ && allocated_.load(lslboost::memory_order_relaxed) > limit_; }
+
+		/// Get the memory that is currently held in samples, in bytes.
+		std::size_t allocated() const { return allocated_.load(lslboost::memory_order_relaxed); }
+
+		/// Account an allocation of sample memory.
+		void add(std::size_t bytes) { allocated_.fetch_add(bytes,lslboost::memory_order_relaxed); }
+
+		/// Account the release of sample memory.
+		void remove(std::size_t bytes) { allocated_.fetch_sub(bytes,lslboost::memory_order_relaxed); }
+
+		/// Register a consumer queue so that samples can be evicted from it.
+		void register_queue(consumer_queue *q);
+
+		/// Unregister a consumer queue (blocks while samples are being evicted from it).
+		void unregister_queue(consumer_queue *q);
+
+		/**
+		* Evict samples from the evictable queues until the memory held in samples is within the budget again
+		* (or there is nothing left to evict). Returns immediately if another thread is already evicting.
+		*/
+		void enforce();
+
+	private:
+		/// Construct the instance from the config file.
+		memory_budget();
+
+		/// Select the queue from which to evict next (requires a lock on queues_mut_).
+		consumer_queue *select_victim();
+
+		std::size_t limit_;								// the budget in bytes (0 = unlimited)
+		eviction_policy_t policy_;						// the eviction policy
+		lslboost::atomic<std::size_t> allocated_;		// the memory currently held in samples
+		lslboost::mutex queues_mut_;					// protects the queue registry (held while evicting)
+		std::vector<consumer_queue*> queues_;			// the registered queues
+		double last_warning_;							// the time at which the last warning about the budget was logged
+	};
+
+}
+
+#endif
@@ -0,0 +1,193 @@
+#include <cstring>
+#include <iostream>
+#include <boost/asio.hpp>
+#include "api_config.h"
+#include "multicast_publisher.h"
+
+
+// === implementation of the multicast_publisher class ===
+
+using namespace lsl;
+using namespace lslboost::asio;
+using lslboost::asio::ip::udp;
+using lslboost::system::error_code;
+
+/// The time after which a heartbeat is sent if no data has been sent, in seconds.
+const double heartbeat_interval = 0.5;
+
+/**
+* Open the publisher's socket and advertise the group in the stream_info; throws if no socket could be opened.
+* @param info The stream_info of the outlet (receives the multicast group).
+* @param sendbuf The send buffer of the outlet.
+* @param chunk_size The preferred chunk size of the outlet (or 0 to send a datagram whenever a sample is pushed through).
+*/
+multicast_publisher::multicast_publisher(const stream_info_impl_p &info, const send_buffer_p &sendbuf, int chunk_size): info_(info), chunk_size_(chunk_size), tag_(datagram_tag(info->uid())),
+	sock_(io_), shutdown_(false), seq_(0), index_(0), payload_index_(0), last_timestamp_(0.0), chunk_seqn_(0), sent_bytes_(0), samples_sent_(0), bytes_sent_(0)
+{
+	const api_config *cfg = api_config::get_instance();
+	// streams that share the group are spread over 256 ports (receivers skip the datagrams of other streams by their tag)
+	ip::address group = ip::address::from_string(cfg->multicast_data_address());
+	if (!group.is_v4() || !group.is_multicast())
+		throw std::invalid_argument("The multicast data address (" + cfg->multicast_data_address() + ") is not an IPv4 multicast address.");
+	group_ = udp::endpoint(group,(unsigned short)(cfg->multicast_data_port() + tag_%256));
+	max_payload_ = (std::size_t)std::min(std::max(cfg->multicast_packet_size(),256),65507) - datagram_header_size;
+	max_sent_bytes_ = (std::size_t)(cfg->multicast_repair_buffer_mb()*1024*1024);
+
+	// open the socket
+	sock_.open(udp::v4());
+	sock_.set_option(ip::multicast::hops(cfg->multicast_ttl()));
+	sock_.set_option(ip::multicast::enable_loopback(true));
+	if (!cfg->listen_address().empty())
+		sock_.set_option(ip::multicast::outbound_interface(ip::address_v4::from_string(cfg->listen_address())));
+	try {
+		sock_.set_option(socket_base::send_buffer_size(4*1024*1024));
+	} catch(std::exception &) { }
+
+	// advertise the group and take our share of the outlet's samples
+	info_->v4multicast_address(group.to_string());
+	info_->v4multicast_port(group_.port());
+	queue_ = sendbuf->new_consumer();
+}
+
+/// Destructor. Stops publishing.
+multicast_publisher::~multicast_publisher() {
+	try {
+		end_publishing();
+	} catch(std::exception &e) {
+		std::cerr << "Unexpected error during destruction of a multicast publisher: " << e.what() << std::endl;
+	}
+}
+
+/// Begin publishing the samples that are pushed into the outlet.
+void multicast_publisher::begin_publishing() {
+	thread_ = lslboost::thread(&multicast_publisher::publish_thread,this);
+}
+
+/// Stop publishing (tells the receivers that the outlet is gone).
+void multicast_publisher::end_publishing() {
+	if (!thread_.joinable())
+		return;
+	shutdown_ = true;
+	thread_.join();
+	// datagrams may get lost, so the end is announced twice
+	for (int k=0; k<2; k++)
+		send_datagram(index_,0,0,datagram_end,NULL,0);
+}
+
+/**
+* Append the given datagrams to a repair response (each preceded by its length as a 4-byte value in network byte order).
+* Datagrams that are no longer buffered are left out.
+* @param first The number of the first requested datagram.
+* @param count The number of requested datagrams.
+* @param out The response to append to.
+*/
+void multicast_publisher::repair(lslboost::uint64_t first, lslboost::uint64_t count, std::string &out) {
+	lslboost::lock_guard<lslboost::mutex> lock(repair_mut_);
+	lslboost::uint64_t oldest = seq_ - sent_.size();
+	lslboost::uint64_t begin = std::max(first,oldest), end = std::min(first+count,seq_);
+	for (lslboost::uint64_t k=begin; k<end; k++) {
+		const std::string &dgram = sent_[(std::size_t)(k-oldest)];
+		char length[4]; datagram_put(length,dgram.size(),4);
+		out.append(length,4);
+		out += dgram;
+	}
+}
+
+/// The publishing thread: serializes the samples into datagrams and sends them.
+void multicast_publisher::publish_thread() {
+	try {
+		double srate = info_->nominal_srate();
+		string_sink sink(payload_);
+		std::vector<char> scratch(format_sizes[info_->channel_format()]*info_->channel_count());
+		while (!shutdown_) {
+			sample_p samp = queue_->pop_sample(heartbeat_interval);
+			if (!samp) {
+				// nothing new for a while: send what we have and let the receivers know where we are
+				flush();
+				send_datagram(index_,0,0,datagram_heartbeat,NULL,0);
+				continue;
+			}
+			// the first sample of a datagram gets an explicit time stamp, so that the receivers can deduce the
+			// time stamps of the following ones even if they have missed the previous datagram
+			double timestamp = samp->timestamp;
+			if (timestamp == DEDUCED_TIMESTAMP)
+				timestamp = (srate != IRREGULAR_RATE) ? last_timestamp_ + 1.0/srate : last_timestamp_;
+			std::size_t previous_size = payload_.size();
+			if (payload_.empty())
+				payload_index_ = index_;
+			samp->save_streambuf(sink,110,BOOST_BYTE_ORDER,&scratch[0],previous_size ? DEDUCED_TIMESTAMP : timestamp);
+			if (payload_.size() > max_payload_ && previous_size) {
+				// the sample does not fit: send the previous ones and start a new datagram with it
+				payload_.resize(previous_size);
+				flush();
+				payload_index_ = index_;
+				samp->save_streambuf(sink,110,BOOST_BYTE_ORDER,&scratch[0],timestamp);
+			}
+			if (payload_.size() > max_payload_) {
+				// the sample is too large for a single datagram
+				send_fragments(payload_,index_);
+				payload_.clear();
+			}
+			last_timestamp_ = timestamp;
+			index_++;
+			samples_sent_.store(samples_sent_.load(lslboost::memory_order_relaxed)+1,lslboost::memory_order_relaxed);
+			// send according to the preferred chunk size (or the pushthrough flag if there is none)
+			if (chunk_size_ ? (++chunk_seqn_ % chunk_size_ == 0) : samp->pushthrough)
+				flush();
+		}
+		flush();
+	} catch(std::exception &e) {
+		std::cerr << "The multicast publisher of stream " << info_->name() << " stopped unexpectedly: " << e.what() << std::endl;
+	}
+}
+
+/// Send the samples that have been serialized so far as one datagram.
+void multicast_publisher::flush() {
+	if (payload_.empty())
+		return;
+	send_datagram(payload_index_,0,0,0,payload_.data(),payload_.size());
+	payload_.clear();
+}
+
+/// Send a serialized sample that is too large for a single datagram in fragments.
+void multicast_publisher::send_fragments(const std::string &data, lslboost::uint64_t index) {
+	std::size_t fragments = (data.size() + max_payload_ - 1) / max_payload_;
+	if (fragments > 0xFFFF) {
+		std::cerr << "A sample of stream " << info_->name() << " is too large to be multicast (" << data.size() << " bytes); increase DataPacketSize or use TCP." << std::endl;
+		return;
+	}
+	for (std::size_t k=0; k<fragments; k++) {
+		std::size_t offset = k*max_payload_;
+		send_datagram(index,(lslboost::uint16_t)k,(lslboost::uint16_t)fragments,0,data.data()+offset,std::min(max_payload_,data.size()-offset));
+	}
+}
+
+/// Send a datagram (and keep it for repairs unless it is a heartbeat or the end).
+void multicast_publisher::send_datagram(lslboost::uint64_t index, lslboost::uint16_t fragment, lslboost::uint16_t fragments, lslboost::uint16_t flags, const char *payload, std::size_t len) {
+	datagram_header hdr;
+	hdr.tag = tag_;
+	hdr.seq = seq_;
+	hdr.index = index;
+	hdr.fragment = fragment;
+	hdr.fragments = fragments;
+	hdr.byte_order = BOOST_BYTE_ORDER;
+	hdr.flags = flags;
+	packet_.resize(datagram_header_size+len);
+	datagram_write_header(&packet_[0],hdr);
+	if (len)
+		memcpy(&packet_[datagram_header_size],payload,len);
+	// a datagram that could not be sent counts as lost (the receivers can have it repaired)
+	error_code ec;
+	sock_.send_to(buffer(packet_),group_,0,ec);
+	bytes_sent_.store(bytes_sent_.load(lslboost::memory_order_relaxed)+packet_.size(),lslboost::memory_order_relaxed);
+	if (!flags) {
+		lslboost::lock_guard<lslboost::mutex> lock(repair_mut_);
+		sent_.push_back(packet_);
+		sent_bytes_ += packet_.size();
+		while (sent_bytes_ > max_sent_bytes_ && sent_.size() > 1) {
+			sent_bytes_ -= sent_.front().size();
+			sent_.pop_front();
+		}
+		seq_++;
+	}
+}
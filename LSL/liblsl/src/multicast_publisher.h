@@ -0,0 +1,112 @@
+#ifndef MULTICAST_PUBLISHER_H
+#define MULTICAST_PUBLISHER_H
+
+#include <deque>
+#include <string>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include "send_buffer.h"
+#include "datagram.h"
+#include "stream_info_impl.h"
+
+
+namespace lsl {
+
+	/// shared pointer to a multicast publisher
+	typedef lslboost::shared_ptr<class multicast_publisher> multicast_publisher_p;
+
+	/**
+	* Publishes the data of an outlet to a multicast group (if the outlet has been created with transp_multicast).
+	*
+	* Normally every inlet receives its own copy of the data over TCP, so the outlet's load grows with the number of
+	* inlets. In multicast mode the data is additionally sent once to a multicast group (see datagram.h for the format),
+	* which is advertised in the stream_info (v4multicast_address/v4multicast_port); inlets join the group instead of
+	* requesting a feed, and detect gaps by the sequence numbers of the datagrams. The publisher keeps the most recently
+	* sent datagrams (see api_config::multicast_repair_buffer_mb()), which inlets that shall not lose data can request
+	* from the outlet's data port (LSL:repair; see tcp_server). Heartbeats are sent while no data is sent, so that inlets
+	* see gaps at the end of a burst and can tell an idle stream from an unreachable group.
+	* Only IPv4 is supported; the publisher counts as one consumer of the outlet (so have_consumers() is always true).
+	*/
+	class multicast_publisher: public lslboost::noncopyable {
+	public:
+		/**
+		* Open the publisher's socket and advertise the group in the stream_info; throws if no socket could be opened.
+		* @param info The stream_info of the outlet (receives the multicast group).
+		* @param sendbuf The send buffer of the outlet.
+		* @param chunk_size The preferred chunk size of the outlet (or 0 to send a datagram whenever a sample is pushed through).
+		*/
+		multicast_publisher(const stream_info_impl_p &info, const send_buffer_p &sendbuf, int chunk_size);
+
+		/// Destructor. Stops publishing.
+		~multicast_publisher();
+
+		/// Begin publishing the samples that are pushed into the outlet.
+		void begin_publishing();
+
+		/// Stop publishing (tells the receivers that the outlet is gone).
+		void end_publishing();
+
+		/**
+		* Append the given datagrams to a repair response (each preceded by its length as a 4-byte value in network byte order).
+		* Datagrams that are no longer buffered are left out.
+		* @param first The number of the first requested datagram.
+		* @param count The number of requested datagrams.
+		* @param out The response to append to.
+		*/
+		void repair(lslboost::uint64_t first, lslboost::uint64_t count, std::string &out);
+
+		/// Get the number of samples that have been published so far.
+		lslboost::uint64_t samples_sent() const { return samples_sent_.load(lslboost::memory_order_relaxed); }
+
+		/// Get the number of bytes of sample data that have been published so far.
+		lslboost::uint64_t bytes_sent() const { return bytes_sent_.load(lslboost::memory_order_relaxed); }
+
+	private:
+		/// The publishing thread: serializes the samples into datagrams and sends them.
+		void publish_thread();
+
+		/// Send the samples that have been serialized so far as one datagram.
+		void flush();
+
+		/// Send a serialized sample that is too large for a single datagram in fragments.
+		void send_fragments(const std::string &data, lslboost::uint64_t index);
+
+		/// Send a datagram (and keep it for repairs unless it is a heartbeat or the end).
+		void send_datagram(lslboost::uint64_t index, lslboost::uint16_t fragment, lslboost::uint16_t fragments, lslboost::uint16_t flags, const char *payload, std::size_t len);
+
+		stream_info_impl_p info_;					// the stream_info of the outlet
+		consumer_queue_p queue_;					// our queue of the outlet's samples
+		int chunk_size_;							// the preferred chunk size of the outlet (or 0)
+		lslboost::uint32_t tag_;					// the tag of the stream (see datagram.h)
+		std::size_t max_payload_;					// the maximum payload of a datagram
+		lslboost::asio::io_service io_;				// the IO service of the socket
+		lslboost::asio::ip::udp::socket sock_;		// the socket from which the datagrams are sent
+		lslboost::asio::ip::udp::endpoint group_;	// the multicast group and port
+		lslboost::thread thread_;					// the publishing thread
+		lslboost::atomic<bool> shutdown_;			// tells the publishing thread to finish
+
+		// state of the publishing thread
+		std::string payload_;						// the samples that have been serialized but not yet sent
+		std::string packet_;						// the datagram that is being sent
+		lslboost::uint64_t seq_;					// the number of the next datagram
+		lslboost::uint64_t index_;					// the number of the next sample
+		lslboost::uint64_t payload_index_;			// the number of the first sample in the payload
+		double last_timestamp_;						// the time stamp of the last sample (for deducing the next one)
+		unsigned chunk_seqn_;						// the number of samples since the start (for the chunk size)
+
+		lslboost::mutex repair_mut_;				// protects the repair buffer
+		std::deque<std::string> sent_;				// the most recently sent datagrams (the last one has the number seq_-1)
+		std::size_t sent_bytes_;					// the total size of the buffered datagrams
+		std::size_t max_sent_bytes_;				// the maximum total size of the buffered datagrams
+
+		lslboost::atomic<lslboost::uint64_t> samples_sent_;	// the number of samples published so far
+		lslboost::atomic<lslboost::uint64_t> bytes_sent_;	// the number of bytes published so far
+	};
+
+}
+
+#endif
@@ -0,0 +1,121 @@
+#include <boost/asio.hpp>
+#include "api_config.h"
+#include "multicast_receiver.h"
+
+
+// === implementation of the multicast_receiver class ===
+
+using namespace lsl;
+using namespace lslboost::asio;
+using lslboost::asio::ip::udp;
+using lslboost::system::error_code;
+
+/**
+* Join a multicast group.
+* @param group The multicast group and port.
+* @param uid The UID of the stream (the datagrams of other streams are skipped).
+* @param factory The factory for the received samples.
+* @param srate The nominal sampling rate of the stream (for deducing time stamps).
+*/
+multicast_receiver::multicast_receiver(const udp::endpoint &group, const std::string &uid, const sample::factory_p &factory, double srate): datagram_receiver(uid),
+	factory_(factory), srate_(srate), started_(false), next_seq_(0), next_index_(0), last_timestamp_(0.0), fragment_index_(0), next_fragment_(0)
+{
+	const api_config *cfg = api_config::get_instance();
+	sock_.open(udp::v4());
+	sock_.set_option(udp::socket::reuse_address(true));
+	// binding to the group address (where supported) keeps out the unicast traffic to the port
+	try {
+		sock_.bind(group);
+	} catch(std::exception &) {
+		sock_.bind(udp::endpoint(ip::address_v4::any(),group.port()));
+	}
+	if (cfg->listen_address().empty())
+		sock_.set_option(ip::multicast::join_group(group.address()));
+	else
+		sock_.set_option(ip::multicast::join_group(group.address().to_v4(),ip::address_v4::from_string(cfg->listen_address())));
+	try {
+		sock_.set_option(socket_base::receive_buffer_size(4*1024*1024));
+	} catch(std::exception &) { }
+}
+
+/// Get the number of datagrams that have been lost before the given one (0 if none, or if it is the first one).
+lslboost::uint64_t multicast_receiver::missing(const std::string &dgram) const {
+	datagram_header hdr;
+	if (!started_ || !datagram_read_header(dgram.data(),dgram.size(),hdr))
+		return 0;
+	return (hdr.seq > next_seq_) ? hdr.seq - next_seq_ : 0;
+}
+
+/**
+* Unpack a datagram (received or repaired, in order) into samples.
+* @param dgram The datagram.
+* @param samples Receives the samples that it completes.
+* @return The number of samples that have been lost before it.
+* @throws lost_error if the outlet has been destroyed.
+*/
+lslboost::uint64_t multicast_receiver::unpack(const std::string &dgram, std::vector<sample_p> &samples) {
+	datagram_header hdr;
+	if (!datagram_read_header(dgram.data(),dgram.size(),hdr))
+		return 0;
+	if (hdr.flags & datagram_end)
+		throw lost_error("The outlet has been destroyed.");
+	bool heartbeat = (hdr.flags & datagram_heartbeat) != 0;
+	if (!started_) {
+		// a datagram with the later fragments of a sample starts the stream with the next sample
+		started_ = true;
+		next_seq_ = hdr.seq;
+		next_index_ = (hdr.fragment && !heartbeat) ? hdr.index+1 : hdr.index;
+	}
+	// skip duplicates and datagrams that have arrived too late
+	if (hdr.seq < next_seq_)
+		return 0;
+	next_seq_ = heartbeat ? hdr.seq : hdr.seq+1;
+	// the samples between the last one and the first one of this datagram have been lost
+	lslboost::uint64_t lost = 0;
+	if (hdr.index > next_index_) {
+		lost = hdr.index - next_index_;
+		next_index_ = hdr.index;
+	}
+	if (heartbeat)
+		return lost;
+	const char *payload = dgram.data() + datagram_header_size;
+	std::size_t len = dgram.size() - datagram_header_size;
+	if (!hdr.fragments) {
+		next_fragment_ = 0;
+		parse(payload,len,hdr.byte_order,samples);
+	} else if (hdr.index >= next_index_) {
+		// reassemble the sample (an incomplete one is lost once the next one begins)
+		if (hdr.fragment == 0) {
+			fragments_.assign(payload,len);
+			fragment_index_ = hdr.index;
+			next_fragment_ = 1;
+		} else if (next_fragment_ && hdr.index == fragment_index_ && hdr.fragment == next_fragment_) {
+			fragments_.append(payload,len);
+			next_fragment_++;
+		} else
+			next_fragment_ = 0;
+		if (next_fragment_ && next_fragment_ == hdr.fragments) {
+			next_fragment_ = 0;
+			parse(fragments_.data(),fragments_.size(),hdr.byte_order,samples);
+		}
+	}
+	return lost;
+}
+
+/// Parse the samples in a payload.
+void multicast_receiver::parse(const char *payload, std::size_t len, int byte_order, std::vector<sample_p> &samples) {
+	memory_source src(payload,len);
+	while (src.in_avail() > 0) {
+		sample_p samp(factory_->new_sample(0.0,false));
+		samp->load_streambuf(src,110,byte_order,false);
+		// deduce the time stamp if necessary (the first sample of each datagram has an explicit one)
+		if (samp->timestamp == DEDUCED_TIMESTAMP) {
+			samp->timestamp = last_timestamp_;
+			if (srate_ != IRREGULAR_RATE)
+				samp->timestamp += 1.0/srate_;
+		}
+		last_timestamp_ = samp->timestamp;
+		next_index_++;
+		samples.push_back(samp);
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef MULTICAST_RECEIVER_H
+#define MULTICAST_RECEIVER_H
+
+#include <string>
+#include <vector>
+#include "datagram_receiver.h"
+#include "sample.h"
+
+
+namespace lsl {
+
+	/**
+	* Receives the samples of a stream from the multicast group to which its outlet publishes them (see multicast_publisher).
+	* Keeps track of the datagram and sample numbers, so that the caller can find out about lost datagrams (and have them
+	* repaired) before a datagram is unpacked, and reassembles samples that have been sent in fragments.
+	*/
+	class multicast_receiver: public datagram_receiver {
+	public:
+		/**
+		* Join a multicast group.
+		* @param group The multicast group and port.
+		* @param uid The UID of the stream (the datagrams of other streams are skipped).
+		* @param factory The factory for the received samples.
+		* @param srate The nominal sampling rate of the stream (for deducing time stamps).
+		*/
+		multicast_receiver(const lslboost::asio::ip::udp::endpoint &group, const std::string &uid, const sample::factory_p &factory, double srate);
+
+		/// Get the number of datagrams that have been lost before the given one (0 if none, or if it is the first one).
+		lslboost::uint64_t missing(const std::string &dgram) const;
+
+		/// Get the number of the next expected datagram.
+		lslboost::uint64_t next_seq() const { return next_seq_; }
+
+		/**
+		* Unpack a datagram (received or repaired, in order) into samples.
+		* @param dgram The datagram.
+		* @param samples Receives the samples that it completes.
+		* @return The number of samples that have been lost before it.
+		* @throws lost_error if the outlet has been destroyed.
+		*/
+		lslboost::uint64_t unpack(const std::string &dgram, std::vector<sample_p> &samples);
+
+	private:
+		/// Parse the samples in a payload.
+		void parse(const char *payload, std::size_t len, int byte_order, std::vector<sample_p> &samples);
+
+		sample::factory_p factory_;					// the factory for the received samples
+		double srate_;								// the nominal sampling rate of the stream
+
+		// the position in the stream
+		bool started_;								// whether a datagram has been unpacked yet
+		lslboost::uint64_t next_seq_;				// the number of the next expected datagram
+		lslboost::uint64_t next_index_;				// the number of the next expected sample
+		double last_timestamp_;						// the time stamp of the last sample (for deducing the next one)
+		std::string fragments_;						// the fragments of a sample that have been received so far
+		lslboost::uint64_t fragment_index_;			// the number of the sample that is being reassembled
+		lslboost::uint16_t next_fragment_;			// the number of the next expected fragment (0 if none)
+	};
+
+}
+
+#endif
@@ -0,0 +1,343 @@
+#include <iostream>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/weak_ptr.hpp>
+#include "api_config.h"
+#include "mux_connection.h"
+
+
+// === implementation of the mux_connection class ===
+
+using namespace lsl;
+using namespace lslboost::asio;
+
+namespace {
+	lslboost::mutex connections_mut;										// protects the registry of connections
+	std::map<tcp::endpoint,lslboost::weak_ptr<mux_connection> > connections;	// the connections of this process by endpoint
+}
+
+/// The size of the reads from the connection.
+const std::size_t read_size = 64*1024;
+
+/// Get the connection to the given endpoint (a new one if there is none or the previous one has failed).
+mux_connection_p mux_connection::get(const tcp::endpoint &endpoint) {
+	lslboost::lock_guard<lslboost::mutex> lock(connections_mut);
+	mux_connection_p conn = connections[endpoint].lock();
+	if (conn) {
+		lslboost::lock_guard<lslboost::mutex> state_lock(conn->mut_);
+		if (conn->state_ == failed)
+			conn.reset();
+	}
+	if (!conn) {
+		conn.reset(new mux_connection(endpoint));
+		connections[endpoint] = conn;
+	}
+	return conn;
+}
+
+/// Establish a new connection (asynchronously).
+mux_connection::mux_connection(const tcp::endpoint &endpoint): sock_(io_), state_(connecting), next_id_(1) {
+	sock_.async_connect(endpoint,lslboost::bind(&mux_connection::handle_connect_outcome,this,placeholders::error));
+	io_thread_ = lslboost::thread(&mux_connection::run_io,this);
+}
+
+/// Destructor. Closes the connection.
+mux_connection::~mux_connection() {
+	try {
+		// the IO thread ends once the socket is closed (and right away if the connection has already failed)
+		io_.post(lslboost::bind(&mux_connection::fail,this,error_code(error::operation_aborted)));
+		io_thread_.join();
+	} catch(std::exception &e) {
+		std::cerr << "Unexpected error during destruction of a multiplexed connection: " << e.what() << std::endl;
+	}
+}
+
+/// Open a channel for the given stream buffer; the buffer is notified once the connection is ready (or has failed).
+lslboost::uint32_t mux_connection::open_channel(mux_streambuf *owner) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	lslboost::uint32_t id = next_id_++;
+	if (state_ == failed) {
+		owner->on_connected(error_);
+		return id;
+	}
+	channels_[id] = owner;
+	if (state_ == connected)
+		owner->on_connected(error_code());
+	return id;
+}
+
+/// Close a channel (no further calls will be made to its stream buffer).
+void mux_connection::close_channel(lslboost::uint32_t id) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	if (channels_.erase(id) && state_ == connected) {
+		// tell the server to stop sending
+		std::string frame;
+		mux_append_header(frame,mux_close,id,0);
+		send(frame);
+	}
+}
+
+/// Send a frame (thread-safe; the frames are sent in order by the IO thread).
+void mux_connection::send(const std::string &frame) {
+	io_.post(lslboost::bind(&mux_connection::enqueue,this,frame));
+}
+
+/// Handler that gets called when the connection has been established.
+void mux_connection::handle_connect_outcome(error_code err) {
+	if (err) {
+		fail(err);
+		return;
+	}
+	try {
+		sock_.set_option(ip::tcp::no_delay(true));
+	} catch(std::exception &) { }
+	// send the request line and read the response line
+	enqueue("LSL:mux/" + lslboost::lexical_cast<std::string>(api_config::get_instance()->use_protocol_version()) + "\r\n");
+	async_read_until(sock_,inbuf_,"\r\n",lslboost::bind(&mux_connection::handle_read_response,this,placeholders::error));
+}
+
+/// Handler that gets called when the response line has been read.
+void mux_connection::handle_read_response(error_code err) {
+	if (err) {
+		fail(err);
+		return;
+	}
+	// check the response line (LSL/[Version] [StatusCode] [Message])
+	std::istream response(&inbuf_);
+	std::string line; getline(response,line); lslboost::trim(line);
+	std::vector<std::string> parts; lslboost::algorithm::split(parts,line,lslboost::algorithm::is_any_of(" \t"));
+	if (parts.size() < 3 || !lslboost::algorithm::starts_with(parts[0],"LSL/") || parts[1] != "200") {
+		std::cerr << "The other party refused the multiplexed session: " << line << std::endl;
+		fail(error::connection_refused);
+		return;
+	}
+	{
+		lslboost::lock_guard<lslboost::mutex> lock(mut_);
+		state_ = connected;
+		for (std::map<lslboost::uint32_t,mux_streambuf*>::iterator i=channels_.begin(); i != channels_.end(); i++)
+			i->second->on_connected(error_code());
+	}
+	handle_read_outcome(error_code(),0);
+}
+
+/// Read the next bytes from the connection.
+void mux_connection::read_next() {
+	sock_.async_read_some(inbuf_.prepare(read_size),
+		lslboost::bind(&mux_connection::handle_read_outcome,this,placeholders::error,placeholders::bytes_transferred));
+}
+
+/// Handler that gets called when bytes have been read; dispatches all complete frames.
+void mux_connection::handle_read_outcome(error_code err, std::size_t len) {
+	if (err) {
+		fail(err);
+		return;
+	}
+	inbuf_.commit(len);
+	while (inbuf_.size() >= mux_header_size) {
+		const char *p = buffer_cast<const char*>(inbuf_.data());
+		int type;
+		lslboost::uint32_t id, length;
+		mux_read_header(p,type,id,length);
+		if (length > mux_max_payload || (type != mux_data && type != mux_close)) {
+			std::cerr << "Received a malformed frame on a multiplexed session; closing it." << std::endl;
+			fail(error::invalid_argument);
+			return;
+		}
+		if (inbuf_.size() < mux_header_size+length)
+			break;
+		{
+			lslboost::lock_guard<lslboost::mutex> lock(mut_);
+			std::map<lslboost::uint32_t,mux_streambuf*>::iterator i = channels_.find(id);
+			if (i != channels_.end()) {
+				if (type == mux_data) {
+					i->second->on_data(p+mux_header_size,length);
+				} else {
+					i->second->on_end(error_code());
+					channels_.erase(i);
+				}
+			}
+		}
+		inbuf_.consume(mux_header_size+length);
+	}
+	read_next();
+}
+
+/// Queue a frame for sending (IO thread).
+void mux_connection::enqueue(const std::string &frame) {
+	outbox_.push_back(frame);
+	if (outbox_.size() == 1)
+		async_write(sock_,buffer(outbox_.front()),lslboost::bind(&mux_connection::handle_write_outcome,this,placeholders::error));
+}
+
+/// Handler that gets called when a frame has been sent.
+void mux_connection::handle_write_outcome(error_code err) {
+	if (err) {
+		outbox_.clear();
+		fail(err);
+		return;
+	}
+	outbox_.pop_front();
+	if (!outbox_.empty())
+		async_write(sock_,buffer(outbox_.front()),lslboost::bind(&mux_connection::handle_write_outcome,this,placeholders::error));
+}
+
+/// Fail the connection and end all channels (IO thread).
+void mux_connection::fail(const error_code &err) {
+	{
+		lslboost::lock_guard<lslboost::mutex> lock(mut_);
+		if (state_ != failed) {
+			state_ = failed;
+			error_ = err;
+		}
+		for (std::map<lslboost::uint32_t,mux_streambuf*>::iterator i=channels_.begin(); i != channels_.end(); i++)
+			i->second->on_end(error_);
+		channels_.clear();
+	}
+	error_code ec;
+	sock_.close(ec);
+}
+
+/// Run the IO service.
+void mux_connection::run_io() {
+	while (true) {
+		try {
+			io_.run();
+			return;
+		} catch(std::exception &e) {
+			std::cerr << "Error during io_service processing (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
+		}
+	}
+}
+
+
+//
+// === implementation of the mux_streambuf class ===
+//
+
+/// Create a buffer for a request to the stream with the given UID.
+mux_streambuf::mux_streambuf(const std::string &uid): uid_(uid), id_(0), requested_(false), consumed_(0), bytes_received_(0), connected_(false), ended_(false), cancelled_(false) { }
+
+/// Destructor. Closes the channel.
+mux_streambuf::~mux_streambuf() {
+	// no cancel() can fire after this call
+	unregister_from_all();
+	if (conn_)
+		conn_->close_channel(id_);
+}
+
+/// Open a channel on the multiplexed session at the given endpoint; check puberror() for the outcome.
+mux_streambuf *mux_streambuf::connect(const tcp::endpoint &endpoint) {
+	{
+		lslboost::lock_guard<lslboost::mutex> lock(mut_);
+		if (cancelled_)
+			throw std::runtime_error("Attempt to connect() a mux_streambuf after it has been cancelled.");
+	}
+	conn_ = mux_connection::get(endpoint);
+	id_ = conn_->open_channel(this);
+	// wait until the connection is ready (or has failed)
+	lslboost::unique_lock<lslboost::mutex> lock(mut_);
+	while (!connected_ && !ended_ && !cancelled_)
+		cv_.wait(lock);
+	if (!connected_ && !error_)
+		error_ = error::operation_aborted;
+	return this;
+}
+
+/// Cancel the current and all subsequent blocking operations.
+void mux_streambuf::cancel() {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	cancelled_ = true;
+	cv_.notify_all();
+}
+
+/// The connection is ready (or has failed).
+void mux_streambuf::on_connected(const error_code &err) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	if (err) {
+		ended_ = true;
+		error_ = err;
+	} else
+		connected_ = true;
+	cv_.notify_all();
+}
+
+/// Data has been received on the channel.
+void mux_streambuf::on_data(const char *data, std::size_t len) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	incoming_.append(data,len);
+	cv_.notify_all();
+}
+
+/// The channel has ended (closed by the server or the connection has failed).
+void mux_streambuf::on_end(const error_code &err) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	ended_ = true;
+	if (err)
+		error_ = err;
+	cv_.notify_all();
+}
+
+/// Read the next received data into the get area (blocking).
+mux_streambuf::int_type mux_streambuf::underflow() {
+	if (gptr() < egptr())
+		return traits_type::to_int_type(*gptr());
+	{
+		lslboost::unique_lock<lslboost::mutex> lock(mut_);
+		while (incoming_.empty() && !ended_ && !cancelled_)
+			cv_.wait(lock);
+		if (incoming_.empty() || cancelled_)
+			return traits_type::eof();
+		getbuf_.swap(incoming_);
+		incoming_.clear();
+	}
+	// grant the bytes that we have taken on back to the server (in batches)
+	bytes_received_ += getbuf_.size();
+	consumed_ += getbuf_.size();
+	if (consumed_ >= mux_window/4) {
+		std::string frame;
+		mux_append_value(frame,mux_credit,id_,(lslboost::uint32_t)consumed_);
+		conn_->send(frame);
+		consumed_ = 0;
+	}
+	setg(&getbuf_[0],&getbuf_[0],&getbuf_[0]+getbuf_.size());
+	return traits_type::to_int_type(*gptr());
+}
+
+/// Append a character to the request.
+mux_streambuf::int_type mux_streambuf::overflow(int_type c) {
+	if (!traits_type::eq_int_type(c,traits_type::eof()))
+		request_.push_back(traits_type::to_char_type(c));
+	return traits_type::not_eof(c);
+}
+
+/// Append characters to the request.
+std::streamsize mux_streambuf::xsputn(const char *s, std::streamsize n) {
+	request_.append(s,(std::size_t)n);
+	return n;
+}
+
+/// Send the request (once).
+int mux_streambuf::sync() {
+	if (!conn_ || !connected_)
+		return -1;
+	if (!requested_ && !request_.empty()) {
+		// the payload of the open frame is the UID of the stream and the request
+		std::string payload = uid_ + "\r\n" + request_, frame;
+		mux_append_header(frame,mux_open,id_,(lslboost::uint32_t)payload.size());
+		frame += payload;
+		conn_->send(frame);
+		requested_ = true;
+	}
+	return 0;
+}
+
+/// The number of bytes that can be read without blocking.
+std::streamsize mux_streambuf::showmanyc() {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	if (!incoming_.empty())
+		return (std::streamsize)incoming_.size();
+	return (ended_ || cancelled_) ? -1 : 0;
+}
@@ -0,0 +1,170 @@
+#ifndef MUX_CONNECTION_H
+#define MUX_CONNECTION_H
+
+#include <deque>
+#include <map>
+#include <streambuf>
+#include <string>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include "cancellation.h"
+#include "mux_frame.h"
+
+
+using lslboost::asio::ip::tcp;
+using lslboost::system::error_code;
+
+namespace lsl {
+
+	class mux_streambuf;
+
+	/// shared pointer to a multiplexed connection
+	typedef lslboost::shared_ptr<class mux_connection> mux_connection_p;
+
+	/**
+	* A multiplexed session with the process of one or more outlets (see mux_server), shared by all streams of this
+	* process that are read from there. The connection is established when the first channel is opened and closed when
+	* the last one is gone; if it fails, all its channels end and the next channel is opened on a new connection.
+	*/
+	class mux_connection: public lslboost::noncopyable {
+	public:
+		/// Get the connection to the given endpoint (a new one if there is none or the previous one has failed).
+		static mux_connection_p get(const tcp::endpoint &endpoint);
+
+		/// Destructor. Closes the connection.
+		~mux_connection();
+
+		/// Open a channel for the given stream buffer; the buffer is notified once the connection is ready (or has failed).
+		lslboost::uint32_t open_channel(mux_streambuf *owner);
+
+		/// Close a channel (no further calls will be made to its stream buffer).
+		void close_channel(lslboost::uint32_t id);
+
+		/// Send a frame (thread-safe; the frames are sent in order by the IO thread).
+		void send(const std::string &frame);
+
+	private:
+		/// Establish a new connection (asynchronously).
+		mux_connection(const tcp::endpoint &endpoint);
+
+		/// Handler that gets called when the connection has been established.
+		void handle_connect_outcome(error_code err);
+
+		/// Handler that gets called when the response line has been read.
+		void handle_read_response(error_code err);
+
+		/// Read the next bytes from the connection.
+		void read_next();
+
+		/// Handler that gets called when bytes have been read; dispatches all complete frames.
+		void handle_read_outcome(error_code err, std::size_t len);
+
+		/// Queue a frame for sending (IO thread).
+		void enqueue(const std::string &frame);
+
+		/// Handler that gets called when a frame has been sent.
+		void handle_write_outcome(error_code err);
+
+		/// Fail the connection and end all channels (IO thread).
+		void fail(const error_code &err);
+
+		/// Run the IO service.
+		void run_io();
+
+		enum state_t { connecting, connected, failed };
+
+		lslboost::asio::io_service io_;			// the IO service of the connection
+		tcp::socket sock_;						// the connection socket
+		lslboost::asio::streambuf inbuf_;		// the data received from the server that has not yet been processed
+		std::deque<std::string> outbox_;		// the frames that have not yet been sent (IO thread)
+		lslboost::thread io_thread_;			// the thread that runs the IO service
+
+		lslboost::mutex mut_;					// protects the state and the channels
+		state_t state_;							// the state of the connection
+		error_code error_;						// the error with which the connection failed
+		std::map<lslboost::uint32_t,mux_streambuf*> channels_;	// the stream buffers of the open channels
+		lslboost::uint32_t next_id_;			// the number of the next channel
+	};
+
+	/**
+	* A stream buffer that reads the response to a request that has been sent on a channel of a multiplexed session.
+	* It can be used in place of a cancellable_streambuf that is connected to the stream's data port: the request is
+	* written into the buffer and sent on the first flush, and the response is read from it until the channel ends.
+	*/
+	class mux_streambuf: public std::streambuf, public cancellable_obj {
+	public:
+		/// Create a buffer for a request to the stream with the given UID.
+		explicit mux_streambuf(const std::string &uid);
+
+		/// Destructor. Closes the channel.
+		virtual ~mux_streambuf();
+
+		/// Open a channel on the multiplexed session at the given endpoint; check puberror() for the outcome.
+		mux_streambuf *connect(const tcp::endpoint &endpoint);
+
+		/// Get the last error.
+		const error_code &puberror() const { return error_; }
+
+		/// Get the number of bytes that have been received.
+		lslboost::uint64_t bytes_received() const { return bytes_received_; }
+
+		/// Cancel the current and all subsequent blocking operations.
+		void cancel();
+
+		// === calls from the connection (under its lock) ===
+
+		/// The connection is ready (or has failed).
+		void on_connected(const error_code &err);
+
+		/// Data has been received on the channel.
+		void on_data(const char *data, std::size_t len);
+
+		/// The channel has ended (closed by the server or the connection has failed).
+		void on_end(const error_code &err);
+
+	protected:
+		/// Read the next received data into the get area (blocking).
+		int_type underflow();
+
+		/// Append a character to the request.
+		int_type overflow(int_type c);
+
+		/// Append characters to the request.
+		std::streamsize xsputn(const char *s, std::streamsize n);
+
+		/// Send the request (once).
+		int sync();
+
+		/// The number of bytes that can be read without blocking.
+		std::streamsize showmanyc();
+
+	private:
+		std::string uid_;						// the UID of the stream
+		mux_connection_p conn_;					// the connection (once connected)
+		lslboost::uint32_t id_;					// the channel number
+		std::string request_;					// the request written so far
+		bool requested_;						// whether the request has been sent
+		std::string getbuf_;					// the get area
+		std::size_t consumed_;					// the bytes that have been read but not yet granted back to the server
+		lslboost::uint64_t bytes_received_;		// the number of bytes that have been received
+
+		lslboost::mutex mut_;					// protects the state below
+		lslboost::condition_variable cv_;		// notified when the state changes
+		std::string incoming_;					// the received data that has not yet been read
+		bool connected_;						// whether the connection is ready
+		bool ended_;							// whether the channel has ended
+		bool cancelled_;						// whether cancel() has been called
+		error_code error_;						// the last error
+	};
+
+}
+
+#endif
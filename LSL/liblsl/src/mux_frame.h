@@ -0,0 +1,72 @@
+#ifndef MUX_FRAME_H
+#define MUX_FRAME_H
+
+#include <cstddef>
+#include <string>
+#include <boost/cstdint.hpp>
+
+
+namespace lsl {
+
+	/**
+	* The framing of the multiplexed sessions (see mux_server and mux_connection).
+	*
+	* A multiplexed session begins with the request line LSL:mux/[ProtocolVersion] of the client and the response line
+	* LSL/[ProtocolVersion] [StatusCode] [Message] of the server, after which both parties exchange frames. A frame consists
+	* of a header (the frame type, the channel number and the payload length, in network byte order) and the payload.
+	* Each channel carries one request and its response exactly as a dedicated connection to the stream's data port would
+	* (so the feed negotiation and the sample format are the same):
+	*  * open (client to server): opens a channel; the payload is the UID of the stream, CRLF, and the request.
+	*  * data (server to client): the next bytes of the response.
+	*  * credit (client to server): allows the server to send a number of further bytes on the channel (4-byte payload).
+	*	 Each channel starts with a window of mux_window bytes, which the client replenishes as its reader consumes the data,
+	*	 so that a stalled reader only stalls its own stream (and the outlet's buffer applies as usual).
+	*  * close (either direction): ends the channel; the client sees the end of the response.
+	*/
+	enum mux_frame_type {
+		mux_open = 1,		// open a channel (client to server)
+		mux_data = 2,		// data of a channel (server to client)
+		mux_credit = 3,		// grant further bytes to a channel (client to server)
+		mux_close = 4		// close a channel (either direction)
+	};
+
+	/// The size of a frame header, in bytes.
+	const std::size_t mux_header_size = 9;
+
+	/// The number of bytes that the server may send on a channel before the client has granted more.
+	const std::size_t mux_window = 256*1024;
+
+	/// The maximum payload of a frame (larger frames are a protocol error).
+	const std::size_t mux_max_payload = 1024*1024;
+
+	/// Append a frame header to a string.
+	inline void mux_append_header(std::string &out, mux_frame_type type, lslboost::uint32_t channel, lslboost::uint32_t length) {
+		char hdr[mux_header_size] = {(char)type,
+			(char)(channel>>24), (char)(channel>>16), (char)(channel>>8), (char)channel,
+			(char)(length>>24), (char)(length>>16), (char)(length>>8), (char)length};
+		out.append(hdr,mux_header_size);
+	}
+
+	/// Append a frame with a 4-byte payload (e.g., a credit) to a string.
+	inline void mux_append_value(std::string &out, mux_frame_type type, lslboost::uint32_t channel, lslboost::uint32_t value) {
+		mux_append_header(out,type,channel,4);
+		char v[4] = {(char)(value>>24), (char)(value>>16), (char)(value>>8), (char)value};
+		out.append(v,4);
+	}
+
+	/// Read a 4-byte value in network byte order.
+	inline lslboost::uint32_t mux_read_value(const char *p) {
+		const unsigned char *u = (const unsigned char*)p;
+		return ((lslboost::uint32_t)u[0]<<24) | ((lslboost::uint32_t)u[1]<<16) | ((lslboost::uint32_t)u[2]<<8) | u[3];
+	}
+
+	/// Parse a frame header.
+	inline void mux_read_header(const char *p, int &type, lslboost::uint32_t &channel, lslboost::uint32_t &length) {
+		type = (unsigned char)p[0];
+		channel = mux_read_value(p+1);
+		length = mux_read_value(p+5);
+	}
+
+}
+
+#endif
@@ -0,0 +1,373 @@
+#include <iostream>
+#include <sstream>
+#include <boost/asio.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include "mux_server.h"
+#include "socket_utils.h"
+#include "trace.h"
+
+
+// === implementation of the mux_server class ===
+
+using namespace lsl;
+using namespace lslboost::asio;
+
+/// The maximum payload of a data frame (so that the channels of a session take turns).
+const std::size_t max_data_frame = 64*1024;
+
+/// Get the instance (created on first use; lives until the process exits).
+mux_server &mux_server::get_instance() {
+	static mux_server *server = new mux_server();
+	return *server;
+}
+
+/// Construct the instance.
+mux_server::mux_server(): io_(new io_service()) { }
+
+/// Get the port of the multiplexed sessions for the given protocol (opened on first use). Throws if no port could be opened.
+int mux_server::port(tcp protocol) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	tcp_acceptor_p &acceptor = (protocol == tcp::v4()) ? v4acceptor_ : v6acceptor_;
+	if (!acceptor) {
+		// open the server socket and bind it to a free port in the allowed range
+		tcp_acceptor_p newacceptor(new tcp::acceptor(*io_));
+		newacceptor->open(protocol);
+		bind_and_listen_to_port_in_range(*newacceptor,protocol,10);
+		acceptor = newacceptor;
+		accept_next_connection(acceptor);
+		// start the IO thread once the first acceptor is open
+		if (!work_) {
+			work_.reset(new io_service::work(*io_));
+			io_thread_ = lslboost::thread(&mux_server::run_io,this);
+		}
+	}
+	return acceptor->local_endpoint().port();
+}
+
+/// Make the stream of a TCP server available to the multiplexed sessions (called when the server begins serving).
+void mux_server::add_stream(const tcp_server_p &serv) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	streams_[serv->info_->uid()] = serv;
+}
+
+/// Remove the stream of a TCP server (called when the server ends serving).
+void mux_server::remove_stream(const tcp_server *serv) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	// the IPv4 and IPv6 servers of an outlet serve the same stream, so the entry may belong to the other one
+	std::map<std::string,lslboost::weak_ptr<tcp_server> >::iterator i = streams_.find(serv->info_->uid());
+	if (i != streams_.end()) {
+		tcp_server_p registered = i->second.lock();
+		if (!registered || registered.get() == serv)
+			streams_.erase(i);
+	}
+}
+
+/// Find the TCP server of a stream by its UID (or an empty pointer).
+tcp_server_p mux_server::find_stream(const std::string &uid) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	std::map<std::string,lslboost::weak_ptr<tcp_server> >::iterator i = streams_.find(uid);
+	return (i != streams_.end()) ? i->second.lock() : tcp_server_p();
+}
+
+/// Start accepting a new connection.
+void mux_server::accept_next_connection(tcp_acceptor_p acceptor) {
+	try {
+		session_p newsession(new session(*this,io_));
+		acceptor->async_accept(*newsession->socket(),
+			lslboost::bind(&mux_server::handle_accept_outcome,this,acceptor,newsession,placeholders::error));
+	} catch(std::exception &e) {
+		std::cerr << "Error during mux_server::accept_next_connection (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
+	}
+}
+
+/// Handler that is called when the accept has finished.
+void mux_server::handle_accept_outcome(tcp_acceptor_p acceptor, session_p newsession, error_code err) {
+	if (err == error::operation_aborted || err == error::shut_down)
+		return;
+	if (!err)
+		newsession->begin_processing();
+	accept_next_connection(acceptor);
+}
+
+/// Run the IO service.
+void mux_server::run_io() {
+	while (true) {
+		try {
+			io_->run();
+			return;
+		} catch(std::exception &e) {
+			std::cerr << "Error during io_service processing (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
+		}
+	}
+}
+
+
+//
+// === implementation of the mux_server::session class ===
+//
+
+/// Instantiate a new session & its socket.
+mux_server::session::session(mux_server &owner, const io_service_p &io): owner_(owner), io_(io), sock_(new tcp::socket(*io)), failed_(false) { }
+
+/// Begin processing this session (reading the request line).
+void mux_server::session::begin_processing() {
+	try {
+		sock_->set_option(ip::tcp::no_delay(true));
+		async_read_until(*sock_, inbuf_, "\r\n",
+			lslboost::bind(&session::handle_read_request,shared_from_this(),placeholders::error));
+	} catch(std::exception &e) {
+		std::cerr << "Error during mux_server::session::begin_processing (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
+	}
+}
+
+/// Handler that gets called when the request line has been read.
+void mux_server::session::handle_read_request(error_code err) {
+	if (err)
+		return;
+	try {
+		// parse the request line (LSL:mux/[ProtocolVersion])
+		std::istream requeststream(&inbuf_);
+		std::string method; getline(requeststream,method); lslboost::trim(method);
+		if (!lslboost::algorithm::starts_with(method,"LSL:mux/"))
+			return;
+		int request_protocol_version = lslboost::lexical_cast<int>(method.substr(method.find_first_of("/")+1));
+		int protocol_version = api_config::get_instance()->use_protocol_version();
+		if (request_protocol_version/100 > protocol_version/100) {
+			string_p msg(new std::string((lslboost::format("LSL/%1% 505 Version not supported\r\n") % protocol_version).str()));
+			async_write(*sock_, buffer(*msg), lslboost::bind(&session::handle_status_outcome,shared_from_this(),msg,placeholders::error));
+			return;
+		}
+		response_ = (lslboost::format("LSL/%1% 200 OK\r\n") % protocol_version).str();
+		// spawn the transfer thread (which sends the response) and process the frames
+		lslboost::thread(&session::transfer_thread,this,shared_from_this());
+		handle_read_outcome(error_code(),0);
+	} catch(std::exception &e) {
+		std::cerr << "Unexpected error while parsing a multiplexed session request (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
+	}
+}
+
+/// Handler that gets called after finishing the sending of a status message, holding a reference to the message.
+void mux_server::session::handle_status_outcome(string_p, error_code) { }
+
+/// Read the next bytes from the connection.
+void mux_server::session::read_next() {
+	sock_->async_read_some(inbuf_.prepare(max_data_frame),
+		lslboost::bind(&session::handle_read_outcome,shared_from_this(),placeholders::error,placeholders::bytes_transferred));
+}
+
+/// Handler that gets called when bytes have been read; processes all complete frames.
+void mux_server::session::handle_read_outcome(error_code err, std::size_t len) {
+	if (err) {
+		fail();
+		return;
+	}
+	try {
+		inbuf_.commit(len);
+		while (inbuf_.size() >= mux_header_size) {
+			const char *p = buffer_cast<const char*>(inbuf_.data());
+			int type;
+			lslboost::uint32_t id, length;
+			mux_read_header(p,type,id,length);
+			if (length > mux_max_payload)
+				throw std::runtime_error("Received an oversized frame.");
+			if (inbuf_.size() < mux_header_size+length)
+				break;
+			std::string payload(p+mux_header_size,length);
+			inbuf_.consume(mux_header_size+length);
+			process_frame(type,id,payload);
+		}
+	} catch(std::exception &e) {
+		std::cerr << "Error in a multiplexed session (" << e.what() << "); closing it." << std::endl;
+		fail();
+		return;
+	}
+	read_next();
+}
+
+/// Process a frame from the client (IO thread).
+void mux_server::session::process_frame(int type, lslboost::uint32_t id, const std::string &payload) {
+	if (type == mux_open) {
+		open_channel(id,payload);
+		return;
+	}
+	if (type != mux_credit && type != mux_close)
+		throw std::runtime_error("Received a frame of unknown type.");
+	{
+		lslboost::lock_guard<lslboost::mutex> lock(channels_mut_);
+		std::map<lslboost::uint32_t,channel_p>::iterator i = channels_.find(id);
+		if (i == channels_.end())
+			return;
+		if (type == mux_credit) {
+			if (payload.size() != 4)
+				throw std::runtime_error("Received a malformed credit frame.");
+			i->second->credit.fetch_add((long)mux_read_value(payload.data()));
+		} else
+			i->second->closed = true;
+	}
+	event_.signal();
+}
+
+/// Open a channel and parse its request (IO thread).
+void mux_server::session::open_channel(lslboost::uint32_t id, const std::string &payload) {
+	channel_p c(new channel(id));
+	std::istringstream requeststream(payload);
+	// the payload is the UID of the stream and the request as it would be sent to the stream's data port
+	std::string uid; getline(requeststream,uid); lslboost::trim(uid);
+	std::string method; getline(requeststream,method); lslboost::trim(method);
+	tcp_server_p serv = owner_.find_stream(uid);
+	c->finished = true;
+	if (serv && !serv->shutdown_) {
+		if (method == "LSL:shortinfo") {
+			// shortinfo request: reply if the query matches
+			std::string query; getline(requeststream,query); lslboost::trim(query);
+			if (serv->info_->matches_query(query))
+				c->feedbuf.sputn(serv->shortinfo_msg_.data(),serv->shortinfo_msg_.size());
+		}
+		if (method == "LSL:fullinfo") {
+			// fullinfo request: reply with the full stream_info
+			std::string msg = serv->info_->to_fullinfo_message();
+			c->feedbuf.sputn(msg.data(),msg.size());
+		}
+		if (method == "LSL:streamfeed" || lslboost::algorithm::starts_with(method,"LSL:streamfeed/")) {
+			// streamfeed request (with version): negotiate the feed
+			int request_protocol_version = 100;
+			std::string request_uid;
+			if (method != "LSL:streamfeed") {
+				std::vector<std::string> parts; lslboost::algorithm::split(parts,method,lslboost::algorithm::is_any_of(" \t"));
+				request_protocol_version = lslboost::lexical_cast<int>(parts[0].substr(parts[0].find_first_of("/")+1));
+				request_uid = (parts.size()>1) ? parts[1] : "";
+			}
+			std::string status = c->feed.negotiate(*serv->info_,serv->shortinfo_msg_,serv->chunk_size_,request_protocol_version,request_uid,requeststream,c->feedbuf);
+			if (!status.empty()) {
+				status += "\r\n";
+				c->feedbuf.sputn(status.data(),status.size());
+			} else if (c->feed.max_buffered() > 0) {
+				// make a new consumer queue for the feed
+				c->serv = serv;
+				c->queue = c->feed.lossless() ? serv->send_buffer_->new_lossless_consumer(c->feed.max_buffered(),serv->info_->channel_format(),serv->info_->channel_count()) : serv->send_buffer_->new_consumer(c->feed.max_buffered());
+				c->finished = false;
+			}
+		}
+	} else if (lslboost::algorithm::starts_with(method,"LSL:streamfeed/")) {
+		std::string status = (lslboost::format("LSL/%1% 404 Not found\r\n") % api_config::get_instance()->use_protocol_version()).str();
+		c->feedbuf.sputn(status.data(),status.size());
+	}
+	// the response so far (the feed header) can be sent right away
+	c->flushable = c->feedbuf.size();
+	{
+		lslboost::lock_guard<lslboost::mutex> lock(channels_mut_);
+		channels_[id] = c;
+		opened_.push_back(c);
+	}
+	event_.signal();
+}
+
+/// Mark the session as failed and wake up the transfer thread.
+void mux_server::session::fail() {
+	failed_ = true;
+	event_.signal();
+}
+
+/// Transfers the data of all channels to the client.
+void mux_server::session::transfer_thread(session_p) {
+	std::vector<channel_p> active;	// the channels that are being served
+	std::string frames;				// the frames that are sent with the next write
+	try {
+		error_code err;
+		write(*sock_,buffer(response_),err);
+		while (!err && !failed_) {
+			// pick up the new channels
+			{
+				lslboost::lock_guard<lslboost::mutex> lock(channels_mut_);
+				for (std::size_t k=0; k<opened_.size(); k++) {
+					if (opened_[k]->queue)
+						opened_[k]->queue->attach(&event_);
+					active.push_back(opened_[k]);
+				}
+				opened_.clear();
+			}
+			// serve each channel in turn
+			frames.clear();
+			for (std::size_t k=0; k<active.size();) {
+				if (!active[k]->closed)
+					serve_channel(*active[k],frames);
+				if (active[k]->closed || (active[k]->finished && !active[k]->feedbuf.size())) {
+					release_channel(active[k]);
+					active.erase(active.begin()+k);
+				} else
+					k++;
+			}
+			// send the frames of all channels at once, or wait for samples, credits or new channels
+			if (frames.empty()) {
+				event_.wait(FOREVER);
+			} else {
+				LSL_TRACE_SCOPE("write");
+				write(*sock_,buffer(frames),err);
+			}
+		}
+	} catch(std::exception &e) {
+		std::cerr << "Unexpected error in the transfer thread of a multiplexed session (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
+	}
+	for (std::size_t k=0; k<active.size(); k++)
+		release_channel(active[k]);
+	// close the connection (which ends the read chain, too)
+	failed_ = true;
+	io_->post(lslboost::bind(&shutdown_and_close<tcp_socket_p,tcp>,sock_));
+}
+
+/// Serialize the available samples of a channel and append a data frame (and a close frame at its end) if possible.
+void mux_server::session::serve_channel(channel &c, std::string &frames) {
+	if (c.queue && !c.finished) {
+		// serialize the available samples while little data is pending (otherwise they stay in the queue, where the outlet's buffer applies)
+		while (c.feedbuf.size() < mux_window) {
+			sample_p samp(c.queue->pop_sample(0.0));
+			if (c.serv->shutdown_) {
+				c.finished = true;
+				break;
+			}
+			if (!samp)
+				break;
+			bool pushthrough;
+			{
+				LSL_TRACE_SCOPE("serialize");
+				pushthrough = c.feed.encode(*samp,c.queue->skipped());
+			}
+			c.chunk_samples++;
+			// the data up to the end of a chunk may be sent
+			if (pushthrough) {
+				c.flushable = c.feedbuf.size();
+				c.serv->samples_sent_.fetch_add(c.chunk_samples,lslboost::memory_order_relaxed);
+				c.chunk_samples = 0;
+			}
+		}
+	}
+	if (c.finished)
+		c.flushable = c.feedbuf.size();
+	// send as much as the client allows
+	long credit = c.credit.load();
+	std::size_t n = std::min(std::min(c.flushable,max_data_frame),(std::size_t)std::max(credit,0L));
+	if (n) {
+		mux_append_header(frames,mux_data,c.id,(lslboost::uint32_t)n);
+		frames.append(buffer_cast<const char*>(c.feedbuf.data()),n);
+		c.feedbuf.consume(n);
+		c.flushable -= n;
+		c.credit.fetch_sub((long)n);
+		if (c.serv)
+			c.serv->bytes_sent_.fetch_add(n,lslboost::memory_order_relaxed);
+	}
+	if (c.finished && !c.feedbuf.size())
+		mux_append_header(frames,mux_close,c.id,0);
+}
+
+/// Release the resources of a channel that is no longer served.
+void mux_server::session::release_channel(const channel_p &c) {
+	if (c->queue) {
+		c->queue->detach(&event_);
+		c->queue.reset();
+	}
+	lslboost::lock_guard<lslboost::mutex> lock(channels_mut_);
+	channels_.erase(c->id);
+}
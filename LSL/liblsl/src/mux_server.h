@@ -0,0 +1,155 @@
+#ifndef MUX_SERVER_H
+#define MUX_SERVER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/atomic.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/weak_ptr.hpp>
+#include "consumer_queue.h"
+#include "mux_frame.h"
+#include "tcp_server.h"
+
+
+namespace lsl {
+
+	/**
+	* The server of the multiplexed sessions of this process.
+	*
+	* Normally an inlet opens a TCP connection to the data port of its outlet (and another one for the full stream_info),
+	* and each of them is served by its own session and transfer thread. If multiplexing is enabled (see
+	* api_config::multiplex_sessions()), the process additionally listens on one port per IP stack, which is advertised in the
+	* stream_info of all its outlets (v4mux_port/v6mux_port). An inlet process then opens a single connection to that port
+	* (see mux_connection) and requests the feeds of all the streams that it reads from this process as channels of that
+	* connection (see mux_frame.h). A session is served by one transfer thread, which waits for the samples of all its
+	* channels at once and sends the chunks of several streams with one write; each channel is flow-controlled separately.
+	*/
+	class mux_server: public lslboost::noncopyable {
+	public:
+		/// Get the instance (created on first use; lives until the process exits).
+		static mux_server &get_instance();
+
+		/// Get the port of the multiplexed sessions for the given protocol (opened on first use). Throws if no port could be opened.
+		int port(tcp protocol);
+
+		/// Make the stream of a TCP server available to the multiplexed sessions (called when the server begins serving).
+		void add_stream(const tcp_server_p &serv);
+
+		/// Remove the stream of a TCP server (called when the server ends serving).
+		void remove_stream(const tcp_server *serv);
+
+	private:
+		/// A multiplexed session with a client process.
+		class session;
+		typedef lslboost::shared_ptr<session> session_p;
+
+		/// Construct the instance.
+		mux_server();
+
+		/// Find the TCP server of a stream by its UID (or an empty pointer).
+		tcp_server_p find_stream(const std::string &uid);
+
+		/// Start accepting a new connection.
+		void accept_next_connection(tcp_acceptor_p acceptor);
+
+		/// Handler that is called when the accept has finished.
+		void handle_accept_outcome(tcp_acceptor_p acceptor, session_p newsession, error_code err);
+
+		/// Run the IO service.
+		void run_io();
+
+		/**
+		* A multiplexed session with a client process.
+		* The session is owned by its IO handlers and by its transfer thread; it ends when the connection fails or is closed.
+		* The channels are created by the IO thread (which parses the requests) and are then served by the transfer thread.
+		*/
+		class session: public lslboost::enable_shared_from_this<session> {
+		public:
+			/// Instantiate a new session & its socket.
+			session(mux_server &owner, const io_service_p &io);
+
+			/// Get the socket of this session.
+			tcp_socket_p socket() { return sock_; }
+
+			/// Begin processing this session (reading the request line).
+			void begin_processing();
+
+		private:
+			/// A channel of the session (the feed of one stream, or the response to an info request).
+			struct channel {
+				channel(lslboost::uint32_t id): id(id), flushable(0), chunk_samples(0), credit(mux_window), closed(false), finished(false) {}
+				lslboost::uint32_t id;					// the channel number
+				tcp_server_p serv;						// the server of the stream (empty for info requests)
+				feed_encoder feed;						// the negotiated feed
+				lslboost::asio::streambuf feedbuf;		// the serialized data that has not yet been sent
+				std::size_t flushable;					// the bytes of the feedbuf that may be sent (up to the end of the last chunk)
+				unsigned chunk_samples;					// the number of samples in the chunk that is being aggregated
+				consumer_queue_p queue;					// the queue of the feed (empty for info requests)
+				lslboost::atomic<long> credit;			// the number of bytes that the client allows us to send
+				lslboost::atomic<bool> closed;			// whether the client has closed the channel
+				bool finished;							// whether the channel ends once the feedbuf has been sent
+			};
+			typedef lslboost::shared_ptr<channel> channel_p;
+
+			/// Handler that gets called when the request line has been read.
+			void handle_read_request(error_code err);
+
+			/// Handler that gets called after finishing the sending of a status message, holding a reference to the message.
+			void handle_status_outcome(string_p msg, error_code err);
+
+			/// Read the next bytes from the connection.
+			void read_next();
+
+			/// Handler that gets called when bytes have been read; processes all complete frames.
+			void handle_read_outcome(error_code err, std::size_t len);
+
+			/// Process a frame from the client (IO thread).
+			void process_frame(int type, lslboost::uint32_t id, const std::string &payload);
+
+			/// Open a channel and parse its request (IO thread).
+			void open_channel(lslboost::uint32_t id, const std::string &payload);
+
+			/// Mark the session as failed and wake up the transfer thread.
+			void fail();
+
+			/// Transfers the data of all channels to the client.
+			void transfer_thread(session_p sess);
+
+			/// Serialize the available samples of a channel and append a data frame (and a close frame at its end) if possible.
+			void serve_channel(channel &c, std::string &frames);
+
+			/// Release the resources of a channel that is no longer served.
+			void release_channel(const channel_p &c);
+
+			mux_server &owner_;						// the server that accepted the session
+			io_service_p io_;						// the IO service of the server
+			tcp_socket_p sock_;						// connection socket
+			lslboost::asio::streambuf inbuf_;		// the data received from the client that has not yet been processed
+			std::string response_;					// the response line (sent by the transfer thread before any frame)
+			lslboost::atomic<bool> failed_;			// whether the connection has failed or has been closed
+			queue_event event_;						// signalled on new samples, credits, channel changes and failure
+
+			lslboost::mutex channels_mut_;			// protects the channel maps
+			std::map<lslboost::uint32_t,channel_p> channels_;	// the open channels (for routing the frames of the client)
+			std::vector<channel_p> opened_;			// the channels that the transfer thread has not yet picked up
+		};
+
+		io_service_p io_;							// the IO service that runs the acceptors and session reads
+		lslboost::scoped_ptr<lslboost::asio::io_service::work> work_;	// keeps the IO service running
+		lslboost::thread io_thread_;				// the thread that runs the IO service (started on first use)
+		lslboost::mutex mut_;						// protects the acceptors and the streams
+		tcp_acceptor_p v4acceptor_;					// the IPv4 acceptor (once opened)
+		tcp_acceptor_p v6acceptor_;					// the IPv6 acceptor (once opened)
+		std::map<std::string,lslboost::weak_ptr<tcp_server> > streams_;	// the streams of this process by UID
+	};
+
+}
+
+#endif
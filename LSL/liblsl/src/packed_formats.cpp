@@ -0,0 +1,168 @@
+#include "packed_formats.h"
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+	#include <immintrin.h>
+	#define LSL_HAS_SIMD_KERNELS
+	#define LSL_TARGET(isa)
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#include <cpuid.h>
+	#include <immintrin.h>
+	#define LSL_HAS_SIMD_KERNELS
+	#define LSL_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+
+// === implementation of the bulk conversions of the compact channel formats ===
+
+using namespace lsl;
+
+namespace {
+
+	// scalar kernels (used on all CPUs for the values that do not fill a SIMD step)
+
+	void pack_half_scalar(const float *src, lslboost::uint16_t *dst, std::size_t count) {
+		for (std::size_t k=0; k<count; k++)
+			dst[k] = float_to_half(src[k]);
+	}
+
+	void unpack_half_scalar(const lslboost::uint16_t *src, float *dst, std::size_t count) {
+		for (std::size_t k=0; k<count; k++)
+			dst[k] = half_to_float(src[k]);
+	}
+
+	void pack_int24_scalar(const lslboost::int32_t *src, char *dst, std::size_t count) {
+		for (std::size_t k=0; k<count; k++)
+			store_int24(&dst[3*k],src[k]);
+	}
+
+	void unpack_int24_scalar(const char *src, lslboost::int32_t *dst, std::size_t count) {
+		for (std::size_t k=0; k<count; k++)
+			dst[k] = load_int24(&src[3*k]);
+	}
+
+#ifdef LSL_HAS_SIMD_KERNELS
+	// SIMD kernels; these are compiled for their instruction set regardless of the target of the build and
+	// must only be called if the CPU supports it
+
+	LSL_TARGET("f16c") void pack_half_f16c(const float *src, lslboost::uint16_t *dst, std::size_t count) {
+		std::size_t k = 0;
+		for (; k+4 <= count; k+=4)
+			_mm_storel_epi64((__m128i*)&dst[k],_mm_cvtps_ph(_mm_loadu_ps(&src[k]),_MM_FROUND_TO_NEAREST_INT));
+		pack_half_scalar(&src[k],&dst[k],count-k);
+	}
+
+	LSL_TARGET("f16c") void unpack_half_f16c(const lslboost::uint16_t *src, float *dst, std::size_t count) {
+		std::size_t k = 0;
+		for (; k+4 <= count; k+=4)
+			_mm_storeu_ps(&dst[k],_mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)&src[k])));
+		unpack_half_scalar(&src[k],&dst[k],count-k);
+	}
+
+	LSL_TARGET("ssse3") void pack_int24_ssse3(const lslboost::int32_t *src, char *dst, std::size_t count) {
+		// each step writes 16 bytes of which the last 4 are overwritten by the next step, so stop 2 values before the end
+		const __m128i mask = _mm_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+		std::size_t k = 0;
+		for (; k+6 <= count; k+=4)
+			_mm_storeu_si128((__m128i*)&dst[3*k],_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[k]),mask));
+		pack_int24_scalar(&src[k],&dst[3*k],count-k);
+	}
+
+	LSL_TARGET("ssse3") void unpack_int24_ssse3(const char *src, lslboost::int32_t *dst, std::size_t count) {
+		// move the 3 bytes of each value into the upper bytes of its lane, then shift them down with sign extension
+		const __m128i mask = _mm_setr_epi8(-1,0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11);
+		std::size_t k = 0;
+		for (; k+6 <= count; k+=4)
+			_mm_storeu_si128((__m128i*)&dst[k],_mm_srai_epi32(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[3*k]),mask),8));
+		unpack_int24_scalar(&src[3*k],&dst[k],count-k);
+	}
+
+	/// Whether the CPU supports the F16C instructions (which also requires the OS to save the AVX register state).
+	bool f16c_supported() {
+#ifdef _MSC_VER
+		int regs[4];
+		__cpuid(regs,1);
+		const unsigned c = (unsigned)regs[2];
+#else
+		unsigned a, b, c, d;
+		if (!__get_cpuid(1,&a,&b,&c,&d))
+			return false;
+#endif
+		// F16C (bit 29) and OSXSAVE (bit 27)
+		if ((c & (1u<<29)) == 0 || (c & (1u<<27)) == 0)
+			return false;
+#ifdef _MSC_VER
+		const unsigned long long xcr0 = _xgetbv(0);
+#else
+		unsigned xcr0_lo, xcr0_hi;
+		__asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+		const unsigned long long xcr0 = xcr0_lo;
+#endif
+		// the SSE and AVX states must be enabled
+		return (xcr0 & 6) == 6;
+	}
+
+	/// Whether the CPU supports the SSSE3 instructions.
+	bool ssse3_supported() {
+#ifdef _MSC_VER
+		int regs[4];
+		__cpuid(regs,1);
+		return (regs[2] & (1<<9)) != 0;
+#else
+		unsigned a, b, c, d;
+		if (!__get_cpuid(1,&a,&b,&c,&d))
+			return false;
+		return (c & (1u<<9)) != 0;
+#endif
+	}
+#endif
+
+	/// The conversion kernels that are used on this CPU (selected once).
+	struct packed_kernels {
+		packed_kernels(): pack_half(&pack_half_scalar), unpack_half(&unpack_half_scalar), pack_int24(&pack_int24_scalar), unpack_int24(&unpack_int24_scalar) {
+#ifdef LSL_HAS_SIMD_KERNELS
+			if (f16c_supported()) {
+				pack_half = &pack_half_f16c;
+				unpack_half = &unpack_half_f16c;
+			}
+#if BOOST_BYTE_ORDER == 1234
+			if (ssse3_supported()) {
+				pack_int24 = &pack_int24_ssse3;
+				unpack_int24 = &unpack_int24_ssse3;
+			}
+#endif
+#endif
+		}
+
+		/// Get the kernels of this CPU.
+		static const packed_kernels &get_instance() {
+			static packed_kernels kernels;
+			return kernels;
+		}
+
+		void (*pack_half)(const float *, lslboost::uint16_t *, std::size_t);
+		void (*unpack_half)(const lslboost::uint16_t *, float *, std::size_t);
+		void (*pack_int24)(const lslboost::int32_t *, char *, std::size_t);
+		void (*unpack_int24)(const char *, lslboost::int32_t *, std::size_t);
+	};
+
+}
+
+/// Convert an array of floats to half-precision floats.
+void lsl::pack_half(const float *src, lslboost::uint16_t *dst, std::size_t count) {
+	packed_kernels::get_instance().pack_half(src,dst,count);
+}
+
+/// Convert an array of half-precision floats to floats.
+void lsl::unpack_half(const lslboost::uint16_t *src, float *dst, std::size_t count) {
+	packed_kernels::get_instance().unpack_half(src,dst,count);
+}
+
+/// Convert an array of integers to packed 24-bit integers (keeping the lower 24 bits of each).
+void lsl::pack_int24(const lslboost::int32_t *src, char *dst, std::size_t count) {
+	packed_kernels::get_instance().pack_int24(src,dst,count);
+}
+
+/// Convert an array of packed 24-bit integers to integers.
+void lsl::unpack_int24(const char *src, lslboost::int32_t *dst, std::size_t count) {
+	packed_kernels::get_instance().unpack_int24(src,dst,count);
+}
@@ -0,0 +1,94 @@
+#ifndef PACKED_FORMATS_H
+#define PACKED_FORMATS_H
+
+#include <cmath>
+#include <cstring>
+#include <boost/cstdint.hpp>
+#include <boost/detail/endian.hpp>
+
+
+namespace lsl {
+
+	/**
+	* Conversion between the compact channel formats and the types in which applications push and pull them.
+	* A cf_float16 value is an IEEE 754 half-precision float (binary16) and a cf_int24 value is a two's complement
+	* 24-bit integer stored in 3 bytes; both are kept in the host's byte order like the other formats. The bulk
+	* functions use SIMD instructions if the CPU has them (F16C for the half-precision floats and SSSE3 for the
+	* 24-bit integers; this is detected once at runtime) and scalar code otherwise.
+	*/
+
+	/// Convert a float to a half-precision float (rounding to nearest even; out-of-range values become infinite).
+	inline lslboost::uint16_t float_to_half(float value) {
+		lslboost::uint32_t x; memcpy(&x,&value,sizeof(x));
+		lslboost::uint32_t sign = x & UINT32_C(0x80000000);
+		x ^= sign;
+		lslboost::uint16_t result;
+		if (x >= UINT32_C(0x47800000)) {
+			// overflow, infinity or NaN
+			result = (x > UINT32_C(0x7f800000)) ? 0x7e00 : 0x7c00;
+		} else if (x < UINT32_C(0x38800000)) {
+			// subnormal or zero: let the FPU do the rounding by adding a value whose exponent aligns the mantissa
+			float tmp; memcpy(&tmp,&x,sizeof(tmp));
+			tmp += 0.5f;
+			memcpy(&x,&tmp,sizeof(x));
+			result = (lslboost::uint16_t)(x - UINT32_C(0x3f000000));
+		} else {
+			// normal: rebias the exponent and round the mantissa to nearest even
+			lslboost::uint32_t odd = (x >> 13) & 1;
+			x += UINT32_C(0xc8000fff) + odd;
+			result = (lslboost::uint16_t)(x >> 13);
+		}
+		return result | (lslboost::uint16_t)(sign >> 16);
+	}
+
+	/// Convert a half-precision float to a float (exactly).
+	inline float half_to_float(lslboost::uint16_t value) {
+		lslboost::uint32_t sign = (lslboost::uint32_t)(value & 0x8000) << 16, exponent = (value >> 10) & 0x1f, mantissa = value & 0x3ff, x;
+		if (exponent == 0) {
+			// zero or subnormal
+			float result = std::ldexp((float)mantissa,-24);
+			return sign ? -result : result;
+		}
+		if (exponent == 0x1f)
+			x = sign | UINT32_C(0x7f800000) | (mantissa << 13);
+		else
+			x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		float result; memcpy(&result,&x,sizeof(result));
+		return result;
+	}
+
+	/// Store the lower 24 bits of an integer in 3 bytes.
+	inline void store_int24(char *dst, lslboost::int32_t value) {
+#if BOOST_BYTE_ORDER == 1234
+		dst[0] = (char)value; dst[1] = (char)(value >> 8); dst[2] = (char)(value >> 16);
+#else
+		dst[2] = (char)value; dst[1] = (char)(value >> 8); dst[0] = (char)(value >> 16);
+#endif
+	}
+
+	/// Load a 24-bit integer from 3 bytes (with sign extension).
+	inline lslboost::int32_t load_int24(const char *src) {
+		const unsigned char *s = (const unsigned char*)src;
+#if BOOST_BYTE_ORDER == 1234
+		lslboost::uint32_t x = (lslboost::uint32_t)s[0] | ((lslboost::uint32_t)s[1] << 8) | ((lslboost::uint32_t)s[2] << 16);
+#else
+		lslboost::uint32_t x = (lslboost::uint32_t)s[2] | ((lslboost::uint32_t)s[1] << 8) | ((lslboost::uint32_t)s[0] << 16);
+#endif
+		return (lslboost::int32_t)(x << 8) >> 8;
+	}
+
+	/// Convert an array of floats to half-precision floats.
+	void pack_half(const float *src, lslboost::uint16_t *dst, std::size_t count);
+
+	/// Convert an array of half-precision floats to floats.
+	void unpack_half(const lslboost::uint16_t *src, float *dst, std::size_t count);
+
+	/// Convert an array of integers to packed 24-bit integers (keeping the lower 24 bits of each).
+	void pack_int24(const lslboost::int32_t *src, char *dst, std::size_t count);
+
+	/// Convert an array of packed 24-bit integers to integers.
+	void unpack_int24(const char *src, lslboost::int32_t *dst, std::size_t count);
+
+}
+
+#endif
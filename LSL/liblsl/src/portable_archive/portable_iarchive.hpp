@@ -408,6 +408,76 @@ namespace eos {
 				throw portable_archive_exception(t);
 		}
 
+		/**
+		 * \brief Load an array of integer or floating point values.
+		 *
+		 * Reads values that were saved individually or with save_values(). The
+		 * bytes are taken from the stream buffer directly, which saves the
+		 * per-value dispatch through the archive.
+		 */
+		template <typename T>
+		void load_values(T* values, std::size_t count)
+		{
+			const bool finite_only = (get_flags() & no_infnan) != 0;
+			for (std::size_t k = 0; k < count; ++k)
+				decode(values[k], finite_only);
+		}
+
+	private:
+		// get the next byte from the stream
+		inline unsigned char next_byte()
+		{
+			std::streambuf::int_type c = m_sb.sbumpc();
+			if (std::streambuf::traits_type::eq_int_type(c, std::streambuf::traits_type::eof()))
+				lslboost::serialization::throw_exception(
+					lslboost::archive::archive_exception(lslboost::archive::archive_exception::input_stream_error));
+			return (unsigned char)c;
+		}
+
+		// decode an integer like load() does
+		template <typename T>
+		typename lslboost::enable_if<lslboost::is_integral<T> >::type
+		decode(T& t, bool = false)
+		{
+			if (signed char size = (signed char)next_byte())
+			{
+				if (size < 0 && lslboost::is_unsigned<T>::value)
+					throw portable_archive_exception();
+				else if ((unsigned) abs(size) > sizeof(T))
+					throw portable_archive_exception(size);
+
+				// the lowest bytes in little endian order, sign-extended
+				typedef typename lslboost::uint_t<sizeof(T)*CHAR_BIT>::least bits_type;
+				bits_type bits = 0;
+				int n = abs(size);
+				for (int k = 0; k < n; ++k)
+					bits |= (bits_type) next_byte() << (k*CHAR_BIT);
+				if (size < 0 && n < (int) sizeof(T))
+					bits |= (bits_type) -1 << (n*CHAR_BIT);
+				t = (T) bits;
+			}
+			else t = 0; // zero optimization
+		}
+
+		// decode a floating point value like load() does
+		template <typename T>
+		typename lslboost::enable_if<lslboost::is_floating_point<T> >::type
+		decode(T& t, bool finite_only)
+		{
+			typedef typename fp::detail::fp_traits<T>::type traits;
+
+			typename traits::bits bits;
+			decode(bits);
+			traits::set_bits(t, bits);
+
+			if (finite_only && !fp::isfinite(t))
+				throw portable_archive_exception(t);
+			if (std::numeric_limits<T>::has_denorm == std::denorm_absent
+				&& fp::fpclassify(t) == (int) FP_SUBNORMAL)
+				throw portable_archive_exception(t);
+		}
+
+	public:
 		// in boost 1.44 version_type was splitted into library_version_type and
 		// item_version_type, plus a whole bunch of additional strong typedefs.
 		template <typename T>
@@ -91,10 +91,13 @@
 
 #pragma once
 
+#include <cstring>
 #include <ostream>
 
 // basic headers
 #include <boost/version.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/detail/endian.hpp>
 #include <boost/utility/enable_if.hpp>
 #include <boost/archive/basic_binary_oprimitive.hpp>
 #include <boost/archive/basic_binary_oarchive.hpp>
@@ -398,6 +401,91 @@ namespace eos {
 			save(bits);
 		}
 
+		/**
+		 * \brief Save an array of integer or floating point values.
+		 *
+		 * The values are encoded exactly like a sequence of individual saves, so
+		 * that any portable_iarchive can read them back one by one. The encoding
+		 * happens in a local block that is written to the stream at once, which
+		 * saves the per-value dispatch through the archive and the stream buffer.
+		 */
+		template <typename T>
+		void save_values(const T* values, std::size_t count)
+		{
+			unsigned char block[4096];
+			std::size_t used = 0;
+			const bool finite_only = (get_flags() & no_infnan) != 0;
+			for (std::size_t k = 0; k < count; ++k)
+			{
+				if (used + sizeof(T) + 1 > sizeof(block))
+				{
+					save_binary(block, used);
+					used = 0;
+				}
+				used += encode(values[k], &block[used], finite_only);
+			}
+			if (used) save_binary(block, used);
+		}
+
+	private:
+		// encode an integer like save() does, return the number of bytes
+		template <typename T>
+		static typename lslboost::enable_if<lslboost::is_integral<T>, std::size_t>::type
+		encode(const T& t, unsigned char* dst, bool = false)
+		{
+			// zero optimization
+			if (!t) { *dst = 0; return 1; }
+
+			signed char size = significant_bytes(t);
+			*dst++ = (unsigned char)(t > 0 ? size : -size);
+
+			// the lowest size bytes in little endian order (there is
+			// room for all bytes of T, of which the first size count)
+		#if BOOST_BYTE_ORDER == 1234
+			std::memcpy(dst, &t, sizeof(T));
+		#else
+			typename lslboost::uint_t<sizeof(T)*CHAR_BIT>::least bits = t;
+			for (signed char k = 0; k < size; ++k, bits >>= CHAR_BIT)
+				*dst++ = (unsigned char)bits;
+		#endif
+			return size + 1;
+		}
+
+		// the number of bytes that save() uses for a non-zero integer, i.e.,
+		// up to the last byte that is not just a sign extension
+		template <typename T>
+		static signed char significant_bytes(const T& t)
+		{
+			lslboost::uintmax_t bits = (lslboost::uintmax_t)(t < 0 ? (T) ~t : t);
+		#if defined(__GNUC__)
+			return bits ? (signed char)((sizeof(unsigned long long)*CHAR_BIT - __builtin_clzll((unsigned long long)bits) + CHAR_BIT-1) / CHAR_BIT) : 1;
+		#else
+			signed char size = 1;
+			while (bits >>= CHAR_BIT) ++size;
+			return size;
+		#endif
+		}
+
+		// encode a floating point value like save() does, return the number of bytes
+		template <typename T>
+		static typename lslboost::enable_if<lslboost::is_floating_point<T>, std::size_t>::type
+		encode(const T& t, unsigned char* dst, bool finite_only)
+		{
+			typedef typename fp::detail::fp_traits<T>::type traits;
+
+			if (finite_only && !fp::isfinite(t))
+				throw portable_archive_exception(t);
+
+			// the bit pattern is that of save() for all values: the bits of
+			// an IEC 559 float, except that all NaNs become the same quiet NaN
+			typename traits::bits bits;
+			traits::get_bits(t, bits);
+			if ((bits & traits::exponent) == traits::exponent && (bits & traits::mantissa))
+				bits = traits::exponent | traits::mantissa;
+			return encode(bits, dst);
+		}
+
+	public:
 		// in lslboost 1.44 version_type was splitted into library_version_type and
 		// item_version_type, plus a whole bunch of additional strong typedefs.
 		template <typename T>
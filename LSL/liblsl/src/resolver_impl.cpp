@@ -79,7 +79,32 @@ std::vector<stream_info_impl> resolver_impl::resolve_oneshot(const std::string &
 	forget_after_ = FOREVER;
 	fast_mode_ = true;
 	expired_ = false;
+	direct_endpoints_.clear();
+	return run_oneshot(timeout);
+}
 
+/**
+* Resolve a query string by probing only a given set of UDP endpoints (e.g., the last known location of a stream).
+* Blocks until at least the minimum number of streams has been resolved, or the timeout fires, or the resolve has been cancelled.
+*/
+std::vector<stream_info_impl> resolver_impl::resolve_direct(const std::string &query, const std::vector<udp::endpoint> &targets, int minimum, double timeout) {
+	if (targets.empty())
+		return std::vector<stream_info_impl>();
+	// reset the IO service & set up the query parameters
+	io_->reset();
+	query_ = query;
+	minimum_ = minimum;
+	wait_until_ = 0;
+	results_.clear();
+	forget_after_ = FOREVER;
+	fast_mode_ = true;
+	expired_ = false;
+	direct_endpoints_ = targets;
+	return run_oneshot(timeout);
+}
+
+/// Run a oneshot resolve with the current settings until finished and return the results.
+std::vector<stream_info_impl> resolver_impl::run_oneshot(double timeout) {
 	// start a timer that cancels all outstanding IO operations and wave schedules after the timeout has expired
 	if (timeout != FOREVER) {
 		resolve_timeout_expired_.expires_from_now(millisec(1000*timeout));
@@ -111,6 +136,7 @@ void resolver_impl::resolve_continuous(const std::string &query, double forget_a
 	forget_after_ = forget_after;
 	fast_mode_ = false;
 	expired_ = false;
+	direct_endpoints_.clear();
 	// start a wave of resolve packets
 	next_resolve_wave();
 	// spawn a thread that runs the IO operations
@@ -146,6 +172,11 @@ void resolver_impl::next_resolve_wave() {
 	if (cancelled_ || expired_ || (minimum_ && (num_results >= (std::size_t)minimum_) && lsl_clock() >= wait_until_)) {
 		// stopping criteria satisfied: cancel the ongoing operations
 		cancel_ongoing_resolve();
+	} else if (!direct_endpoints_.empty()) {
+		// directed resolve: re-probe only the given endpoints and skip the multicast/known-peer waves
+		udp_direct_burst();
+		wave_timer_.expires_from_now(millisec(1000*cfg_->recovery_probe_interval()));
+		wave_timer_.async_wait(lslboost::bind(&resolver_impl::wave_timeout_expired,this,placeholders::error));
 	} else {
 		// start a new multicast wave
 		udp_multicast_burst();
@@ -194,6 +225,20 @@ void resolver_impl::udp_unicast_burst(error_code err) {
 	}
 }
 
+/// Start a new resolver attempt on the directly targeted endpoints.
+void resolver_impl::udp_direct_burst() {
+	// start one per IP stack under consideration
+	for (unsigned k=0,failures=0;k<udp_protocols_.size();k++) {
+		try {
+			resolve_attempt_udp_p attempt(new resolve_attempt_udp(*io_,udp_protocols_[k],direct_endpoints_,query_,results_,results_mut_,cfg_->unicast_max_rtt(),this));
+			attempt->begin();
+		} catch(std::exception &e) {
+			if (++failures == udp_protocols_.size())
+				std::cerr << "Could not start a directed resolve attempt for any of the allowed protocol stacks: " << e.what() << std::endl;
+		}
+	}
+}
+
 /// This handler is called when the overall resolve timeout (if any) expires.
 void resolver_impl::resolve_timeout_expired(error_code err) {
 	if (err != error::operation_aborted)
@@ -63,6 +63,17 @@ namespace lsl {
 		*/
 		std::vector<stream_info_impl> resolve_oneshot(const std::string &query, int minimum=0, double timeout=FOREVER, double minimum_time=0.0);
 
+		/**
+		* Resolve a query string by probing only a given set of UDP endpoints (e.g., the last known location of a stream).
+		* No multicast or known-peer traffic is generated; the probe is re-sent to the targets every recovery_probe_interval
+		* (see API config) until the minimum number of streams has been resolved, or the timeout fires, or the resolve has been cancelled.
+		* @param query The query string to send (see resolve_oneshot()).
+		* @param targets The UDP service endpoints to probe; endpoints not matching an allowed protocol stack are ignored.
+		* @param minimum The minimum number of unique streams that should be resolved before this function may to return.
+		* @param timeout The timeout after which this function is forced to return (even if it did not produce the desired number of results).
+		*/
+		std::vector<stream_info_impl> resolve_direct(const std::string &query, const std::vector<udp::endpoint> &targets, int minimum=1, double timeout=1.0);
+
 		/**
 		* Starts a background thread that resolves a query string and periodically updates the list of present streams.
 		* After this, the resolver can *not* be repurposed for other queries or for oneshot operation (a new instance needs to be created for that).
@@ -83,6 +94,9 @@ namespace lsl {
 		void cancel();
 
 	private:
+		/// Run a oneshot resolve with the current settings until finished and return the results.
+		std::vector<stream_info_impl> run_oneshot(double timeout);
+
 		/// This function starts a new wave of resolves.
 		void next_resolve_wave();
 
@@ -92,6 +106,9 @@ namespace lsl {
 		/// Start a new resolver attempt on the known peers.
 		void udp_unicast_burst(error_code err);
 
+		/// Start a new resolver attempt on the directly targeted endpoints.
+		void udp_direct_burst();
+
 		/// This handler is called when the overall timeout (if any) expires.
 		void resolve_timeout_expired(error_code err);
 
@@ -119,6 +136,7 @@ namespace lsl {
 		double forget_after_;							// forget results that are older than this (continuous operation only)
 		double wait_until_;								// wait until this point in time before returning results (optional to allow for returning potentially more than a minimum number of results)
 		bool fast_mode_;								// whether this is a fast resolve: determines the rate at which the query is repeated
+		std::vector<udp::endpoint> direct_endpoints_;	// if non-empty, only these endpoints are probed (directed resolve)
 		result_container results_;						// results are stored here
 		lslboost::mutex results_mut_;						// a mutex that protects the results map
 
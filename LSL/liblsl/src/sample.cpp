@@ -1,9 +1,54 @@
 #include "sample.h"
+#include "api_config.h"
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 // === implementation of the sample class ===
 
 using namespace lsl;
 
+/// the size of a memory page, to which large samples are aligned
+const std::size_t page_size = 4096;
+
+/// The number of bytes to allocate for a sample (large samples are padded to whole memory pages).
+lslboost::uint32_t sample::factory::allocation_size(channel_format_t fmt, int num_chans) {
+	lslboost::uint32_t size = ensure_multiple(sizeof(sample)-sizeof(char)+format_sizes[fmt]*num_chans,16);
+	return (size >= (lslboost::uint32_t)api_config::get_instance()->large_sample_bytes()) ? ensure_multiple(size,page_size) : size;
+}
+
+/// The number of samples to pre-allocate (capped for large samples).
+int sample::factory::reserve_count(int sample_size, int num_reserve) {
+	const api_config *cfg = api_config::get_instance();
+	return (sample_size >= cfg->large_sample_bytes()) ? std::min(num_reserve,cfg->large_sample_reserve()) : num_reserve;
+}
+
+/// Allocate memory for one or more samples (page-aligned if it holds large samples).
+char *sample::factory::allocate(std::size_t bytes) {
+	std::size_t alignment = (bytes >= (std::size_t)api_config::get_instance()->large_sample_bytes()) ? page_size : 16;
+#ifdef _WIN32
+	void *result = _aligned_malloc(bytes,alignment);
+#else
+	void *result = NULL;
+	if (posix_memalign(&result,alignment,bytes))
+		result = NULL;
+#endif
+	if (!result)
+		throw std::bad_alloc();
+	return (char*)result;
+}
+
+/// Free memory that was allocated with allocate().
+void sample::factory::deallocate(void *p) {
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
 /// Compare two samples for equality (based on content).
 bool sample::operator==(const sample &rhs) {
 	if ((timestamp != rhs.timestamp) || (format_ != rhs.format_) || (num_channels_ != rhs.num_channels_))
@@ -32,6 +77,8 @@ sample &sample::assign_typed(const std::string *s) {
 #ifndef BOOST_NO_INT64_T
 		case cf_int64:    for (lslboost::int64_t *p=(lslboost::int64_t*)&data_,*e=p+num_channels_; p<e; *p++ = lslboost::lexical_cast<lslboost::int64_t>(*s++)); break;
 #endif
+		case cf_float16:  for (lslboost::uint16_t *p=(lslboost::uint16_t*)&data_,*e=p+num_channels_; p<e; *p++ = float_to_half(lslboost::lexical_cast<float>(*s++))); break;
+		case cf_int24:    for (char *p=&data_,*e=p+3*num_channels_; p<e; p+=3) store_int24(p,lslboost::lexical_cast<lslboost::int32_t>(*s++)); break;
 		default: throw std::invalid_argument("Unsupported channel format.");
 	}
 	return *this;
@@ -49,6 +96,8 @@ sample &sample::retrieve_typed(std::string *d) {
 #ifndef BOOST_NO_INT64_T
 		case cf_int64:    for (lslboost::int64_t *p=(lslboost::int64_t*)&data_,*e=p+num_channels_; p<e; *d++ = lslboost::lexical_cast<std::string>(*p++)); break; 
 #endif
+		case cf_float16:  for (lslboost::uint16_t *p=(lslboost::uint16_t*)&data_,*e=p+num_channels_; p<e; *d++ = lslboost::lexical_cast<std::string>(half_to_float(*p++))); break; 
+		case cf_int24:    for (char *p=&data_,*e=p+3*num_channels_; p<e; p+=3) *d++ = lslboost::lexical_cast<std::string>(load_int24(p)); break; 
 		default: throw std::invalid_argument("Unsupported channel format.");
 	}
 	return *this;
@@ -105,6 +154,18 @@ sample &sample::assign_test_pattern(int offset) {
 			break;
 					  }
 #endif
+		case cf_float16: {
+			lslboost::uint16_t *data = (lslboost::uint16_t*)&data_;
+			for (int k=0; k<num_channels_; k++)
+				data[k] = float_to_half(((float)k + (float)offset) * (k%2==0 ? 1 : -1));
+			break;
+						 }
+		case cf_int24: {
+			char *data = &data_;
+			for (int k=0; k<num_channels_; k++)
+				store_int24(&data[3*k],((k + offset + 65537)%8388607) * (k%2==0 ? 1 : -1));
+			break;
+					   }
 		default:
 			throw std::invalid_argument("Unsupported channel format used to construct a sample.");
 	}
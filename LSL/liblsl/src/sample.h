@@ -2,6 +2,7 @@
 #define SAMPLE_H
 
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <iostream>
@@ -11,9 +12,13 @@
 #include <boost/intrusive_ptr.hpp>
 #include <boost/atomic.hpp>
 #include <boost/static_assert.hpp>
+#include <boost/mpl/bool.hpp>
 #include <boost/serialization/split_member.hpp>
+#include <boost/thread/mutex.hpp>
 #include "endian/conversion.hpp"
 #include "common.h"
+#include "memory_budget.h"
+#include "packed_formats.h"
 
 namespace lsl {
 	// if you get an error here your machine cannot represent the double-precision time-stamp format required by LSL
@@ -24,11 +29,11 @@ namespace lsl {
 	const lslboost::uint8_t TAG_TRANSMITTED_TIMESTAMP = 2;
 
 	/// channel format properties
-	const int format_sizes[] = {0,sizeof(float),sizeof(double),sizeof(std::string),sizeof(lslboost::int32_t),sizeof(lslboost::int16_t),sizeof(lslboost::int8_t),8};
-	const bool format_ieee754[] = {false,std::numeric_limits<float>::is_iec559,std::numeric_limits<double>::is_iec559,false,false,false,false,false}; 
-	const bool format_subnormal[] = {false,std::numeric_limits<float>::has_denorm!=std::denorm_absent,std::numeric_limits<double>::has_denorm!=std::denorm_absent,false,false,false,false,false}; 
-	const bool format_integral[] = {false,false,false,false,true,true,true,true}; 
-	const bool format_float[] = {false,true,true,false,false,false,false,false}; 
+	const int format_sizes[] = {0,sizeof(float),sizeof(double),sizeof(std::string),sizeof(lslboost::int32_t),sizeof(lslboost::int16_t),sizeof(lslboost::int8_t),8,2,3};
+	const bool format_ieee754[] = {false,std::numeric_limits<float>::is_iec559,std::numeric_limits<double>::is_iec559,false,false,false,false,false,true,false}; 
+	const bool format_subnormal[] = {false,std::numeric_limits<float>::has_denorm!=std::denorm_absent,std::numeric_limits<double>::has_denorm!=std::denorm_absent,false,false,false,false,false,false,false}; 
+	const bool format_integral[] = {false,false,false,false,true,true,true,true,false,true}; 
+	const bool format_float[] = {false,true,true,false,false,false,false,false,true,false}; 
  
 	/// smart pointer to a sample
 	typedef lslboost::intrusive_ptr<class sample> sample_p;
@@ -62,20 +67,23 @@ namespace lsl {
 		class factory {
 		public:
 			/// Create a new factory and optionally pre-allocate samples.
+			/// Large samples (see api_config::large_sample_bytes()) are padded to whole memory pages and at most
+			/// api_config::large_sample_reserve() of them are pre-allocated.
 			factory(channel_format_t fmt, int num_chans, int num_reserve): fmt_(fmt), num_chans_(num_chans), 
-				sample_size_(ensure_multiple(sizeof(sample)-sizeof(char)+format_sizes[fmt]*num_chans,16)), storage_size_(sample_size_*std::max(1,num_reserve)), 
-				storage_(new char[storage_size_]), sentinel_(new_sample_unmanaged(fmt,num_chans,0.0,false)), head_(sentinel_), tail_(sentinel_)
+				sample_size_(allocation_size(fmt,num_chans)), storage_size_(sample_size_*std::max(1,reserve_count(sample_size_,num_reserve))), 
+				storage_(allocate(storage_size_)), sentinel_(new_sample_unmanaged(fmt,num_chans,0.0,false)), head_(sentinel_), tail_(sentinel_), heap_size_(0)
 			{
 				// pre-construct an array of samples in the storage area and chain into a freelist
 				sample *s = NULL;
-				for (char *p=storage_.get(),*e=p+storage_size_;p<e;) {
+				for (char *p=storage_,*e=p+storage_size_;p<e;) {
 					#pragma warning(suppress: 4291)
 					s = new((sample*)p) sample(fmt,num_chans,this);
 					s->next_ = (sample*)(p += sample_size_);
 				}
 				s->next_ = NULL;
 				head_.store(s);
-				sentinel_->next_ = (sample*)storage_.get();
+				sentinel_->next_ = (sample*)storage_;
+				memory_budget::get_instance().add(storage_size_);
 			}
 
 			/// Destroy the factory and delete all of its samples.
@@ -84,20 +92,50 @@ namespace lsl {
 					for (sample *next=cur->next_;next;cur=next,next=next->next_)
 						delete cur;
 				delete sentinel_;
+				deallocate(storage_);
+				memory_budget::get_instance().remove(storage_size_ + heap_size_);
 			}
 
 			/// Create a new sample with a given timestamp and pushthrough flag.
 			/// Only one thread may call this function for a given factory object.
 			sample_p new_sample(double timestamp, bool pushthrough) { 
-				sample *result = pop_freelist();
-				if (!result)
-					#pragma warning(suppress: 4291)
-					result = new(new char[sample_size_]) sample(fmt_,num_chans_,this);
+				sample *result = take_sample();
 				result->timestamp = timestamp;
 				result->pushthrough = pushthrough;
 				return sample_p(result);
 			}
 
+			/// Create a new sample on a thread other than the producer (e.g., a server's wakeup sample).
+			/// This is serialized with take_samples(), so it may be called while several threads take samples for their caches;
+			/// a single producer that calls new_sample() must not run at the same time (the outlet only does this while being destroyed).
+			sample_p new_sample_locked(double timestamp, bool pushthrough) {
+				lslboost::mutex::scoped_lock lock(take_mut_);
+				return new_sample(timestamp,pushthrough);
+			}
+
+			/// Take a batch of samples for the cache of one of several threads that create samples (see stream_outlet_impl).
+			/// Unlike new_sample(), this may be called by multiple threads at the same time (but not together with new_sample()).
+			/// The samples are appended to the given vector; they return to the factory when their last sample_p is released
+			/// (or via release_sample() if they are never used).
+			void take_samples(std::vector<sample*> &cache) {
+				// large samples are taken one at a time, so that idle threads don't sit on much memory
+				int count = std::max(1,std::min(32,65536/sample_size_));
+				lslboost::mutex::scoped_lock lock(take_mut_);
+				while (count--)
+					cache.push_back(take_sample());
+			}
+
+			/// Release a sample that's no longer used: return it to the freelist, or to the system if it was allocated
+			/// beyond the pre-allocated storage while the memory budget is exceeded.
+			void release_sample(sample *s) {
+				if (!in_storage(s) && memory_budget::get_instance().exceeded()) {
+					heap_size_.fetch_sub(sample_size_,lslboost::memory_order_relaxed);
+					memory_budget::get_instance().remove(sample_size_);
+					delete s;
+				} else
+					reclaim_sample(s);
+			}
+
 			/// Reclaim a sample that's no longer used.
 			void reclaim_sample(sample *s) { 
 				s->next_ = NULL;
@@ -108,16 +146,51 @@ namespace lsl {
 			/// Create a new sample whose memory is not managed by the factory.
 			static sample *new_sample_unmanaged(channel_format_t fmt, int num_chans, double timestamp, bool pushthrough) { 
 				#pragma warning(suppress: 4291)
-				sample *result = new(new char[ensure_multiple(sizeof(sample)-sizeof(char) + format_sizes[fmt]*num_chans,16)]) sample(fmt,num_chans,NULL);
+				sample *result = new(allocate(allocation_size(fmt,num_chans))) sample(fmt,num_chans,NULL);
 				result->timestamp = timestamp;
 				result->pushthrough = pushthrough;
 				return result;
 			}
 
 		private:
+			/// Check whether a sample lies in the pre-allocated storage area.
+			bool in_storage(const sample *s) const { return ((const char*)s) >= storage_ && ((const char*)s) <= storage_+storage_size_; }
+
 			/// ensure that a given value is a multiple of some base, round up if necessary
 			static lslboost::uint32_t ensure_multiple(lslboost::uint32_t v, unsigned base) { return (v%base) ? v - (v%base) + base : v; }
 
+			/// The number of bytes to allocate for a sample (large samples are padded to whole memory pages).
+			static lslboost::uint32_t allocation_size(channel_format_t fmt, int num_chans);
+
+			/// The number of samples to pre-allocate (capped for large samples).
+			static int reserve_count(int sample_size, int num_reserve);
+
+			/// Allocate memory for one or more samples (page-aligned if it holds large samples).
+			static char *allocate(std::size_t bytes);
+
+			/// Free memory that was allocated with allocate().
+			static void deallocate(void *p);
+
+			/// Take a sample from the freelist, or allocate a new one if the freelist is empty.
+			sample *take_sample() {
+				sample *result = pop_freelist();
+				if (!result) {
+					memory_budget &budget = memory_budget::get_instance();
+					if (budget.exceeded()) {
+						// make room within the memory budget (this may return some of our samples to the freelist)
+						budget.enforce();
+						result = pop_freelist();
+					}
+					if (!result) {
+						#pragma warning(suppress: 4291)
+						result = new(allocate(sample_size_)) sample(fmt_,num_chans_,this);
+						heap_size_.fetch_add(sample_size_,lslboost::memory_order_relaxed);
+						budget.add(sample_size_);
+					}
+				}
+				return result;
+			}
+
 			// Pop a sample from the freelist
 			// (multi-producer/single-consumer queue by Dmitry Vjukov)
 			sample *pop_freelist(){ 
@@ -150,10 +223,12 @@ namespace lsl {
 			int num_chans_;							// the number of channels to construct samples with
 			int sample_size_;						// size of a sample, in bytes
 			int storage_size_;						// size of the allocated storage, in bytes
-			lslboost::scoped_array<char> storage_;		// a slab of storage for pre-allocated samples
+			char *storage_;							// a slab of storage for pre-allocated samples
 			sample *sentinel_;						// a sentinel element for our freelist
 			lslboost::atomic<sample*> head_;			// head of the freelist
 			sample *tail_;							// tail of the freelist
+			lslboost::atomic<std::size_t> heap_size_;	// the memory of the samples allocated beyond the storage area, in bytes
+			lslboost::mutex take_mut_;				// serializes the threads that take samples for their caches
 		};
 
 
@@ -167,8 +242,8 @@ namespace lsl {
 		void operator delete(void *x) {
 			// delete the underlying memory only if it wasn't allocated in the factory's storage area
 			sample *s = (sample*)x;
-			if (s && !(s->factory_ && (((char*)s) >= s->factory_->storage_.get() && ((char*)s) <= s->factory_->storage_.get()+s->factory_->storage_size_)))
-				delete[] (char*)x;
+			if (s && !(s->factory_ && s->factory_->in_storage(s)))
+				factory::deallocate(x);
 		}
 
 		/// Test for equality with another sample.
@@ -190,6 +265,18 @@ namespace lsl {
 #ifndef BOOST_NO_INT64_T
 					case cf_int64:    for (lslboost::int64_t *p=(lslboost::int64_t*)&data_,*e=p+num_channels_; p<e; *p++ = (lslboost::int64_t)*s++); break; 
 #endif
+					case cf_float16:
+						if (lslboost::is_same<typename lslboost::remove_const<T>::type,float>::value)
+							pack_half((const float*)s,(lslboost::uint16_t*)&data_,num_channels_);
+						else
+							for (lslboost::uint16_t *p=(lslboost::uint16_t*)&data_,*e=p+num_channels_; p<e; *p++ = float_to_half((float)*s++));
+						break;
+					case cf_int24:
+						if (lslboost::is_same<typename lslboost::remove_const<T>::type,lslboost::int32_t>::value)
+							pack_int24((const lslboost::int32_t*)s,&data_,num_channels_);
+						else
+							for (char *p=&data_,*e=p+3*num_channels_; p<e; p+=3) store_int24(p,(lslboost::int32_t)*s++);
+						break;
 					case cf_string:   for (std::string    *p=(std::string*)   &data_,*e=p+num_channels_; p<e; *p++ = lslboost::lexical_cast<std::string>(*s++)); break; 
 					default: throw std::invalid_argument("Unsupported channel format.");
 				}
@@ -211,6 +298,18 @@ namespace lsl {
 #ifndef BOOST_NO_INT64_T
 					case cf_int64:    for (lslboost::int64_t *p=(lslboost::int64_t*)&data_,*e=p+num_channels_; p<e; *d++ = (T)*p++); break; 
 #endif
+					case cf_float16:
+						if (lslboost::is_same<T,float>::value)
+							unpack_half((const lslboost::uint16_t*)&data_,(float*)d,num_channels_);
+						else
+							for (lslboost::uint16_t *p=(lslboost::uint16_t*)&data_,*e=p+num_channels_; p<e; *d++ = (T)half_to_float(*p++));
+						break;
+					case cf_int24:
+						if (lslboost::is_same<T,lslboost::int32_t>::value)
+							unpack_int24(&data_,(lslboost::int32_t*)d,num_channels_);
+						else
+							for (char *p=&data_,*e=p+3*num_channels_; p<e; p+=3) *d++ = (T)load_int24(p);
+						break;
 					case cf_string:   for (std::string    *p=(std::string*)   &data_,*e=p+num_channels_; p<e; *d++ = lslboost::lexical_cast<T>(*p++)); break; 
 					default: throw std::invalid_argument("Unsupported channel format.");
 				}
@@ -235,6 +334,13 @@ namespace lsl {
 			return *this; 
 		}
 
+		/// Get a pointer to the numeric data of the sample (so that it can be written in place).
+		void *untyped_data() {
+			if (format_ == cf_string)
+				throw std::invalid_argument("Cannot access the untyped data of a string-formatted sample.");
+			return &data_;
+		}
+
 		/// Retrieve numeric data from the sample.
 		sample &retrieve_untyped(void *newdata) { 
 			if (format_ != cf_string)
@@ -277,14 +383,19 @@ namespace lsl {
 		/// Load a value from a stream buffer; specialization of the above.
 		template<class StreamBuf> void load_value(StreamBuf &sb, lslboost::uint8_t &v, int use_byte_order) { load_raw(sb,&v,sizeof(v)); }
 
-		/// Serialize a sample to a stream buffer (protocol 1.10).
-		template<class StreamBuf> void save_streambuf(StreamBuf &sb, int protocol_version, int use_byte_order, void *scratchpad=NULL) const {
+		/**
+		* Serialize a sample to a stream buffer (protocol 1.10).
+		* If the time stamp is to be deduced by the receiver but the receiver may not have seen the preceding sample
+		* (e.g., at the start of a datagram), the deduced value can be given to transmit it instead.
+		*/
+		template<class StreamBuf> void save_streambuf(StreamBuf &sb, int protocol_version, int use_byte_order, void *scratchpad=NULL, double deduced_timestamp=DEDUCED_TIMESTAMP) const {
 			// write sample header
-			if (timestamp == DEDUCED_TIMESTAMP) {
+			double stamp = (timestamp == DEDUCED_TIMESTAMP) ? deduced_timestamp : timestamp;
+			if (stamp == DEDUCED_TIMESTAMP) {
 				save_value(sb,TAG_DEDUCED_TIMESTAMP,use_byte_order);
 			} else {
 				save_value(sb,TAG_TRANSMITTED_TIMESTAMP,use_byte_order);
-				save_value(sb,timestamp,use_byte_order);
+				save_value(sb,stamp,use_byte_order);
 			}
 			// write channel data
 			if (format_ == cf_string) {
@@ -366,7 +477,7 @@ namespace lsl {
 						for (lslboost::uint32_t *p=(lslboost::uint32_t*)&data_,*e=p+num_channels_; p<e; p++)
 							if (*p && ((*p & UINT32_C(0x7fffffff)) <= UINT32_C(0x007fffff)))
 								*p &= UINT32_C(0x80000000);
-					} else {
+					} else if (format_ == cf_double64) {
 #ifndef BOOST_NO_INT64_T
 						for (lslboost::uint64_t *p=(lslboost::uint64_t*)&data_,*e=p+num_channels_; p<e; p++)
 							if (*p && ((*p & UINT64_C(0x7fffffffffffffff)) <= UINT64_C(0x000fffffffffffff)))
@@ -382,6 +493,7 @@ namespace lsl {
 			switch (format_sizes[format_]) {
 				case 1: break;
 				case sizeof(lslboost::int16_t): for (lslboost::int16_t *p=(lslboost::int16_t*)data,*e=p+num_channels_; p<e; lslboost::endian::reverse(*p++)); break;
+				case 3: for (char *p=(char*)data,*e=p+3*num_channels_; p<e; p+=3) std::swap(p[0],p[2]); break;
 				case sizeof(lslboost::int32_t): for (lslboost::int32_t *p=(lslboost::int32_t*)data,*e=p+num_channels_; p<e; lslboost::endian::reverse(*p++)); break;
 #ifndef BOOST_NO_INT64_T
 				case sizeof(lslboost::int64_t): for (lslboost::int64_t *p=(lslboost::int64_t*)data,*e=p+num_channels_; p<e; lslboost::endian::reverse(*p++)); break;
@@ -422,19 +534,38 @@ namespace lsl {
 		/// Serialize (read/write) the channel data.
 		template<class Archive> void serialize_channels(Archive &ar, const unsigned int archive_version) {
 			switch (format_) {
-				case cf_float32:  for (float          *p=(float*)         &data_,*e=p+num_channels_; p<e; ar & *p++); break;
-				case cf_double64: for (double         *p=(double*)        &data_,*e=p+num_channels_; p<e; ar & *p++); break;
+				case cf_float32:  serialize_values(ar,(float*)&data_,num_channels_); break;
+				case cf_double64: serialize_values(ar,(double*)&data_,num_channels_); break;
 				case cf_string:   for (std::string    *p=(std::string*)   &data_,*e=p+num_channels_; p<e; ar & *p++); break;
-				case cf_int8:     for (lslboost::int8_t  *p=(lslboost::int8_t*) &data_,*e=p+num_channels_; p<e; ar & *p++); break;
-				case cf_int16:    for (lslboost::int16_t *p=(lslboost::int16_t*)&data_,*e=p+num_channels_; p<e; ar & *p++); break;
-				case cf_int32:    for (lslboost::int32_t *p=(lslboost::int32_t*)&data_,*e=p+num_channels_; p<e; ar & *p++); break;
+				case cf_int8:     serialize_values(ar,(lslboost::int8_t*)&data_,num_channels_); break;
+				case cf_int16:    serialize_values(ar,(lslboost::int16_t*)&data_,num_channels_); break;
+				case cf_int32:    serialize_values(ar,(lslboost::int32_t*)&data_,num_channels_); break;
 #ifndef BOOST_NO_INT64_T
-				case cf_int64:    for (lslboost::int64_t *p=(lslboost::int64_t*)&data_,*e=p+num_channels_; p<e; ar & *p++); break;
+				case cf_int64:    serialize_values(ar,(lslboost::int64_t*)&data_,num_channels_); break;
 #endif
+				case cf_float16:  serialize_values(ar,(lslboost::uint16_t*)&data_,num_channels_); break;
+				case cf_int24:
+					// the portable archive has no 24-bit type, so the values are transferred as 32-bit integers
+					// (saving only reads the sample, since several sessions may serialize it at the same time)
+					for (int k=0,n; k<num_channels_; k+=n) {
+						lslboost::int32_t values[256];
+						n = std::min(num_channels_-k,256);
+						if (Archive::is_saving::value)
+							unpack_int24(&data_+3*k,values,n);
+						serialize_values(ar,values,n);
+						if (!Archive::is_saving::value)
+							pack_int24(values,&data_+3*k,n);
+					}
+					break;
 				default: throw std::runtime_error("Unsupported channel format.");
 			}
 		}
 
+		/// Serialize (read/write) an array of numeric values in one block (see eos::portable_oarchive::save_values()).
+		template<class Archive, typename T> static void serialize_values(Archive &ar, T *values, std::size_t count) { serialize_values(ar,values,count,typename Archive::is_saving()); }
+		template<class Archive, typename T> static void serialize_values(Archive &ar, const T *values, std::size_t count, lslboost::mpl::true_) { ar.save_values(values,count); }
+		template<class Archive, typename T> static void serialize_values(Archive &ar, T *values, std::size_t count, lslboost::mpl::false_) { ar.load_values(values,count); }
+
 		BOOST_SERIALIZATION_SPLIT_MEMBER()		
 
 		/// Assign a test pattern to the sample (for protocol validation)
@@ -456,7 +587,7 @@ namespace lsl {
 		friend void intrusive_ptr_release(sample *s) {
 			if (s->refcount_.fetch_sub(1,lslboost::memory_order_release) == 1) {
 				lslboost::atomic_thread_fence(lslboost::memory_order_acquire);
-				s->factory_->reclaim_sample(s);
+				s->factory_->release_sample(s);
 			}
 		}
 	};
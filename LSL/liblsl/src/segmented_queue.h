@@ -0,0 +1,158 @@
+#ifndef SEGMENTED_QUEUE_H
+#define SEGMENTED_QUEUE_H
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/thread.hpp>
+
+
+namespace lsl {
+
+	/**
+	* A bounded single-producer queue whose storage grows and shrinks in fixed-size segments.
+	*
+	* Unlike a ring buffer, which allocates all of its slots up front, the queue only holds the segments that
+	* contain elements (plus one spare segment that is kept to avoid allocating at every segment boundary).
+	* This matters since consumer queues are sized for the worst case (minutes of data) but are nearly empty
+	* most of the time.
+	*
+	* Pushes must come from a single thread and are lock-free. Pops normally come from a single consumer
+	* thread, but the producer may pop, too (to drop the oldest element when the queue is full), so the pop
+	* side is serialized by a flag that is uncontended in the common case.
+	*
+	* Optionally, each segment is stamped with the time at which its first element was pushed, which gives
+	* the approximate age of the oldest element at the cost of one clock reading per segment.
+	*/
+	template<class T, std::size_t SegmentSize=256> class segmented_queue: public lslboost::noncopyable {
+		/// A segment of the queue's storage.
+		struct segment {
+			segment(): next(NULL), stamp(0.0) {}
+			lslboost::atomic<segment*> next;	// the next (newer) segment
+			double stamp;						// the time at which the first element was pushed into the segment (if stamped)
+			T items[SegmentSize];				// the elements
+		};
+
+	public:
+		/// A clock with which the segments are stamped.
+		typedef double (*stamp_fn)();
+
+		/**
+		* Create a new queue.
+		* @param capacity The maximum number of elements that the queue can hold.
+		* @param stamp Optionally a clock with which the segments are stamped (see front_stamp()).
+		*/
+		explicit segmented_queue(std::size_t capacity, stamp_fn stamp=NULL): capacity_(capacity), stamp_(stamp), write_count_(0), read_count_(0), spare_(NULL), popping_(false) {
+			head_ = tail_ = new segment();
+			head_pos_ = tail_pos_ = 0;
+		}
+
+		/// Destroy the queue and its elements.
+		~segmented_queue() {
+			for (segment *s=head_,*next; s; s=next) {
+				next = s->next.load();
+				delete s;
+			}
+			delete spare_.load();
+		}
+
+		/**
+		* Append an element to the queue (producer only).
+		* @return False if the queue is full.
+		*/
+		bool push(const T &t) {
+			lslboost::uint64_t w = write_count_.load(lslboost::memory_order_relaxed);
+			if (w - read_count_.load(lslboost::memory_order_acquire) >= capacity_)
+				return false;
+			if (tail_pos_ == SegmentSize) {
+				// the current segment is full: continue in a new (or the spare) one
+				segment *s = spare_.exchange(NULL,lslboost::memory_order_acquire);
+				if (s)
+					s->next.store(NULL,lslboost::memory_order_relaxed);
+				else
+					s = new segment();
+				tail_->next.store(s,lslboost::memory_order_relaxed);
+				tail_ = s;
+				tail_pos_ = 0;
+			}
+			if (stamp_ && !tail_pos_)
+				tail_->stamp = stamp_();
+			tail_->items[tail_pos_++] = t;
+			// publish the element (and the link to a new segment, if any)
+			write_count_.store(w+1,lslboost::memory_order_release);
+			return true;
+		}
+
+		/**
+		* Remove the oldest element from the queue.
+		* @param t Receives the element.
+		* @param position Optionally receives the position of the element in the sequence of all elements pushed so far.
+		* @return False if the queue is empty.
+		*/
+		bool pop(T &t, lslboost::uint64_t *position=NULL) {
+			while (popping_.exchange(true,lslboost::memory_order_acquire))
+				lslboost::this_thread::yield();
+			bool result = false;
+			lslboost::uint64_t r = read_count_.load(lslboost::memory_order_relaxed);
+			if (r != write_count_.load(lslboost::memory_order_acquire)) {
+				if (head_pos_ == SegmentSize) {
+					// the head segment is drained: move on and release it
+					segment *old = head_;
+					head_ = old->next.load(lslboost::memory_order_relaxed);
+					head_pos_ = 0;
+					delete spare_.exchange(old,lslboost::memory_order_release);
+				}
+				t = head_->items[head_pos_];
+				// release the element's resources right away
+				head_->items[head_pos_++] = T();
+				read_count_.store(r+1,lslboost::memory_order_release);
+				if (position)
+					*position = r;
+				result = true;
+			}
+			popping_.store(false,lslboost::memory_order_release);
+			return result;
+		}
+
+		/**
+		* Get the stamp of the segment that holds the oldest element, i.e., a time no later than the push of that element
+		* (requires a stamping clock).
+		* @return False if the queue is empty.
+		*/
+		bool front_stamp(double &stamp) {
+			while (popping_.exchange(true,lslboost::memory_order_acquire))
+				lslboost::this_thread::yield();
+			bool result = false;
+			if (read_count_.load(lslboost::memory_order_relaxed) != write_count_.load(lslboost::memory_order_acquire)) {
+				stamp = (head_pos_ == SegmentSize ? head_->next.load(lslboost::memory_order_relaxed) : head_)->stamp;
+				result = true;
+			}
+			popping_.store(false,lslboost::memory_order_release);
+			return result;
+		}
+
+		/// Check whether the queue is empty (may be outdated if the queue is concurrently modified).
+		bool empty() const { return read_count_.load(lslboost::memory_order_acquire) == write_count_.load(lslboost::memory_order_acquire); }
+
+		/// Get the maximum number of elements that the queue can hold.
+		std::size_t capacity() const { return capacity_; }
+
+	private:
+		std::size_t capacity_;								// the maximum number of elements
+		stamp_fn stamp_;									// the clock with which the segments are stamped (if any)
+		// producer side
+		segment *tail_;										// the segment that receives the next element
+		std::size_t tail_pos_;								// the slot in the tail segment that receives the next element
+		lslboost::atomic<lslboost::uint64_t> write_count_;	// the number of elements pushed so far
+		// consumer side
+		segment *head_;										// the segment that holds the oldest element
+		std::size_t head_pos_;								// the slot of the oldest element in the head segment
+		lslboost::atomic<lslboost::uint64_t> read_count_;	// the number of elements popped so far
+		// shared
+		lslboost::atomic<segment*> spare_;					// a drained segment that is kept for reuse (if any)
+		lslboost::atomic<bool> popping_;					// serializes the pops
+	};
+
+}
+
+#endif
@@ -1,3 +1,5 @@
+#include <iostream>
+#include "api_config.h"
 #include "send_buffer.h"
 #include <boost/bind.hpp>
 
@@ -10,7 +12,22 @@ using namespace lsl;
 * Create a new send buffer.
 * @param max_capacity Hard upper bound on queue capacity beyond which the oldest samples will be dropped.
 */
-send_buffer::send_buffer(int max_capacity): max_capacity_(max_capacity) {} 
+send_buffer::send_buffer(int max_capacity): max_capacity_(max_capacity), room_waiters_(0), retired_high_water_(0), retired_dropped_(0), retired_spilled_(0) {
+	const std::string &policy = api_config::get_instance()->overflow_policy();
+	overflow_policy_ = lsl_overflow_spill;
+	if (policy == "block")
+		overflow_policy_ = lsl_overflow_block;
+	else if (policy == "drop")
+		overflow_policy_ = lsl_overflow_drop;
+	else if (policy != "spill") {
+		// the configuration is the same for all outlets, so this is only reported once
+		static bool warned = false;
+		if (!warned) {
+			warned = true;
+			std::cerr << "Unsupported overflow policy " << policy << "; spilling the samples of full lossless queues instead." << std::endl;
+		}
+	}
+}
 
 
 /**
@@ -26,15 +43,66 @@ consumer_queue_p send_buffer::new_consumer(int max_buffered) {
 	return consumer_queue_p(new consumer_queue(max_buffered, shared_from_this())); 
 }
 
+/**
+* Add a new lossless consumer to the send buffer.
+* @param max_buffered If non-zero, the queue size for this consumer will be constrained to be no larger than this value.
+* @param fmt The channel format of the samples.
+* @param num_chans The number of channels of the samples.
+* @return Shared pointer to the newly created queue.
+*/
+consumer_queue_p send_buffer::new_lossless_consumer(int max_buffered, channel_format_t fmt, int num_chans) {
+	max_buffered = max_buffered ? std::min(max_buffered,max_capacity_) : max_capacity_;
+	return consumer_queue_p(new consumer_queue(max_buffered, shared_from_this(), true, fmt, num_chans));
+}
+
 
 /**
-* Push a sample onto the send buffer.
-* Will subsequently be seen by all consumers.
+* Push a batch of samples onto the send buffer.
+* Will subsequently be seen by all consumers, in one piece.
 */
-void send_buffer::push_sample(const sample_p &s) {
-	lslboost::lock_guard<lslboost::mutex> lock(consumers_mut_);
-	for (consumer_set::iterator i=consumers_.begin(); i != consumers_.end(); i++)
-		(*i)->push_sample(s);
+void send_buffer::push_samples(const sample_p *samples, std::size_t num_samples) {
+	if (overflow_policy() == lsl_overflow_block) {
+		// wait for room before each sample; other producers are held back meanwhile, so that the batch stays in one piece
+		lslboost::lock_guard<lslboost::mutex> publishing(publish_mut_);
+		for (std::size_t k=0; k<num_samples; k++) {
+			wait_for_lossless_consumers();
+			lslboost::lock_guard<lslboost::mutex> lock(consumers_mut_);
+			for (consumer_set::iterator i=consumers_.begin(); i != consumers_.end(); i++)
+				(*i)->push_sample(samples[k]);
+		}
+	} else {
+		lslboost::lock_guard<lslboost::mutex> lock(consumers_mut_);
+		for (consumer_set::iterator i=consumers_.begin(); i != consumers_.end(); i++)
+			for (std::size_t k=0; k<num_samples; k++)
+				(*i)->push_sample(samples[k]);
+	}
+}
+
+
+/// Wait until all lossless consumers have room for another sample.
+void send_buffer::wait_for_lossless_consumers() {
+	lslboost::unique_lock<lslboost::mutex> lock(consumers_mut_);
+	room_waiters_++;
+	while (true) {
+		// the fence pairs with the one in consumer_queue::notify_room(), so that either we see the room or the consumer sees us waiting
+		lslboost::atomic_thread_fence(lslboost::memory_order_seq_cst);
+		bool room = true;
+		for (consumer_set::iterator i=consumers_.begin(); i != consumers_.end() && room; i++)
+			room = !((*i)->lossless() && (*i)->full());
+		if (room)
+			break;
+		// the lock is released while waiting, so that the consumers can come and go
+		room_made_.wait(lock);
+	}
+	room_waiters_--;
+}
+
+/// Wake up a producer that waits for room in the lossless consumers (called by a consumer_queue that has made room).
+void send_buffer::notify_room() {
+	if (room_waiters_.load(lslboost::memory_order_relaxed)) {
+		lslboost::lock_guard<lslboost::mutex> lock(consumers_mut_);
+		room_made_.notify_all();
+	}
 }
 
 
@@ -50,7 +118,14 @@ void send_buffer::register_consumer(consumer_queue *q) {
 /// Unregister a previously registered consumer.
 void send_buffer::unregister_consumer(consumer_queue *q) {
 	lslboost::lock_guard<lslboost::mutex> lock(consumers_mut_);
-	consumers_.erase(q);
+	if (consumers_.erase(q)) {
+		// keep the statistics of the consumer around
+		retired_high_water_ = std::max(retired_high_water_,q->high_water_mark());
+		retired_dropped_ += q->dropped();
+		retired_spilled_ += q->spilled();
+		// a producer may be waiting for room in this consumer
+		room_made_.notify_all();
+	}
 }
 
 /// Check whether there currently are consumers.
@@ -65,3 +140,19 @@ bool send_buffer::wait_for_consumers(double timeout) {
 	return some_registered_.wait_for(lock, lslboost::chrono::duration<double>(timeout), lslboost::bind(&send_buffer::some_registered,this));
 }
 
+
+/// Get aggregate statistics of the consumer queues.
+void send_buffer::queue_stats(std::size_t &num_consumers, std::size_t &max_depth, std::size_t &high_water, lslboost::uint64_t &dropped, lslboost::uint64_t &spilled) {
+	lslboost::lock_guard<lslboost::mutex> lock(consumers_mut_);
+	num_consumers = consumers_.size();
+	max_depth = 0;
+	high_water = retired_high_water_;
+	dropped = retired_dropped_;
+	spilled = retired_spilled_;
+	for (consumer_set::iterator i=consumers_.begin(); i != consumers_.end(); i++) {
+		max_depth = std::max(max_depth,(*i)->size());
+		high_water = std::max(high_water,(*i)->high_water_mark());
+		dropped += (*i)->dropped();
+		spilled += (*i)->spilled();
+	}
+}
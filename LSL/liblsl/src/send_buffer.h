@@ -2,10 +2,12 @@
 #define SEND_BUFFER_H
 
 #include <set>
+#include <boost/atomic.hpp>
 #include <boost/container/flat_set.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
+#include "../include/lsl_c.h"
 #include "consumer_queue.h"
 #include "sample.h"
 
@@ -14,8 +16,10 @@
 namespace lsl {
 
 	/**
-	* A thread-safe single-producer multiple-consumer queue where each consumer gets every pushed sample.
+	* A thread-safe multiple-producer multiple-consumer queue where each consumer gets every pushed sample.
 	* If the bounded capacity is exhausted, the oldest samples will be erased.
+	* The pushes of concurrent producers are published in one sequence, so all consumers see the samples in the same order,
+	* and the samples of one push_samples() call are not interleaved with those of other producers.
 	* 
 	* Note that the send_buffer is actually just a dispatcher that distributes the data to producer-consumer 
 	* queues (each of which can have its own capacity preferences). The ownership of the send_buffer is shared 
@@ -41,11 +45,34 @@ namespace lsl {
 		*/
 		consumer_queue_p new_consumer(int max_buffered=0);
 
+		/**
+		* Add a new lossless consumer queue to the buffer.
+		* When a lossless consumer falls behind, the overflow policy decides what happens once its queue is full.
+		* @param max_buffered If non-zero, the queue size for this consumer will be constrained to be no larger than this value
+		*					  (and never larger than the max_capacity of the send_buffer).
+		* @param fmt The channel format of the samples (for spilling them to a file).
+		* @param num_chans The number of channels of the samples (for spilling them to a file).
+		* @return Shared pointer to the newly created consumer.
+		*/
+		consumer_queue_p new_lossless_consumer(int max_buffered, channel_format_t fmt, int num_chans);
+
+		/// Set the policy that applies when the queue of a lossless consumer is full.
+		void set_overflow_policy(lsl_overflow_policy_t policy) { overflow_policy_ = policy; }
+
+		/// Get the policy that applies when the queue of a lossless consumer is full.
+		lsl_overflow_policy_t overflow_policy() const { return (lsl_overflow_policy_t)overflow_policy_.load(); }
+
 		/** 
 		* Push a sample onto the send buffer. 
 		* Will subsequently be received by all consumers.
 		*/
-		void push_sample(const sample_p &s);
+		void push_sample(const sample_p &s) { push_samples(&s,1); }
+
+		/**
+		* Push a batch of samples (e.g., a chunk) onto the send buffer.
+		* The samples are received by all consumers in one piece, without samples of other producers in between.
+		*/
+		void push_samples(const sample_p *samples, std::size_t num_samples);
 
 		/// Wait until some consumers are present.
 		bool wait_for_consumers(double timeout=FOREVER);
@@ -53,6 +80,16 @@ namespace lsl {
 		/// Check whether any consumer is currently registered.
 		bool have_consumers();
 
+		/**
+		* Get aggregate statistics of the consumer queues.
+		* @param num_consumers Receives the number of currently registered consumers.
+		* @param max_depth Receives the fill level of the currently fullest consumer queue.
+		* @param high_water Receives the highest fill level that any consumer queue (including past ones) has reached.
+		* @param dropped Receives the total number of samples dropped due to overrun across all consumers (including past ones).
+		* @param spilled Receives the total number of samples spilled to disk by lossless consumers (including past ones).
+		*/
+		void queue_stats(std::size_t &num_consumers, std::size_t &max_depth, std::size_t &high_water, lslboost::uint64_t &dropped, lslboost::uint64_t &spilled);
+
 	private:
 		friend class consumer_queue;
 
@@ -61,13 +98,26 @@ namespace lsl {
 		/// Unregister a previously registered consumer (called by the consumer_queue).
 		void unregister_consumer(consumer_queue *q);
 
+		/// Wait until all lossless consumers have room for another sample (without holding the lock, so that the other consumers can come and go).
+		void wait_for_lossless_consumers();
+
+		/// Wake up a producer that waits for room in the lossless consumers (called by a consumer_queue that has made room).
+		void notify_room();
+
 		/// wait_for_consumers is waiting for this
 		bool some_registered() const { return !consumers_.empty(); }
 
 		int max_capacity_;							// maximum capacity beyond which the oldest samples will be dropped
 		consumer_set consumers_;					// a set of registered consumer queues
-		lslboost::mutex consumers_mut_;				// mutex to protect the integrity of consumers_
+		lslboost::mutex consumers_mut_;				// mutex to protect the integrity of consumers_ (also orders the pushes)
+		lslboost::mutex publish_mut_;				// orders the pushes while they wait for lossless consumers (block policy)
 		lslboost::condition_variable some_registered_;	// condition variable signaling that a consumer has registered
+		lslboost::condition_variable room_made_;	// notified when a lossless consumer has made room or has unregistered
+		lslboost::atomic<int> room_waiters_;		// the number of producers waiting for room (checked by the consumers without locking)
+		std::size_t retired_high_water_;			// the highest high-water mark of all consumers that have unregistered
+		lslboost::uint64_t retired_dropped_;		// the number of samples dropped by consumers that have unregistered
+		lslboost::uint64_t retired_spilled_;		// the number of samples spilled by consumers that have unregistered
+		lslboost::atomic<int> overflow_policy_;		// the policy that applies when the queue of a lossless consumer is full
 	};
 
 }
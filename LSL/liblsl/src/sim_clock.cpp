@@ -0,0 +1,43 @@
+#include <cmath>
+#include <boost/bind.hpp>
+#include "sim_clock.h"
+
+
+// === implementation of the sim_clock class ===
+
+using namespace lsl;
+
+/// Construct a new simulated clock.
+sim_clock::sim_clock(double offset, double drift, double jitter, lslboost::uint64_t seed): epoch_(lsl_clock()), offset_(offset), drift_(drift*1e-6), jitter_(jitter), state_(seed ? seed : 1) { }
+
+/// Read the clock (including jitter).
+double sim_clock::now() {
+	double t = lsl_clock();
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	return t + offset_ + drift_*(t-epoch_) + (jitter_ ? jitter_*gaussian() : 0.0);
+}
+
+/// Get the jitter-free reading of the clock at the given lsl_clock() time.
+double sim_clock::ideal(double t) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	return t + offset_ + drift_*(t-epoch_);
+}
+
+/// Make the clock jump by the given amount of seconds.
+void sim_clock::step(double delta) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	offset_ += delta;
+}
+
+/// Get a clock_fn that reads this clock.
+clock_fn sim_clock::reader() { return lslboost::bind(&sim_clock::now,this); }
+
+/// Draw a standard normally distributed random number (xorshift64* generator and Box-Muller transform).
+double sim_clock::gaussian() {
+	double u[2];
+	for (int k=0;k<2;k++) {
+		state_ ^= state_ >> 12; state_ ^= state_ << 25; state_ ^= state_ >> 27;
+		u[k] = ((state_ * 2685821657736338717ULL) >> 11) * (1.0/9007199254740992.0);
+	}
+	return std::sqrt(-2.0*std::log(u[0] + 1e-300)) * std::cos(6.283185307179586*u[1]);
+}
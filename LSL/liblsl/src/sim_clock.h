@@ -0,0 +1,93 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include "common.h"
+
+
+namespace lsl {
+
+	/// A source of time stamps in seconds; an empty clock_fn stands for lsl_clock().
+	typedef lslboost::function<double()> clock_fn;
+
+	/// Read a clock, falling back to lsl_clock() if no clock has been injected.
+	inline double read_clock(const clock_fn &clock) { return clock.empty() ? lsl_clock() : clock(); }
+
+	/**
+	* Assigns default time stamps to a batch of samples that are pushed together (e.g., a chunk with per-sample time stamps).
+	* The clock is read at most once per batch, and all samples without a time stamp of their own get that same time.
+	*/
+	class batch_clock {
+	public:
+		/**
+		* Construct a batch clock.
+		* @param clock The clock from which the default time stamp is taken.
+		* @param force_default Whether all samples get the default time stamp, even if they have one of their own.
+		*/
+		batch_clock(const clock_fn &clock, bool force_default): clock_(clock), force_default_(force_default), now_(0.0) {}
+
+		/// Get the time stamp of a sample whose given time stamp is 0.0 for the current time.
+		double operator()(double timestamp) {
+			if (timestamp != 0.0 && !force_default_)
+				return timestamp;
+			if (now_ == 0.0)
+				now_ = read_clock(clock_);
+			return now_;
+		}
+
+	private:
+		const clock_fn &clock_;		// the clock from which the default time stamp is taken
+		bool force_default_;		// whether all samples get the default time stamp
+		double now_;				// the default time stamp (0.0 until the clock has been read)
+	};
+
+	/**
+	* A simulated clock of a (virtual) host, for testing and benchmarking the clock synchronization.
+	*
+	* The clock is derived from lsl_clock() with a configurable offset and drift, and every reading is disturbed
+	* by a random jitter. Outlets and inlets can be given such clocks (see stream_outlet_impl and stream_inlet_impl)
+	* so that several hosts with mutually unsynchronized clocks can be simulated within a single process,
+	* while the true relationship between their clocks remains known.
+	*/
+	class sim_clock: public lslboost::noncopyable {
+	public:
+		/**
+		* Construct a new simulated clock.
+		* @param offset The offset of the clock relative to lsl_clock(), in seconds.
+		* @param drift The drift of the clock relative to lsl_clock(), in parts per million.
+		* @param jitter The standard deviation of the (Gaussian) jitter of each reading, in seconds.
+		* @param seed The seed of the random number generator for the jitter.
+		*/
+		sim_clock(double offset=0.0, double drift=0.0, double jitter=0.0, lslboost::uint64_t seed=1);
+
+		/// Read the clock (including jitter). Thread-safe.
+		double now();
+
+		/// Get the jitter-free reading of the clock at the given lsl_clock() time.
+		double ideal(double t);
+
+		/// Make the clock jump by the given amount of seconds (e.g., to simulate a clock reset).
+		void step(double delta);
+
+		/// Get a clock_fn that reads this clock (the sim_clock must outlive all users of the function).
+		clock_fn reader();
+
+	private:
+		/// Draw a standard normally distributed random number (requires a lock on mut_).
+		double gaussian();
+
+		double epoch_;					// the lsl_clock() time at which the clock was created (drift accumulates from here)
+		double offset_;					// the current offset relative to lsl_clock()
+		double drift_;					// the drift relative to lsl_clock(), as a fraction
+		double jitter_;					// the standard deviation of the jitter
+		lslboost::uint64_t state_;		// the state of the random number generator
+		lslboost::mutex mut_;			// protects the offset and the random number generator
+	};
+
+}
+
+#endif
+
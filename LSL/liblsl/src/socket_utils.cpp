@@ -1,12 +1,27 @@
 #include "socket_utils.h"
 #include "endian/conversion.hpp"
 #include "common.h"
+#include <boost/atomic.hpp>
 
 
 // === Implementation of the socket utils ===
 
 using namespace lsl;
 
+/// The offset into the port range right after the most recently taken port (shared port allocator state).
+static lslboost::atomic<int> port_offset_hint(0);
+
+/// Get the offset into the configured port range at which the next port search should start.
+int lsl::next_port_offset() {
+	return port_offset_hint.load() % std::max(1,api_config::get_instance()->port_range());
+}
+
+/// Record that the port at the given offset into the port range has been taken.
+/// Ports that are released again are found once the search wraps around the range.
+void lsl::port_offset_taken(int offset) {
+	port_offset_hint.store(offset + 1);
+}
+
 /// Measure the endian conversion performance of this machine.
 double lsl::measure_endian_performance() {
 	const double measure_duration = 0.01;
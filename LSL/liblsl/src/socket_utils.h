@@ -10,12 +10,23 @@
 
 namespace lsl {
     
+	/// Get the offset into the configured port range at which the next port search should start.
+	/// This is shared by all sockets of the process, so that a new outlet does not re-probe all ports
+	/// that are known to be held by previously created outlets.
+	int next_port_offset();
+
+	/// Record that the port at the given offset into the port range has been taken.
+	void port_offset_taken(int offset);
+
     /// Bind a socket (or acceptor) to a free port in the configured port range or throw an error otherwise.
 	template<class Socket, class Protocol> int bind_port_in_range(Socket &sock, Protocol protocol) {
-		for (int k=0,e=api_config::get_instance()->port_range(); k<e; k++) {
+		const int base_port = api_config::get_instance()->base_port(), range = api_config::get_instance()->port_range();
+		for (int k=0,start=next_port_offset(); k<range; k++) {
+			int offset = (start + k) % range;
 			try {
-				sock.bind(typename Protocol::endpoint(protocol,(unsigned short)(k + api_config::get_instance()->base_port())));
-				return k + api_config::get_instance()->base_port();
+				sock.bind(typename Protocol::endpoint(protocol,(unsigned short)(offset + base_port)));
+				port_offset_taken(offset);
+				return offset + base_port;
 			} catch (lslboost::system::system_error &) { /* port occupied */ }
 		}
 		if (api_config::get_instance()->allow_random_ports()) {
@@ -32,11 +43,14 @@ namespace lsl {
     
     /// Bind to and listen at a socket (or acceptor) on a free port in the configured port range or throw an error otherwise.
 	template<class Socket, class Protocol> int bind_and_listen_to_port_in_range(Socket &sock, Protocol protocol, int backlog) {
-		for (int k=0,e=api_config::get_instance()->port_range(); k<e; k++) {
+		const int base_port = api_config::get_instance()->base_port(), range = api_config::get_instance()->port_range();
+		for (int k=0,start=next_port_offset(); k<range; k++) {
+			int offset = (start + k) % range;
 			try {
-				sock.bind(typename Protocol::endpoint(protocol,(unsigned short)(k + api_config::get_instance()->base_port())));
+				sock.bind(typename Protocol::endpoint(protocol,(unsigned short)(offset + base_port)));
                 sock.listen(backlog);
-				return k + api_config::get_instance()->base_port();
+				port_offset_taken(offset);
+				return offset + base_port;
 			} catch (lslboost::system::system_error &) { /* port occupied */ }
 		}
 		if (api_config::get_instance()->allow_random_ports()) {
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <cstdlib>
+#include <boost/atomic.hpp>
+#include <boost/lexical_cast.hpp>
+#include "api_config.h"
+#include "spill_file.h"
+
+
+// === implementation of the spill_file class ===
+
+using namespace lsl;
+
+/// The number of samples that are read back from the file at a time (so that reads and writes do not alternate for every sample).
+const std::size_t read_batch_size = 64;
+
+/// Get the directory in which spill files are created.
+static std::string spill_directory() {
+	std::string dir = api_config::get_instance()->spill_directory();
+	if (dir.empty()) {
+		const char *vars[] = {"TMPDIR","TEMP","TMP"};
+		for (int k=0;k<3 && dir.empty();k++)
+			if (const char *val = getenv(vars[k]))
+				dir = val;
+	}
+	if (dir.empty())
+#ifdef _WIN32
+		dir = ".";
+#else
+		dir = "/tmp";
+#endif
+	return dir;
+}
+
+/**
+* Create a new spill file in the configured spill directory.
+* @param fmt The channel format of the samples.
+* @param num_chans The number of channels of the samples.
+*/
+spill_file::spill_file(channel_format_t fmt, int num_chans): factory_(fmt,num_chans,read_batch_size), read_pos_(0), write_pos_(0), in_file_(0) {
+	static lslboost::atomic<unsigned> counter(0);
+	filename_ = spill_directory() + "/lsl_spill_" + lslboost::lexical_cast<std::string>((lslboost::uint64_t)(lsl_clock()*1e6)) + "_" + lslboost::lexical_cast<std::string>(counter++) + ".tmp";
+	if (!file_.open(filename_.c_str(),std::ios_base::in|std::ios_base::out|std::ios_base::trunc|std::ios_base::binary))
+		throw std::runtime_error("Could not create the spill file " + filename_ + ".");
+}
+
+/// Close and remove the file.
+spill_file::~spill_file() {
+	read_ahead_.clear();
+	file_.close();
+	remove(filename_.c_str());
+}
+
+/// Append a sample to the file.
+void spill_file::write(const sample_p &s) {
+	file_.pubseekpos(write_pos_);
+	file_.sputc(s->pushthrough ? 1 : 0);
+	s->save_streambuf(file_,LSL_PROTOCOL_VERSION,BOOST_BYTE_ORDER);
+	write_pos_ = file_.pubseekoff(0,std::ios_base::cur);
+	if (write_pos_ < 0)
+		throw std::runtime_error("Could not write to the spill file " + filename_ + ".");
+	in_file_++;
+}
+
+/// Remove the oldest sample from the file and return it.
+sample_p spill_file::read() {
+	if (read_ahead_.empty()) {
+		file_.pubseekpos(read_pos_);
+		for (std::size_t k=0;k<read_batch_size && in_file_;k++,in_file_--) {
+			sample_p s(factory_.new_sample(0.0,file_.sbumpc() != 0));
+			s->load_streambuf(file_,LSL_PROTOCOL_VERSION,BOOST_BYTE_ORDER,false);
+			read_ahead_.push_back(s);
+		}
+		read_pos_ = file_.pubseekoff(0,std::ios_base::cur);
+		// start over at the beginning of the file once everything has been read
+		if (!in_file_)
+			read_pos_ = write_pos_ = 0;
+	}
+	sample_p result = read_ahead_.front();
+	read_ahead_.pop_front();
+	return result;
+}
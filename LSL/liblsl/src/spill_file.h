@@ -0,0 +1,51 @@
+#ifndef SPILL_FILE_H
+#define SPILL_FILE_H
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include "sample.h"
+
+
+namespace lsl {
+
+	/**
+	* A first-in first-out store of samples in a temporary file.
+	* Used by lossless consumer queues to hold the samples that do not fit into memory until the consumer has caught up.
+	* The file is removed when the store is destroyed. Not thread-safe; the owner must serialize all accesses.
+	*/
+	class spill_file: public lslboost::noncopyable {
+	public:
+		/**
+		* Create a new spill file in the configured spill directory.
+		* @param fmt The channel format of the samples.
+		* @param num_chans The number of channels of the samples.
+		*/
+		spill_file(channel_format_t fmt, int num_chans);
+
+		/// Close and remove the file.
+		~spill_file();
+
+		/// Append a sample to the file.
+		void write(const sample_p &s);
+
+		/// Remove the oldest sample from the file and return it (the store must not be empty).
+		sample_p read();
+
+		/// Get the number of samples in the store.
+		std::size_t size() const { return in_file_ + read_ahead_.size(); }
+
+	private:
+		std::string filename_;				// the name of the file
+		std::filebuf file_;					// the file
+		sample::factory factory_;			// the factory of the samples that are read back (must outlive them)
+		std::streamoff read_pos_;			// the file position of the oldest sample that has not been read yet
+		std::streamoff write_pos_;			// the file position at which the next sample will be written
+		std::size_t in_file_;				// the number of samples in the file that have not been read yet
+		std::deque<sample_p> read_ahead_;	// samples that have been read from the file in a batch but not yet returned
+	};
+
+}
+
+#endif
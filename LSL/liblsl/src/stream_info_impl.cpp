@@ -14,7 +14,7 @@ using std::string;
 using lslboost::lexical_cast;
 
 /// Default Constructor.
-stream_info_impl::stream_info_impl(): channel_count_(0), nominal_srate_(0), channel_format_(cf_undefined), version_(0), v4data_port_(0), v4service_port_(0), v6data_port_(0), v6service_port_(0), created_at_(0) {
+stream_info_impl::stream_info_impl(): channel_count_(0), nominal_srate_(0), channel_format_(cf_undefined), version_(0), v4data_port_(0), v4service_port_(0), v4mux_port_(0), v4multicast_port_(0), v6data_port_(0), v6service_port_(0), v6mux_port_(0), created_at_(0) {
 	// initialize XML document
 	write_xml(doc_);
 }
@@ -22,14 +22,14 @@ stream_info_impl::stream_info_impl(): channel_count_(0), nominal_srate_(0), chan
 /// Constructor.
 stream_info_impl::stream_info_impl(const string &name, const string &type, int channel_count, double nominal_srate, channel_format_t channel_format, const string &source_id):
 	name_(name), type_(type), channel_count_(channel_count), nominal_srate_(nominal_srate), channel_format_(channel_format), source_id_(source_id), version_(api_config::get_instance()->use_protocol_version()),
-	v4data_port_(0), v4service_port_(0), v6data_port_(0), v6service_port_(0), created_at_(0) {
+	v4data_port_(0), v4service_port_(0), v4mux_port_(0), v4multicast_port_(0), v6data_port_(0), v6service_port_(0), v6mux_port_(0), created_at_(0) {
 	if (name.empty())
 		throw std::invalid_argument("The name of a stream must be non-empty.");
 	if (channel_count < 0)
 		throw std::invalid_argument("The channel_count of a stream must be nonnegative.");
 	if (nominal_srate < 0)
 		throw std::invalid_argument("The nominal sampling rate of a stream must be nonnegative.");
-	if (channel_format < 0 || channel_format > 7)
+	if (channel_format < 0 || channel_format > 9)
 		throw std::invalid_argument("The stream info was created with an unknown channel format.");
 	// initialize XML document
 	write_xml(doc_);
@@ -37,7 +37,6 @@ stream_info_impl::stream_info_impl(const string &name, const string &type, int c
 
 /// Initialize the XML DOM structure (leaving .desc unchanged) from the data.
 void stream_info_impl::write_xml(xml_document &doc) {
-	const char *channel_format_strings[] = {"undefined","float32","double64","string","int32","int16","int8","int64"};
 	xml_node info = doc.append_child("info");
 	info.append_child("name").append_child(node_pcdata).set_value(name_.c_str());
 	info.append_child("type").append_child(node_pcdata).set_value(type_.c_str());
@@ -53,9 +52,17 @@ void stream_info_impl::write_xml(xml_document &doc) {
 	info.append_child("v4address").append_child(node_pcdata).set_value(v4address_.c_str());
 	info.append_child("v4data_port").append_child(node_pcdata).set_value(lexical_cast<string>(v4data_port_).c_str());
 	info.append_child("v4service_port").append_child(node_pcdata).set_value(lexical_cast<string>(v4service_port_).c_str());
+	if (v4mux_port_)
+		info.append_child("v4mux_port").append_child(node_pcdata).set_value(lexical_cast<string>(v4mux_port_).c_str());
+	if (v4multicast_port_) {
+		info.append_child("v4multicast_address").append_child(node_pcdata).set_value(v4multicast_address_.c_str());
+		info.append_child("v4multicast_port").append_child(node_pcdata).set_value(lexical_cast<string>(v4multicast_port_).c_str());
+	}
 	info.append_child("v6address").append_child(node_pcdata).set_value(v6address_.c_str());
 	info.append_child("v6data_port").append_child(node_pcdata).set_value(lexical_cast<string>(v6data_port_).c_str());
 	info.append_child("v6service_port").append_child(node_pcdata).set_value(lexical_cast<string>(v6service_port_).c_str());
+	if (v6mux_port_)
+		info.append_child("v6mux_port").append_child(node_pcdata).set_value(lexical_cast<string>(v6mux_port_).c_str());
 	info.append_child("desc");
 }
 
@@ -94,6 +101,10 @@ void stream_info_impl::read_xml(xml_document &doc) {
 			channel_format_ = cf_int8;
 		if (fmt == "int64")
 			channel_format_ = cf_int64;
+		if (fmt == "float16")
+			channel_format_ = cf_float16;
+		if (fmt == "int24")
+			channel_format_ = cf_int24;
 		// source_id
 		source_id_ = info.child_value("source_id");
 		// version
@@ -116,12 +127,19 @@ void stream_info_impl::read_xml(xml_document &doc) {
 		v4data_port_ = lexical_cast<int>(info.child_value("v4data_port"));
 		// service_port
 		v4service_port_ = lexical_cast<int>(info.child_value("v4service_port"));
+		// mux_port (optional)
+		v4mux_port_ = *info.child_value("v4mux_port") ? lexical_cast<int>(info.child_value("v4mux_port")) : 0;
+		// multicast group (optional)
+		v4multicast_address_ = info.child_value("v4multicast_address");
+		v4multicast_port_ = *info.child_value("v4multicast_port") ? lexical_cast<int>(info.child_value("v4multicast_port")) : 0;
 		// address
 		v6address_ = info.child_value("v6address");
 		// data_port
 		v6data_port_ = lexical_cast<int>(info.child_value("v6data_port"));
 		// service_port
 		v6service_port_ = lexical_cast<int>(info.child_value("v6service_port"));
+		// mux_port (optional)
+		v6mux_port_ = *info.child_value("v6mux_port") ? lexical_cast<int>(info.child_value("v6mux_port")) : 0;
 	} catch(std::exception &e) {
 		// reset the stream info to blank state
 		*this = stream_info_impl();
@@ -291,6 +309,33 @@ void stream_info_impl::v4service_port(int v) {
 	doc_.child("info").child("v4service_port").first_child().set_value(lexical_cast<string>(v4service_port_).c_str()); 
 }
 
+/**
+* Set the TCP port of the multiplexed sessions of the stream's process (0 if it does not accept any).
+* The field is only present in the XML if the port is nonzero (so that other streams are unaffected).
+*/
+void stream_info_impl::v4mux_port(int v) { 
+	v4mux_port_ = v; 
+	set_optional_node("v4mux_port","v6address",v ? lexical_cast<string>(v) : string());
+}
+
+/**
+* Set the multicast group to which the outlet publishes the stream's data (empty if it does not).
+* The field is only present in the XML if it is nonempty.
+*/
+void stream_info_impl::v4multicast_address(const std::string &v) { 
+	v4multicast_address_ = v; 
+	set_optional_node("v4multicast_address","v6address",v);
+}
+
+/**
+* Set the port to which the outlet publishes the stream's data (0 if it does not).
+* The field is only present in the XML if the port is nonzero.
+*/
+void stream_info_impl::v4multicast_port(int v) { 
+	v4multicast_port_ = v; 
+	set_optional_node("v4multicast_port","v6address",v ? lexical_cast<string>(v) : string());
+}
+
 /**
 * Set the host name or IP address where the stream is hosted.
 */
@@ -317,6 +362,31 @@ void stream_info_impl::v6service_port(int v) {
 	doc_.child("info").child("v6service_port").first_child().set_value(lexical_cast<string>(v6service_port_).c_str()); 
 }
 
+/**
+* Set the TCP port of the multiplexed sessions of the stream's process (0 if it does not accept any).
+* The field is only present in the XML if the port is nonzero (so that other streams are unaffected).
+*/
+void stream_info_impl::v6mux_port(int v) { 
+	v6mux_port_ = v; 
+	set_optional_node("v6mux_port","desc",v ? lexical_cast<string>(v) : string());
+}
+
+/// Set, add or remove an optional field of the XML (added before the given field; removed if the value is empty).
+void stream_info_impl::set_optional_node(const char *name, const char *before, const std::string &value) {
+	xml_node info = doc_.child("info");
+	xml_node node = info.child(name);
+	if (value.empty()) {
+		if (node)
+			info.remove_child(node);
+		return;
+	}
+	if (!node)
+		node = info.insert_child_before(name,info.child(before));
+	if (!node.first_child())
+		node.append_child(node_pcdata);
+	node.first_child().set_value(value.c_str());
+}
+
 /**
 * Assignment operator.
 * Needs special handling because xml_document is non-copyable.
@@ -334,9 +404,13 @@ stream_info_impl& stream_info_impl::operator=(stream_info_impl const &rhs) {
 	v4address_ = rhs.v4address_;
 	v4data_port_ = rhs.v4data_port_;
 	v4service_port_ = rhs.v4service_port_;
+	v4mux_port_ = rhs.v4mux_port_;
+	v4multicast_address_ = rhs.v4multicast_address_;
+	v4multicast_port_ = rhs.v4multicast_port_;
 	v6address_ = rhs.v6address_;
 	v6data_port_ = rhs.v6data_port_;
 	v6service_port_ = rhs.v6service_port_;
+	v6mux_port_ = rhs.v6mux_port_;
 	uid_ = rhs.uid_;
 	created_at_ = rhs.created_at_;
 	session_id_ = rhs.session_id_;
@@ -351,7 +425,8 @@ stream_info_impl& stream_info_impl::operator=(stream_info_impl const &rhs) {
 */
 stream_info_impl::stream_info_impl(const stream_info_impl &rhs): name_(rhs.name_), type_(rhs.type_), channel_count_(rhs.channel_count_),
 nominal_srate_(rhs.nominal_srate_), channel_format_(rhs.channel_format_), source_id_(rhs.source_id_), version_(rhs.version_), v4address_(rhs.v4address_),
-v4data_port_(rhs.v4data_port_), v4service_port_(rhs.v4service_port_), v6address_(rhs.v6address_), v6data_port_(rhs.v6data_port_), v6service_port_(rhs.v6service_port_),
+v4data_port_(rhs.v4data_port_), v4service_port_(rhs.v4service_port_), v4mux_port_(rhs.v4mux_port_), v4multicast_address_(rhs.v4multicast_address_), v4multicast_port_(rhs.v4multicast_port_), v6address_(rhs.v6address_), v6data_port_(rhs.v6data_port_), v6service_port_(rhs.v6service_port_),
+v6mux_port_(rhs.v6mux_port_),
 uid_(rhs.uid_), created_at_(rhs.created_at_), session_id_(rhs.session_id_), hostname_(rhs.hostname_) {
 	doc_.reset(rhs.doc_);
 }
@@ -10,6 +10,9 @@
 
 namespace lsl {
 
+	/// The names of the channel formats in the XML description of a stream (indexed by channel_format_t).
+	const char *const channel_format_strings[] = {"undefined","float32","double64","string","int32","int16","int8","int64","float16","int24"};
+
 	/// shared pointer to a stream_info_impl
 	typedef lslboost::shared_ptr<class stream_info_impl> stream_info_impl_p;
 
@@ -126,7 +129,7 @@ namespace lsl {
 		* Get the number of bytes per channel (returns 0 for string-typed channels).
 		*/
 		int channel_bytes() const {
-			const int channel_format_sizes[] = {0,sizeof(float),sizeof(double),sizeof(std::string),sizeof(lslboost::uint32_t),sizeof(lslboost::uint16_t),sizeof(lslboost::uint8_t),8};
+			const int channel_format_sizes[] = {0,sizeof(float),sizeof(double),sizeof(std::string),sizeof(lslboost::uint32_t),sizeof(lslboost::uint16_t),sizeof(lslboost::uint8_t),8,2,3};
 			return channel_format_sizes[channel_format_];
 		}
 
@@ -199,6 +202,22 @@ namespace lsl {
 		int v4service_port() const { return v4service_port_; }
 		void v4service_port(int v);
 
+		/**
+		* Get/Set the TCP port where the stream's process accepts multiplexed sessions (0 if it does not).
+		* A multiplexed session carries the data and meta-data of all streams of that process (see mux_server).
+		*/
+		int v4mux_port() const { return v4mux_port_; }
+		void v4mux_port(int v);
+
+		/**
+		* Get/Set the multicast group and port to which the outlet publishes the stream's data (empty/0 if it does not).
+		* Inlets can join the group instead of requesting their own copy of the data (see multicast_publisher).
+		*/
+		const std::string &v4multicast_address() const { return v4multicast_address_; }
+		void v4multicast_address(const std::string &v);
+		int v4multicast_port() const { return v4multicast_port_; }
+		void v4multicast_port(int v);
+
 		/**
 		* Get/Set the host name or IP address where the stream is hosted.
 		* This may be a fully resolved address (such as testing.uscd.edu) or an IPv4 or IPv6 address in string form.
@@ -220,6 +239,13 @@ namespace lsl {
 		int v6service_port() const { return v6service_port_; }
 		void v6service_port(int v);
 
+		/**
+		* Get/Set the TCP port where the stream's process accepts multiplexed sessions (0 if it does not).
+		* A multiplexed session carries the data and meta-data of all streams of that process (see mux_server).
+		*/
+		int v6mux_port() const { return v6mux_port_; }
+		void v6mux_port(int v);
+
 		/**
 		* Get the (editable) XML description of a stream.
 		*/
@@ -239,6 +265,9 @@ namespace lsl {
 		*/
 		void read_xml(pugi::xml_document &doc);
 
+		/// Set, add or remove an optional field of the XML (added before the given field; removed if the value is empty).
+		void set_optional_node(const char *name, const char *before, const std::string &value);
+
 	private:
 		// data information
 		std::string name_;
@@ -252,9 +281,13 @@ namespace lsl {
 		std::string v4address_;
 		int v4data_port_;
 		int v4service_port_;
+		int v4mux_port_;
+		std::string v4multicast_address_;
+		int v4multicast_port_;
 		std::string v6address_;
 		int v6data_port_;
 		int v6service_port_;
+		int v6mux_port_;
 		std::string uid_;
 		double created_at_;
 		std::string session_id_;
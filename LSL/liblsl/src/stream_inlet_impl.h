@@ -9,6 +9,7 @@
 #include "inlet_connection.h"
 #include "info_receiver.h"
 #include "time_postprocessor.h"
+#include "../include/lsl_c.h"
 
 
 namespace lsl {
@@ -33,11 +34,15 @@ namespace lsl {
 		* @param recover Try to silently recover lost streams that are recoverable (=those that that have a source_id set).
 		*				 In all other cases (recover is false or the stream is not recoverable) a lost_error is thrown where 
 		*				 indicated if the stream's source is lost (e.g., due to an app or computer crash).
+		* @param clock Optionally the clock of the inlet's host for the time synchronization (default: lsl_clock(); see sim_clock).
 		*/
-		stream_inlet_impl(const stream_info_impl &info, int max_buflen=360, int max_chunklen=0, bool recover=true): conn_(info,recover), info_receiver_(conn_), time_receiver_(conn_), data_receiver_(conn_,max_buflen,max_chunklen),
+		stream_inlet_impl(const stream_info_impl &info, int max_buflen=360, int max_chunklen=0, bool recover=true, const clock_fn &clock=clock_fn()): conn_(info,recover), info_receiver_(conn_), time_receiver_(conn_,clock), data_receiver_(conn_,max_buflen,max_chunklen),
 			postprocessor_(lslboost::bind(&time_receiver::time_correction,&time_receiver_,5), 
 			lslboost::bind(&inlet_connection::current_srate,&conn_),
-			lslboost::bind(&time_receiver::was_reset,&time_receiver_)) 
+			lslboost::bind(&time_receiver::was_reset,&time_receiver_)), callback_(NULL), callback_format_(cft_undefined), callback_user_data_(NULL),
+			callback_postprocessor_(lslboost::bind(&time_receiver::cached_correction,&time_receiver_),
+			lslboost::bind(&inlet_connection::current_srate,&conn_),
+			lslboost::bind(&stream_inlet_impl::callback_clock_reset,this)), callback_resets_(0)
 		{
 			ensure_lsl_initialized();
 			conn_.engage();
@@ -50,6 +55,8 @@ namespace lsl {
 		~stream_inlet_impl() {
 			try {
 				conn_.disengage(); 
+				// wait until the data thread has left the callback (if any) since it is about to be destroyed
+				data_receiver_.set_chunk_handler(chunk_handler_t());
 			}
 			catch(std::exception &e) {
 				std::cerr << "Unexpected error during inlet shutdown: " << e.what() << std::endl;
@@ -140,6 +147,48 @@ namespace lsl {
 			return samples_written*num_chans;
 		}
 
+		/**
+		* Borrow a chunk of samples from the inlet without copying their values.
+		* The samples are held by the inlet until release_chunk() or the next borrow_chunk() call, and their values can
+		* be read in place through the returned pointers (one per sample, since each sample is a separate allocation).
+		* @param format The format in which the values will be read (must be the stream's format, which must be numeric).
+		* @param max_samples The maximum number of samples to borrow.
+		* @param data Receives a pointer to an array of pointers to the channel values of each sample.
+		* @param timestamps Receives a pointer to an array of the (post-processed) time stamps of the samples.
+		* @param timeout The timeout for this operation, if any. When the timeout expires, the function may return
+		*                fewer than max_samples samples. The default value of 0.0 will retrieve only data available for immediate pickup.
+		* @return The number of samples borrowed.
+		* @throws std::invalid_argument if the format does not match, or lost_error (if the stream source has been lost).
+		*/
+		std::size_t borrow_chunk(channel_format_t format, std::size_t max_samples, const void * const **data, const double **timestamps, double timeout=0.0) {
+			if (format != conn_.type_info().channel_format())
+				throw std::invalid_argument("The format of a borrowed chunk must match the stream's channel format.");
+			if (format == cf_string)
+				throw std::invalid_argument("Samples of string-formatted streams cannot be borrowed.");
+			if (!data || !timestamps)
+				throw std::invalid_argument("The data and timestamp pointers must not be NULL.");
+			release_chunk();
+			double end_time = timeout ? lsl_clock()+timeout : 0.0;
+			while (borrowed_.size() < max_samples) {
+				if (sample_p s = data_receiver_.pull_sample(timeout?end_time-lsl_clock():0.0)) {
+					borrowed_stamps_.push_back(postprocess(s->timestamp));
+					borrowed_data_.push_back(s->untyped_data());
+					borrowed_.push_back(s);
+				} else
+					break;
+			}
+			*data = borrowed_data_.empty() ? NULL : &borrowed_data_[0];
+			*timestamps = borrowed_stamps_.empty() ? NULL : &borrowed_stamps_[0];
+			return borrowed_.size();
+		}
+
+		/// Release the samples of the most recently borrowed chunk (see borrow_chunk()).
+		void release_chunk() {
+			borrowed_.clear();
+			borrowed_data_.clear();
+			borrowed_stamps_.clear();
+		}
+
 		/**
 		* Retrieve the complete information of the given stream, including the extended description.
 		* Can be invoked at any time of the stream's lifetime.
@@ -169,7 +218,62 @@ namespace lsl {
 		* @param flags An integer that is the result of bitwise OR'ing one or more options from processing_options_t 
 		*        together (e.g., post_clocksync|post_dejitter); the default is to enable all options.
 		*/
-		void set_postprocessing(unsigned flags=post_ALL) { postprocessor_.set_options(flags); }
+		void set_postprocessing(unsigned flags=post_ALL) { postprocessor_.set_options(flags); callback_postprocessor_.set_options(flags); }
+
+		/**
+		* Enable or disable lossless transmission (takes effect when the inlet (re-)connects to the outlet).
+		* A lossless inlet stops reading from the network while its buffer is full instead of dropping samples,
+		* and asks the outlet to apply its overflow policy instead of dropping samples, too.
+		*/
+		void set_lossless(bool lossless) { data_receiver_.set_lossless(lossless); }
+
+		/**
+		* Enable or disable the repair of datagrams that have been lost on a multicast stream (see lsl_create_outlet_ex).
+		* Lost datagrams are re-sent by the outlet over TCP if it still has them, which delays the following samples.
+		*/
+		void set_multicast_repair(bool repair) { data_receiver_.set_multicast_repair(repair); }
+
+		/**
+		* Enable or disable the datagram transport (see lsl_set_datagram_transport).
+		* Each sample is then sent to the inlet as a UDP datagram, which saves latency for small, irregular samples.
+		*/
+		void set_datagram_transport(bool datagrams) { data_receiver_.set_datagram_transport(datagrams); }
+
+		/**
+		* Keep only the most recent samples in the inlet's buffer (see lsl_set_latest_only).
+		* Older samples are dropped as soon as newer ones arrive, so that a slow consumer always gets the latest data.
+		*/
+		void set_latest_only(unsigned num_samples) { data_receiver_.set_latest_only(num_samples); }
+
+		/**
+		* Set a callback that receives the samples from the data thread as soon as they have arrived, instead of queueing
+		* them for pull_sample() and pull_chunk(). The samples are delivered in chunks of those that have arrived together,
+		* converted to the given format and with post-processed time stamps.
+		* Blocks while the previous callback (if any) is being called.
+		* @param format The format of the values passed to the callback (cft_undefined for the stream's format, or float32/int32 for float16/int24 streams).
+		* @param callback The callback, or NULL to resume queueing the samples.
+		* @param user_data An arbitrary pointer that is passed to the callback.
+		*/
+		void set_chunk_callback(lsl_channel_format_t format, lsl_chunk_callback callback, void *user_data) {
+			if (format == cft_undefined) {
+				// the compact formats are delivered in the types in which they are pushed
+				switch (conn_.type_info().channel_format()) {
+					case cf_float16: format = cft_float32; break;
+					case cf_int24: format = cft_int32; break;
+					default: format = (lsl_channel_format_t)conn_.type_info().channel_format();
+				}
+			}
+			if (format < cft_float32 || format > cft_int64)
+				throw std::invalid_argument("Unsupported callback format.");
+			if ((format == cft_string) != (conn_.type_info().channel_format() == cf_string))
+				throw std::invalid_argument("String streams can only be delivered as strings (and vice versa).");
+			data_receiver_.set_chunk_handler(chunk_handler_t());
+			callback_ = callback;
+			callback_format_ = format;
+			callback_user_data_ = user_data;
+			if (callback)
+				data_receiver_.set_chunk_handler(lslboost::bind(&stream_inlet_impl::dispatch_chunk,this,_1));
+		}
 
 		/**
 		* Open a new data stream.
@@ -189,11 +293,46 @@ namespace lsl {
 		*/
 		void close_stream() { data_receiver_.close_stream(); }
 
+		/**
+		* Get a file descriptor that becomes readable when samples arrive, so that event loops can wait on many inlets at once.
+		* It stays readable until a pull finds the buffer empty. Serves as an implicit open_stream().
+		* @throws std::runtime_error if the platform does not support it.
+		*/
+		int wakeup_descriptor() { return data_receiver_.wakeup_descriptor(); }
+
+		/**
+		* Wait until any of the given inlets has samples available (or has lost its stream).
+		* Serves as an implicit open_stream() for all of the inlets.
+		* @param inlets The inlets to wait on.
+		* @param num_inlets The number of inlets.
+		* @param timeout The maximum time to wait, in seconds (FOREVER to wait indefinitely).
+		* @return The index of the first such inlet, or -1 if the timeout expired.
+		*/
+		static int wait_any(stream_inlet_impl *const *inlets, int num_inlets, double timeout=FOREVER) {
+			queue_event event;
+			for (int k=0; k<num_inlets; k++)
+				inlets[k]->data_receiver_.attach(&event);
+			int result = -1;
+			double end_time = timeout < FOREVER ? lsl_clock() + timeout : FOREVER;
+			while (true) {
+				for (int k=0; k<num_inlets && result < 0; k++)
+					if (inlets[k]->data_receiver_.ready())
+						result = k;
+				double remaining = end_time < FOREVER ? end_time - lsl_clock() : FOREVER;
+				if (result >= 0 || remaining <= 0.0)
+					break;
+				event.wait(remaining);
+			}
+			for (int k=0; k<num_inlets; k++)
+				inlets[k]->data_receiver_.detach(&event);
+			return result;
+		}
+
 		/** 
 		* Query the current size of the buffer, i.e. the number of samples that are buffered.
 		* Note that this value may be inaccurate and should not be relied on for program logic.
 		*/
-		std::size_t samples_available() { return (std::size_t)(!data_receiver_.empty()); };
+		std::size_t samples_available() { return data_receiver_.queue_depth(); };
 
 		/** Query whether the clock was potentially reset since the last call to was_clock_reset().
 		* This is only interesting for applications that combine multiple time_correction values to estimate clock drift
@@ -202,12 +341,80 @@ namespace lsl {
 		bool was_clock_reset() { return time_receiver_.was_reset(); }
 
 		/// Override the half-time (forget factor) of the time-stamp smoothing.
-		void smoothing_halftime(float value) { postprocessor_.smoothing_halftime(value); }
+		void smoothing_halftime(float value) { postprocessor_.smoothing_halftime(value); callback_postprocessor_.smoothing_halftime(value); }
+
+		/**
+		* Retrieve runtime transport statistics of the inlet.
+		* @param stats The structure that receives the statistics.
+		*/
+		void get_stats(lsl_inlet_stats &stats) {
+			stats.samples_received = data_receiver_.samples_received();
+			stats.bytes_received = data_receiver_.bytes_received();
+			stats.samples_dropped = data_receiver_.samples_dropped();
+			stats.queue_depth = (unsigned)data_receiver_.queue_depth();
+			stats.queue_high_water = (unsigned)data_receiver_.queue_high_water();
+			data_receiver_.connection_stats(stats.reconnects,stats.handshake_time);
+			lslboost::uint64_t probes_sent, probes_received;
+			time_receiver_.probe_stats(probes_sent,probes_received,stats.time_probe_rtt_min,stats.time_probe_rtt_mean,stats.time_probe_rtt_max);
+			stats.time_probes_sent = probes_sent;
+			stats.time_probes_received = probes_received;
+			stats.samples_lost = data_receiver_.samples_lost();
+			stats.samples_repaired = data_receiver_.samples_repaired();
+		}
 
 	private:
 		/// post-process a time stamp
 		double postprocess(double stamp) { return stamp ? postprocessor_.process_timestamp(stamp) : stamp; }
 
+		/// Check whether the clock was reset since the last check by the callback's post-processor (leaves was_clock_reset() alone).
+		bool callback_clock_reset() {
+			lslboost::uint64_t resets = time_receiver_.reset_count();
+			bool result = resets != callback_resets_;
+			callback_resets_ = resets;
+			return result;
+		}
+
+		/**
+		* Convert a chunk of samples to the callback's format and pass it to the callback (called from the data thread).
+		* The time stamps are post-processed with the cached clock offset, so that the data thread never waits for a time estimate.
+		*/
+		void dispatch_chunk(const std::vector<sample_p> &chunk) {
+			callback_stamps_.resize(chunk.size());
+			for (std::size_t k=0; k<chunk.size(); k++)
+				callback_stamps_[k] = chunk[k]->timestamp ? callback_postprocessor_.process_timestamp(chunk[k]->timestamp) : 0.0;
+			switch (callback_format_) {
+				case cft_float32: dispatch_typed<float>(chunk); break;
+				case cft_double64: dispatch_typed<double>(chunk); break;
+				case cft_int32: dispatch_typed<lslboost::int32_t>(chunk); break;
+				case cft_int16: dispatch_typed<lslboost::int16_t>(chunk); break;
+				case cft_int8: dispatch_typed<char>(chunk); break;
+				case cft_int64: dispatch_typed<lslboost::int64_t>(chunk); break;
+				case cft_string: {
+					std::size_t num_chans = conn_.type_info().channel_count();
+					callback_strings_.resize(chunk.size()*num_chans);
+					callback_cstrings_.resize(callback_strings_.size());
+					for (std::size_t k=0; k<chunk.size(); k++)
+						chunk[k]->retrieve_typed(&callback_strings_[k*num_chans]);
+					for (std::size_t k=0; k<callback_strings_.size(); k++)
+						callback_cstrings_[k] = callback_strings_[k].c_str();
+					callback_((lsl_inlet)this,&callback_cstrings_[0],&callback_stamps_[0],(unsigned long)chunk.size(),callback_user_data_);
+					break;
+				}
+				default:
+					break;
+			}
+		}
+
+		/// Convert a chunk of samples to a numeric type and pass it to the callback.
+		template<class T> void dispatch_typed(const std::vector<sample_p> &chunk) {
+			std::size_t num_chans = conn_.type_info().channel_count();
+			callback_buffer_.resize(chunk.size()*num_chans*sizeof(T));
+			T *values = (T*)&callback_buffer_[0];
+			for (std::size_t k=0; k<chunk.size(); k++)
+				chunk[k]->retrieve_typed(&values[k*num_chans]);
+			callback_((lsl_inlet)this,values,&callback_stamps_[0],(unsigned long)chunk.size(),callback_user_data_);
+		}
+
 		// the inlet connection
 		inlet_connection conn_;
 
@@ -218,6 +425,22 @@ namespace lsl {
 
 		// class for post-processing time stamps
 		time_postprocessor postprocessor_;
+
+		// push-style delivery (the buffers are only used by the data thread)
+		lsl_chunk_callback callback_;				// the callback that receives the samples (if any)
+		lsl_channel_format_t callback_format_;		// the format of the values passed to the callback
+		void *callback_user_data_;					// the user data passed to the callback
+		time_postprocessor callback_postprocessor_;	// post-processes the time stamps passed to the callback (only used by the data thread)
+		lslboost::uint64_t callback_resets_;		// the number of clock resets seen by the callback's post-processor
+		std::vector<double> callback_stamps_;		// the post-processed time stamps of the current chunk
+		std::vector<char> callback_buffer_;			// the converted numeric values of the current chunk
+		std::vector<std::string> callback_strings_;	// the string values of the current chunk
+		std::vector<const char*> callback_cstrings_;	// pointers to the string values of the current chunk
+
+		// the samples of the borrowed chunk (see borrow_chunk())
+		std::vector<sample_p> borrowed_;			// the samples held on behalf of the caller
+		std::vector<const void*> borrowed_data_;	// pointers to the values of each borrowed sample
+		std::vector<double> borrowed_stamps_;		// the post-processed time stamps of the borrowed samples
 	};
 
 }
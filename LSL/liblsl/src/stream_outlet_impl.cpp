@@ -15,9 +15,12 @@ using namespace lslboost::asio;
 *					If 0 (=default), the chunk size is determined by the pushthrough flag in push_sample or push_chunk.
 * @param max_capacity The maximum number of samples buffered for unresponsive receivers. If more samples get pushed, the oldest will be dropped.
 *					   The default is sufficient to hold a bit more than 15 minutes of data at 512Hz, while consuming not more than ca. 512MB of RAM.
+* @param clock Optionally the clock of the outlet's host, which is used for default time stamps and by the time service.
+* @param flags Optionally the transport options (transp_multicast to also publish the data to a multicast group,
+*			   transp_multi_producer to allow several threads to push at the same time).
 */
-stream_outlet_impl::stream_outlet_impl(const stream_info_impl &info, int chunk_size, int max_capacity): chunk_size_(chunk_size), info_(new stream_info_impl(info)), 
-	sample_factory_(new sample::factory(info.channel_format(),info.channel_count(),info.nominal_srate()?info.nominal_srate()*api_config::get_instance()->outlet_buffer_reserve_ms()/1000:api_config::get_instance()->outlet_buffer_reserve_samples())), send_buffer_(new send_buffer(max_capacity))
+stream_outlet_impl::stream_outlet_impl(const stream_info_impl &info, int chunk_size, int max_capacity, const clock_fn &clock, lsl_transport_options_t flags): chunk_size_(chunk_size), info_(new stream_info_impl(info)), 
+	sample_factory_(new sample::factory(info.channel_format(),info.channel_count(),info.nominal_srate()?info.nominal_srate()*api_config::get_instance()->outlet_buffer_reserve_ms()/1000:api_config::get_instance()->outlet_buffer_reserve_samples())), send_buffer_(new send_buffer(max_capacity)), samples_pushed_(0), clock_(clock), multi_producer_((flags & transp_multi_producer) != 0)
 {
 	ensure_lsl_initialized();
 	const api_config *cfg = api_config::get_instance();
@@ -43,17 +46,32 @@ stream_outlet_impl::stream_outlet_impl(const stream_info_impl &info, int chunk_s
 	if (tcp_servers_.empty() || udp_servers_.empty())
 		throw std::runtime_error("Neither the IPv4 nor the IPv6 stack could be instantiated.");
 
-	// get the async request chains set up
+	// in multicast mode, publish the data to a multicast group (inlets that cannot receive it use the TCP servers)
+	if (flags & transp_multicast) {
+		try {
+			publisher_.reset(new multicast_publisher(info_,send_buffer_,chunk_size_));
+			for (unsigned k=0;k<tcp_servers_.size();k++)
+				tcp_servers_[k]->set_publisher(publisher_);
+		} catch(std::exception &e) {
+			std::cerr << "Could not set up multicast publishing (the data will be sent over TCP only): " << e.what() << std::endl;
+		}
+	}
+
+	// get the async request chains set up (the shortinfo is the same for all of them, so it is serialized only once)
+	std::string shortinfo_msg = info_->to_shortinfo_message();
 	for (unsigned k=0;k<tcp_servers_.size();k++)
-		tcp_servers_[k]->begin_serving();
+		tcp_servers_[k]->begin_serving(shortinfo_msg);
 	for (unsigned k=0;k<udp_servers_.size();k++)
-		udp_servers_[k]->begin_serving();
+		udp_servers_[k]->begin_serving(shortinfo_msg);
 	for (unsigned k=0;k<responders_.size();k++)
-		responders_[k]->begin_serving();
+		responders_[k]->begin_serving(shortinfo_msg);
 
-	// and start the IO threads to handle them
+	if (publisher_)
+		publisher_->begin_publishing();
+
+	// and run the IO services on pooled threads to handle them
 	for (unsigned k=0;k<ios_.size();k++)
-		io_threads_.push_back(thread_p(new lslboost::thread(lslboost::bind(&stream_outlet_impl::run_io,this,ios_[k]))));
+		io_jobs_.push_back(thread_pool::get_instance().submit(lslboost::bind(&stream_outlet_impl::run_io,this,ios_[k])));
 }
 
 /**
@@ -66,12 +84,25 @@ void stream_outlet_impl::instantiate_stack(tcp tcp_protocol, udp udp_protocol) {
 	std::vector<std::string> multicast_addrs = cfg->multicast_addresses();
 	int multicast_ttl = cfg->multicast_ttl();
 	int multicast_port = cfg->multicast_port();
-	// create TCP data server
+	// create TCP data server and UDP time server on the same port number (inlets of older versions send their time
+	// probes to the data port); if the UDP port is taken, the TCP server moves on to the next free port
 	ios_.push_back(io_service_p(new io_service()));
-	tcp_servers_.push_back(tcp_server_p(new tcp_server(info_, ios_.back(), send_buffer_, sample_factory_, tcp_protocol, chunk_size_)));
-	// create UDP time server
+	io_service_p tcp_ios = ios_.back();
 	ios_.push_back(io_service_p(new io_service()));
-	udp_servers_.push_back(udp_server_p(new udp_server(info_, *ios_.back(), udp_protocol)));
+	const int max_attempts = cfg->port_range() + (cfg->allow_random_ports() ? 100 : 0);
+	for (int attempt=0;;attempt++) {
+		tcp_server_p data_server(new tcp_server(info_, tcp_ios, send_buffer_, sample_factory_, tcp_protocol, chunk_size_));
+		int port = (tcp_protocol == tcp::v4()) ? info_->v4data_port() : info_->v6data_port();
+		try {
+			udp_server_p time_server(new udp_server(info_, *ios_.back(), udp_protocol, port, clock_));
+			tcp_servers_.push_back(data_server);
+			udp_servers_.push_back(time_server);
+			break;
+		} catch(lslboost::system::system_error &) {
+			if (attempt+1 >= max_attempts)
+				throw std::runtime_error("No pair of free TCP and UDP ports with the same number was found. You may have more open outlets on this machine than your PortRange setting allows (see Network Connectivity in the LSL wiki) or you have a problem with your network configuration.");
+		}
+	}
 	// create UDP multicast responders
 	for (std::vector<std::string>::iterator i=multicast_addrs.begin(); i != multicast_addrs.end(); i++) {
 		try {
@@ -91,6 +122,9 @@ void stream_outlet_impl::instantiate_stack(tcp tcp_protocol, udp udp_protocol) {
 */
 stream_outlet_impl::~stream_outlet_impl() {
 	try {
+		// stop publishing to the multicast group
+		if (publisher_)
+			publisher_->end_publishing();
 		// cancel all request chains
 		for (unsigned k=0;k<tcp_servers_.size();k++)
 			tcp_servers_[k]->end_serving();
@@ -98,16 +132,14 @@ stream_outlet_impl::~stream_outlet_impl() {
 			udp_servers_[k]->end_serving();
 		for (unsigned k=0;k<responders_.size();k++)
 			responders_[k]->end_serving();
-		// join the IO threads
-		for (unsigned k=0;k<io_threads_.size();k++)
-			if (!io_threads_[k]->try_join_for(lslboost::chrono::milliseconds(1000))) {
+		// wait for the IO jobs to finish
+		for (unsigned k=0;k<io_jobs_.size();k++)
+			if (!io_jobs_[k]->wait_for(lslboost::chrono::milliseconds(1000))) {
  				// .. using force, if necessary (should only ever happen if the CPU is maxed out)
-				std::cerr << "Tearing down stream_outlet of thread " << io_threads_[k]->get_id() << " (in id: " << lslboost::this_thread::get_id() << "): " << std::endl;
+				std::cerr << "Tearing down stream_outlet of thread " << io_jobs_[k]->thread_id() << " (in id: " << lslboost::this_thread::get_id() << "): " << std::endl;
 				ios_[k]->stop();
-				for (int attempt=1; !io_threads_[k]->try_join_for(lslboost::chrono::milliseconds(1000)); attempt++) {
+				for (int attempt=1; !io_jobs_[k]->wait_for(lslboost::chrono::milliseconds(1000)); attempt++)
 					std::cerr << "Trying to kill stream_outlet (attempt #" << attempt << ")..." << std::endl;
-					io_threads_[k]->interrupt();
-				}
 			}
 	}
 	catch(std::exception &e) {
@@ -147,3 +179,108 @@ bool stream_outlet_impl::have_consumers() { return send_buffer_->have_consumers(
 */
 bool stream_outlet_impl::wait_for_consumers(double timeout) { return send_buffer_->wait_for_consumers(timeout); }
 
+
+/**
+* Reserve samples in the outlet, so that their data can be written in place instead of being copied in by a push.
+* Only one reservation can be pending at a time; it ends with a commit (which may push fewer samples than reserved).
+* @param num_samples The number of samples to reserve.
+* @param format The format in which the values will be written (must be the stream's format, which must be numeric).
+* @param buffers Receives a pointer to the channel values of each sample (num_samples pointers).
+* @throws std::invalid_argument if the format does not match, or std::logic_error if a reservation is pending.
+*/
+void stream_outlet_impl::reserve(std::size_t num_samples, channel_format_t format, void **buffers) {
+	if (format != info_->channel_format())
+		throw std::invalid_argument("The format of a reservation must match the stream's channel format.");
+	if (format == cf_string)
+		throw std::invalid_argument("Samples of string-formatted streams cannot be written in place.");
+	if (num_samples && !buffers)
+		throw std::invalid_argument("The buffer pointer must not be NULL.");
+	std::vector<sample_p> &reserved = reservation();
+	if (!reserved.empty())
+		throw std::logic_error("The outlet already has a pending reservation.");
+	reserved.reserve(num_samples);
+	for (std::size_t k=0; k<num_samples; k++) {
+		reserved.push_back(new_sample(0.0,false));
+		buffers[k] = reserved[k]->untyped_data();
+	}
+}
+
+/**
+* Push the first num_samples reserved samples into the outlet and release the others.
+* @param num_samples The number of samples to push (at most the number of reserved ones).
+* @param timestamp The capture time of the most recent sample, in agreement with lsl_clock(); if 0.0, the current time is used.
+*					The time stamps of the other samples are derived based on the sampling rate of the stream.
+* @param pushthrough Whether to push the samples through to the receivers instead of buffering them with subsequent samples.
+*/
+void stream_outlet_impl::commit(std::size_t num_samples, double timestamp, bool pushthrough) {
+	std::vector<sample_p> &reserved = reservation();
+	if (num_samples > reserved.size())
+		throw std::invalid_argument("More samples were committed than reserved.");
+	if (num_samples > 0) {
+		if (timestamp == 0.0 || api_config::get_instance()->force_default_timestamps())
+			timestamp = read_clock(clock_);
+		if (info_->nominal_srate() != IRREGULAR_RATE)
+			timestamp = timestamp - (num_samples-1)/info_->nominal_srate();
+		for (std::size_t k=0; k<num_samples; k++) {
+			reserved[k]->timestamp = k ? DEDUCED_TIMESTAMP : timestamp;
+			reserved[k]->pushthrough = pushthrough && (k==num_samples-1);
+		}
+	}
+	push_reserved(num_samples);
+}
+
+/**
+* Push the first num_samples reserved samples into the outlet and release the others.
+* @param num_samples The number of samples to push (at most the number of reserved ones).
+* @param timestamps The capture time of each sample (0.0 for the current time, which is read once for all samples).
+* @param pushthrough Whether to push the samples through to the receivers instead of buffering them with subsequent samples.
+*/
+void stream_outlet_impl::commit(std::size_t num_samples, const double *timestamps, bool pushthrough) {
+	std::vector<sample_p> &reserved = reservation();
+	if (num_samples > reserved.size())
+		throw std::invalid_argument("More samples were committed than reserved.");
+	if (num_samples && !timestamps)
+		throw std::invalid_argument("The timestamp buffer pointer must not be NULL.");
+	batch_clock stamp(clock_,api_config::get_instance()->force_default_timestamps());
+	for (std::size_t k=0; k<num_samples; k++) {
+		reserved[k]->timestamp = stamp(timestamps[k]);
+		reserved[k]->pushthrough = pushthrough && (k==num_samples-1);
+	}
+	push_reserved(num_samples);
+}
+
+/// Push the first num_samples reserved samples (whose time stamps have been assigned) and release the others.
+void stream_outlet_impl::push_reserved(std::size_t num_samples) {
+	std::vector<sample_p> &reserved = reservation();
+	reserved.resize(num_samples);
+	publish(reserved);
+	reserved.clear();
+}
+
+
+/**
+* Retrieve runtime transport statistics of the outlet.
+* @param stats The structure that receives the statistics.
+*/
+void stream_outlet_impl::get_stats(lsl_outlet_stats &stats) {
+	stats.samples_pushed = samples_pushed_.load(lslboost::memory_order_relaxed);
+	// the size of string samples is not tracked, so their bytes are reported as 0 (as documented)
+	stats.bytes_pushed = info_->channel_format() == cf_string ? 0 : stats.samples_pushed * info_->sample_bytes();
+	stats.samples_sent = stats.bytes_sent = 0;
+	for (unsigned k=0;k<tcp_servers_.size();k++) {
+		stats.samples_sent += tcp_servers_[k]->samples_sent();
+		stats.bytes_sent += tcp_servers_[k]->bytes_sent();
+	}
+	if (publisher_) {
+		stats.samples_sent += publisher_->samples_sent();
+		stats.bytes_sent += publisher_->bytes_sent();
+	}
+	std::size_t consumers, depth, high_water;
+	lslboost::uint64_t dropped, spilled;
+	send_buffer_->queue_stats(consumers,depth,high_water,dropped,spilled);
+	stats.consumers = (unsigned)consumers;
+	stats.queue_depth = (unsigned)depth;
+	stats.queue_high_water = (unsigned)high_water;
+	stats.samples_dropped = dropped;
+	stats.samples_spilled = spilled;
+}
@@ -2,19 +2,22 @@
 #define STREAM_OUTLET_IMPL_H
 
 #include <boost/container/flat_set.hpp>
+#include <boost/thread.hpp>
 #include "tcp_server.h"
 #include "send_buffer.h"
 #include "common.h"
 #include "api_config.h"
 #include "udp_server.h"
+#include "multicast_publisher.h"
 #include "sample.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "../include/lsl_c.h"
 
 
 
 namespace lsl { 
 
-	/// pointer to a thread
-	typedef lslboost::shared_ptr<lslboost::thread> thread_p;
 	/// pointer to an io_service
 	typedef lslboost::shared_ptr<lslboost::asio::io_service> io_service_p;
 
@@ -31,8 +34,11 @@ namespace lsl {
 		*					If 0 (=default), the chunk size is determined by the pushthrough flag in push_sample or push_chunk.
 		* @param max_capacity The maximum number of samples buffered for unresponsive receivers. If more samples get pushed, the oldest will be dropped. 
 		*					   The default is sufficient to hold a bit more than 15 minutes of data at 512Hz, while consuming not more than ca. 512MB of RAM.
+		* @param clock Optionally the clock of the outlet's host, which is used for default time stamps and by the time service (default: lsl_clock(); see sim_clock).
+		* @param flags Optionally the transport options (transp_multicast to also publish the data to a multicast group; see multicast_publisher;
+		*			   transp_multi_producer to allow several threads to push into the outlet at the same time).
 		*/
-		stream_outlet_impl(const stream_info_impl &info, int chunk_size=0, int max_capacity=512000);
+		stream_outlet_impl(const stream_info_impl &info, int chunk_size=0, int max_capacity=512000, const clock_fn &clock=clock_fn(), lsl_transport_options_t flags=transp_default);
 
 		/**
 		* Destructor.
@@ -84,11 +90,14 @@ namespace lsl {
 		* @param pushthrough Whether to push the sample through to the receivers instead of buffering it into a chunk according to network speeds.
 		*/
 		void push_numeric_raw(void *data, double timestamp=0.0, bool pushthrough=true) { 
+			LSL_TRACE_PUSH_BEGIN(traced,"push");
 			if (lsl::api_config::get_instance()->force_default_timestamps())
 				timestamp = 0.0;
-			sample_p smp(sample_factory_->new_sample(timestamp == 0.0 ? lsl_clock() : timestamp, pushthrough));
+			sample_p smp(new_sample(timestamp == 0.0 ? read_clock(clock_) : timestamp, pushthrough));
 			smp->assign_untyped(data);
 			send_buffer_->push_sample(smp);
+			LSL_TRACE_PUSH_EVENT(traced,"dispatch");
+			samples_pushed_.fetch_add(1,lslboost::memory_order_relaxed);
 		}
 
 		//
@@ -99,7 +108,8 @@ namespace lsl {
 		* Push a chunk of multiplexed samples into the send buffer. One timestamp per sample is provided.
 		* IMPORTANT: Note that the provided buffer size is measured in channel values (e.g., floats) rather than in samples.
 		* @param data_buffer A buffer of channel values holding the data for zero or more successive samples to send.
-		* @param timestamp_buffer A buffer of timestamp values holding time stamps for each sample in the data buffer.
+		* @param timestamp_buffer A buffer of timestamp values holding time stamps for each sample in the data buffer
+		*						  (0.0 for the current time, which is read once for the whole chunk).
 		* @param data_buffer_elements The number of data values (of type T) in the data buffer. Must be a multiple of the channel count.
 		* @param pushthrough Whether to push the chunk through to the receivers instead of buffering it with subsequent samples.
 		*					 Note that the chunk_size, if specified at outlet construction, takes precedence over the pushthrough flag.
@@ -112,8 +122,17 @@ namespace lsl {
 				throw std::runtime_error("The data buffer pointer must not be NULL.");
 			if (!timestamp_buffer)
 				throw std::runtime_error("The timestamp buffer pointer must not be NULL.");
-			for (std::size_t k=0; k<num_samples; k++)
-				enqueue(&data_buffer[k*num_chans],timestamp_buffer[k],pushthrough && k==num_samples-1);
+			batch_clock stamp(clock_,api_config::get_instance()->force_default_timestamps());
+			if (multi_producer_) {
+				// publish the samples together, so that they are not interleaved with those of other threads
+				std::vector<sample_p> chunk(num_samples);
+				for (std::size_t k=0; k<num_samples; k++)
+					chunk[k] = make_sample(&data_buffer[k*num_chans],stamp(timestamp_buffer[k]),pushthrough && k==num_samples-1);
+				publish(chunk);
+			} else {
+				for (std::size_t k=0; k<num_samples; k++)
+					enqueue_stamped(&data_buffer[k*num_chans],stamp(timestamp_buffer[k]),pushthrough && k==num_samples-1);
+			}
 		}
 
 		/**
@@ -133,16 +152,54 @@ namespace lsl {
 			if (!buffer)
 				throw std::runtime_error("The number of buffer elements to send is not a multiple of the stream's channel count.");
 			if (num_samples > 0) {
-				if (timestamp == 0.0)
-					timestamp = lsl_clock();
+				if (timestamp == 0.0 || api_config::get_instance()->force_default_timestamps())
+					timestamp = read_clock(clock_);
 				if (info().nominal_srate() != IRREGULAR_RATE)
 					timestamp = timestamp - (num_samples-1)/info().nominal_srate();
-				push_sample(buffer,timestamp,pushthrough && (num_samples==1));
-				for (std::size_t k=1; k<num_samples; k++)
-					push_sample(&buffer[k*num_chans],DEDUCED_TIMESTAMP,pushthrough && (k==num_samples-1));
+				if (multi_producer_) {
+					// the samples are published together, so the deduced time stamps follow the first one even if other threads push, too
+					std::vector<sample_p> chunk(num_samples);
+					for (std::size_t k=0; k<num_samples; k++)
+						chunk[k] = make_sample(&buffer[k*num_chans],k ? DEDUCED_TIMESTAMP : timestamp,pushthrough && (k==num_samples-1));
+					publish(chunk);
+				} else {
+					for (std::size_t k=0; k<num_samples; k++)
+						enqueue_stamped(&buffer[k*num_chans],k ? DEDUCED_TIMESTAMP : timestamp,pushthrough && (k==num_samples-1));
+				}
 			}
 		}
 
+		//
+		// === Writing samples in place ===
+		//
+
+		/**
+		* Reserve samples in the outlet, so that their data can be written in place instead of being copied in by a push.
+		* Only one reservation can be pending at a time; it ends with a commit (which may push fewer samples than reserved).
+		* @param num_samples The number of samples to reserve.
+		* @param format The format in which the values will be written (must be the stream's format, which must be numeric).
+		* @param buffers Receives a pointer to the channel values of each sample (num_samples pointers).
+		* @throws std::invalid_argument if the format does not match, or std::logic_error if a reservation is pending.
+		*/
+		void reserve(std::size_t num_samples, channel_format_t format, void **buffers);
+
+		/**
+		* Push the first num_samples reserved samples into the outlet and release the others.
+		* @param num_samples The number of samples to push (at most the number of reserved ones).
+		* @param timestamp The capture time of the most recent sample, in agreement with lsl_clock(); if 0.0, the current time is used.
+		*					The time stamps of the other samples are derived based on the sampling rate of the stream.
+		* @param pushthrough Whether to push the samples through to the receivers instead of buffering them with subsequent samples.
+		*/
+		void commit(std::size_t num_samples, double timestamp=0.0, bool pushthrough=true);
+
+		/**
+		* Push the first num_samples reserved samples into the outlet and release the others.
+		* @param num_samples The number of samples to push (at most the number of reserved ones).
+		* @param timestamps The capture time of each sample (0.0 for the current time).
+		* @param pushthrough Whether to push the samples through to the receivers instead of buffering them with subsequent samples.
+		*/
+		void commit(std::size_t num_samples, const double *timestamps, bool pushthrough=true);
+
 		//
 		// === Misc Features ===
 		//
@@ -154,6 +211,7 @@ namespace lsl {
 		const stream_info_impl &info() const;
 		/**
 		* Check whether consumers are currently registered.
+		* Always true in multicast mode (the multicast publisher is a consumer).
 		*/
 		bool have_consumers();
 
@@ -162,6 +220,17 @@ namespace lsl {
 		*/
 		bool wait_for_consumers(double timeout=FOREVER);
 
+		/**
+		* Retrieve runtime transport statistics of the outlet.
+		* @param stats The structure that receives the statistics.
+		*/
+		void get_stats(lsl_outlet_stats &stats);
+
+		/**
+		* Set what happens when the queue of a lossless consumer is full.
+		*/
+		void set_overflow_policy(lsl_overflow_policy_t policy) { send_buffer_->set_overflow_policy(policy); }
+
 	private:
 		/**
 		* Instantiate a new server stack.
@@ -177,11 +246,99 @@ namespace lsl {
 		template<class T> void enqueue(T* data, double timestamp, bool pushthrough) { 
 			if (lsl::api_config::get_instance()->force_default_timestamps())
 				timestamp = 0.0;
-			sample_p smp(sample_factory_->new_sample(timestamp == 0.0 ? lsl_clock() : timestamp, pushthrough));
+			enqueue_stamped(data, timestamp == 0.0 ? read_clock(clock_) : timestamp, pushthrough);
+		}
+
+		/**
+		* Allocate and enqueue a new sample whose time stamp has already been assigned.
+		*/
+		template<class T> void enqueue_stamped(T* data, double timestamp, bool pushthrough) { 
+			LSL_TRACE_PUSH_BEGIN(traced,"push");
+			send_buffer_->push_sample(make_sample(data,timestamp,pushthrough));
+			LSL_TRACE_PUSH_EVENT(traced,"dispatch");
+			samples_pushed_.fetch_add(1,lslboost::memory_order_relaxed);
+		}
+
+		/// Allocate a new sample and fill in the given values.
+		template<class T> sample_p make_sample(T* data, double timestamp, bool pushthrough) {
+			sample_p smp(new_sample(timestamp,pushthrough));
 			smp->assign_typed(data);
-			send_buffer_->push_sample(smp);
+			return smp;
+		}
+
+		/// Enqueue a chunk of samples into the send buffer in one piece.
+		void publish(const std::vector<sample_p> &chunk) {
+			LSL_TRACE_PUSH_BEGIN(traced,"push");
+			if (!chunk.empty())
+				send_buffer_->push_samples(&chunk[0],chunk.size());
+			LSL_TRACE_PUSH_EVENT(traced,"dispatch");
+			samples_pushed_.fetch_add(chunk.size(),lslboost::memory_order_relaxed);
+		}
+
+		/**
+		* Allocate a new sample.
+		* If several threads push into the outlet (transp_multi_producer), the sample comes from the calling thread's cache.
+		*/
+		sample_p new_sample(double timestamp, bool pushthrough) {
+			if (!multi_producer_)
+				return sample_factory_->new_sample(timestamp,pushthrough);
+			producer_cache *cache = thread_cache();
+			if (cache->samples.empty())
+				sample_factory_->take_samples(cache->samples);
+			sample *result = cache->samples.back();
+			cache->samples.pop_back();
+			result->timestamp = timestamp;
+			result->pushthrough = pushthrough;
+			return sample_p(result);
 		}
 
+		/**
+		* The samples that a thread has taken from the factory for its pushes (if several threads push into the outlet).
+		* The caches are owned by the outlet, so that their samples are returned when it is destroyed (rather than when the threads exit).
+		*/
+		struct producer_cache {
+			explicit producer_cache(const sample::factory_p &factory): factory(factory) {}
+			/// Return the unused samples to the factory.
+			~producer_cache() {
+				for (std::size_t k=0; k<samples.size(); k++)
+					factory->release_sample(samples[k]);
+			}
+			sample::factory_p factory;		// the factory of the samples
+			std::vector<sample*> samples;	// the unused samples
+			std::vector<sample_p> reserved;	// the samples that the thread has reserved for writing in place (see reserve())
+		};
+
+		/// The thread-specific reference to a thread's producer_cache (which outlives the outlet only until the thread exits, and holds no samples).
+		struct producer_slot {
+			producer_slot(): cache(NULL) {}
+			lslboost::weak_ptr<producer_cache> owner;	// expires when the outlet (and thus the cache) is destroyed
+			producer_cache *cache;						// the cache (valid while owner has not expired)
+		};
+
+		/// Get the calling thread's producer_cache, which is created on its first use (only if several threads push into the outlet).
+		producer_cache *thread_cache() {
+			producer_slot *slot = producer_slot_.get();
+			// an expired slot is left over from a destroyed outlet whose thread-specific pointer had the same address
+			if (!slot || slot->owner.expired()) {
+				lslboost::shared_ptr<producer_cache> owned(new producer_cache(sample_factory_));
+				{
+					lslboost::lock_guard<lslboost::mutex> lock(producer_caches_mut_);
+					producer_caches_.push_back(owned);
+				}
+				if (!slot)
+					producer_slot_.reset(slot = new producer_slot());
+				slot->owner = owned;
+				slot->cache = owned.get();
+			}
+			return slot->cache;
+		}
+
+		/// Get the calling thread's pending reservation (see reserve()); each thread has its own if several threads push into the outlet.
+		std::vector<sample_p> &reservation() { return multi_producer_ ? thread_cache()->reserved : reserved_; }
+
+		/// Push the first num_samples reserved samples (whose time stamps have been assigned) and release the others.
+		void push_reserved(std::size_t num_samples);
+
 		/**
 		* Check whether some given number of channels matches the stream's channel_count.
 		* Throws an error if not.
@@ -200,7 +357,15 @@ namespace lsl {
 		std::vector<tcp_server_p> tcp_servers_;		// the threaded TCP data server(s); two if using both IP stacks
 		std::vector<udp_server_p> udp_servers_;		// the UDP timing & ident service(s); two if using both IP stacks
 		std::vector<udp_server_p> responders_;		// UDP multicast responders for service discovery (time features disabled); also using only the allowed IP stacks
-		std::vector<thread_p> io_threads_;			// threads that handle the I/O operations (two per stack: one for UDP and one for TCP)
+		multicast_publisher_p publisher_;			// the multicast publisher (if in multicast mode)
+		std::vector<thread_pool::job_p> io_jobs_;	// pooled jobs that handle the I/O operations (two per stack: one for UDP and one for TCP)
+		lslboost::atomic<lslboost::uint64_t> samples_pushed_;	// the number of samples pushed into the outlet so far
+		clock_fn clock_;							// the clock of the outlet's host (empty for lsl_clock())
+		std::vector<sample_p> reserved_;			// the samples that have been reserved for writing in place (see reserve(); unless multi_producer_)
+		bool multi_producer_;						// whether several threads may push into the outlet at the same time
+		lslboost::mutex producer_caches_mut_;		// protects producer_caches_
+		std::vector<lslboost::shared_ptr<producer_cache> > producer_caches_;	// the sample caches of the pushing threads (if multi_producer_)
+		lslboost::thread_specific_ptr<producer_slot> producer_slot_;	// the calling thread's entry in producer_caches_
 	};
 
 }
@@ -7,14 +7,31 @@
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/serialization/split_member.hpp>
 #include <boost/container/flat_set.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "tcp_server.h"
+#include "mux_server.h"
 #include "socket_utils.h"
+#include "trace.h"
 
 
 // === implementation of the tcp_server class ===
 
 using namespace lsl;
 using namespace lslboost::asio;
+using lslboost::asio::ip::udp;
+
+namespace {
+	lslboost::mutex uid_generator_mut;											// protects the UUID generator
+	lslboost::scoped_ptr<lslboost::uuids::random_generator> uid_generator;	// seeded once per process since seeding is expensive
+
+	/// Generate a new random stream UID.
+	std::string generate_uid() {
+		lslboost::lock_guard<lslboost::mutex> lock(uid_generator_mut);
+		if (!uid_generator)
+			uid_generator.reset(new lslboost::uuids::random_generator());
+		return lslboost::uuids::to_string((*uid_generator)());
+	}
+}
 
 /**
 * Construct a new TCP server for a stream outlet.
@@ -29,7 +46,7 @@ using namespace lslboost::asio;
 * @param protocol The protocol (IPv4 or IPv6) that shall be serviced by this server.
 * @param chunk_size The preferred chunk size, in samples. If 0, the pushthrough flag determines the effective chunking.
 */
-tcp_server::tcp_server(const stream_info_impl_p &info, const io_service_p &io, const send_buffer_p &sendbuf, const sample::factory_p &factory, tcp protocol, int chunk_size): chunk_size_(chunk_size), shutdown_(false), info_(info), io_(io), factory_(factory), send_buffer_(sendbuf), acceptor_(new tcp::acceptor(*io)) {
+tcp_server::tcp_server(const stream_info_impl_p &info, const io_service_p &io, const send_buffer_p &sendbuf, const sample::factory_p &factory, tcp protocol, int chunk_size): chunk_size_(chunk_size), shutdown_(false), samples_sent_(0), bytes_sent_(0), info_(info), io_(io), factory_(factory), send_buffer_(sendbuf), acceptor_(new tcp::acceptor(*io)) {
 	// open the server connection
 	acceptor_->open(protocol);
 
@@ -39,13 +56,25 @@ tcp_server::tcp_server(const stream_info_impl_p &info, const io_service_p &io, c
 	// and assign connection-dependent fields
 	// (note: this may be assigned multiple times by multiple TCPs during setup but does not matter)
 	info_->session_id(api_config::get_instance()->session_id());
-	info_->uid(lslboost::uuids::to_string(lslboost::uuids::random_generator()()));
+	info_->uid(generate_uid());
 	info_->created_at(lsl_clock());
 	info_->hostname(ip::host_name());
     if (protocol == tcp::v4())
 		info_->v4data_port(port);
 	else
 		info_->v6data_port(port);
+	// advertise the multiplexed sessions of this process (if enabled)
+	if (api_config::get_instance()->multiplex_sessions()) {
+		try {
+			int mux_port = mux_server::get_instance().port(protocol);
+			if (protocol == tcp::v4())
+				info_->v4mux_port(mux_port);
+			else
+				info_->v6mux_port(mux_port);
+		} catch(std::exception &e) {
+			std::cerr << "Could not open the port for multiplexed sessions (only direct connections will be served): " << e.what() << std::endl;
+		}
+	}
 }
 
 
@@ -55,14 +84,24 @@ tcp_server::tcp_server(const stream_info_impl_p &info, const io_service_p &io, c
 * Begin serving TCP connections.
 * Should not be called before info has been fully initialized by all involved parties (tcp_server, udp_server...)
 */
-void tcp_server::begin_serving() {
-	// pre-generate the info's messages
-	shortinfo_msg_ = info_->to_shortinfo_message();
-	fullinfo_msg_ = info_->to_fullinfo_message();
+void tcp_server::begin_serving(const std::string &shortinfo_msg) {
+	// the shortinfo is pre-generated by the outlet; the (potentially large) fullinfo is only generated when requested
+	shortinfo_msg_ = shortinfo_msg;
+	// make the stream available to the multiplexed sessions (if enabled)
+	if (api_config::get_instance()->multiplex_sessions())
+		mux_server::get_instance().add_stream(shared_from_this());
 	// start accepting connections
 	accept_next_connection();
 }
 
+/// Get the full-info server response (serialized on first use).
+/// Since all client sessions of this server are handled by a single IO thread, no locking is required.
+const std::string &tcp_server::fullinfo_msg() {
+	if (fullinfo_msg_.empty())
+		fullinfo_msg_ = info_->to_fullinfo_message();
+	return fullinfo_msg_;
+}
+
 /**
 * Initiate teardown of IO processes.
 * The actual teardown will be performed by the IO thread that runs the operations of this server.
@@ -70,12 +109,16 @@ void tcp_server::begin_serving() {
 void tcp_server::end_serving() {
 	// the shutdown flag informs the transfer thread that we're shutting down
 	shutdown_ = true;
+	// no new multiplexed feeds (the current ones end on the wakeup sample below)
+	if (api_config::get_instance()->multiplex_sessions())
+		mux_server::get_instance().remove_stream(this);
 	// issue closure of the server socket; this will result in a cancellation of the associated IO operations
 	io_->post(lslboost::bind(&tcp::acceptor::close,acceptor_));
 	// issue closure of all active client session sockets; cancels the related outstanding IO jobs
 	close_inflight_sockets();
-	// also notify any transfer threads that are blocked waiting for a sample by sending them one (= a ping)
-	send_buffer_->push_sample(factory_->new_sample(lsl_clock(), true));
+	// also notify any transfer threads that are blocked waiting for a sample by sending them one (= a ping);
+	// this takes the factory's lock, since the threads of a multi-producer outlet may still take samples from it
+	send_buffer_->push_sample(factory_->new_sample_locked(lsl_clock(), true));
 }
 
 
@@ -129,13 +172,262 @@ void tcp_server::close_inflight_sockets() {
 
 
 
+//
+// === implementation of the feed_encoder class ===
+//
+
+/**
+* Negotiate the transmission parameters and write the feed header (the response and two test-pattern samples) into a buffer.
+* @param info The stream_info of the served stream.
+* @param shortinfo_msg The shortinfo message of the served stream.
+* @param chunk_size The preferred chunk size of the outlet (or 0).
+* @param request_protocol_version The protocol version of the request line.
+* @param request_uid The UID of the request line (or empty).
+* @param request The stream from which the feed parameters are read (following the request line).
+* @param out The buffer into which the feed header and the samples are serialized.
+* @return An empty string, or the status message that shall be sent instead if the request cannot be served.
+*/
+std::string feed_encoder::negotiate(stream_info_impl &info, const std::string &shortinfo_msg, int chunk_size, int request_protocol_version, const std::string &request_uid, std::istream &request, std::streambuf &out) {
+	// --- protocol negotiation ---
+	using namespace lslboost::algorithm;
+	out_ = &out;
+	chunk_size_ = chunk_size;
+
+	// check request validity
+	if (request_protocol_version/100 > api_config::get_instance()->use_protocol_version()/100)
+		return (lslboost::format("LSL/%1% 505 Version not supported") % api_config::get_instance()->use_protocol_version()).str();
+	if (!request_uid.empty() && request_uid != info.uid())
+		return (lslboost::format("LSL/%1% 404 Not found") % api_config::get_instance()->use_protocol_version()).str();
+
+	if (request_protocol_version >= 110) {
+		int client_byte_order = 1234;			// assume little endian
+		double client_endian_performance = 0;	// the other party's endian conversion performance
+		bool client_has_ieee754_floats = true;	// the client has IEEE-754 compliant floating point formats
+		bool client_supports_subnormals = true;	// the client supports subnormal numbers
+		int client_protocol_version = request_protocol_version;	// assume that the client wants to use the same version for data transmission
+		int client_value_size = info.channel_bytes();	// assume that the client has a standard size for the relevant data type
+		channel_format_t format = info.channel_format();
+		unsigned short datagram_port = 0;		// the port of the client's UDP socket if it asks for a datagram feed
+
+		// read feed parameters
+		char buf[16384] = {0};
+		while (request.getline(buf,sizeof(buf)) && (buf[0] != '\r')) {
+			std::string hdrline(buf);
+			int colon = hdrline.find_first_of(":");
+			if (colon != std::string::npos) {
+				// extract key & value
+				std::string type = to_lower_copy(trim_copy(hdrline.substr(0,colon))), rest = to_lower_copy(trim_copy(hdrline.substr(colon+1)));
+				// strip off comments
+				int semicolon = rest.find_first_of(";");
+				if (semicolon != std::string::npos)
+					rest = rest.substr(0,semicolon);
+				// get the header information
+				if (type == "native-byte-order")
+					client_byte_order = lslboost::lexical_cast<int>(rest);
+				if (type == "endian-performance")
+					client_endian_performance = lslboost::lexical_cast<double>(rest);
+				if (type == "has-ieee754-floats")
+					client_has_ieee754_floats = lslboost::lexical_cast<bool>(rest);
+				if (type == "supports-subnormals")
+					client_supports_subnormals = lslboost::lexical_cast<bool>(rest);
+				if (type == "value-size")
+					client_value_size = lslboost::lexical_cast<int>(rest);
+				if (type == "max-buffer-length")
+					max_buffered_ = lslboost::lexical_cast<int>(rest);
+				if (type == "max-chunk-length")
+					chunk_granularity_ = lslboost::lexical_cast<int>(rest);
+				if (type == "protocol-version")
+					client_protocol_version = lslboost::lexical_cast<int>(rest);
+				if (type == "lossless")
+					lossless_ = lslboost::lexical_cast<bool>(rest);
+				if (type == "latest-only")
+					latest_only_ = lslboost::lexical_cast<int>(rest);
+				if (type == "datagram-port")
+					datagram_port = lslboost::lexical_cast<unsigned short>(rest);
+			}
+		}
+
+		// determine the parameters for data transmission
+		bool client_suppress_subnormals = false;
+		// use least common denominator data protocol version
+		data_protocol_version_ = std::min(api_config::get_instance()->use_protocol_version(),client_protocol_version);
+		// downgrade to 1.00 (portable binary format) if an unsupported binary conversion is involved
+		if (info.channel_bytes() != client_value_size)
+			data_protocol_version_ = 100;
+		if (!format_ieee754[cf_double64] || (format==cf_float32 && !format_ieee754[cf_float32]) || !client_has_ieee754_floats)
+			data_protocol_version_ = 100;
+		if (data_protocol_version_ >= 110) {
+			// decide on the byte order if conflicting
+			if (BOOST_BYTE_ORDER != client_byte_order) {
+				if (client_byte_order == 2134 && client_value_size>=8) {
+					// since we have no implementation for this byte order conversion let the client do it
+					use_byte_order_ = BOOST_BYTE_ORDER;
+				} else {
+					// let the faster party perform the endian conversion
+					use_byte_order_ = (client_value_size<=1 || (measure_endian_performance()>client_endian_performance)) ? client_byte_order : BOOST_BYTE_ORDER;
+				}
+			} else
+				use_byte_order_ = BOOST_BYTE_ORDER;
+			// determine if subnormal suppression needs to be enabled
+			client_suppress_subnormals = (format_subnormal[format] && !client_supports_subnormals);
+		}
+
+		// serve a datagram feed if asked for (its samples are in the binary format, and lossless feeds are sent over TCP)
+		if (datagram_port && datagrams_allowed_ && data_protocol_version_ >= 110 && !lossless_) {
+			datagram_port_ = datagram_port;
+			max_datagram_size_ = (std::size_t)std::min(std::max(api_config::get_instance()->datagram_size(),256),65507);
+			tag_ = datagram_tag(info.uid());
+		}
+
+		// serve a latest-only feed if asked for by buffering no more than the requested number of samples
+		// (a lossless feed must not drop any samples, and a 1.00 feed cannot restore the deduced time stamps after a gap)
+		if (latest_only_ > 0 && !lossless_ && data_protocol_version_ >= 110) {
+			if (max_buffered_ > 0)
+				max_buffered_ = std::min(max_buffered_,latest_only_);
+		} else
+			latest_only_ = 0;
+		srate_ = info.nominal_srate();
+
+		// send the response
+		std::ostream response_stream(&out);
+		response_stream << "LSL/" << api_config::get_instance()->use_protocol_version() << " 200 OK\r\n";
+		response_stream << "UID: " << info.uid() << "\r\n";
+		response_stream << "Byte-Order: " << use_byte_order_ << "\r\n";
+		response_stream << "Suppress-Subnormals: " << client_suppress_subnormals << "\r\n";
+		response_stream << "Data-Protocol-Version: " << data_protocol_version_ << "\r\n";
+		if (lossless_)
+			response_stream << "Lossless: 1\r\n";
+		if (datagram_port_)
+			response_stream << "Datagrams: 1\r\n";
+		if (latest_only_)
+			response_stream << "Latest-Only: " << latest_only_ << "\r\n";
+		response_stream << "\r\n" << std::flush;
+	} else {
+		// read feed parameters
+		request >> max_buffered_ >> chunk_granularity_;
+	}
+
+	// --- validation ---
+	if (data_protocol_version_ == 100) {
+		// create a portable output archive to write to
+		outarch_.reset(new eos::portable_oarchive(out));
+		// serialize the shortinfo message into an archive
+		*outarch_ << shortinfo_msg;
+	} else {
+		// allocate scratchpad memory for endian conversion, etc.
+		scratch_.reset(new char[format_sizes[info.channel_format()]*info.channel_count()]);
+	}
+
+	// send test pattern samples
+	lslboost::scoped_ptr<sample> temp(sample::factory::new_sample_unmanaged(info.channel_format(),info.channel_count(),0.0,false));
+	temp->assign_test_pattern(4); if (data_protocol_version_ >= 110) temp->save_streambuf(out,data_protocol_version_,use_byte_order_,scratch_.get()); else *outarch_ << *temp;
+	temp->assign_test_pattern(2); if (data_protocol_version_ >= 110) temp->save_streambuf(out,data_protocol_version_,use_byte_order_,scratch_.get()); else *outarch_ << *temp;
+	return std::string();
+}
+
+/**
+* Serialize a sample into the buffer.
+* @param samp The sample.
+* @param skipped The number of samples that the consumer queue has dropped right before this one.
+* @return Whether the data serialized so far shall be sent off (the end of a chunk).
+*/
+bool feed_encoder::encode(sample &samp, lslboost::uint64_t skipped) {
+	// optionally override the pushthrough flag by the chunk size of the receiver (if set) or of the sender (if set);
+	// a latest-only feed sends every sample right away, since a newer one may supersede it while it is held back
+	bool pushthrough = samp.pushthrough;
+	if (latest_only_)
+		pushthrough = true;
+	else if (chunk_granularity_)
+		pushthrough = (((++seqn_)%(unsigned)chunk_granularity_) == 0);
+	else
+		if (chunk_size_)
+			pushthrough = (((++seqn_)%(unsigned)chunk_size_) == 0);
+	if (data_protocol_version_ >= 110) {
+		// the client deduces a time stamp from that of the previous sample, which it has not received if dropped here
+		bool explicit_timestamp = skipped || !last_timestamp_;
+		double timestamp = resolve_timestamp(samp,skipped);
+		samp.save_streambuf(*out_,data_protocol_version_,use_byte_order_,scratch_.get(),explicit_timestamp ? timestamp : DEDUCED_TIMESTAMP);
+	} else
+		*outarch_ << samp;
+	return pushthrough;
+}
+
+/**
+* Serialize a sample into a datagram of a datagram feed.
+* @param samp The sample.
+* @param dgram Receives the datagram.
+* @param skipped The number of samples that the consumer queue has dropped right before this one.
+* @return False if the sample is too large for a datagram; it has then been serialized into the buffer instead
+*		  (and shall be sent over the connection, followed by a heartbeat datagram).
+*/
+bool feed_encoder::encode_datagram(sample &samp, std::string &dgram, lslboost::uint64_t skipped) {
+	// every sample gets an explicit time stamp, since the previous one may have been lost (or dropped here)
+	double timestamp = resolve_timestamp(samp,skipped);
+	dgram.resize(datagram_header_size);
+	string_sink sink(dgram);
+	samp.save_streambuf(sink,data_protocol_version_,use_byte_order_,scratch_.get(),timestamp);
+	datagram_header hdr;
+	hdr.tag = tag_;
+	hdr.seq = seq_;
+	hdr.index = index_++;
+	hdr.fragment = 0;
+	hdr.fragments = 0;
+	hdr.byte_order = (lslboost::uint16_t)use_byte_order_;
+	hdr.flags = 0;
+	datagram_write_header(&dgram[0],hdr);
+	if (dgram.size() <= max_datagram_size_) {
+		seq_++;
+		return true;
+	}
+	// the datagrams skip the number of a sample that goes over the connection (preceded by its length)
+	char length[4]; datagram_put(length,dgram.size(),4);
+	out_->sputn(length,4);
+	out_->sputn(dgram.data(),dgram.size());
+	return false;
+}
+
+/**
+* Resolve the time stamp of a sample, which is deduced from that of the previous sample (if any; otherwise the current
+* time is the best guess) unless it has been given explicitly.
+* @param samp The sample.
+* @param skipped The number of samples that the consumer queue has dropped right before this one.
+*/
+double feed_encoder::resolve_timestamp(const sample &samp, lslboost::uint64_t skipped) {
+	double timestamp = samp.timestamp;
+	if (timestamp == DEDUCED_TIMESTAMP) {
+		if (!last_timestamp_)
+			timestamp = lsl_clock();
+		else {
+			timestamp = last_timestamp_;
+			if (srate_ != IRREGULAR_RATE)
+				timestamp += (double)(1 + skipped)/srate_;
+		}
+	}
+	return last_timestamp_ = timestamp;
+}
+
+/// Serialize a datagram without payload (a heartbeat, or the end of the feed) of a datagram feed.
+void feed_encoder::encode_control(lslboost::uint16_t flags, std::string &dgram) {
+	datagram_header hdr;
+	hdr.tag = tag_;
+	hdr.seq = seq_;
+	hdr.index = index_;
+	hdr.fragment = 0;
+	hdr.fragments = 0;
+	hdr.byte_order = (lslboost::uint16_t)use_byte_order_;
+	hdr.flags = flags;
+	dgram.resize(datagram_header_size);
+	datagram_write_header(&dgram[0],hdr);
+}
+
+
 //
 // === implementation of the tcp_server::client_session class ===
 //
 
 
 /// Instantiate a new session & its socket.
-tcp_server::client_session::client_session(const tcp_server_p &serv): registered_(false), io_(serv->io_), serv_(serv), sock_(tcp_socket_p(new tcp::socket(*serv->io_))), requeststream_(&requestbuf_), use_byte_order_(0), data_protocol_version_(100) {	}
+tcp_server::client_session::client_session(const tcp_server_p &serv): registered_(false), io_(serv->io_), serv_(serv), sock_(tcp_socket_p(new tcp::socket(*serv->io_))), requeststream_(&requestbuf_), peer_data_(0), peer_closed_(false) {	}
 
 /**
 * Destructor. Unregisters the socket from the server & closes it.
@@ -184,12 +476,19 @@ void tcp_server::client_session::handle_read_command_outcome(error_code err) {
 					lslboost::bind(&client_session::handle_read_query_outcome,shared_from_this(),placeholders::error));
 			if (method == "LSL:fullinfo")
 				// fullinfo request: reply right away
-				async_write(*sock_, lslboost::asio::buffer(serv_->fullinfo_msg_),
+				async_write(*sock_, lslboost::asio::buffer(serv_->fullinfo_msg()),
 					lslboost::bind(&client_session::handle_send_outcome,shared_from_this(),placeholders::error));
 			if (method == "LSL:streamfeed")
 				// streamfeed request (1.00): read feed parameters
 				async_read_until(*sock_, requestbuf_, "\r\n",
 					lslboost::bind(&client_session::handle_read_feedparams,shared_from_this(),100,"",placeholders::error));
+			if (lslboost::algorithm::starts_with(method,"LSL:repair/")) {
+				// repair request: read the range of datagrams
+				std::vector<std::string> parts; lslboost::algorithm::split(parts,method,lslboost::algorithm::is_any_of(" \t"));
+				std::string request_uid = (parts.size()>1) ? parts[1] : "";
+				async_read_until(*sock_, requestbuf_, "\r\n",
+					lslboost::bind(&client_session::handle_read_repair_outcome,shared_from_this(),request_uid,placeholders::error));
+			}
 			if (lslboost::algorithm::starts_with(method,"LSL:streamfeed/")) {
 				// streamfeed request with version: read feed parameters
 				std::vector<std::string> parts; lslboost::algorithm::split(parts,method,lslboost::algorithm::is_any_of(" \t"));
@@ -220,6 +519,28 @@ void tcp_server::client_session::handle_read_query_outcome(error_code err) {
 	}
 }
 
+/// Handler that gets called after finishing reading of the range of a repair request.
+void tcp_server::client_session::handle_read_repair_outcome(std::string request_uid, error_code err) {
+	try {
+		if (!err) {
+			// read the range line ([First] [Count])
+			lslboost::uint64_t first = 0, count = 0;
+			requeststream_ >> first >> count;
+			std::string rest; getline(requeststream_,rest);
+			int protocol_version = api_config::get_instance()->use_protocol_version();
+			if (!serv_->publisher_ || request_uid != serv_->info_->uid()) {
+				send_status_message((lslboost::format("LSL/%1% 404 Not found\r\n\r\n") % protocol_version).str());
+				return;
+			}
+			std::string response = (lslboost::format("LSL/%1% 200 OK\r\n\r\n") % protocol_version).str();
+			serv_->publisher_->repair(first,count,response);
+			send_status_message(response);
+		}
+	} catch(std::exception &e) {
+		std::cerr << "Unexpected error while serving a repair request (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
+	}
+}
+
 /// Handler that gets called after finishing the sending of a reply (nothing to do here).
 void tcp_server::client_session::handle_send_outcome(error_code err) { }
 
@@ -237,113 +558,13 @@ void tcp_server::client_session::handle_status_outcome(string_p msg, error_code
 void tcp_server::client_session::handle_read_feedparams(int request_protocol_version, std::string request_uid, error_code err) {
 	try {
 		if (!err) {
-			// --- protocol negotiation ---
-			using namespace lslboost::algorithm;
-
-			// check request validity
-			if (request_protocol_version/100 > api_config::get_instance()->use_protocol_version()/100) {
-				send_status_message((lslboost::format("LSL/%1% 505 Version not supported") % api_config::get_instance()->use_protocol_version()).str());
-				return;
-			}
-			if (!request_uid.empty() && request_uid != serv_->info_->uid()) {
-				send_status_message((lslboost::format("LSL/%1% 404 Not found") % api_config::get_instance()->use_protocol_version()).str());
+			// negotiate the feed and serialize the feed header (a client with a dedicated connection may ask for a datagram feed)
+			feed_.allow_datagrams();
+			std::string status = feed_.negotiate(*serv_->info_,serv_->shortinfo_msg_,serv_->chunk_size_,request_protocol_version,request_uid,requeststream_,feedbuf_);
+			if (!status.empty()) {
+				send_status_message(status);
 				return;
 			}
-
-			if (request_protocol_version >= 110) {
-				int client_byte_order = 1234;			// assume little endian
-				double client_endian_performance = 0;	// the other party's endian conversion performance
-				bool client_has_ieee754_floats = true;	// the client has IEEE-754 compliant floating point formats
-				bool client_supports_subnormals = true;	// the client supports subnormal numbers
-				int client_protocol_version = request_protocol_version;	// assume that the client wants to use the same version for data transmission
-				int client_value_size = serv_->info_->channel_bytes();	// assume that the client has a standard size for the relevant data type
-				channel_format_t format = serv_->info_->channel_format();
-
-				// read feed parameters
-				char buf[16384] = {0};
-				while (requeststream_.getline(buf,sizeof(buf)) && (buf[0] != '\r')) {
-					std::string hdrline(buf);
-					int colon = hdrline.find_first_of(":");
-					if (colon != std::string::npos) {
-						// extract key & value
-						std::string type = to_lower_copy(trim_copy(hdrline.substr(0,colon))), rest = to_lower_copy(trim_copy(hdrline.substr(colon+1)));
-						// strip off comments
-						int semicolon = rest.find_first_of(";");
-						if (semicolon != std::string::npos)
-							rest = rest.substr(0,semicolon);
-						// get the header information
-						if (type == "native-byte-order")
-							client_byte_order = lslboost::lexical_cast<int>(rest);
-						if (type == "endian-performance")
-							client_endian_performance = lslboost::lexical_cast<double>(rest);
-						if (type == "has-ieee754-floats")
-							client_has_ieee754_floats = lslboost::lexical_cast<bool>(rest);
-						if (type == "supports-subnormals")
-							client_supports_subnormals = lslboost::lexical_cast<bool>(rest);
-						if (type == "value-size")
-							client_value_size = lslboost::lexical_cast<int>(rest);
-						if (type == "max-buffer-length")
-							max_buffered_ = lslboost::lexical_cast<int>(rest);
-						if (type == "max-chunk-length")
-							chunk_granularity_ = lslboost::lexical_cast<int>(rest);
-						if (type == "protocol-version")
-							client_protocol_version = lslboost::lexical_cast<int>(rest);
-					}
-				}
-
-				// determine the parameters for data transmission
-				bool client_suppress_subnormals = false;
-				// use least common denominator data protocol version
-				data_protocol_version_ = std::min(api_config::get_instance()->use_protocol_version(),client_protocol_version);
-				// downgrade to 1.00 (portable binary format) if an unsupported binary conversion is involved
-				if (serv_->info_->channel_bytes() != client_value_size)
-					data_protocol_version_ = 100;
-				if (!format_ieee754[cf_double64] || (format==cf_float32 && !format_ieee754[cf_float32]) || !client_has_ieee754_floats)
-					data_protocol_version_ = 100;
-				if (data_protocol_version_ >= 110) {
-					// decide on the byte order if conflicting
-					if (BOOST_BYTE_ORDER != client_byte_order) {
-						if (client_byte_order == 2134 && client_value_size>=8) {
-							// since we have no implementation for this byte order conversion let the client do it
-							use_byte_order_ = BOOST_BYTE_ORDER;
-						} else {
-							// let the faster party perform the endian conversion
-							use_byte_order_ = (client_value_size<=1 || (measure_endian_performance()>client_endian_performance)) ? client_byte_order : BOOST_BYTE_ORDER;
-						}
-					} else
-						use_byte_order_ = BOOST_BYTE_ORDER;
-					// determine if subnormal suppression needs to be enabled
-					client_suppress_subnormals = (format_subnormal[format] && !client_supports_subnormals);
-				}
-
-				// send the response
-				std::ostream response_stream(&feedbuf_);
-				response_stream << "LSL/" << api_config::get_instance()->use_protocol_version() << " 200 OK\r\n";
-				response_stream << "UID: " << serv_->info_->uid() << "\r\n";
-				response_stream << "Byte-Order: " << use_byte_order_ << "\r\n";
-				response_stream << "Suppress-Subnormals: " << client_suppress_subnormals << "\r\n";
-				response_stream << "Data-Protocol-Version: " << data_protocol_version_ << "\r\n";
-				response_stream << "\r\n" << std::flush;
-			} else {
-				// read feed parameters
-				requeststream_ >> max_buffered_ >> chunk_granularity_;
-			}
-
-			// --- validation ---
-			if (data_protocol_version_ == 100) {
-				// create a portable output archive to write to
-				outarch_.reset(new eos::portable_oarchive(feedbuf_));
-				// serialize the shortinfo message into an archive
-				*outarch_ << serv_->shortinfo_msg_;
-			} else {
-				// allocate scratchpad memory for endian conversion, etc.
-				scratch_.reset(new char[format_sizes[serv_->info_->channel_format()]*serv_->info_->channel_count()]);
-			}
-
-			// send test pattern samples
-			lslboost::scoped_ptr<sample> temp(sample::factory::new_sample_unmanaged(serv_->info_->channel_format(),serv_->info_->channel_count(),0.0,false));
-			temp->assign_test_pattern(4); if (data_protocol_version_ >= 110) temp->save_streambuf(feedbuf_,data_protocol_version_,use_byte_order_,scratch_.get()); else *outarch_ << *temp;
-			temp->assign_test_pattern(2); if (data_protocol_version_ >= 110) temp->save_streambuf(feedbuf_,data_protocol_version_,use_byte_order_,scratch_.get()); else *outarch_ << *temp;
 			// send off the newly created feedheader
 			async_write(*sock_,feedbuf_.data(),
 				lslboost::bind(&client_session::handle_send_feedheader_outcome,shared_from_this(),placeholders::error,placeholders::bytes_transferred));
@@ -370,13 +591,18 @@ void tcp_server::client_session::handle_send_feedheader_outcome(error_code err,
 
 /// Transfers samples from the server's send buffer into the async send queues of the IO threads.
 void tcp_server::client_session::transfer_samples_thread(client_session_p) {
-	if (max_buffered_ <= 0)
+	if (feed_.max_buffered() <= 0)
 		return;
 	try {
 		// make a new consumer queue
-		consumer_queue_p queue = serv_->send_buffer_->new_consumer(max_buffered_);
-		// the sequence # is merely used to determine chunk boundaries (no need for int64)
-		unsigned seqn = 0;
+		// (a lossless consumer applies the outlet's overflow policy instead of dropping samples when it falls behind)
+		consumer_queue_p queue = feed_.lossless() ? serv_->send_buffer_->new_lossless_consumer(feed_.max_buffered(),serv_->info_->channel_format(),serv_->info_->channel_count()) : serv_->send_buffer_->new_consumer(feed_.max_buffered());
+		if (feed_.datagram_port()) {
+			transfer_datagrams(queue);
+			return;
+		}
+		// the number of samples in the chunk that is being aggregated
+		unsigned chunk_samples = 0;
 		while (!serv_->shutdown_) {
 			try {
 				// get next sample from the sample queue (blocking)
@@ -386,28 +612,20 @@ void tcp_server::client_session::transfer_samples_thread(client_session_p) {
 				// ignore blank samples (they are basically wakeup notifiers from someone's end_serving())
 				if (!samp)
 					continue;
-				// optionally override the pushthrough flag by the chunk size of the receiver (if set) or of the sender (if set)
-				if (chunk_granularity_)
-					samp->pushthrough = (((++seqn)%(unsigned)chunk_granularity_) == 0);
-				else
-					if (serv_->chunk_size_)
-						samp->pushthrough = (((++seqn)%(unsigned)serv_->chunk_size_) == 0);
 				// serialize the sample into the stream
-				if (data_protocol_version_ >= 110) samp->save_streambuf(feedbuf_,data_protocol_version_,use_byte_order_,scratch_.get()); else *outarch_ << *samp;
+				bool pushthrough;
+				{
+					LSL_TRACE_SCOPE("serialize");
+					pushthrough = feed_.encode(*samp,queue->skipped());
+				}
+				chunk_samples++;
 				// if the sample shall be pushed though...
-				if (samp->pushthrough) {
-					// send off the chunk that we aggregated so far
-					lslboost::unique_lock<lslboost::mutex> lock(completion_mut_);
-					transfer_completed_ = false;
-					async_write(*sock_,feedbuf_.data(),
-						lslboost::bind(&client_session::handle_chunk_transfer_outcome,shared_from_this(),placeholders::error,placeholders::bytes_transferred));
-					// wait for the completion condition
-					completion_cond_.wait(lock, lslboost::bind(&client_session::transfer_completed,this));
-					// handle transfer outcome
-					if (!transfer_error_) {
-						feedbuf_.consume(transfer_amount_);
-					} else
+				if (pushthrough) {
+					// send off the chunk that we aggregated so far (the trace event ends when the write has completed)
+					LSL_TRACE_SCOPE("write");
+					if (!send_feedbuf(chunk_samples))
 						break;
+					chunk_samples = 0;
 				}
 
 			} catch(std::exception &e) {
@@ -419,6 +637,89 @@ void tcp_server::client_session::transfer_samples_thread(client_session_p) {
 	}
 }
 
+/// The time after which a heartbeat is sent to the client of a datagram feed if no data has been sent, in seconds.
+const double heartbeat_interval = 0.5;
+
+/**
+* Sends the samples of a datagram feed to the client's UDP socket (see feed_encoder).
+* Each sample goes out as a datagram right away (the chunking does not apply), except for those that are too large for
+* one, which are sent over the connection and followed by a heartbeat, so that the client picks them up without delay.
+* Heartbeats are also sent while there is no data (so that the client notices lost datagrams at the end of a burst).
+* The feed ends when the client closes the connection or the server shuts down.
+*/
+void tcp_server::client_session::transfer_datagrams(const consumer_queue_p &queue) {
+	udp::socket dsock(*io_);
+	dsock.open(sock_->local_endpoint().protocol() == tcp::v4() ? udp::v4() : udp::v6());
+	dsock.connect(udp::endpoint(sock_->remote_endpoint().address(),feed_.datagram_port()));
+	// the client sends nothing after the request, so a read completes when it closes the connection
+	peer_closed_ = false;
+	sock_->async_read_some(lslboost::asio::buffer(&peer_data_,1),
+		lslboost::bind(&client_session::handle_peer_closed,shared_from_this(),placeholders::error));
+	std::string dgram;
+	error_code ec;
+	feed_.encode_control(datagram_heartbeat,dgram);
+	dsock.send(lslboost::asio::buffer(dgram),0,ec);
+	while (!serv_->shutdown_ && !peer_closed_) {
+		try {
+			sample_p samp(queue->pop_sample(heartbeat_interval));
+			if (serv_->shutdown_ || peer_closed_)
+				break;
+			if (samp) {
+				bool fits;
+				{
+					LSL_TRACE_SCOPE("serialize");
+					fits = feed_.encode_datagram(*samp,dgram,queue->skipped());
+				}
+				LSL_TRACE_SCOPE("write");
+				if (fits) {
+					// a datagram that could not be sent counts as lost
+					dsock.send(lslboost::asio::buffer(dgram),0,ec);
+					serv_->samples_sent_.fetch_add(1,lslboost::memory_order_relaxed);
+					serv_->bytes_sent_.fetch_add(dgram.size(),lslboost::memory_order_relaxed);
+					continue;
+				}
+				if (!send_feedbuf(1))
+					break;
+			}
+			feed_.encode_control(datagram_heartbeat,dgram);
+			dsock.send(lslboost::asio::buffer(dgram),0,ec);
+		} catch(std::exception &e) {
+			std::cerr << "Unexpected glitch in transfer_datagrams (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
+		}
+	}
+	// datagrams may get lost, so the end is announced twice
+	feed_.encode_control(datagram_end,dgram);
+	for (int k=0; k<2; k++)
+		dsock.send(lslboost::asio::buffer(dgram),0,ec);
+}
+
+/**
+* Sends off the data in the feed buffer and waits for the transfer to complete.
+* @param samples The number of samples in the buffer (for the statistics).
+* @return False if the transfer failed (e.g., since the client has gone away).
+*/
+bool tcp_server::client_session::send_feedbuf(unsigned samples) {
+	lslboost::unique_lock<lslboost::mutex> lock(completion_mut_);
+	transfer_completed_ = false;
+	async_write(*sock_,feedbuf_.data(),
+		lslboost::bind(&client_session::handle_chunk_transfer_outcome,shared_from_this(),placeholders::error,placeholders::bytes_transferred));
+	// wait for the completion condition
+	completion_cond_.wait(lock, lslboost::bind(&client_session::transfer_completed,this));
+	// handle transfer outcome
+	if (transfer_error_)
+		return false;
+	feedbuf_.consume(transfer_amount_);
+	// account for the transferred chunk
+	serv_->samples_sent_.fetch_add(samples,lslboost::memory_order_relaxed);
+	serv_->bytes_sent_.fetch_add(transfer_amount_,lslboost::memory_order_relaxed);
+	return true;
+}
+
+/// Handler that gets called when the client of a datagram feed has closed the connection (or sent something).
+void tcp_server::client_session::handle_peer_closed(error_code) {
+	peer_closed_ = true;
+}
+
 /// Handler that gets called when a sample transfer has been completed.
 void tcp_server::client_session::handle_chunk_transfer_outcome(error_code err, std::size_t len) {
 	try {
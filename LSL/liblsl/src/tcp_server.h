@@ -9,12 +9,14 @@
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/streambuf.hpp>
+#include <boost/atomic.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/thread.hpp>
 #include "common.h"
 
 #include "send_buffer.h"
 #include "api_config.h"
+#include "multicast_publisher.h"
 #include "portable_archive/portable_oarchive.hpp"
 
 
@@ -34,15 +36,114 @@ namespace lsl {
 	/// pointer to an io_service
 	typedef lslboost::shared_ptr<lslboost::asio::io_service> io_service_p;
 
+	/**
+	* The encoding of a data feed to one client: negotiates the transmission parameters from the client's feed request
+	* and serializes the feed header and the samples into a stream buffer.
+	* Used by the sessions of the TCP data server and by the multiplexed sessions (see mux_server).
+	* A client can ask for a datagram feed (by giving the port of its UDP socket), where each sample is sent to it as a
+	* single datagram (see datagram.h) instead of over the connection, which saves the latency of the TCP transfer for
+	* small, irregular samples such as event markers. Lost datagrams are not re-sent; samples that are too large for a
+	* datagram (see api_config::datagram_size()) are still sent over the connection.
+	* A client can also ask for a latest-only feed (e.g., a viewer or a control loop), for which at most the given number of
+	* samples is buffered, so that a newer sample supersedes the oldest one that has not been sent yet (see lsl_set_latest_only).
+	*/
+	class feed_encoder {
+	public:
+		/// Create an encoder that has not yet negotiated a feed.
+		feed_encoder(): out_(NULL), data_protocol_version_(100), use_byte_order_(0), chunk_granularity_(0), chunk_size_(0), max_buffered_(0), lossless_(false), latest_only_(0), seqn_(0),
+			datagrams_allowed_(false), datagram_port_(0), max_datagram_size_(0), tag_(0), seq_(0), index_(0), srate_(0.0), last_timestamp_(0.0) {}
+
+		/// Let the client ask for a datagram feed (only a session with its own connection can send one).
+		void allow_datagrams() { datagrams_allowed_ = true; }
+
+		/**
+		* Negotiate the transmission parameters and write the feed header (the response and two test-pattern samples) into a buffer.
+		* @param info The stream_info of the served stream.
+		* @param shortinfo_msg The shortinfo message of the served stream.
+		* @param chunk_size The preferred chunk size of the outlet (or 0).
+		* @param request_protocol_version The protocol version of the request line.
+		* @param request_uid The UID of the request line (or empty).
+		* @param request The stream from which the feed parameters are read (following the request line).
+		* @param out The buffer into which the feed header and the samples are serialized.
+		* @return An empty string, or the status message that shall be sent instead if the request cannot be served.
+		*/
+		std::string negotiate(stream_info_impl &info, const std::string &shortinfo_msg, int chunk_size, int request_protocol_version, const std::string &request_uid, std::istream &request, std::streambuf &out);
+
+		/**
+		* Serialize a sample into the buffer.
+		* A sample whose predecessor has been dropped (e.g., superseded on a latest-only feed) gets an explicit time stamp.
+		* @param samp The sample.
+		* @param skipped The number of samples that the consumer queue has dropped right before this one.
+		* @return Whether the data serialized so far shall be sent off (the end of a chunk).
+		*/
+		bool encode(sample &samp, lslboost::uint64_t skipped=0);
+
+		/**
+		* Serialize a sample into a datagram of a datagram feed.
+		* @param samp The sample.
+		* @param dgram Receives the datagram.
+		* @param skipped The number of samples that the consumer queue has dropped right before this one.
+		* @return False if the sample is too large for a datagram; it has then been serialized into the buffer instead
+		*		  (and shall be sent over the connection, followed by a heartbeat datagram).
+		*/
+		bool encode_datagram(sample &samp, std::string &dgram, lslboost::uint64_t skipped=0);
+
+		/// Serialize a datagram without payload (a heartbeat, or the end of the feed) of a datagram feed.
+		void encode_control(lslboost::uint16_t flags, std::string &dgram);
+
+		/// The port of the client's UDP socket if it receives a datagram feed (otherwise 0).
+		unsigned short datagram_port() const { return datagram_port_; }
+
+		/// The maximum number of samples that shall be buffered for the client (no data is sent if <= 0; at most latest_only() if set).
+		int max_buffered() const { return max_buffered_; }
+
+		/// Whether the client has asked for lossless transmission.
+		bool lossless() const { return lossless_; }
+
+		/// The number of most recent samples that are kept for the client of a latest-only feed (otherwise 0).
+		int latest_only() const { return latest_only_; }
+
+	private:
+		/// Resolve the time stamp of a sample (deduced from that of the previous one unless given explicitly).
+		double resolve_timestamp(const sample &samp, lslboost::uint64_t skipped);
+
+		std::streambuf *out_;				// the buffer that receives the feed
+		lslboost::scoped_ptr<eos::portable_oarchive> outarch_;	// output archive (wrapped around the feed buffer)
+		lslboost::scoped_array<char> scratch_;	// scratchpad memory (e.g., for endianness conversion)
+		int data_protocol_version_;			// protocol version to use for transmission
+		int use_byte_order_;				// byte order to use (0=portable, 1234=little endian, 4321=big endian, 2134=PDP endian, not supported)
+		int chunk_granularity_;				// the chunk granularity requested by the client
+		int chunk_size_;					// the chunk size of the outlet (or 0)
+		int max_buffered_;					// maximum number of samples buffered
+		bool lossless_;						// whether the client has asked for lossless transmission
+		int latest_only_;					// the number of samples kept for a latest-only feed (or 0)
+		unsigned seqn_;						// the sequence # is merely used to determine chunk boundaries (no need for int64)
+
+		// datagram feeds
+		bool datagrams_allowed_;			// whether the client may ask for a datagram feed
+		unsigned short datagram_port_;		// the port of the client's UDP socket (or 0 if it receives the feed over TCP)
+		std::size_t max_datagram_size_;		// the maximum size of a datagram
+		lslboost::uint32_t tag_;			// the tag of the stream (see datagram.h)
+		lslboost::uint64_t seq_;			// the number of the next datagram
+		lslboost::uint64_t index_;			// the number of the next sample
+
+		// explicit time stamps after dropped samples (and on datagram feeds)
+		double srate_;						// the nominal sampling rate of the stream (for deducing time stamps)
+		double last_timestamp_;				// the time stamp of the last sample
+	};
+
 	/**
 	* The TCP data server.
 	* Acts as a TCP server on a free port (in the configured port range), and understands the following messages:
 	*  * LSL:streamfeed: A request to receive streaming data on the connection. The server responds with
 	*				     the shortinfo, two samples filled with a test pattern, followed by samples until
-	*					 the server outlet goes out of existence.
+	*					 the server outlet goes out of existence (or, for a datagram feed, sends the samples
+	*					 to the client's UDP socket; see feed_encoder).
 	*  * LSL:fullinfo: A request for the stream_info served by this server.
 	*  * LSL:shortinfo: A request for the stream_info served by this server if matching the provided query string.
 	*                   The short version of the stream_info (empty <desc> element) is returned.
+	*  * LSL:repair: A request for datagrams that have been published to the stream's multicast group (see
+	*				 multicast_publisher::repair()), followed by a line with the number of the first one and the count.
 	*/
 	class tcp_server: public lslboost::enable_shared_from_this<tcp_server> {
 	public:
@@ -65,13 +166,25 @@ namespace lsl {
 		/// Begin serving TCP connections.
 		/// Should not be called before info_ has been fully initialized by all involved parties (tcp_server, udp_server)
 		/// since no modifications to the stream_info thereafter are permitted.
-		void begin_serving();
+		/// @param shortinfo_msg The pre-computed shortinfo message of the stream (shared by all servers of an outlet).
+		void begin_serving(const std::string &shortinfo_msg);
+
+		/// Serve repair requests for the datagrams of the given multicast publisher (must be called before begin_serving()).
+		void set_publisher(const multicast_publisher_p &publisher) { publisher_ = publisher; }
 
 		/// Initiate teardown of IO processes.
 		/// The actual teardown will be performed by the IO thread that runs the operations of this server.
 		void end_serving();
 
+		/// Get the number of samples that have been sent to all clients of this server so far.
+		lslboost::uint64_t samples_sent() const { return samples_sent_.load(lslboost::memory_order_relaxed); }
+
+		/// Get the number of bytes of sample data that have been sent to all clients of this server so far.
+		lslboost::uint64_t bytes_sent() const { return bytes_sent_.load(lslboost::memory_order_relaxed); }
+
 	private:
+		friend class mux_server;
+
 		/// shared pointer to a client session
 		class client_session;
 		typedef lslboost::shared_ptr<client_session> client_session_p;
@@ -130,6 +243,9 @@ namespace lsl {
 			/// Handler that gets called after finishing reading of the query line.
 			void handle_read_query_outcome(error_code err);
 
+			/// Handler that gets called after finishing reading of the range of a repair request.
+			void handle_read_repair_outcome(std::string request_uid, error_code err);
+
 			/// Handler that gets called after finishing the sending of a reply (nothing to do here).
 			void handle_send_outcome(error_code err);
 
@@ -148,9 +264,18 @@ namespace lsl {
 			/// Transfers samples from the server's send buffer into the async send queues of the IO threads.
 			void transfer_samples_thread(client_session_p sess);
 
+			/// Sends the samples of a datagram feed to the client's UDP socket (see feed_encoder).
+			void transfer_datagrams(const consumer_queue_p &queue);
+
+			/// Sends off the data in the feed buffer and waits for the transfer to complete; returns false if it failed.
+			bool send_feedbuf(unsigned samples);
+
 			/// Handler that gets called when a sample transfer has been completed.
 			void handle_chunk_transfer_outcome(error_code err, std::size_t len);
 
+			/// Handler that gets called when the client of a datagram feed has closed the connection (or sent something).
+			void handle_peer_closed(error_code err);
+
 			/// There is a condition variable that is waiting on this condition in the inner transfer loop
 			bool transfer_completed() const { return transfer_completed_; }
 
@@ -163,13 +288,8 @@ namespace lsl {
 			// data used by the transfer thread (and some other handlers)
 			lslboost::asio::streambuf feedbuf_;	// this buffer holds the data feed generated by us
 			lslboost::asio::streambuf requestbuf_;	// this buffer holds the request as received from the client (incrementally filled)
-			lslboost::scoped_ptr<eos::portable_oarchive> outarch_;	// output archive (wrapped around the feed buffer)
 			std::istream requeststream_;		// this is a stream on top of the request buffer for convenient parsing			
-			lslboost::scoped_array<char> scratch_;	// scratchpad memory (e.g., for endianness conversion)
-			int data_protocol_version_;			// protocol version to use for transmission
-			int use_byte_order_;				// byte order to use (0=portable, 1234=little endian, 4321=big endian, 2134=PDP endian, not supported)
-			int chunk_granularity_;				// our chunk granularity
-			int max_buffered_;					// maximum number of samples buffered
+			feed_encoder feed_;					// the negotiated feed parameters and the serialization of the feed
 
 			// data exchanged between the transfer completion handler and the transfer thread
 			bool transfer_completed_;			// whether the current transfer has finished (possibly with an error)
@@ -177,17 +297,24 @@ namespace lsl {
 			std::size_t transfer_amount_;		// the amount of bytes transferred
 			lslboost::mutex completion_mut_;		// a mutex that protects the completion data
 			lslboost::condition_variable completion_cond_;	// a condition variable that signals completion
+
+			// data of a datagram feed
+			char peer_data_;					// a byte that the client might send (the connection is read to notice when it closes)
+			lslboost::atomic<bool> peer_closed_;	// whether the client has closed the connection
 		};
 
 		// data used by the transfer threads
 		int chunk_size_;						// the chunk size to use (or 0)
 		bool shutdown_;							// shutdown flag: tells the transfer thread that it should terminate itself asap
+		lslboost::atomic<lslboost::uint64_t> samples_sent_;	// number of samples sent by all transfer threads (updated once per chunk)
+		lslboost::atomic<lslboost::uint64_t> bytes_sent_;	// number of bytes sent by all transfer threads (updated once per chunk)
 
 		// data shared with the outlet
 		stream_info_impl_p info_;				// shared stream_info object
 		io_service_p io_;						// shared ptr to IO service; ensures that the IO is still around by the time the acceptor needs to be destroyed
 		sample::factory_p factory_;				// reference to the sample factory (which owns the samples)
 		send_buffer_p send_buffer_;				// the send buffer, shared with other TCP's and the outlet
+		multicast_publisher_p publisher_;		// the multicast publisher of the outlet (if any)
 
 		// acceptor socket
 		tcp_acceptor_p acceptor_;				// our server socket
@@ -196,9 +323,12 @@ namespace lsl {
 		std::set<tcp_socket_p> inflight_;		// registry of currently in-flight sockets
 		lslboost::recursive_mutex inflight_mut_;	// mutex protecting the registry from concurrent access
 
+		/// Get the full-info server response (serialized on first use; only called from the IO thread).
+		const std::string &fullinfo_msg();
+
 		// some cached data
 		std::string shortinfo_msg_;				// pre-computed short-info server response
-		std::string fullinfo_msg_;				// pre-computed full-info server response
+		std::string fullinfo_msg_;				// lazily computed full-info server response (empty until first requested)
 	};
 }
 
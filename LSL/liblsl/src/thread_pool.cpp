@@ -0,0 +1,79 @@
+#include <iostream>
+#include <boost/bind.hpp>
+#include "thread_pool.h"
+
+
+// === implementation of the thread_pool class ===
+
+using namespace lsl;
+
+/// Get the process-wide pool instance.
+/// The instance is intentionally never destroyed since detached workers may still reference it during process exit.
+thread_pool &thread_pool::get_instance() {
+	static thread_pool *pool = new thread_pool();
+	return *pool;
+}
+
+/// Construct a new pool.
+thread_pool::thread_pool(double idle_timeout): idle_timeout_(idle_timeout), idle_(0) { }
+
+/// Run a function on a pooled thread.
+thread_pool::job_p thread_pool::submit(const lslboost::function<void()> &func) {
+	job_p j(new job(func));
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	pending_.push_back(j);
+	if ((int)pending_.size() <= idle_)
+		pending_cond_.notify_one();
+	else
+		lslboost::thread(&thread_pool::worker,this).detach();
+	return j;
+}
+
+/// The worker thread function.
+void thread_pool::worker() {
+	lslboost::unique_lock<lslboost::mutex> lock(mut_);
+	while (true) {
+		// wait for a job (or exit if we've been idle for too long)
+		if (pending_.empty()) {
+			idle_++;
+			bool got_job = pending_cond_.wait_for(lock,lslboost::chrono::duration<double>(idle_timeout_),lslboost::bind(&thread_pool::has_pending,this));
+			idle_--;
+			if (!got_job)
+				return;
+		}
+		job_p j = pending_.front();
+		pending_.pop_front();
+		lock.unlock();
+		// run it
+		{
+			lslboost::lock_guard<lslboost::mutex> jlock(j->mut_);
+			j->thread_id_ = lslboost::this_thread::get_id();
+		}
+		try {
+			j->func_();
+		} catch(std::exception &e) {
+			std::cerr << "Unexpected error in a pooled thread: " << e.what() << std::endl;
+		}
+		// and signal its completion
+		{
+			lslboost::lock_guard<lslboost::mutex> jlock(j->mut_);
+			j->func_.clear();
+			j->done_ = true;
+			j->thread_id_ = lslboost::thread::id();
+		}
+		j->done_cond_.notify_all();
+		lock.lock();
+	}
+}
+
+/// Wait until the job has finished or the timeout has expired.
+bool thread_pool::job::wait_for(const lslboost::chrono::milliseconds &timeout) {
+	lslboost::unique_lock<lslboost::mutex> lock(mut_);
+	return done_cond_.wait_for(lock,timeout,lslboost::bind(&job::done_,this));
+}
+
+/// Get the id of the thread that is running the job.
+lslboost::thread::id thread_pool::job::thread_id() {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	return thread_id_;
+}
@@ -0,0 +1,73 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <deque>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+
+namespace lsl {
+
+	/**
+	* A process-wide pool of worker threads for long-running jobs (such as the IO services of outlets).
+	*
+	* Creating an outlet used to spawn (and destroying it to join) several threads, which is a significant
+	* part of the cost of short-lived outlets. The pool keeps finished workers around for a while so that
+	* they can be handed the jobs of the next outlet; idle workers exit after a timeout.
+	*/
+	class thread_pool: public lslboost::noncopyable {
+	public:
+		/// A job that has been submitted to the pool.
+		class job: public lslboost::noncopyable {
+		public:
+			/// Wait until the job has finished or the timeout has expired. Returns whether the job has finished.
+			bool wait_for(const lslboost::chrono::milliseconds &timeout);
+
+			/// Get the id of the thread that is running the job (not-a-thread if it has not started or has finished).
+			lslboost::thread::id thread_id();
+
+		private:
+			friend class thread_pool;
+			explicit job(const lslboost::function<void()> &func): func_(func), done_(false) {}
+
+			lslboost::function<void()> func_;		// the function to run
+			bool done_;								// whether the job has finished
+			lslboost::thread::id thread_id_;		// the thread running the job
+			lslboost::mutex mut_;					// protects the state of the job
+			lslboost::condition_variable done_cond_;// notified when the job has finished
+		};
+		typedef lslboost::shared_ptr<job> job_p;
+
+		/// Get the process-wide pool instance.
+		static thread_pool &get_instance();
+
+		/**
+		* Run a function on a pooled thread.
+		* A new thread is started if no idle worker is available.
+		* @param func The function to run.
+		* @return A handle that can be used to wait for the completion of the job.
+		*/
+		job_p submit(const lslboost::function<void()> &func);
+
+	private:
+		/// Construct a new pool; idle workers exit after the given time in seconds.
+		explicit thread_pool(double idle_timeout=10.0);
+
+		/// The worker thread function.
+		void worker();
+
+		/// Whether there are jobs waiting to be picked up (requires a lock on mut_).
+		bool has_pending() const { return !pending_.empty(); }
+
+		double idle_timeout_;						// time after which an idle worker exits
+		std::deque<job_p> pending_;					// jobs that have not yet been picked up
+		int idle_;									// the number of idle workers
+		lslboost::mutex mut_;						// protects the pending jobs and idle count
+		lslboost::condition_variable pending_cond_;	// notified when a job has been submitted
+	};
+
+}
+
+#endif
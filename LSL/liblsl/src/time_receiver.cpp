@@ -14,9 +14,10 @@ using lslboost::posix_time::millisec;
 /**
 * Construct a new time provider from an inlet connection
 */
-time_receiver::time_receiver(inlet_connection &conn): conn_(conn), timeoffset_(std::numeric_limits<double>::max()),
-       remote_time_(std::numeric_limits<double>::max()), uncertainty_(std::numeric_limits<double>::max()), was_reset_(false),
-	   cfg_(api_config::get_instance()), time_sock_(time_io_), next_estimate_(time_io_), aggregate_results_(time_io_), next_packet_(time_io_) {
+time_receiver::time_receiver(inlet_connection &conn, const clock_fn &clock): conn_(conn), timeoffset_(std::numeric_limits<double>::max()),
+       remote_time_(std::numeric_limits<double>::max()), uncertainty_(std::numeric_limits<double>::max()), was_reset_(false), reset_count_(0),
+	   probes_sent_(0), probes_received_(0), rtt_min_(0), rtt_max_(0), rtt_sum_(0),
+	   cfg_(api_config::get_instance()), clock_(clock), time_sock_(time_io_), next_estimate_(time_io_), aggregate_results_(time_io_), next_packet_(time_io_) {
 	conn_.register_onlost(this,&timeoffset_upd_);
 	conn_.register_onrecover(this,lslboost::bind(&time_receiver::reset_timeoffset_on_recovery,this));
 	time_sock_.open(conn_.udp_protocol());
@@ -88,6 +89,35 @@ bool time_receiver::was_reset() {
 	return result;
 }
 
+/**
+* Get the most recent time correction offset without waiting for it (for callers that must not block).
+* Starts the background estimation if necessary; returns 0 while no estimate is available (e.g., after a recovery).
+*/
+double time_receiver::cached_correction() {
+	lslboost::lock_guard<lslboost::mutex> lock(timeoffset_mut_);
+	if (timeoffset_ != NOT_ASSIGNED)
+		return timeoffset_;
+	if (!time_thread_.joinable() && !conn_.lost())
+		time_thread_ = lslboost::thread(&time_receiver::time_thread,this);
+	return 0.0;
+}
+
+/// Get the number of times the clock was (potentially) reset so far (unlike was_reset(), this does not consume the event).
+lslboost::uint64_t time_receiver::reset_count() {
+	lslboost::lock_guard<lslboost::mutex> lock(timeoffset_mut_);
+	return reset_count_;
+}
+
+/// Get statistics of the time probes exchanged so far.
+void time_receiver::probe_stats(lslboost::uint64_t &sent, lslboost::uint64_t &received, double &rtt_min, double &rtt_mean, double &rtt_max) {
+	lslboost::lock_guard<lslboost::mutex> lock(timeoffset_mut_);
+	sent = probes_sent_;
+	received = probes_received_;
+	rtt_min = rtt_min_;
+	rtt_mean = probes_received_ ? rtt_sum_/probes_received_ : 0.0;
+	rtt_max = rtt_max_;
+}
+
 // === internal processing ===
 
 /// The time reader & updater thread.
@@ -139,10 +169,12 @@ void time_receiver::next_estimate_scheduled(error_code err) {
 void time_receiver::send_next_packet(int packet_num) {
 	try {
 		// form the request & send it
-		std::ostringstream request; request.precision(16); request << "LSL:timedata\r\n" << current_wave_id_ << " " << lsl_clock() << "\r\n";
+		std::ostringstream request; request.precision(16); request << "LSL:timedata\r\n" << current_wave_id_ << " " << read_clock(clock_) << "\r\n";
 		string_p msg_buffer(new std::string(request.str()));
 		time_sock_.async_send_to(lslboost::asio::buffer(*msg_buffer), conn_.get_udp_endpoint(),
 			lslboost::bind(&time_receiver::handle_send_outcome,this,msg_buffer,placeholders::error));
+		lslboost::lock_guard<lslboost::mutex> lock(timeoffset_mut_);
+		probes_sent_++;
 	} catch(std::exception &e) {
 		std::cerr << "Error trying to send a time packet: " << e.what() << std::endl;
 	}
@@ -176,7 +208,7 @@ void time_receiver::handle_receive_outcome(error_code err, std::size_t len) {
 			std::istringstream is(std::string(recv_buffer_,len));
 			int wave_id; is >> wave_id;
 			if (wave_id == current_wave_id_) {
-				double t0, t1, t2, t3 = lsl_clock();
+				double t0, t1, t2, t3 = read_clock(clock_);
 				is >> t0 >> t1 >> t2;
 				// calculate RTT and offset
 				double rtt = (t3-t0) - (t2-t1);				// round trip time (time passed here - time passed there)
@@ -184,6 +216,12 @@ void time_receiver::handle_receive_outcome(error_code err, std::size_t len) {
 				// store it
 				estimates_.push_back(std::make_pair(rtt,offset));
 				estimate_times_.push_back(std::make_pair((t3 + t0)/2.0, (t2 + t1)/2.0));   //local_time, remote_time
+				// update the statistics
+				lslboost::lock_guard<lslboost::mutex> lock(timeoffset_mut_);
+				rtt_min_ = probes_received_ ? std::min(rtt_min_,rtt) : rtt;
+				rtt_max_ = probes_received_ ? std::max(rtt_max_,rtt) : rtt;
+				rtt_sum_ += rtt;
+				probes_received_++;
 			}
 		}
 	} catch(std::exception &e) {
@@ -224,6 +262,9 @@ void time_receiver::reset_timeoffset_on_recovery() {
 	lslboost::lock_guard<lslboost::mutex> lock(timeoffset_mut_);
 	if (timeoffset_ != NOT_ASSIGNED)
 		// this will only be set to true if the reset may have caused a possible interruption in the obtained time offsets
+	{
 		was_reset_ = true;
+		reset_count_++;
+	}
 	timeoffset_ = NOT_ASSIGNED;
 }
@@ -8,6 +8,7 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/random.hpp>
 #include "inlet_connection.h"
+#include "sim_clock.h"
 
 using lslboost::asio::ip::udp;
 using lslboost::asio::deadline_timer;
@@ -30,7 +31,8 @@ namespace lsl {
 	class time_receiver {
 	public:
 		/// Construct a new time receiver for a given connection.
-		time_receiver(inlet_connection &conn);
+		/// The time probes are stamped with the given clock (default: lsl_clock()).
+		time_receiver(inlet_connection &conn, const clock_fn &clock=clock_fn());
 
 		/// Destructor. Stops the background activities.
 		~time_receiver();
@@ -53,6 +55,25 @@ namespace lsl {
 		/// This can happen if the stream got lost (e.g., app crash) and the computer got restarted or swapped out
 		bool was_reset();
 
+		/**
+		* Get the most recent time correction offset without waiting for it (for callers that must not block).
+		* Starts the background estimation if necessary; returns 0 while no estimate is available (e.g., after a recovery).
+		*/
+		double cached_correction();
+
+		/// Get the number of times the clock was (potentially) reset so far (unlike was_reset(), this does not consume the event).
+		lslboost::uint64_t reset_count();
+
+		/**
+		* Get statistics of the time probes exchanged so far.
+		* @param sent Receives the number of probes sent.
+		* @param received Receives the number of probe replies received.
+		* @param rtt_min Receives the smallest round-trip time (0 if no reply was received).
+		* @param rtt_mean Receives the mean round-trip time (0 if no reply was received).
+		* @param rtt_max Receives the largest round-trip time (0 if no reply was received).
+		*/
+		void probe_stats(lslboost::uint64_t &sent, lslboost::uint64_t &received, double &rtt_min, double &rtt_mean, double &rtt_max);
+
 	private:
 		/// The time reader / updater thread.
 		void time_thread();
@@ -93,14 +114,19 @@ namespace lsl {
 		// background reader thread and the data generated by it
 		lslboost::thread time_thread_;					// updates time offset
 		bool was_reset_;							// whether the clock was reset
+		lslboost::uint64_t reset_count_;			// the number of times the clock was reset
 		double timeoffset_;							// the current time offset (or NOT_ASSIGNED if not yet assigned)
 		double remote_time_;                        // remote computer time at the specified timeoffset_
 		double uncertainty_;                        // round trip time (a.k.a. uncertainty) at the specficied timeoffset_
 		lslboost::mutex timeoffset_mut_;				// mutex to protect the time offset
 		lslboost::condition_variable timeoffset_upd_;	// condition variable to indicate that an update for the time offset is available
+		lslboost::uint64_t probes_sent_;			// the number of time probes sent (protected by timeoffset_mut_)
+		lslboost::uint64_t probes_received_;		// the number of time probe replies received (protected by timeoffset_mut_)
+		double rtt_min_, rtt_max_, rtt_sum_;		// statistics of the probe round-trip times (protected by timeoffset_mut_)
 
 		// data used internally by the background thread
 		const api_config *cfg_;						// the configuration object
+		clock_fn clock_;							// the clock used to stamp the time probes
 		lslboost::asio::io_service time_io_;			// an IO service for async time operations
 		char recv_buffer_[16384];					// a buffer to hold inbound packet contents
 		lslboost::random::mt19937 rng_;				// a random number generator
@@ -0,0 +1,179 @@
+#include <iostream>
+#include <cmath>
+#include <boost/bind.hpp>
+#include "timer_wheel.h"
+#include "common.h"
+
+
+// === implementation of the timer_wheel class ===
+
+using namespace lsl;
+
+const lslboost::uint64_t timer_wheel::NO_WAKEUP;
+
+/// Get the process-wide timer wheel instance.
+timer_wheel &timer_wheel::get_instance() {
+	static timer_wheel wheel;
+	return wheel;
+}
+
+/// Construct a new wheel with the given tick duration (in seconds) and number of slots.
+timer_wheel::timer_wheel(double tick_duration, std::size_t num_slots): tick_duration_(tick_duration), start_time_(lsl_clock()),
+	slots_(num_slots), num_pending_(0), cursor_(0), running_id_(0), planned_wakeup_(NO_WAKEUP), shutdown_(false)
+{
+	thread_ = lslboost::thread(&timer_wheel::run,this);
+}
+
+/// Destructor. Stops the wheel thread.
+timer_wheel::~timer_wheel() {
+	try {
+		{
+			lslboost::lock_guard<lslboost::mutex> lock(mut_);
+			shutdown_ = true;
+		}
+		wakeup_.notify_all();
+		thread_.try_join_for(lslboost::chrono::milliseconds(1000));
+	} catch(std::exception &e) {
+		std::cerr << "Unexpected error during destruction of the timer wheel: " << e.what() << std::endl;
+	}
+}
+
+/// Schedule a handler to be invoked once after a given delay.
+timer_wheel::timer_id timer_wheel::schedule(double delay, const lslboost::function<void()> &handler) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	// get a free entry
+	if (free_.empty()) {
+		entry fresh;
+		fresh.generation = 1;
+		fresh.pending = false;
+		fresh.fired = false;
+		pool_.push_back(fresh);
+		free_.push_back((lslboost::uint32_t)(pool_.size()-1));
+	}
+	lslboost::uint32_t index = free_.back();
+	free_.pop_back();
+	entry &e = pool_[index];
+	// round up to the next tick (but expire no earlier than the next tick) and hash it into its slot
+	lslboost::uint64_t ticks = (lslboost::uint64_t)std::max(1.0,std::ceil(delay/tick_duration_));
+	e.tick = std::max(current_tick(),cursor_) + ticks;
+	e.handler = handler;
+	e.pending = true;
+	e.slot = (std::size_t)(e.tick % slots_.size());
+	e.pos = slots_[e.slot].insert(slots_[e.slot].end(),index);
+	num_pending_++;
+	// wake up the wheel thread if it would otherwise oversleep this deadline
+	if (e.tick < planned_wakeup_)
+		wakeup_.notify_all();
+	return ((timer_id)e.generation << 32) | index;
+}
+
+/// Cancel a timer.
+bool timer_wheel::cancel(timer_id id) {
+	lslboost::unique_lock<lslboost::mutex> lock(mut_);
+	int index = pending_index(id);
+	if (index >= 0) {
+		release((lslboost::uint32_t)index);
+		return true;
+	}
+	// the handler may be running right now: wait for it to finish (unless we're being called from it)
+	if (lslboost::this_thread::get_id() != thread_.get_id())
+		while (running_id_ == id)
+			handler_done_.wait(lock);
+	return false;
+}
+
+/// Get the pool index of a timer id, or -1 if the timer is no longer pending.
+int timer_wheel::pending_index(timer_id id) const {
+	lslboost::uint32_t index = (lslboost::uint32_t)(id & 0xFFFFFFFF);
+	if (index < pool_.size() && pool_[index].pending && pool_[index].generation == (lslboost::uint32_t)(id >> 32))
+		return (int)index;
+	return -1;
+}
+
+/// Remove a pending timer from the wheel and recycle its entry.
+void timer_wheel::release(lslboost::uint32_t index) {
+	entry &e = pool_[index];
+	if (!e.fired)
+		slots_[e.slot].erase(e.pos);
+	e.handler.clear();
+	e.pending = false;
+	e.fired = false;
+	e.generation++;
+	free_.push_back(index);
+	num_pending_--;
+}
+
+/// Get the current tick (relative to the construction of the wheel).
+lslboost::uint64_t timer_wheel::current_tick() const {
+	return (lslboost::uint64_t)((lsl_clock() - start_time_)/tick_duration_);
+}
+
+/// Get the tick at which the wheel thread next needs to wake up.
+lslboost::uint64_t timer_wheel::next_wakeup_tick() const {
+	if (!num_pending_)
+		return NO_WAKEUP;
+	// find the first slot within one revolution that holds a timer which is due in this revolution
+	for (std::size_t d=0;d<slots_.size();d++) {
+		const slot_t &slot = slots_[(cursor_+d) % slots_.size()];
+		for (slot_t::const_iterator i=slot.begin();i!=slot.end();i++)
+			if (pool_[*i].tick == cursor_+d)
+				return cursor_+d;
+	}
+	// all pending timers are at least one revolution away
+	return cursor_ + slots_.size();
+}
+
+/// The wheel thread: advances the wheel and dispatches expired timers.
+void timer_wheel::run() {
+	lslboost::unique_lock<lslboost::mutex> lock(mut_);
+	while (!shutdown_) {
+		// an empty wheel may have slept for a long time: skip right to the present
+		if (!num_pending_)
+			cursor_ = std::max(cursor_,current_tick());
+		// process all ticks up to now
+		for (lslboost::uint64_t now=current_tick(); cursor_<=now && !shutdown_; cursor_++) {
+			// take the expired timers of the current slot out of the wheel (they remain pending, and thus cancellable, until invoked)
+			slot_t &slot = slots_[(std::size_t)(cursor_ % slots_.size())];
+			std::vector<timer_id> expired;
+			for (slot_t::iterator i=slot.begin();i!=slot.end();) {
+				lslboost::uint32_t index = *i;
+				entry &e = pool_[index];
+				if (e.tick <= cursor_) {
+					expired.push_back(((timer_id)e.generation << 32) | index);
+					i = slot.erase(i);
+					e.fired = true;
+				} else
+					i++;
+			}
+			// and invoke the handlers of those that have not been cancelled in the meantime without holding the lock
+			for (std::size_t k=0;k<expired.size();k++) {
+				int index = pending_index(expired[k]);
+				if (index < 0)
+					continue;
+				lslboost::function<void()> handler;
+				handler.swap(pool_[index].handler);
+				release((lslboost::uint32_t)index);
+				running_id_ = expired[k];
+				lock.unlock();
+				try {
+					handler();
+				} catch(std::exception &ex) {
+					std::cerr << "Unexpected error in a timer handler: " << ex.what() << std::endl;
+				}
+				lock.lock();
+				running_id_ = 0;
+				handler_done_.notify_all();
+			}
+		}
+		// sleep until the next deadline is due (or until woken up by an earlier deadline)
+		planned_wakeup_ = next_wakeup_tick();
+		if (planned_wakeup_ == NO_WAKEUP)
+			wakeup_.wait(lock);
+		else {
+			double delay = start_time_ + planned_wakeup_*tick_duration_ - lsl_clock();
+			if (delay > 0)
+				wakeup_.wait_for(lock,lslboost::chrono::duration<double>(delay));
+		}
+		planned_wakeup_ = 0;
+	}
+}
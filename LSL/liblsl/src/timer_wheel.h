@@ -0,0 +1,108 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <list>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+
+namespace lsl {
+
+	/**
+	* A process-wide hashed timer wheel.
+	*
+	* Drives the low-rate housekeeping deadlines of all inlets (e.g., the connection watchdogs) from a single
+	* background thread instead of one sleeping thread per inlet. Timers are hashed into a fixed number of slots
+	* by their expiry tick and kept in a recycled pool of entries, so scheduling and cancelling a timer are O(1) operations. The thread only wakes up
+	* when the earliest pending deadline is due (or at most once per revolution of the wheel while only far-off
+	* timers are pending), and sleeps indefinitely while no timers are pending.
+	*
+	* Handlers are invoked on the wheel thread and must therefore return quickly; any blocking work (such as
+	* a resolve) should be handed off to another thread.
+	*/
+	class timer_wheel: public lslboost::noncopyable {
+	public:
+		/// Handle of a scheduled timer (0 is never a valid handle).
+		typedef lslboost::uint64_t timer_id;
+
+		/// Get the process-wide timer wheel instance.
+		static timer_wheel &get_instance();
+
+		/**
+		* Schedule a handler to be invoked once after a given delay.
+		* @param delay The delay in seconds after which the handler shall be called (rounded up to the tick resolution).
+		* @param handler The handler to invoke (on the wheel thread).
+		* @return A handle that can be used to cancel the timer.
+		*/
+		timer_id schedule(double delay, const lslboost::function<void()> &handler);
+
+		/**
+		* Cancel a timer.
+		* A timer that has expired but whose handler has not been invoked yet can still be cancelled.
+		* If the handler is currently executing on the wheel thread, this waits until it has returned
+		* (unless called from within a handler), so that the handler's resources may be released afterwards.
+		* @return True if the timer was still pending and has been removed.
+		*/
+		bool cancel(timer_id id);
+
+		/// Destructor. Stops the wheel thread.
+		~timer_wheel();
+
+	private:
+		/// A slot of the wheel holds the pool indices of the timers that hash into it.
+		typedef std::list<lslboost::uint32_t> slot_t;
+
+		/// A timer entry in the pool.
+		struct entry {
+			lslboost::uint32_t generation;				// incremented whenever the entry is recycled (the upper half of the timer_id)
+			bool pending;								// whether the entry holds a pending timer
+			bool fired;									// whether the timer has expired and waits for its handler to be invoked (it is then no longer held in a slot)
+			std::size_t slot;							// the slot in which the timer is held
+			slot_t::iterator pos;						// the position of the timer in its slot
+			lslboost::uint64_t tick;					// the absolute tick at which the timer expires
+			lslboost::function<void()> handler;			// the handler to invoke
+		};
+
+		/// Marker for "no wakeup planned" (the wheel is empty).
+		static const lslboost::uint64_t NO_WAKEUP = ~(lslboost::uint64_t)0;
+
+		/// Construct a new wheel with the given tick duration (in seconds) and number of slots.
+		timer_wheel(double tick_duration=0.01, std::size_t num_slots=512);
+
+		/// The wheel thread: advances the wheel and dispatches expired timers.
+		void run();
+
+		/// Get the current tick (relative to the construction of the wheel).
+		lslboost::uint64_t current_tick() const;
+
+		/// Get the tick at which the wheel thread next needs to wake up (requires a lock on mut_).
+		lslboost::uint64_t next_wakeup_tick() const;
+
+		/// Get the pool index of a timer id, or -1 if the timer is no longer pending (requires a lock on mut_).
+		int pending_index(timer_id id) const;
+
+		/// Remove a pending timer from the wheel and recycle its entry (requires a lock on mut_).
+		void release(lslboost::uint32_t index);
+
+		const double tick_duration_;					// the duration of a tick, in seconds
+		const double start_time_;						// the lsl_clock() time of tick 0
+		std::vector<slot_t> slots_;						// the slots of the wheel; a timer lives in slot tick % num_slots
+		std::vector<entry> pool_;						// the timer entries (pending or free)
+		std::vector<lslboost::uint32_t> free_;			// indices of the free entries in the pool
+		std::size_t num_pending_;						// the number of pending timers
+		lslboost::uint64_t cursor_;						// the next tick that has yet to be processed
+		timer_id running_id_;							// the handle of the currently executing handler, if any
+		lslboost::uint64_t planned_wakeup_;				// the tick at which the wheel thread plans to wake up next (0 while it is awake)
+		bool shutdown_;									// whether the wheel is shutting down
+		lslboost::mutex mut_;							// protects all of the above
+		lslboost::condition_variable wakeup_;			// notified when an earlier deadline was scheduled or on shutdown
+		lslboost::condition_variable handler_done_;		// notified when a handler has returned
+		lslboost::thread thread_;						// the wheel thread
+	};
+
+}
+
+#endif
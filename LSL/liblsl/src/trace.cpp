@@ -0,0 +1,152 @@
+#include "trace.h"
+
+#ifdef LSL_TRACING
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread.hpp>
+#endif
+
+
+// === implementation of the event tracing facility ===
+
+using namespace lsl;
+
+#ifdef LSL_TRACING
+
+namespace {
+
+	/// The registry of all trace rings.
+	/// Rings are never deallocated: when their thread exits, they are handed to the next new thread
+	/// so that the events of short-lived threads remain available for export.
+	struct trace_registry {
+		trace_registry(): current(&trace_registry::release_ring), origin_ticks(trace_clock()), origin_time(lsl_clock()) {}
+
+		/// Get the process-wide registry (intentionally leaked, since threads may still record during process exit).
+		static trace_registry &get_instance() {
+			static trace_registry *registry = new trace_registry();
+			return *registry;
+		}
+
+		/// Assign a ring to the calling thread.
+		trace_ring *acquire_ring() {
+			lslboost::lock_guard<lslboost::mutex> lock(mut);
+			trace_ring *result = NULL;
+			for (std::size_t k=0;k<rings.size() && !result;k++)
+				if (!rings[k]->in_use)
+					(result = rings[k])->in_use = true;
+			if (!result) {
+				result = new trace_ring((int)rings.size()+1);
+				rings.push_back(result);
+			}
+			// this is only used to hand the ring back when the thread exits
+			current.reset(result);
+			return result;
+		}
+
+		/// Called when a thread that owns a ring exits.
+		static void release_ring(trace_ring *r) {
+			lslboost::lock_guard<lslboost::mutex> lock(get_instance().mut);
+			r->in_use = false;
+		}
+
+		lslboost::thread_specific_ptr<trace_ring> current;	// the ring of the calling thread (for cleanup at thread exit)
+		std::vector<trace_ring*> rings;			// all rings ever created
+		lslboost::mutex mut;					// protects the rings list and their in_use flags
+		lslboost::uint64_t origin_ticks;		// trace_clock() reading at the creation of the registry ...
+		double origin_time;						// ... and the corresponding lsl_clock() reading (for converting ticks into seconds)
+	};
+
+	/// Writes the trace to the file named in LSL_TRACE_FILE (if any) when the library is unloaded.
+	struct trace_exit_writer {
+		~trace_exit_writer() {
+			if (const char *filename = getenv("LSL_TRACE_FILE")) {
+				try {
+					write_trace(filename);
+				} catch(std::exception &e) {
+					std::cerr << "Could not write the LSL trace: " << e.what() << std::endl;
+				}
+			}
+		}
+	} exit_writer;
+
+}
+
+LSL_TRACE_THREAD_LOCAL trace_ring *lsl::trace_thread_ring = NULL;
+
+LSL_TRACE_THREAD_LOCAL unsigned lsl::trace_thread_countdown = 0;
+
+namespace {
+	/// Read the push trace interval from the environment.
+	unsigned read_push_interval() {
+		const char *value = getenv("LSL_TRACE_INTERVAL");
+		int interval = value ? atoi(value) : 64;
+		return interval > 0 ? (unsigned)interval : 1;
+	}
+}
+
+unsigned lsl::trace_push_interval = read_push_interval();
+
+/// Assign a ring to the calling thread (called on its first event).
+trace_ring *lsl::acquire_trace_ring() {
+	return trace_thread_ring = trace_registry::get_instance().acquire_ring();
+}
+
+/// Write the events recorded so far by all threads into a file in the Chrome trace (JSON) format.
+void lsl::write_trace(const std::string &filename) {
+	FILE *f = fopen(filename.c_str(),"w");
+	if (!f)
+		throw std::runtime_error("Could not open the trace file " + filename + " for writing.");
+	trace_registry &registry = trace_registry::get_instance();
+	std::vector<trace_ring*> rings;
+	{
+		lslboost::lock_guard<lslboost::mutex> lock(registry.mut);
+		rings = registry.rings;
+	}
+	// calibrate the trace clock against lsl_clock (over at least 50ms)
+	while (lsl_clock() < registry.origin_time + 0.05)
+		lslboost::this_thread::sleep_for(lslboost::chrono::milliseconds(10));
+	lslboost::uint64_t now_ticks = trace_clock();
+	double now_time = lsl_clock();
+	double us_per_tick = (now_time - registry.origin_time) * 1e6 / (double)(now_ticks - registry.origin_ticks);
+	fprintf(f,"{\"traceEvents\":[\n");
+	bool first = true;
+	std::vector<trace_ring::event> snapshot;
+	for (std::size_t k=0;k<rings.size();k++) {
+		// copy the events of the ring while its owner may keep writing ...
+		lslboost::uint64_t end = rings[k]->head.load(lslboost::memory_order_acquire);
+		lslboost::uint64_t begin = end > trace_ring_size ? end-trace_ring_size : 0;
+		snapshot.clear();
+		for (lslboost::uint64_t i=begin;i<end;i++)
+			snapshot.push_back(rings[k]->events[i & (trace_ring_size-1)]);
+		// ... and skip those that may have been overwritten in the meantime
+		lslboost::uint64_t now = rings[k]->head.load(lslboost::memory_order_acquire);
+		std::size_t skip = (std::size_t)std::min<lslboost::uint64_t>(now > begin+trace_ring_size ? now-(begin+trace_ring_size) : 0, snapshot.size());
+		for (std::size_t i=skip;i<snapshot.size();i++) {
+			const trace_ring::event &e = snapshot[i];
+			double ts = registry.origin_time*1e6 + ((double)e.start - (double)registry.origin_ticks)*us_per_tick;
+			if (e.end)
+				fprintf(f,"%s{\"name\":\"%s\",\"cat\":\"lsl\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",first?"":",\n",e.name,ts,(double)(e.end-e.start)*us_per_tick,rings[k]->tid);
+			else
+				fprintf(f,"%s{\"name\":\"%s\",\"cat\":\"lsl\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",first?"":",\n",e.name,ts,rings[k]->tid);
+			first = false;
+		}
+	}
+	fprintf(f,"\n],\"displayTimeUnit\":\"ns\"}\n");
+	bool failed = ferror(f) != 0;
+	if (fclose(f) != 0 || failed)
+		throw std::runtime_error("Could not write the trace file " + filename + ".");
+}
+
+#else
+
+/// Write the events recorded so far (tracing is not compiled in).
+void lsl::write_trace(const std::string &) {
+	throw std::runtime_error("This build of liblsl does not support tracing (build it with LSL_TRACING enabled).");
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <boost/cstdint.hpp>
+#include "common.h"
+#ifdef LSL_TRACING
+#include <boost/atomic.hpp>
+#endif
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+
+namespace lsl {
+
+	/**
+	* Read the clock that is used for trace events.
+	* On x86 this is the time-stamp counter, which is several times cheaper to read than lsl_clock(); 
+	* it is converted into lsl_clock() time when the trace is written. Elsewhere, it is lsl_clock() in nanoseconds.
+	*/
+	inline lslboost::uint64_t trace_clock() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		return __rdtsc();
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+		return __builtin_ia32_rdtsc();
+#else
+		return (lslboost::uint64_t)(lsl_clock()*1e9);
+#endif
+	}
+
+#ifdef LSL_TRACING
+// The storage class of the trace's thread-locals; on ELF platforms they use the initial-exec model, which saves a call
+// to __tls_get_addr on every push (they take a few bytes of the static TLS block that is reserved for loaded libraries).
+#if defined(_MSC_VER)
+	#define LSL_TRACE_THREAD_LOCAL __declspec(thread)
+#elif defined(__ELF__)
+	#define LSL_TRACE_THREAD_LOCAL __thread __attribute__((tls_model("initial-exec")))
+#else
+	#define LSL_TRACE_THREAD_LOCAL __thread
+#endif
+
+	/// The number of events retained per thread (must be a power of two).
+	const lslboost::uint64_t trace_ring_size = 1<<16;
+
+	/// A per-thread ring buffer of trace events; only ever written by the thread that owns it.
+	struct trace_ring {
+		struct event {
+			const char *name;			// name of the event
+			lslboost::uint64_t start;	// start time (trace_clock)
+			lslboost::uint64_t end;		// end time (trace_clock), or 0 for an instantaneous event
+		};
+		trace_ring(int tid): head(0), tid(tid), in_use(true) {}
+		event events[trace_ring_size];	// the event slots
+		lslboost::atomic<lslboost::uint64_t> head;	// the total number of events written so far
+		int tid;						// the thread id under which the events are exported
+		bool in_use;					// whether the ring is owned by a running thread (protected by the registry mutex)
+	};
+
+	/// The ring of the calling thread (NULL until its first event); a compiler-supported thread-local is much cheaper to access than a thread_specific_ptr.
+	extern LSL_TRACE_THREAD_LOCAL trace_ring *trace_thread_ring;
+
+	/// Assign a ring to the calling thread (called on its first event).
+	trace_ring *acquire_trace_ring();
+
+	/// The number of passes of the calling thread through the push path until the next one is traced.
+	extern LSL_TRACE_THREAD_LOCAL unsigned trace_thread_countdown;
+
+	/// Every how many pushes a thread traces one (read from the environment variable LSL_TRACE_INTERVAL; default 64).
+	extern unsigned trace_push_interval;
+#endif
+
+	/**
+	* Decide whether the calling thread traces its current pass through the push path.
+	* The push path is traced on every trace_push_interval-th pass only, since reading the trace clock on every push
+	* would cost more than the push itself on some machines (e.g., where the time-stamp counter is virtualized).
+	*/
+#ifdef LSL_TRACING
+	inline bool trace_sample() {
+		unsigned &countdown = trace_thread_countdown;
+		if (countdown) {
+			--countdown;
+			return false;
+		}
+		countdown = trace_push_interval ? trace_push_interval-1 : 0;
+		return true;
+	}
+#else
+	inline bool trace_sample() { return false; }
+#endif
+
+	/**
+	* Record a trace event on the calling thread.
+	* Events are written into a per-thread ring buffer without taking any locks; once the ring is full,
+	* the oldest events are overwritten. This function does nothing unless the library was built with LSL_TRACING.
+	* @param name The name of the event (must be a string literal or otherwise outlive the process).
+	* @param start The trace_clock() time at which the event started.
+	* @param end The trace_clock() time at which the event ended, or 0 for an instantaneous event.
+	*/
+#ifdef LSL_TRACING
+	inline void trace_event(const char *name, lslboost::uint64_t start, lslboost::uint64_t end=0) {
+		trace_ring *r = trace_thread_ring;
+		if (!r)
+			r = acquire_trace_ring();
+		lslboost::uint64_t h = r->head.load(lslboost::memory_order_relaxed);
+		trace_ring::event &e = r->events[h & (trace_ring_size-1)];
+		e.name = name;
+		e.start = start;
+		e.end = end;
+		r->head.store(h+1,lslboost::memory_order_release);
+	}
+#else
+	inline void trace_event(const char *, lslboost::uint64_t, lslboost::uint64_t=0) { }
+#endif
+
+	/**
+	* Write the events recorded so far by all threads into a file in the Chrome trace (JSON) format.
+	* The file can be opened with chrome://tracing or https://ui.perfetto.dev.
+	* The recorded events are retained, so this can be called repeatedly.
+	* If the environment variable LSL_TRACE_FILE is set, the trace is also written to that file when the process exits.
+	* @param filename The name of the file to write.
+	* @throws std::runtime_error if the library was built without LSL_TRACING or if the file could not be written.
+	*/
+	void write_trace(const std::string &filename);
+
+	/// Records the lifetime of a scope as a trace event (use via LSL_TRACE_SCOPE).
+	class trace_scope {
+	public:
+		explicit trace_scope(const char *name): name_(name), start_(trace_clock()) {}
+		~trace_scope() { trace_event(name_,start_,trace_clock()); }
+	private:
+		const char *name_;				// name of the event
+		lslboost::uint64_t start_;		// time at which the scope was entered
+	};
+
+}
+
+// Probes of the sample path; these compile to nothing unless the library is built with LSL_TRACING.
+#ifdef LSL_TRACING
+	#define LSL_TRACE_CONCAT_(a,b) a##b
+	#define LSL_TRACE_CONCAT(a,b) LSL_TRACE_CONCAT_(a,b)
+	/// Trace the remainder of the enclosing scope under the given name (two clock reads; keep this off the push path).
+	#define LSL_TRACE_SCOPE(name) lsl::trace_scope LSL_TRACE_CONCAT(lsl_trace_scope_,__LINE__)(name)
+	/// Trace an instantaneous event under the given name (a single clock read and an inline ring write).
+	#define LSL_TRACE_EVENT(name) lsl::trace_event(name,lsl::trace_clock())
+	/// Decide (in the given variable) whether the current pass through the push path is traced, and if so trace the given event.
+	#define LSL_TRACE_PUSH_BEGIN(var,name) const bool var = lsl::trace_sample(); (var) ? LSL_TRACE_EVENT(name) : (void)0
+	/// Trace a further event of a pass through the push path if LSL_TRACE_PUSH_BEGIN chose it.
+	#define LSL_TRACE_PUSH_EVENT(var,name) ((var) ? LSL_TRACE_EVENT(name) : (void)0)
+#else
+	#define LSL_TRACE_SCOPE(name) ((void)0)
+	#define LSL_TRACE_EVENT(name) ((void)0)
+	#define LSL_TRACE_PUSH_BEGIN(var,name) ((void)0)
+	#define LSL_TRACE_PUSH_EVENT(var,name) ((void)0)
+#endif
+
+#endif
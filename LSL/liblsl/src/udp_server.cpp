@@ -14,16 +14,17 @@ using namespace lslboost::asio;
 
 /*
 * Create a UDP responder in unicast mode that listens next to a TCP server.
-* This server will listen on a free local port for timedata and shortinfo requests -- mainly for timing information (unless shortinfo is needed by clients).
+* This server will listen on the port of the TCP server for timedata and shortinfo requests -- mainly for timing information (unless shortinfo is needed by clients).
 * @param info The stream_info of the stream to serve (shared). After success, the appropriate service port will be assigned.
 * @param protocol The protocol stack to use (tcp::v4() or tcp::v6()).
+* @param port The port to listen on (the data port of the TCP server); throws a system_error if it is taken.
 */
-udp_server::udp_server(const stream_info_impl_p &info, io_service &io, udp protocol): info_(info), io_(io), socket_(new udp::socket(io)), time_services_enabled_(true) {
+udp_server::udp_server(const stream_info_impl_p &info, io_service &io, udp protocol, int port, const clock_fn &clock): info_(info), io_(io), socket_(new udp::socket(io)), time_services_enabled_(true), clock_(clock) {
 	// open the socket for the specified protocol
 	socket_->open(protocol);
 
-	// bind to a free port
-	int port = bind_port_in_range(*socket_,protocol);
+	// bind to the same port number as the TCP server (inlets of older versions send their time probes to the data port)
+	socket_->bind(udp::endpoint(protocol,(unsigned short)port));
 
 	// assign the service port field
 	if (protocol == udp::v4())
@@ -80,9 +81,9 @@ udp_server::udp_server(const stream_info_impl_p &info, io_service &io, const std
 
 /// Start serving UDP traffic.
 /// Call this only after the (shared) info object has been initialized by all other parties, too.
-void udp_server::begin_serving() {
-	// pre-calculate the shortinfo message (now that everyone should have initialized their part).
-	shortinfo_msg_ = info_->to_shortinfo_message();
+void udp_server::begin_serving(const std::string &shortinfo_msg) {
+	// the shortinfo message is pre-calculated by the outlet (now that everyone has initialized their part).
+	shortinfo_msg_ = shortinfo_msg;
 	// start asking for a packet
 	request_next_packet();
 }
@@ -109,7 +110,7 @@ void udp_server::handle_receive_outcome(error_code err, std::size_t len) {
 		try {
 			if (!err) {
 				// remember the time of packet reception for possible later use
-				double t1 = time_services_enabled_ ? lsl_clock() : 0.0;
+				double t1 = time_services_enabled_ ? read_clock(clock_) : 0.0;
 
 				// wrap received packet into a request stream and parse the method from it
 				std::istringstream request_stream(std::string(buffer_,buffer_+len));
@@ -135,7 +136,7 @@ void udp_server::handle_receive_outcome(error_code err, std::size_t len) {
 						int wave_id; request_stream >> wave_id;
 						double t0; request_stream >> t0;
 						// send it off (including the time of packet submission and a shared ptr to the message content owned by the handler)
-						std::ostringstream reply; reply.precision(16); reply << " " << wave_id << " " << t0 << " " << t1 << " " << lsl_clock();
+						std::ostringstream reply; reply.precision(16); reply << " " << wave_id << " " << t0 << " " << t1 << " " << read_clock(clock_);
 						string_p replymsg(new std::string(reply.str()));
 						socket_->async_send_to(lslboost::asio::buffer(*replymsg), remote_endpoint_,
 							lslboost::bind(&udp_server::handle_send_outcome,shared_from_this(),replymsg,placeholders::error));
@@ -2,6 +2,7 @@
 #define UDP_SERVER_H
 
 #include "common.h"
+#include "sim_clock.h"
 #include "stream_info_impl.h"
 #include <boost/asio/ip/udp.hpp>
 #include <boost/enable_shared_from_this.hpp>
@@ -28,11 +29,13 @@ namespace lsl {
 	public:
 		/*
 		* Create a UDP responder that listens "side by side" with a TCP server.
-		* This server will listen on a free local port for timedata and shortinfo requests -- mainly for timing information (unless shortinfo is needed by clients).
+		* This server will listen on the port of the TCP server for timedata and shortinfo requests -- mainly for timing information (unless shortinfo is needed by clients).
 		* @param info The stream_info of the stream to serve (shared). After success, the appropriate service port will be assigned.
 		* @param protocol The protocol stack to use (tcp::v4() or tcp::v6()).
+		* @param port The port to listen on (the data port of the TCP server); throws a system_error if it is taken.
+		* @param clock The clock from which the time stamps of the time service are taken (default: lsl_clock()).
 		*/
-		udp_server(const stream_info_impl_p &info, lslboost::asio::io_service &io, udp protocol);
+		udp_server(const stream_info_impl_p &info, lslboost::asio::io_service &io, udp protocol, int port, const clock_fn &clock=clock_fn());
 
 		/**
 		* Create a new UDP server in multicast mode.
@@ -43,7 +46,8 @@ namespace lsl {
 
 		/// Start serving UDP traffic.
 		/// Call this only after the (shared) info object has been initialized by every involved party.
-		void begin_serving();
+		/// @param shortinfo_msg The pre-computed shortinfo message of the stream (shared by all servers of an outlet).
+		void begin_serving(const std::string &shortinfo_msg);
 
 		/// Initiate teardown of UDP traffic.
 		void end_serving();
@@ -67,6 +71,7 @@ namespace lsl {
 		bool time_services_enabled_;		// whether the time services are enabled
 		udp::endpoint remote_endpoint_;		// the endpoint that we're currently talking to
 		std::string shortinfo_msg_;			// pre-computed server response
+		clock_fn clock_;					// the clock used by the time services
 	};
 }
 
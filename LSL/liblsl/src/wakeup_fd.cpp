@@ -0,0 +1,72 @@
+#include <stdexcept>
+#include <string>
+#include <boost/cstdint.hpp>
+#include "wakeup_fd.h"
+#ifndef _WIN32
+	#include <cerrno>
+	#include <cstring>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+#ifdef __linux__
+	#include <sys/eventfd.h>
+#endif
+
+
+// === implementation of the wakeup_fd class ===
+
+using namespace lsl;
+
+/// Create the descriptor (initially unreadable). Throws a std::runtime_error if the platform does not support it.
+wakeup_fd::wakeup_fd(): read_fd_(-1), write_fd_(-1), signalled_(false) {
+#if defined(__linux__)
+	read_fd_ = write_fd_ = eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+	if (read_fd_ < 0)
+		throw std::runtime_error(std::string("Could not create an eventfd: ") + strerror(errno));
+#elif !defined(_WIN32)
+	int fds[2];
+	if (pipe(fds) != 0)
+		throw std::runtime_error(std::string("Could not create a pipe: ") + strerror(errno));
+	for (int k=0;k<2;k++) {
+		fcntl(fds[k],F_SETFL,fcntl(fds[k],F_GETFL) | O_NONBLOCK);
+		fcntl(fds[k],F_SETFD,FD_CLOEXEC);
+	}
+	read_fd_ = fds[0];
+	write_fd_ = fds[1];
+#else
+	throw std::runtime_error("Pollable inlets are not supported on this platform.");
+#endif
+}
+
+/// Close the descriptor.
+wakeup_fd::~wakeup_fd() {
+#ifndef _WIN32
+	close(read_fd_);
+	if (write_fd_ != read_fd_)
+		close(write_fd_);
+#endif
+}
+
+/// Make the descriptor readable (a no-op if it already is). Thread-safe.
+void wakeup_fd::signal() {
+#ifndef _WIN32
+	if (!signalled_.exchange(true)) {
+		// an eventfd takes exactly 8 bytes (a pipe takes anything)
+		lslboost::uint64_t one = 1;
+		if (write(write_fd_,&one,sizeof(one)) < 0 && errno != EAGAIN)
+			signalled_ = false;
+	}
+#endif
+}
+
+/// Make the descriptor unreadable (only one thread at a time may call this).
+void wakeup_fd::reset() {
+#ifndef _WIN32
+	if (signalled_.load()) {
+		// drain the descriptor before clearing the flag, so that a concurrent signal() is either drained or re-arms it
+		char buf[64];
+		while (read(read_fd_,buf,sizeof(buf)) > 0);
+		signalled_ = false;
+	}
+#endif
+}
@@ -0,0 +1,40 @@
+#ifndef WAKEUP_FD_H
+#define WAKEUP_FD_H
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+
+namespace lsl {
+
+	/**
+	* A file descriptor that can be made readable from one thread and unreadable again from another one,
+	* so that event loops (epoll, select, Qt, asio, libuv, ...) can wait for samples to arrive.
+	* This is an eventfd on Linux and a pipe on other POSIX systems; other platforms are not supported.
+	*/
+	class wakeup_fd: public lslboost::noncopyable {
+	public:
+		/// Create the descriptor (initially unreadable). Throws a std::runtime_error if the platform does not support it.
+		wakeup_fd();
+
+		/// Close the descriptor.
+		~wakeup_fd();
+
+		/// Get the descriptor that event loops can wait on for readability.
+		int fd() const { return read_fd_; }
+
+		/// Make the descriptor readable (a no-op if it already is). Thread-safe.
+		void signal();
+
+		/// Make the descriptor unreadable (only one thread at a time may call this).
+		void reset();
+
+	private:
+		int read_fd_;						// the descriptor that becomes readable
+		int write_fd_;						// the descriptor that is written to (the same as read_fd_ for an eventfd)
+		lslboost::atomic<bool> signalled_;	// whether the descriptor has been made readable
+	};
+
+}
+
+#endif
@@ -0,0 +1,69 @@
+#include "../../include/lsl_cpp.h"
+#include <boost/thread.hpp>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// Two threads write reservations into one multi-producer outlet at the same time; the inlet checks that every
+// sample arrives once, with the values its thread wrote, and that the samples of each thread stay in order.
+
+const int num_threads = 2;
+const int num_rounds = 20000;
+const int samples_per_round = 4;
+
+// write num_rounds reservations whose samples hold (thread index, sequence number)
+void producer(lsl::stream_outlet *outlet, int index) {
+	int seq = 0;
+	for (int r=0; r<num_rounds; r++) {
+		lsl::outlet_reservation<int32_t> reservation(*outlet,samples_per_round);
+		for (int k=0; k<samples_per_round; k++) {
+			reservation[k][0] = index;
+			reservation[k][1] = seq++;
+		}
+		// yield between reserving and committing now and then, so that the threads' reservations overlap
+		if (r % 64 == 0)
+			boost::this_thread::yield();
+		reservation.commit();
+	}
+}
+
+int main(int argc, char* argv[]) {
+	try {
+		lsl::stream_info info("MultiProducerTest","Test",2,lsl::IRREGULAR_RATE,lsl::cf_int32,"MultiProducerTest");
+		lsl::stream_outlet outlet(info,0,360,lsl::transport_multi_producer);
+		vector<lsl::stream_info> results = lsl::resolve_stream("source_id","MultiProducerTest",1,5.0);
+		if (results.empty()) {
+			cout << "The test stream could not be resolved." << endl;
+			return 1;
+		}
+		lsl::stream_inlet inlet(results[0]);
+		inlet.set_lossless(true);
+		inlet.open_stream(5.0);
+
+		boost::thread_group producers;
+		for (int t=0; t<num_threads; t++)
+			producers.create_thread(boost::bind(&producer,&outlet,t));
+
+		vector<int> next(num_threads,0);
+		vector<int32_t> sample(2);
+		int errors = 0;
+		for (int received=0; received<num_threads*num_rounds*samples_per_round; received++) {
+			if (inlet.pull_sample(sample,5.0) == 0.0) {
+				cout << "Timed out after " << received << " samples." << endl;
+				errors++;
+				break;
+			}
+			if (sample[0] < 0 || sample[0] >= num_threads || sample[1] != next[sample[0]]) {
+				if (errors++ < 10)
+					cout << "Unexpected sample (" << sample[0] << "," << sample[1] << ")." << endl;
+			} else
+				next[sample[0]]++;
+		}
+		producers.join_all();
+		cout << (errors ? "FAILED" : "passed") << endl;
+		return errors ? 1 : 0;
+	} catch(std::exception &e) {
+		cout << "Error: " << e.what() << endl;
+		return 1;
+	}
+}